@@ -119,33 +119,42 @@ int main(int argc, char** argv)
 	size_t len = 1024;
 	ssize_t read;
 	int capacity = 32, size = 0;
-	ccv_dense_matrix_t** posimg = (ccv_dense_matrix_t**)ccmalloc(sizeof(ccv_dense_matrix_t*) * capacity);
+	char** posfiles = (char**)ccmalloc(sizeof(char*) * capacity);
 	while ((read = getline(&file, &len, r0)) != -1)
 	{
 		while(read > 1 && isspace(file[read - 1]))
 			read--;
 		file[read] = 0;
-		char* posfile = (char*)ccmalloc(1024);
+		posfiles[size] = (char*)ccmalloc(1024);
 		if (base_dir != 0)
 		{
-			strncpy(posfile, base_dir, 1024);
-			posfile[dirlen - 1] = '/';
+			strncpy(posfiles[size], base_dir, 1024);
+			posfiles[size][dirlen - 1] = '/';
 		}
-		strncpy(posfile + dirlen, file, 1024 - dirlen);
-		posimg[size] = 0;
-		ccv_read(posfile, &posimg[size], CCV_IO_GRAY | CCV_IO_ANY_FILE);
-		if (posimg != 0)
+		strncpy(posfiles[size] + dirlen, file, 1024 - dirlen);
+		++size;
+		if (size >= capacity)
 		{
-			++size;
-			if (size >= capacity)
-			{
-				capacity *= 2;
-				posimg = (ccv_dense_matrix_t**)ccrealloc(posimg, sizeof(ccv_dense_matrix_t*) * capacity);
-			}
+			capacity *= 2;
+			posfiles = (char**)ccrealloc(posfiles, sizeof(char*) * capacity);
 		}
 	}
 	fclose(r0);
-	int posnum = size;
+	// decode the positive examples with a pool of threads
+	ccv_dense_matrix_t** posimg = (ccv_dense_matrix_t**)ccmalloc(sizeof(ccv_dense_matrix_t*) * ccv_max(size, 1));
+	ccv_image_loader_param_t loader_params = {
+		.ordered = 1,
+	};
+	ccv_image_loader_t* loader = ccv_image_loader_new((const void* const*)posfiles, 0, size, CCV_IO_GRAY | CCV_IO_ANY_FILE, loader_params);
+	int posnum = 0;
+	ccv_dense_matrix_t* image = 0;
+	while (ccv_image_loader_next(loader, &image) >= 0)
+		if (image != 0)
+			posimg[posnum++] = image;
+	ccv_image_loader_free(loader);
+	for (i = 0; i < size; i++)
+		ccfree(posfiles[i]);
+	ccfree(posfiles);
 	capacity = 32;
 	size = 0;
 	char** bgfiles = (char**)ccmalloc(sizeof(char*) * capacity);
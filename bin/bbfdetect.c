@@ -36,6 +36,7 @@ int main(int argc, char** argv)
 			chdir(argv[3]);
 		if(r)
 		{
+			ccv_array_t* files = ccv_array_new(sizeof(char*), 64, 0);
 			size_t len = 1024;
 			char* file = (char*)malloc(len);
 			ssize_t read;
@@ -44,8 +45,20 @@ int main(int argc, char** argv)
 				while(read > 1 && isspace(file[read - 1]))
 					read--;
 				file[read] = 0;
-				image = 0;
-				ccv_read(file, &image, CCV_IO_GRAY | CCV_IO_ANY_FILE);
+				char* name = strdup(file);
+				ccv_array_push(files, &name);
+			}
+			free(file);
+			fclose(r);
+			// decode the next images while detecting on this one
+			ccv_image_loader_param_t loader_params = {
+				.ordered = 1,
+			};
+			ccv_image_loader_t* loader = ccv_image_loader_new((const void* const*)ccv_array_get(files, 0), 0, files->rnum, CCV_IO_GRAY | CCV_IO_ANY_FILE, loader_params);
+			int k;
+			while ((k = ccv_image_loader_next(loader, &image)) >= 0)
+			{
+				file = *(char**)ccv_array_get(files, k);
 				assert(image != 0);
 				ccv_array_t* seq = ccv_bbf_detect_objects(image, &cascade, 1, ccv_bbf_default_params);
 				printf("%s %d\n", file, seq->rnum);
@@ -57,8 +70,10 @@ int main(int argc, char** argv)
 				ccv_array_free(seq);
 				ccv_matrix_free(image);
 			}
-			free(file);
-			fclose(r);
+			ccv_image_loader_free(loader);
+			for (k = 0; k < files->rnum; k++)
+				free(*(char**)ccv_array_get(files, k));
+			ccv_array_free(files);
 		}
 	}
 	ccv_bbf_classifier_cascade_free(cascade);
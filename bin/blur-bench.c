@@ -0,0 +1,74 @@
+#include "ccv.h"
+#include <sys/time.h>
+
+static unsigned int get_current_time(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static unsigned int bench_mode(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, double sigma, int mode, int repeat)
+{
+	// warm up, thus, the thread pool and the page mapping of the output won't be measured
+	ccv_blur_with_mode(a, b, 0, sigma, mode);
+	int i;
+	unsigned int elapsed_time = get_current_time();
+	for (i = 0; i < repeat; i++)
+		ccv_blur_with_mode(a, b, 0, sigma, mode);
+	return get_current_time() - elapsed_time;
+}
+
+static void bench(ccv_dense_matrix_t* image, int type, double sigma, int repeat)
+{
+	ccv_dense_matrix_t* a = 0;
+	ccv_shift(image, (ccv_matrix_t**)&a, type, 0, 0);
+	a->sig = 0; // otherwise, the result will be cached
+	ccv_dense_matrix_t* x = 0;
+	ccv_dense_matrix_t* y = 0;
+	unsigned int kernel_time = bench_mode(a, &x, sigma, CCV_BLUR_KERNEL, repeat);
+	unsigned int recursive_time = bench_mode(a, &y, sigma, CCV_BLUR_RECURSIVE, repeat);
+	// the accuracy of the recursive one, against the kernel
+	int i, j;
+	double max_diff = 0, sum_diff = 0;
+	const int n = a->cols * CCV_GET_CHANNEL(a->type);
+	for (i = 0; i < a->rows; i++)
+		for (j = 0; j < n; j++)
+		{
+			double diff = fabs(ccv_get_value(x->type, x->data.u8 + i * x->step, j) - ccv_get_value(y->type, y->data.u8 + i * y->step, j));
+			max_diff = ccv_max(max_diff, diff);
+			sum_diff += diff;
+		}
+	printf("%4dx%-4d C%d %s %5.1f %8.3f ms %8.3f ms %6.2fx, max diff %7.4f mean diff %7.4f\n", a->rows, a->cols, CCV_GET_CHANNEL(a->type),
+		CCV_GET_DATA_TYPE(type) == CCV_8U ? "8U " : "32F", sigma, (double)kernel_time / repeat, (double)recursive_time / repeat,
+		(double)kernel_time / ccv_max(recursive_time, 1), max_diff, sum_diff / (a->rows * n));
+	ccv_matrix_free(a);
+	ccv_matrix_free(x);
+	ccv_matrix_free(y);
+}
+
+int main(int argc, char** argv)
+{
+	assert(argc >= 2);
+	ccv_dense_matrix_t* image = 0;
+	ccv_read(argv[1], &image, CCV_IO_ANY_FILE);
+	assert(image != 0);
+	int repeat = argc > 2 ? atoi(argv[2]) : 5;
+	static double sigmas[] = {1, 2, 4, 8, 16, 32};
+	ccv_dense_matrix_t* gray = 0;
+	ccv_read(argv[1], &gray, CCV_IO_GRAY | CCV_IO_ANY_FILE);
+	int i, j;
+	printf("   size   ch type sigma kernel      recursive   speedup\n");
+	for (i = 0; i < 2; i++)
+	{
+		ccv_dense_matrix_t* input = i == 0 ? gray : image;
+		for (j = 0; j < sizeof(sigmas) / sizeof(sigmas[0]); j++)
+		{
+			bench(input, CCV_8U, sigmas[j], repeat);
+			bench(input, CCV_32F, sigmas[j], repeat);
+		}
+	}
+	ccv_matrix_free(image);
+	ccv_matrix_free(gray);
+	return 0;
+}
@@ -11,6 +11,11 @@ static unsigned int get_current_time(void)
 
 #define BATCH_SIZE (8)
 
+static void input_formation(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, void* context)
+{
+	ccv_convnet_input_formation(*(ccv_size_t*)context, a, b);
+}
+
 int main(int argc, char** argv)
 {
 	assert(argc >= 3);
@@ -50,6 +55,7 @@ int main(int argc, char** argv)
 			ccv_dense_matrix_t* images[BATCH_SIZE] = {
 				0
 			};
+			ccv_array_t* files = ccv_array_new(sizeof(char*), 64, 0);
 			size_t len = 1024;
 			char* file = (char*)malloc(len);
 			ssize_t read;
@@ -58,14 +64,31 @@ int main(int argc, char** argv)
 				while(read > 1 && isspace(file[read - 1]))
 					read--;
 				file[read] = 0;
+				char* name = strdup(file);
+				ccv_array_push(files, &name);
+			}
+			free(file);
+			fclose(r);
+			// decode and form the inputs of the next batches while classifying this one, the input formation scales
+			// them down to the input size anyway, thus, decode them no larger than that
+			ccv_image_loader_param_t loader_params = {
+				.ordered = 1,
+				.capacity = BATCH_SIZE * 2,
+				.read = {
+					.rows = convnet->input.height,
+					.cols = convnet->input.width,
+				},
+				.transform = input_formation,
+				.context = &convnet->input,
+			};
+			ccv_image_loader_t* loader = ccv_image_loader_new((const void* const*)ccv_array_get(files, 0), 0, files->rnum, CCV_IO_ANY_FILE | CCV_IO_RGB_COLOR, loader_params);
+			ccv_dense_matrix_t* input = 0;
+			while (ccv_image_loader_next(loader, &input) >= 0)
+			{
+				assert(input != 0);
 				if (images[k % BATCH_SIZE] != 0)
 					ccv_matrix_free(images[k % BATCH_SIZE]);
-				ccv_dense_matrix_t* image = 0;
-				ccv_read(file, &image, CCV_IO_ANY_FILE | CCV_IO_RGB_COLOR);
-				assert(image != 0);
-				images[k % BATCH_SIZE] = 0;
-				ccv_convnet_input_formation(convnet->input, image, images + (k % BATCH_SIZE));
-				ccv_matrix_free(image);
+				images[k % BATCH_SIZE] = input;
 				++k;
 				if (k % BATCH_SIZE == 0)
 				{
@@ -111,9 +134,11 @@ int main(int argc, char** argv)
 				for (i = 0; i < ccv_min(BATCH_SIZE, k); i++)
 					ccv_matrix_free(images[i]);
 			}
+			ccv_image_loader_free(loader);
+			for (i = 0; i < files->rnum; i++)
+				free(*(char**)ccv_array_get(files, i));
+			ccv_array_free(files);
 			ccv_convnet_free(convnet);
-			free(file);
-			fclose(r);
 		}
 	}
 	ccv_drain_cache();
@@ -0,0 +1,60 @@
+#include "ccv.h"
+#include <sys/time.h>
+#include <ctype.h>
+
+static unsigned int get_current_time(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void bench(int size, int type, int transpose)
+{
+	ccv_dense_matrix_t* a = ccv_dense_matrix_new(size, size, type | CCV_C1, 0, 0);
+	ccv_dense_matrix_t* b = ccv_dense_matrix_new(size, size, type | CCV_C1, 0, 0);
+	int i;
+	for (i = 0; i < size * size; i++)
+	{
+		ccv_set_value(type, a->data.u8, i, (i % 13) / 13.0 - 0.5, 0);
+		ccv_set_value(type, b->data.u8, i, (i % 11) / 11.0 - 0.5, 0);
+	}
+	ccv_dense_matrix_t* x = 0;
+	ccv_dense_matrix_t* y = 0;
+	// warm up both, thus, the thread pool and the page mapping of the output won't be measured
+	ccv_gemm(a, b, 1, 0, 0, transpose, (ccv_matrix_t**)&x, 0);
+	ccv_gemm_native(a, b, 1, 0, 0, transpose, (ccv_matrix_t**)&y, 0);
+	unsigned int elapsed_time = get_current_time();
+	ccv_gemm(a, b, 1, 0, 0, transpose, (ccv_matrix_t**)&x, 0);
+	unsigned int gemm_time = get_current_time() - elapsed_time;
+	elapsed_time = get_current_time();
+	ccv_gemm_native(a, b, 1, 0, 0, transpose, (ccv_matrix_t**)&y, 0);
+	unsigned int native_time = get_current_time() - elapsed_time;
+	double diff = 0;
+	for (i = 0; i < size * size; i++)
+		diff = ccv_max(diff, fabs(ccv_get_value(type, x->data.u8, i) - ccv_get_value(type, y->data.u8, i)));
+	const double gflop = 2.0 * size * size * size * 1e-6;
+	printf("%5d %s %c%c %8u ms %8.2f gflops %8u ms %8.2f gflops, max diff %g\n", size, type == CCV_32F ? "32F" : "64F",
+		(transpose & CCV_A_TRANSPOSE) ? 'T' : 'N', (transpose & CCV_B_TRANSPOSE) ? 'T' : 'N',
+		gemm_time, gflop / ccv_max(gemm_time, 1), native_time, gflop / ccv_max(native_time, 1), diff);
+	ccv_matrix_free(a);
+	ccv_matrix_free(b);
+	ccv_matrix_free(x);
+	ccv_matrix_free(y);
+}
+
+int main(int argc, char** argv)
+{
+	static int sizes[] = {128, 256, 512, 1024, 2048};
+	int i, j, k;
+	printf(" size type  ccv_gemm                      ccv_gemm_native\n");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		if (argc > 1 && atoi(argv[1]) > 0 && sizes[i] > atoi(argv[1]))
+			break;
+		for (j = 0; j < 2; j++)
+			for (k = 0; k < 4; k++)
+				bench(sizes[i], j == 0 ? CCV_32F : CCV_64F, k);
+	}
+	return 0;
+}
@@ -0,0 +1,59 @@
+#include "ccv.h"
+#include <sys/time.h>
+
+static unsigned int get_current_time(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void bench(ccv_dense_matrix_t* image, int type, double scale, int inter, int repeat)
+{
+	ccv_dense_matrix_t* a = 0;
+	ccv_shift(image, (ccv_matrix_t**)&a, type, 0, 0);
+	a->sig = 0; // otherwise, the result will be cached
+	const int rows = (int)(a->rows * scale + 0.5), cols = (int)(a->cols * scale + 0.5);
+	ccv_dense_matrix_t* b = 0;
+	// warm up, thus, the thread pool and the page mapping of the output won't be measured
+	ccv_resample(a, &b, 0, rows, cols, inter);
+	int i;
+	unsigned int elapsed_time = get_current_time();
+	for (i = 0; i < repeat; i++)
+		ccv_resample(a, &b, 0, rows, cols, inter);
+	elapsed_time = get_current_time() - elapsed_time;
+	printf("%4dx%-4d C%d %s %s %4.2f -> %4dx%-4d %8.3f ms %8.2f Mpixel/s\n", a->rows, a->cols, CCV_GET_CHANNEL(a->type),
+		CCV_GET_DATA_TYPE(type) == CCV_8U ? "8U " : "32F", (inter & CCV_INTER_AREA) ? "area " : "cubic", scale, rows, cols,
+		(double)elapsed_time / repeat, (double)a->rows * a->cols * repeat / ccv_max(elapsed_time, 1) * 1e-3);
+	ccv_matrix_free(a);
+	ccv_matrix_free(b);
+}
+
+int main(int argc, char** argv)
+{
+	assert(argc >= 2);
+	ccv_dense_matrix_t* image = 0;
+	ccv_read(argv[1], &image, CCV_IO_ANY_FILE);
+	assert(image != 0);
+	int repeat = argc > 2 ? atoi(argv[2]) : 20;
+	static double scales[] = {0.5, 0.8409, 0.3};
+	ccv_dense_matrix_t* gray = 0;
+	ccv_read(argv[1], &gray, CCV_IO_GRAY | CCV_IO_ANY_FILE);
+	int i, j;
+	for (i = 0; i < 2; i++)
+	{
+		ccv_dense_matrix_t* input = i == 0 ? gray : image;
+		for (j = 0; j < sizeof(scales) / sizeof(scales[0]); j++)
+		{
+			bench(input, CCV_8U, scales[j], CCV_INTER_AREA, repeat);
+			bench(input, CCV_8U, scales[j], CCV_INTER_CUBIC, repeat);
+			bench(input, CCV_32F, scales[j], CCV_INTER_AREA, repeat);
+			bench(input, CCV_32F, scales[j], CCV_INTER_CUBIC, repeat);
+		}
+		bench(input, CCV_8U, 1.5, CCV_INTER_CUBIC, repeat);
+		bench(input, CCV_32F, 1.5, CCV_INTER_CUBIC, repeat);
+	}
+	ccv_matrix_free(image);
+	ccv_matrix_free(gray);
+	return 0;
+}
@@ -65,6 +65,8 @@ static const int _ccv_get_data_type_size[] = { -1, 1, 4, -1, 4, -1, -1, -1, 8, -
 #define CCV_GET_CHANNEL(x) ((x) & 0xFFF)
 #define CCV_GET_STEP(cols, type) (((cols) * CCV_GET_DATA_TYPE_SIZE(type) * CCV_GET_CHANNEL(type) + 3) & -4)
 #define CCV_ALL_DATA_TYPE (CCV_8U | CCV_32S | CCV_32F | CCV_64S | CCV_64F)
+#define CCV_ALIGN_SIZE (64) // cache line, and the width of AVX-512 register
+#define CCV_GET_ALIGNED_STEP(cols, type) (((cols) * CCV_GET_DATA_TYPE_SIZE(type) * CCV_GET_CHANNEL(type) + CCV_ALIGN_SIZE - 1) & -CCV_ALIGN_SIZE)
 
 enum {
 	CCV_MATRIX_DENSE  = 0x00100000,
@@ -155,6 +157,16 @@ typedef union {
 	} terminal;
 } ccv_cache_index_t;
 
+typedef struct {
+	uint64_t hits; /**< Number of lookups that found the object. */
+	uint64_t misses; /**< Number of lookups that didn't find the object. The cache cannot tell which type a missed lookup was for, therefore, this is counted by the caller (ccv_memory.c for the application-wide cache). */
+	uint64_t puts; /**< Number of objects put into the cache. */
+	uint64_t rejects; /**< Number of objects rejected because they are larger than the cache upper limit. */
+	uint64_t evictions; /**< Number of objects evicted by LRU to make room. */
+	size_t size; /**< Bytes currently held in the cache. */
+	size_t peak; /**< The most bytes ever held in the cache (since last reset). */
+} ccv_cache_stats_t;
+
 typedef struct {
 	ccv_cache_index_t origin;
 	uint32_t rnum;
@@ -162,6 +174,7 @@ typedef struct {
 	size_t up;
 	size_t size;
 	ccv_cache_index_free_f ffree[16];
+	ccv_cache_stats_t stats[16];
 } ccv_cache_t;
 
 /* I made it as generic as possible */
@@ -192,6 +205,12 @@ void* ccv_cache_get(ccv_cache_t* cache, uint64_t sign, uint8_t* type);
  * @return 0 - success, 1 - replace, -1 - failure.
  */
 int ccv_cache_put(ccv_cache_t* cache, uint64_t sign, void* x, uint32_t size, uint8_t type);
+/**
+ * Evict the least recently used objects from cache (and free them) until it holds no more than the given bytes.
+ * @param cache The cache.
+ * @param size The bytes to keep at most.
+ */
+void ccv_cache_evict(ccv_cache_t* cache, size_t size);
 /**
  * Get an object from cache for its signature and then remove that object from the cache. 0 if cannot find the object.
  * @param cache The cache.
@@ -272,6 +291,27 @@ CCV_WARN_UNUSED(ccv_dense_matrix_t*) ccv_dense_matrix_renew(ccv_dense_matrix_t*
  * @return The newly created matrix object.
  */
 CCV_WARN_UNUSED(ccv_dense_matrix_t*) ccv_dense_matrix_new(int rows, int cols, int type, void* data, uint64_t sig);
+#define ccv_compute_aligned_dense_matrix_size(rows, cols, type) (((sizeof(ccv_dense_matrix_t) + CCV_ALIGN_SIZE - 1) & -CCV_ALIGN_SIZE) + CCV_GET_ALIGNED_STEP(cols, type) * (rows))
+/**
+ * Check if every row of the matrix starts at CCV_ALIGN_SIZE boundary, thus, aligned vector loads can be used on it.
+ * @param x The dense matrix.
+ */
+#define ccv_dense_matrix_is_aligned(x) ((((uintptr_t)(x)->data.u8 | (uintptr_t)(x)->step) & (CCV_ALIGN_SIZE - 1)) == 0)
+/**
+ * Check if the rows of the matrix follow one another with no padding (step is CCV_GET_STEP), thus, the data can be walked as one array.
+ * @param x The dense matrix.
+ */
+#define ccv_dense_matrix_is_packed(x) ((x)->step == CCV_GET_STEP((x)->cols, (x)->type))
+/**
+ * Create a dense matrix with its data pointer aligned to CCV_ALIGN_SIZE (64 bytes), and each row padded to a multiple of 64 bytes (thus, step is larger than cols * channels * data type size). Rows processed by different threads therefore never share a cache line. The matrix is never put into the application-wide cache, because a matrix with the same signature can be asked without padding.
+ * Image processing, resampling, transform, algebra (ccv_gemm included), ccv_hog and the other functions that walk rows with step accept such matrix, as input or output, the same as a matrix from ccv_slice. Functions that take the data as one array assert the matrix is packed (see ccv_dense_matrix_is_packed): ccv_eigen for its output vectors and ccv_minimize for its x. ccv_write keeps the padding with an aligned binary file, and packs the rows otherwise.
+ * @param rows Rows of the matrix.
+ * @param cols Columns of the matrix.
+ * @param type The type of the matrix, the same as ccv_dense_matrix_new.
+ * @param sig The signature, using 0 if you don't know what it is.
+ * @return The newly created matrix object.
+ */
+CCV_WARN_UNUSED(ccv_dense_matrix_t*) ccv_dense_matrix_new_aligned(int rows, int cols, int type, uint64_t sig);
 /**
  * This method will return a dense matrix allocated on stack, with a data pointer to a custom memory region.
  * @param rows Rows of the matrix.
@@ -436,7 +476,7 @@ uint64_t ccv_cache_generate_signature(const char* msg, int len, uint64_t sig_sta
 #define CCV_DEFAULT_CACHE_SIZE (1024 * 1024 * 64)
 
 /**
- * Drain up the cache.
+ * Drain up the cache, both the one for current thread and the process-wide one.
  */
 void ccv_drain_cache(void);
 /**
@@ -452,6 +492,36 @@ void ccv_enable_default_cache(void);
  * @param size The upper limit of the cache, in bytes.
  */
 void ccv_enable_cache(size_t size);
+/**
+ * Get the statistics of the application-wide cache, and optionally reset the counters. It combines the cache of current thread and the process-wide cache. For the process-wide cache, peak is the sum of the peaks of its shards.
+ * @param stats The statistics broken down by cache type, stats[0] for dense matrices and stats[1] for arrays.
+ * @param reset If non-zero, reset the counters after taking the snapshot (current bytes are kept, and the peak restarts from it).
+ */
+void ccv_cache_stats(ccv_cache_stats_t stats[2], int reset);
+/**
+ * Enable a process-wide cache for ccv, shared by all threads. Matrices and arrays freed on one thread can be picked up by another thread that computes the same derived signature. The cache is split into shards by signature, each with its own lock, and the byte budget is one for all shards, thus, an object can take up to the whole budget. A thread that has its own cache enabled with ccv_enable_cache will keep using that one. Enable it again to change the budget, which drains the cache.
+ * @param size The upper limit of the cache across all threads, in bytes.
+ */
+void ccv_enable_shared_cache(size_t size);
+/**
+ * Drain up and disable the process-wide cache. Other threads can still be using ccv, what they free afterwards is freed right away.
+ */
+void ccv_disable_shared_cache(void);
+
+/**
+ * Start a scope in which ccv_dense_matrix_new and ccv_array_new allocate from a thread-local arena instead of the heap. Everything allocated in the scope is released in one step by the matching ccv_arena_end, ccv_matrix_free and ccv_array_free on these objects do nothing. Scopes can be nested. The memory is kept for the next outermost scope on this thread, grown to the most the previous scope used, so a steady workload settles on one region without calling malloc. Objects allocated in the scope are tagged so, ccv_matrix_free and ccv_array_free leave them alone even on another thread or after the scope ended, but they must not be used otherwise after ccv_arena_end, copy anything you want to keep (such as the result of a detector) out before ending the scope. That includes state a model keeps between calls, for example, call ccv_convnet_compact in the scope where ccv_convnet_classify ran.
+ */
+void ccv_arena_begin(void);
+/**
+ * End the innermost arena scope of current thread, release everything allocated since its ccv_arena_begin.
+ */
+void ccv_arena_end(void);
+/**
+ * Allocate memory from the arena of current thread, it has to be in an arena scope. The memory is 16-byte aligned, and released with the scope.
+ * @param size The size of the memory.
+ * @return The pointer to the memory.
+ */
+CCV_WARN_UNUSED(void*) ccv_arena_alloc(size_t size);
 
 #define ccv_get_dense_matrix_cell_by(type, x, row, col, ch) \
 	(((type) & CCV_32S) ? (void*)((x)->data.i32 + ((row) * (x)->cols + (col)) * CCV_GET_CHANNEL(type) + (ch)) : \
@@ -501,7 +571,8 @@ enum {
 };
 
 enum {
-	// modifier for not copy the data over when read raw in-memory data
+	// modifier for not copy the data over when read raw in-memory data, or map
+	// the file in place when read binary on-disk data
 	CCV_IO_NO_COPY = 0x10000,
 };
 
@@ -529,6 +600,10 @@ enum {
 	CCV_IO_BGRA_RAW       = 0x045,
 	CCV_IO_ABGR_RAW       = 0x046,
 	CCV_IO_GRAY_RAW       = 0x047,
+	// 4:2:0 YUV, the y plane followed by the chroma planes of half the rows and the scanline (NV12 / NV21 has at least (cols + 1) / 2 * 2 for it)
+	CCV_IO_I420_RAW       = 0x048,
+	CCV_IO_NV12_RAW       = 0x049,
+	CCV_IO_NV21_RAW       = 0x04A,
 };
 
 enum {
@@ -543,9 +618,10 @@ enum {
  * @file ccv_doxygen.h
  * @fn int ccv_read(const char* in, ccv_dense_matrix_t** x, int type)
  * Read image from a file. This function has soft dependencies on [LibJPEG](http://libjpeg.sourceforge.net/) and [LibPNG](http://www.libpng.org/pub/png/libpng.html). No these libraries, no JPEG nor PNG read support. However, ccv does support BMP read natively (it is a simple format after all).
+ * For CCV_IO_BINARY_FILE, CCV_IO_NO_COPY maps the file into memory rather than reading it, the matrix data points into the mapping and pages are loaded when touched. Such matrix should be released with ccv_matrix_unmap. Its signature is derived from the file identity (device, inode, size and modification time) rather than its content. A file whose data is not aligned to its element (64-bit data in a file written without alignment) is read as usual instead. A binary file is not converted, thus, CCV_IO_NO_COPY with CCV_IO_GRAY or CCV_IO_RGB_COLOR gives CCV_IO_ERROR for it.
  * @param in The file name.
  * @param x The output image.
- * @param type CCV_IO_ANY_FILE, accept any file format. CCV_IO_GRAY, convert to grayscale image. CCV_IO_RGB_COLOR, convert to color image.
+ * @param type CCV_IO_ANY_FILE, accept any file format. CCV_IO_GRAY, convert to grayscale image. CCV_IO_RGB_COLOR, convert to color image. CCV_IO_NO_COPY, map binary file in place.
  */
 /**
  * @fn int ccv_read(const void* data, ccv_dense_matrix_t** x, int type, int size)
@@ -557,10 +633,11 @@ enum {
  */
 /**
  * @fn int ccv_read(const void* data, ccv_dense_matrix_t** x, int type, int rows, int cols, int scanline)
- * Read image from a region of memory that assumes specific layout (RGB, GRAY, BGR, RGBA, ARGB, RGBA, ABGR, BGRA). By default, this method will create a matrix and copy data over to that matrix. With CCV_IO_NO_COPY, it will create a matrix that has data block pointing to the original data memory region. It is your responsibility to release that data memory at an appropriate time after release the matrix.
+ * Read image from a region of memory that assumes specific layout (RGB, GRAY, BGR, RGBA, ARGB, RGBA, ABGR, BGRA, or 4:2:0 YUV as I420, NV12, NV21). By default, this method will create a matrix and copy data over to that matrix. With CCV_IO_NO_COPY, it will create a matrix that has data block pointing to the original data memory region. It is your responsibility to release that data memory at an appropriate time after release the matrix.
+ * For YUV, the default output is RGB (BT.601, limited range), CCV_IO_GRAY copies the y plane, and CCV_IO_NO_COPY wraps the y plane as a grayscale matrix, which is what grayscale detectors take.
  * @param data The data memory.
  * @param x The output image.
- * @param type CCV_IO_ANY_RAW, CCV_IO_RGB_RAW, CCV_IO_BGR_RAW, CCV_IO_RGBA_RAW, CCV_IO_ARGB_RAW, CCV_IO_BGRA_RAW, CCV_IO_ABGR_RAW, CCV_IO_GRAY_RAW. These in conjunction can be used with CCV_IO_NO_COPY.
+ * @param type CCV_IO_ANY_RAW, CCV_IO_RGB_RAW, CCV_IO_BGR_RAW, CCV_IO_RGBA_RAW, CCV_IO_ARGB_RAW, CCV_IO_BGRA_RAW, CCV_IO_ABGR_RAW, CCV_IO_GRAY_RAW, CCV_IO_I420_RAW, CCV_IO_NV12_RAW, CCV_IO_NV21_RAW. These in conjunction can be used with CCV_IO_NO_COPY.
  * @param rows How many rows in the given data memory region.
  * @param cols How many columns in the given data memory region.
  * @param scanline The size of a single column in the given data memory region (or known as "bytes per row").
@@ -573,15 +650,151 @@ int ccv_read_impl(const void* in, ccv_dense_matrix_t** x, int type, int rows, in
 // this is a way to implement function-signature based dispatch, you can call either
 // ccv_read(in, x, type) or ccv_read(in, x, type, rows, cols, scanline)
 // notice that you can implement this with va_* functions, but that is not type-safe
+
+typedef struct {
+	int rows; /**< The least number of rows the decoded image needs, 0 if any. */
+	int cols; /**< The least number of columns the decoded image needs, 0 if any. */
+	int x; /**< The left of the region of interest, in full resolution. */
+	int y; /**< The top of the region of interest, in full resolution. */
+	int width; /**< The width of the region of interest, 0 to decode the whole image. */
+	int height; /**< The height of the region of interest, 0 to decode the whole image. */
+} ccv_io_read_param_t;
+
+/**
+ * Read image from a file or a region of memory, decode it only as large as needed. A JPEG image is scaled down by 1/8 .. 7/8 in DCT domain while decoding, as long as the region is still at least rows x cols, thus, the output can be larger than asked, and only the rows (and with libjpeg-turbo, the columns) covering the region of interest are decoded. Other formats are decoded whole then sliced to the region of interest, the size is ignored.
+ * @param in The file name or the data memory.
+ * @param x The output image.
+ * @param type CCV_IO_ANY_FILE or CCV_IO_ANY_STREAM (and the specific formats). CCV_IO_GRAY, convert to grayscale image. CCV_IO_RGB_COLOR, convert to color image.
+ * @param size The size of that data memory region for streams, 0 for files.
+ * @param params The size and the region of interest, see ccv_io_read_param_t.
+ */
+int ccv_read_with_param(const void* in, ccv_dense_matrix_t** x, int type, int size, ccv_io_read_param_t params);
 /**
  * Write image to a file. This function has soft dependencies on [LibJPEG](http://libjpeg.sourceforge.net/) and [LibPNG](http://www.libpng.org/pub/png/libpng.html). No these libraries, no JPEG nor PNG write support.
  * @param mat The input image.
  * @param out The file name.
  * @param len The output bytes.
- * @param type CCV_IO_PNG_FILE, save to PNG format. CCV_IO_JPEG_FILE, save to JPEG format.
- * @param conf configuration.
+ * @param type CCV_IO_PNG_FILE, save to PNG format. CCV_IO_JPEG_FILE, save to JPEG format. CCV_IO_BINARY_FILE, save to ccv's own binary format. CCV_IO_PNG_STREAM, CCV_IO_JPEG_STREAM, encode into the memory region out of *len bytes directly, *len is set to the bytes written (or needed if it doesn't fit, with CCV_IO_ERROR returned). The encoder is kept per thread and reused by the next stream write of the thread, use ccv_image_encoder_new to own one instead.
+ * @param conf configuration. For CCV_IO_JPEG_FILE, an int quality (95 by default). For CCV_IO_PNG_FILE, an int memory level for compression (0 for the fastest). For CCV_IO_BINARY_FILE, an int alignment (power of 2, for example, the page size) in bytes for the data section, which makes the file mappable in place with CCV_IO_NO_COPY.
  */
 int ccv_write(ccv_dense_matrix_t* mat, char* out, int* len, int type, void* conf);
+
+typedef struct ccv_image_encoder_s ccv_image_encoder_t;
+
+/**
+ * Create an encoder that encodes images into memory. It is set up once (for JPEG, the libjpeg compressor is kept) and reused by every image after. Images that are not 8-bit are converted with the same truncation as ccv_set_value, JPEG takes 1 or 3 channels of them.
+ * @param type CCV_IO_JPEG_STREAM or CCV_IO_PNG_STREAM.
+ * @param conf The same configuration as ccv_write takes for the format, 0 for the default.
+ * @return The encoder.
+ */
+CCV_WARN_UNUSED(ccv_image_encoder_t*) ccv_image_encoder_new(int type, void* conf);
+/**
+ * Encode an image into a growable buffer, thus, a buffer can be reused for every image.
+ * @param encoder The encoder.
+ * @param mat The image.
+ * @param out The buffer, it is ccrealloc'ed if it is too small (or 0), and yours to ccfree.
+ * @param size The size of the buffer, updated as it grows.
+ * @param len The bytes written.
+ * @return CCV_IO_FINAL, or CCV_IO_ERROR if the encoder fails.
+ */
+int ccv_image_encode(ccv_image_encoder_t* encoder, ccv_dense_matrix_t* mat, unsigned char** out, size_t* size, size_t* len);
+/**
+ * Free the encoder.
+ * @param encoder The encoder.
+ */
+void ccv_image_encoder_free(ccv_image_encoder_t* encoder);
+/**
+ * Release a matrix read with CCV_IO_BINARY_FILE | CCV_IO_NO_COPY, unmap its data and free the matrix. It is safe to call on a matrix ccv_read fell back to copy.
+ * @param mat The matrix to be released.
+ */
+void ccv_matrix_unmap(ccv_dense_matrix_t* mat);
+
+typedef struct ccv_image_loader_s ccv_image_loader_t;
+
+typedef struct {
+	int threads; /**< The number of decoding threads, 0 for one per online processor. */
+	int capacity; /**< The most decoded images held ahead of the consumer, 0 for twice the number of threads. */
+	int ordered; /**< 1 to hand out images in the given order, 0 to hand them out as they complete. */
+	ccv_io_read_param_t read; /**< Decode no larger than needed, and only the region of interest, see ccv_read_with_param. */
+	int rows; /**< Resample the decoded image to rows x cols, 0 to keep its size. */
+	int cols; /**< Resample the decoded image to rows x cols, 0 to keep its size. */
+	void (*transform)(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, void* context); /**< Called on the decoding thread with the decoded (and resampled) image, its output is handed out instead, 0 for none. */
+	void* context; /**< The context passed to transform. */
+} ccv_image_loader_param_t;
+
+/**
+ * Create a loader which decodes images with a pool of threads, into a bounded ring of ready matrices. Decoding starts right away, and stops when the ring is full until ccv_image_loader_next takes images out of it.
+ * @param in The file names, or the data memory regions (these are not copied, they have to outlive the loader).
+ * @param size The size of each data memory region for CCV_IO_ANY_STREAM, 0 for files.
+ * @param count The number of images.
+ * @param type CCV_IO_ANY_FILE or CCV_IO_ANY_STREAM (and the specific formats). CCV_IO_GRAY, convert to grayscale image. CCV_IO_RGB_COLOR, convert to color image.
+ * @param params The ccv_image_loader_param_t.
+ * @return The loader, 0 if its decoding threads cannot be started.
+ */
+CCV_WARN_UNUSED(ccv_image_loader_t*) ccv_image_loader_new(const void* const* in, const int* size, int count, int type, ccv_image_loader_param_t params);
+/**
+ * Take the next decoded image out of the loader, wait until it is ready.
+ * @param loader The loader.
+ * @param x The output image, 0 if it cannot be decoded. It is yours to free.
+ * @return The index of the image in the given list, -1 if all images are handed out.
+ */
+int ccv_image_loader_next(ccv_image_loader_t* loader, ccv_dense_matrix_t** x);
+/**
+ * Stop decoding, free the images not handed out yet and the loader.
+ * @param loader The loader.
+ */
+void ccv_image_loader_free(ccv_image_loader_t* loader);
+
+typedef struct ccv_record_writer_s ccv_record_writer_t;
+typedef struct ccv_record_reader_s ccv_record_reader_t;
+
+/**
+ * Create a writer which packs many matrices into one record file: a header, the matrices each starting at a 64-byte boundary, and an index of them at the end. A data set in one such file is read with sequential I/O and random access by index rather than a file open per matrix.
+ * @param filename The file name.
+ * @param compression 0 to store matrices as they are (thus, they can be mapped in place), 1 to 9 to deflate each of them with that zlib level (needs zlib, which comes with libpng). A matrix deflate doesn't make smaller is stored as it is.
+ * @return The writer, 0 if the file cannot be opened.
+ */
+CCV_WARN_UNUSED(ccv_record_writer_t*) ccv_record_writer_new(const char* filename, int compression);
+/**
+ * Append a matrix to the record file.
+ * @param writer The writer.
+ * @param mat The matrix.
+ * @return The index of the record, -1 if it cannot be written (or it is bigger than 1GiB), the next record is written where this one would have been then.
+ */
+int ccv_record_write(ccv_record_writer_t* writer, ccv_dense_matrix_t* mat);
+/**
+ * Write the index, finish the record file and free the writer. A record file is not readable until then.
+ * @param writer The writer.
+ * @return 0 if the record file is finished, -1 if the index or the header cannot be written, or the file cannot be closed. The writer is freed either way.
+ */
+int ccv_record_writer_free(ccv_record_writer_t* writer);
+/**
+ * Open a record file for random access. Records can be read from many threads at the same time.
+ * @param filename The file name.
+ * @param type 0 to read records from the file with positioned reads. CCV_IO_NO_COPY to map the file into memory, pages are loaded when touched, and records can be read in place (see ccv_record_read). A file that cannot be mapped is read as with 0.
+ * @return The reader, 0 if it is not a (finished) record file, or any record in its index is out of the file, bigger than 1GiB, or inconsistent with its type.
+ */
+CCV_WARN_UNUSED(ccv_record_reader_t*) ccv_record_reader_new(const char* filename, int type);
+/**
+ * The number of records in the file.
+ * @param reader The reader.
+ * @return The number of records.
+ */
+int ccv_record_count(ccv_record_reader_t* reader);
+/**
+ * Read a record by its index.
+ * @param reader The reader.
+ * @param i The index of the record.
+ * @param x The output matrix.
+ * @param type 0 to copy the record into a new matrix. CCV_IO_NO_COPY to point the matrix data into the mapping instead (deflated records, and records of a reader that doesn't map the file, are still copied), such matrix is released with ccv_matrix_free, and before the reader is. Its signature is derived from the file identity and the index rather than its content.
+ * @return CCV_IO_FINAL, or CCV_IO_ERROR if the record cannot be read.
+ */
+int ccv_record_read(ccv_record_reader_t* reader, int i, ccv_dense_matrix_t** x, int type);
+/**
+ * Free the reader and unmap the file.
+ * @param reader The reader.
+ */
+void ccv_record_reader_free(ccv_record_reader_t* reader);
 /** @} */
 
 /**
@@ -631,6 +844,15 @@ double ccv_normalize(ccv_matrix_t* a, ccv_matrix_t** b, int btype, int flag);
  * @param padding_pattern CCV_NO_PADDING - the first row and the first column in the output matrix is the same as the input matrix. CCV_PADDING_ZERO - the first row and the first column in the output matrix is zero, thus, the output matrix size is 1 larger than the input matrix.
  */
 void ccv_sat(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int padding_pattern);
+/**
+ * Generate the summed area table and the summed area table of squares in one pass. For 8-bit input, both are computed row block by row block in parallel with SIMD prefix sums, the squares never materialize as a separate matrix.
+ * @param a The input matrix.
+ * @param b The output summed area table, the same as ccv_sat.
+ * @param c The output summed area table of squares.
+ * @param type The type of both output matrices, if 0, b is chosen the same way as ccv_sat, and c is 64-bit integer for 8-bit or 32-bit integer input.
+ * @param padding_pattern CCV_NO_PADDING or CCV_PADDING_ZERO, the same as ccv_sat.
+ */
+void ccv_sat_square(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, ccv_dense_matrix_t** c, int type, int padding_pattern);
 /**
  * Dot product of two matrix.
  * @param a The input matrix.
@@ -690,7 +912,7 @@ enum {
 };
 
 /**
- * General purpose matrix multiplication. This function has a hard dependency on [cblas](http://www.netlib.org/blas/) library.
+ * General purpose matrix multiplication. This function uses [cblas](http://www.netlib.org/blas/) library if available, otherwise, it falls back to ccv_gemm_native.
  *
  * As general as it is, it computes:
  *
@@ -703,11 +925,23 @@ enum {
  * @param alpha The multiplication factor.
  * @param c The input matrix.
  * @param beta The multiplication factor.
- * @param transpose CCV_A_TRANSPOSE, CCV_B_TRANSPOSE to indicate if matrix A or B need to be transposed first before multiplication.
+ * @param transpose CCV_A_TRANSPOSE, CCV_B_TRANSPOSE, CCV_C_TRANSPOSE to indicate if matrix A, B or C need to be transposed first before multiplication. C cannot be transposed if it is also the output matrix.
  * @param d The output matrix.
  * @param type The type of output matrix, if 0, ccv will try to match the input matrix for appropriate type.
  */
 void ccv_gemm(ccv_matrix_t* a, ccv_matrix_t* b, double alpha, ccv_matrix_t* c, double beta, int transpose, ccv_matrix_t** d, int type);
+/**
+ * Matrix multiplication with ccv's own implementation regardless of whether there is a BLAS library. It is cache blocked, vectorized (SSE2, AVX2 if the CPU supports, NEON) and multi-threaded. The parameters are the same as ccv_gemm.
+ * @param a The input matrix.
+ * @param b The input matrix.
+ * @param alpha The multiplication factor.
+ * @param c The input matrix.
+ * @param beta The multiplication factor.
+ * @param transpose CCV_A_TRANSPOSE, CCV_B_TRANSPOSE, CCV_C_TRANSPOSE to indicate if matrix A, B or C need to be transposed first before multiplication.
+ * @param d The output matrix.
+ * @param type The type of output matrix, if 0, ccv will try to match the input matrix for appropriate type.
+ */
+void ccv_gemm_native(ccv_matrix_t* a, ccv_matrix_t* b, double alpha, ccv_matrix_t* c, double beta, int transpose, ccv_matrix_t** d, int type);
 /** @} */
 
 typedef struct {
@@ -902,6 +1136,7 @@ inline static int ccv_rect_is_zero(ccv_rect_t rect)
 
 typedef struct {
 	int type;
+	int arena; // array is allocated in the arena, see ccv_arena_begin
 	uint64_t sig;
 	int refcount;
 	int rnum;
@@ -932,6 +1167,16 @@ typedef int(*ccv_array_group_f)(const void*, const void*, void*);
  * @param data Any extra user data.
  */
 int ccv_array_group(ccv_array_t* array, ccv_array_t** index, ccv_array_group_f gfunc, void* data);
+typedef ccv_rect_t(*ccv_array_group_hint_f)(const void*, void*);
+/**
+ * Group elements in the array from its similarity, only compares elements that are spatially close. Each element is bucketed into a grid by a hint rectangle, and only elements with overlapping hint rectangles are compared. The result is the same as ccv_array_group as long as whenever gfunc(a, b, data) returns 1, hfunc(a, data) and hfunc(b, data) overlap.
+ * @param array The array.
+ * @param index The output index, same group element will have the same index.
+ * @param gfunc int ccv_array_group_f(const void* a, const void* b, void* data). Return 1 if a and b are in the same group.
+ * @param hfunc ccv_rect_t ccv_array_group_hint_f(const void* a, void* data). Return the non-empty hint rectangle of a. If it is 0, falls back to ccv_array_group.
+ * @param data Any extra user data.
+ */
+int ccv_array_group_spatial(ccv_array_t* array, ccv_array_t** index, ccv_array_group_f gfunc, ccv_array_group_hint_f hfunc, void* data);
 void ccv_make_array_immutable(ccv_array_t* array);
 void ccv_make_array_mutable(ccv_array_t* array);
 /**
@@ -1082,6 +1327,65 @@ void ccv_minimize(ccv_dense_matrix_t* x, int length, double red, ccv_minimize_f
  * @param padding_pattern ccv doesn't support padding pattern for now.
  */
 void ccv_filter(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b, ccv_dense_matrix_t** d, int type, int padding_pattern);
+typedef struct ccv_filter_plan_s ccv_filter_plan_t;
+/**
+ * Prepare to convolve images of a given size with dense matrix b many times. The plan holds the spectrum of b and the FFT plans, thus, applying it only costs the forward and inverse transform of the image. A plan can be executed from many threads at the same time.
+ * @param b Dense matrix b, the kernel. It is not referenced after this call.
+ * @param rows The rows of the images to convolve.
+ * @param cols The columns of the images to convolve.
+ * @param atype The type of the images to convolve (with the channel).
+ * @param type The type of output matrix, if 0, ccv will try to match the input matrix for appropriate type.
+ * @return The filter plan.
+ */
+CCV_WARN_UNUSED(ccv_filter_plan_t*) ccv_filter_plan_new(ccv_dense_matrix_t* b, int rows, int cols, int atype, int type);
+/**
+ * Convolve on dense matrix a with the kernel of the plan, the result is the same as ccv_filter.
+ * @param plan The filter plan.
+ * @param a Dense matrix a, it has to be of the size and the channel the plan is made for.
+ * @param d The output matrix.
+ * @param padding_pattern ccv doesn't support padding pattern for now.
+ */
+void ccv_filter_plan_execute(ccv_filter_plan_t* plan, ccv_dense_matrix_t* a, ccv_dense_matrix_t** d, int padding_pattern);
+/**
+ * Free the filter plan.
+ * @param plan The filter plan.
+ */
+void ccv_filter_plan_free(ccv_filter_plan_t* plan);
+typedef struct ccv_filter_bank_s ccv_filter_bank_t;
+/**
+ * Prepare to convolve images of a given size with a bank of kernels. Kernels of the same size share the forward transform of each tile of the image, the spectra of them are multiplied and transformed back in parallel. It can be executed from many threads at the same time.
+ * @param b The kernels, they have to have the same channel as the images. They are not referenced after this call.
+ * @param count The number of kernels.
+ * @param rows The rows of the images to convolve.
+ * @param cols The columns of the images to convolve.
+ * @param atype The type of the images to convolve (with the channel).
+ * @param type The type of output matrices, if 0, ccv will try to match the input matrix for appropriate type.
+ * @return The filter bank.
+ */
+CCV_WARN_UNUSED(ccv_filter_bank_t*) ccv_filter_bank_new(ccv_dense_matrix_t** b, int count, int rows, int cols, int atype, int type);
+/**
+ * Convolve on dense matrix a with every kernel of the bank, each output is the same as ccv_filter with that kernel.
+ * @param bank The filter bank.
+ * @param a Dense matrix a, it has to be of the size and the channel the bank is made for.
+ * @param d The array of output matrices, one for each kernel.
+ * @param padding_pattern ccv doesn't support padding pattern for now.
+ */
+void ccv_filter_bank_execute(ccv_filter_bank_t* bank, ccv_dense_matrix_t* a, ccv_dense_matrix_t** d, int padding_pattern);
+/**
+ * Free the filter bank.
+ * @param bank The filter bank.
+ */
+void ccv_filter_bank_free(ccv_filter_bank_t* bank);
+/**
+ * Convolve on dense matrix a with a number of kernels, the forward transform of a is shared. It is a shorthand of ccv_filter_bank_new, ccv_filter_bank_execute and ccv_filter_bank_free.
+ * @param a Dense matrix a.
+ * @param b The kernels.
+ * @param count The number of kernels.
+ * @param d The array of output matrices, one for each kernel.
+ * @param type The type of output matrices, if 0, ccv will try to match the input matrix for appropriate type.
+ * @param padding_pattern ccv doesn't support padding pattern for now.
+ */
+void ccv_filter_bank(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int count, ccv_dense_matrix_t** d, int type, int padding_pattern);
 typedef double(*ccv_filter_kernel_f)(double x, double y, void*);
 /**
  * Fill a given dense matrix with a kernel function.
@@ -1108,6 +1412,23 @@ void ccv_filter_kernel(ccv_dense_matrix_t* x, ccv_filter_kernel_f func, void* da
  * @param flag CCV_GSEDT, generalized squared Euclidean distance transform. CCV_NEGATIVE, negate value in input matrix for computation; effectively, this enables us to compute the maximum distance transform rather than minimum (default one).
  */
 void ccv_distance_transform(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, ccv_dense_matrix_t** x, int x_type, ccv_dense_matrix_t** y, int y_type, double dx, double dy, double dxx, double dyy, int flag);
+/**
+ * Run distance transform on a batch of matrices, each with its own coefficients, such as the part responses of a DPM model. The result is the same as calling ccv_distance_transform on each of them, but the whole batch is scheduled on the thread pool together.
+ * @param a The array of input matrices.
+ * @param b The array of output matrices, the same length as a.
+ * @param type The type of output matrices, if 0, ccv will try to match the input matrix for appropriate type.
+ * @param x The array of x coordinate offsets, 0 if not needed.
+ * @param x_type The type of output x coordinate offset, if 0, ccv will default to CCV_32S | CCV_C1.
+ * @param y The array of y coordinate offsets, 0 if not needed.
+ * @param y_type The type of output y coordinate offset, if 0, ccv will default to CCV_32S | CCV_C1.
+ * @param dx The x coefficients, one per matrix.
+ * @param dy The y coefficients, one per matrix.
+ * @param dxx The x^2 coefficients, one per matrix.
+ * @param dyy The y^2 coefficients, one per matrix.
+ * @param count The number of matrices.
+ * @param flag The same as flag in ccv_distance_transform.
+ */
+void ccv_distance_transform_batch(ccv_dense_matrix_t** a, ccv_dense_matrix_t** b, int type, ccv_dense_matrix_t** x, int x_type, ccv_dense_matrix_t** y, int y_type, const double* dx, const double* dy, const double* dxx, const double* dyy, int count, int flag);
 /** @} */
 void ccv_sparse_coding(ccv_matrix_t* x, int k, ccv_matrix_t** A, int typeA, ccv_matrix_t** y, int typey);
 void ccv_compressive_sensing_reconstruct(ccv_matrix_t* a, ccv_matrix_t* x, ccv_matrix_t** y, int type);
@@ -1139,6 +1460,21 @@ void ccv_sobel(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int dx,
  */
 void ccv_gradient(ccv_dense_matrix_t* a, ccv_dense_matrix_t** theta, int ttype, ccv_dense_matrix_t** m, int mtype, int dx, int dy);
 
+enum {
+	CCV_GRADIENT_HISTOGRAM_SIGNED = 0x01, /**< Bin the orientation over 360 degrees, otherwise, opposite directions share a bin and it is binned over 180 degrees. */
+	CCV_GRADIENT_HISTOGRAM_MAGNITUDE = 0x02, /**< Put the accumulated magnitude in the first channel, before the bins. */
+};
+/**
+ * Compute the histogram of gradient orientations over cells of size x size pixels, it is the fused version of ccv_gradient (with dx = dy = 1) followed by the binning of ccv_hog. It goes row by row, thus, the gradient of a row lives in small buffers and is accumulated into the cells right away, instead of going through 4 full-size intermediate matrices. For multi-channel input, the channel with the largest magnitude is taken at each pixel. The magnitude is split between the two nearest orientation bins, and between the 4 nearest cells (by the distance to their centers), the same as ccv_hog. With size 1, every pixel is a cell of its own.
+ * @param a The input matrix.
+ * @param b The output matrix, it has a->rows / size rows, a->cols / size columns and nbin channels (nbin + 1 with CCV_GRADIENT_HISTOGRAM_MAGNITUDE).
+ * @param type The type of output matrix, CCV_32F (default) or CCV_64F.
+ * @param nbin The number of orientation bins.
+ * @param size The cell size.
+ * @param flag CCV_GRADIENT_HISTOGRAM_SIGNED, CCV_GRADIENT_HISTOGRAM_MAGNITUDE or both.
+ */
+void ccv_gradient_histogram(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int nbin, int size, int flag);
+
 enum {
 	CCV_FLIP_X = 0x01,
 	CCV_FLIP_Y = 0x02,
@@ -1151,6 +1487,21 @@ enum {
  * @param type CCV_FLIP_X - flip around x-axis, CCV_FLIP_Y - flip around y-axis.
  */
 void ccv_flip(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int btype, int type);
+enum {
+	CCV_BLUR_KERNEL = 0x01,
+	CCV_BLUR_RECURSIVE = 0x02,
+};
+
+/**
+ * Gaussian blur with a selectable implementation. CCV_BLUR_KERNEL is ccv_blur, it convolves with a kernel of radius 4 * sigma, thus, it is exact to the kernel but its cost grows with sigma. CCV_BLUR_RECURSIVE is the recursive filter of Young and van Vliet, its cost per pixel is constant, and it wins from sigma around 2 on, by more as sigma grows (bin/blur-bench compares both). The price is accuracy: its impulse response is an approximation of the Gaussian, with an error of a few percent of the peak, mostly in the tails. On natural images, it is within 1 level of the exact Gaussian on average, with larger differences at sharp edges that shrink as sigma grows. For 8-bit output at large sigma, it is closer to the exact Gaussian than CCV_BLUR_KERNEL, which quantizes its kernel, and it rounds to the nearest where ccv_blur truncates. It is not meant for sigma below 1, where the approximation is poor (sigma has to be at least 0.5).
+ * @param a The input matrix.
+ * @param b The output matrix.
+ * @param type The type of output matrix, if 0, ccv will try to match the input matrix for appropriate type.
+ * @param sigma The sigma factor in Gaussian filtering kernel.
+ * @param mode CCV_BLUR_KERNEL or CCV_BLUR_RECURSIVE.
+ */
+void ccv_blur_with_mode(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, double sigma, int mode);
+
 /**
  * Using [Gaussian blur](https://en.wikipedia.org/wiki/Gaussian_blur) on a given matrix. It implements a O(n * sqrt(m)) algorithm, n is the size of input matrix, m is the size of Gaussian filtering kernel.
  * @param a The input matrix.
@@ -1169,6 +1520,8 @@ void ccv_blur(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, double si
 
 enum {
 	CCV_RGB_TO_YUV = 0x01,
+	CCV_RGB_TO_GRAY = 0x02,
+	CCV_RGB_TO_LUV = 0x03,
 };
 
 /**
@@ -1176,7 +1529,7 @@ enum {
  * @param a The input matrix.
  * @param b The output matrix.
  * @param type The type of output matrix, if 0, ccv will use the sample type as the input matrix.
- * @param flag **CCV_RGB_TO_YUV** to convert from RGB color space to YUV color space.
+ * @param flag **CCV_RGB_TO_YUV** to convert from RGB color space to YUV color space. **CCV_RGB_TO_GRAY** to convert to a single channel luminance with the same weights as CCV_IO_GRAY. **CCV_RGB_TO_LUV** to convert to CIE LUV color space with each channel scaled to 0~255, the output defaults to 32-bit float.
  */
 void ccv_color_transform(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int flag);
 /**
@@ -1237,6 +1590,88 @@ void ccv_sample_down(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, in
  * @param src_y Shift the start point by src_y.
  */
 void ccv_sample_up(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int src_x, int src_y);
+/**
+ * Build an image pyramid with interval levels between two octaves, the way detectors scan an image. Level 0 is the input itself, levels 1 to interval are resampled from it with CCV_INTER_AREA by a factor of 2^(i / (interval + 1)), and any further level is ccv_sample_down of the level one octave (interval + 1 levels) above. All levels of one octave are computed in parallel.
+ * @param a The input matrix.
+ * @param pyr The array of output levels. Without shifted variants, level i is pyr[i], otherwise, level i is pyr[i * 4] and its variants sampled down from a start point shifted by (1, 0), (0, 1) and (1, 1) are pyr[i * 4 + 1], pyr[i * 4 + 2] and pyr[i * 4 + 3]. pyr[0] is a, the others are to be freed by the caller.
+ * @param levels The number of levels.
+ * @param interval The number of levels between two octaves.
+ * @param shifted The first level to have the shifted variants, 0 for none. It has to be at least interval + 1.
+ */
+void ccv_pyramid_build(ccv_dense_matrix_t* a, ccv_dense_matrix_t** pyr, int levels, int interval, int shifted);
+
+enum {
+	CCV_IMAGE_PYRAMID_GRAY = 0x01,
+	CCV_IMAGE_PYRAMID_LUV = 0x02,
+	CCV_IMAGE_PYRAMID_HOG = 0x03,
+	CCV_IMAGE_PYRAMID_SAT = 0x04,
+	CCV_IMAGE_PYRAMID_SHIFTED = 0x05,
+};
+
+typedef struct ccv_image_pyramid_s ccv_image_pyramid_t;
+/**
+ * Create an image pyramid object that computes its levels, and the products derived from them, on demand. The levels are the same as ccv_pyramid_build would give. It is meant to be built once per image and passed to several detectors (ccv_bbf_detect_objects_in_pyramid, ccv_scd_detect_objects_in_pyramid, ccv_icf_detect_objects_in_pyramid and ccv_dpm_detect_objects_in_pyramid), so the scaling work is done only once. All methods on it are thread-safe, and it is reference counted. Don't create or use it in an arena scope (ccv_arena_begin), the levels it keeps have to outlive the scope.
+ * @param a The input matrix, it is not copied and has to outlive the pyramid.
+ * @param interval The number of levels between two octaves.
+ * @return An image pyramid with a reference count of 1.
+ */
+CCV_WARN_UNUSED(ccv_image_pyramid_t*) ccv_image_pyramid_new(ccv_dense_matrix_t* a, int interval);
+/**
+ * Take one more reference to the image pyramid, for example, before handing it to another thread.
+ * @param pyramid The image pyramid.
+ * @return The same image pyramid.
+ */
+ccv_image_pyramid_t* ccv_image_pyramid_retain(ccv_image_pyramid_t* pyramid);
+/**
+ * Drop one reference to the image pyramid, the levels and the derived products are freed with the last one.
+ * @param pyramid The image pyramid.
+ */
+void ccv_image_pyramid_free(ccv_image_pyramid_t* pyramid);
+/**
+ * The input matrix an image pyramid was created with (its level 0).
+ * @param pyramid The image pyramid.
+ * @return The input matrix.
+ */
+ccv_dense_matrix_t* ccv_image_pyramid_source(ccv_image_pyramid_t* pyramid);
+/**
+ * The number of levels between two octaves of an image pyramid.
+ * @param pyramid The image pyramid.
+ * @return The interval.
+ */
+int ccv_image_pyramid_interval(ccv_image_pyramid_t* pyramid);
+/**
+ * Compute the levels 0, step, 2 * step ... (count - 1) * step of an image pyramid ahead of time, and the levels they depend on. The missing levels of one octave are computed in parallel, which ccv_image_pyramid_level, computing one level at a time, cannot do.
+ * @param pyramid The image pyramid.
+ * @param count The number of levels wanted.
+ * @param step The distance between two wanted levels, for example, interval + 1 to only have the octaves.
+ */
+void ccv_image_pyramid_reserve(ccv_image_pyramid_t* pyramid, int count, int step);
+/**
+ * Get one level of an image pyramid, it is computed if it is not there yet.
+ * @param pyramid The image pyramid.
+ * @param level The level, level 0 is the input itself.
+ * @return The level, owned by the pyramid, don't free it.
+ */
+ccv_dense_matrix_t* ccv_image_pyramid_level(ccv_image_pyramid_t* pyramid, int level);
+/**
+ * Get a product derived from one level of an image pyramid, it is computed the first time it is asked for, and shared by everyone asks for it later.
+ * @param pyramid The image pyramid.
+ * @param level The level the product is derived from.
+ * @param product CCV_IMAGE_PYRAMID_GRAY for the grayscale level (the level itself if it is already single channel), CCV_IMAGE_PYRAMID_LUV for ccv_color_transform with CCV_RGB_TO_LUV, CCV_IMAGE_PYRAMID_HOG for ccv_hog with 9 orientation bins, CCV_IMAGE_PYRAMID_SAT for ccv_sat, and CCV_IMAGE_PYRAMID_SHIFTED for a variant of the level that is sampled down from one octave above with its start point shifted (the same as the shifted variants of ccv_pyramid_build, level has to be at least interval + 1).
+ * @param param The cell size for CCV_IMAGE_PYRAMID_HOG, the padding pattern for CCV_IMAGE_PYRAMID_SAT, the shift for CCV_IMAGE_PYRAMID_SHIFTED (1 for (1, 0), 2 for (0, 1) and 3 for (1, 1)), and 0 otherwise.
+ * @return The product, owned by the pyramid, don't free it.
+ */
+ccv_dense_matrix_t* ccv_image_pyramid_derived(ccv_image_pyramid_t* pyramid, int level, int product, int param);
+/**
+ * Get a product derived from a batch of levels of an image pyramid, the same as calling ccv_image_pyramid_derived on each of them. The missing CCV_IMAGE_PYRAMID_HOG products are computed together with ccv_hog_batch.
+ * @param pyramid The image pyramid.
+ * @param level The levels the products are derived from.
+ * @param product The product, the same as in ccv_image_pyramid_derived.
+ * @param param The parameters of the product, one per level.
+ * @param count The number of levels.
+ * @param x The products, owned by the pyramid, don't free them.
+ */
+void ccv_image_pyramid_derived_batch(ccv_image_pyramid_t* pyramid, const int* level, int product, const int* param, int count, ccv_dense_matrix_t** x);
 /** @} */
 
 /**
@@ -1255,6 +1690,17 @@ void ccv_sample_up(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int
  * @param cols The number of cols for destination matrix
  */
 void ccv_decimal_slice(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, float y, float x, int rows, int cols);
+/**
+ * Slice a batch of patches of the same size out of a given matrix, the same as calling ccv_decimal_slice on each of them, but these are sliced in parallel.
+ * @param a The given matrix that will be sliced
+ * @param b The array of output matrices, the same length as point
+ * @param type The type of output matrices
+ * @param point The top left points to slice
+ * @param rows The number of rows for destination matrices
+ * @param cols The number of cols for destination matrices
+ * @param count The number of patches
+ */
+void ccv_decimal_slice_batch(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, const ccv_decimal_point_t* point, int rows, int cols, int count);
 /**
  * Apply a [3D transform](https://en.wikipedia.org/wiki/Perspective_transform#Perspective_projection) against the given point in a given image size, assuming field of view is 60 (in degree).
  * @param point The point to be transformed in decimal
@@ -1270,6 +1716,16 @@ ccv_decimal_point_t ccv_perspective_transform_apply(ccv_decimal_point_t point, c
  * @param m00, m01, m02, m10, m11, m12, m20, m21, m22 The transformation matrix
  */
 void ccv_perspective_transform(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, float m00, float m01, float m02, float m10, float m11, float m12, float m20, float m21, float m22);
+/**
+ * Apply a batch of 3D transforms on a given matrix. Each output is the given window of what ccv_perspective_transform gives with its transformation matrix, the same as ccv_slice on it (0 outside of the matrix), but only the pixels in the window are computed. The bands of rows of all of them are computed in parallel.
+ * @param a The given matrix to be transformed
+ * @param b The array of output matrices, the same length as rect
+ * @param type The type of output matrices
+ * @param m The transformation matrices, 9 values (m00, m01, m02, m10, m11, m12, m20, m21, m22) each
+ * @param rect The windows of the transformed matrix, 0 for the whole matrix
+ * @param count The number of transforms
+ */
+void ccv_perspective_transform_batch(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, const float* m, const ccv_rect_t* rect, int count);
 /** @} */
 
 /* classic computer vision algorithms ccv_classic.c */
@@ -1287,6 +1743,16 @@ void ccv_perspective_transform(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, in
  * @param size The window size for HOG (default to 8)
  */
 void ccv_hog(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int b_type, int sbin, int size);
+/**
+ * Compute HOG for a batch of matrices, such as the levels of an image pyramid. The result is the same as calling ccv_hog on each of them, but the cell rows of the whole batch are put in one work queue, thus, the small levels on top of a pyramid don't leave threads idle.
+ * @param a The array of input matrices.
+ * @param b The array of output matrices, the same length as a.
+ * @param b_type The type of output matrices, if 0, ccv will try to match the input matrix for appropriate type.
+ * @param sbin The number of bins for orientation (default to 9).
+ * @param size The window sizes, one per matrix.
+ * @param count The number of matrices.
+ */
+void ccv_hog_batch(ccv_dense_matrix_t** a, ccv_dense_matrix_t** b, int b_type, int sbin, const int* size, int count);
 /**
  * [Canny edge detector](https://en.wikipedia.org/wiki/Canny_edge_detector) implementation. For performance reason, this is a clean-up reimplementation of OpenCV's Canny edge detector, it has very similar performance characteristic as the OpenCV one. As of today, ccv's Canny edge detector only works with CCV_8U or CCV_32S dense matrix type.
  * @param a The input matrix.
@@ -1623,6 +2089,15 @@ void ccv_dpm_mixture_model_new(char** posfiles, ccv_rect_t* bboxes, int posnum,
  * @return A **ccv_array_t** of **ccv_root_comp_t** that contains the root bounding box as well as its parts.
  */
 CCV_WARN_UNUSED(ccv_array_t*) ccv_dpm_detect_objects(ccv_dense_matrix_t* a, ccv_dpm_mixture_model_t** model, int count, ccv_dpm_param_t params);
+/**
+ * The same as ccv_dpm_detect_objects, but on an image pyramid that can be shared with other detectors. The levels and their HOG are reused if the interval of the pyramid matches params.interval, otherwise, a private pyramid is used.
+ * @param pyramid The image pyramid of the input image, see ccv_image_pyramid_new.
+ * @param model An array of mixture models.
+ * @param count How many mixture models you've passed in.
+ * @param params A **ccv_dpm_param_t** structure that defines various aspects of the detector.
+ * @return A **ccv_array_t** of **ccv_root_comp_t** that contains the root bounding box as well as its parts.
+ */
+CCV_WARN_UNUSED(ccv_array_t*) ccv_dpm_detect_objects_in_pyramid(ccv_image_pyramid_t* pyramid, ccv_dpm_mixture_model_t** model, int count, ccv_dpm_param_t params);
 /**
  * Read DPM mixture model from a model file.
  * @param directory The model file for DPM mixture model.
@@ -1721,6 +2196,15 @@ void ccv_bbf_classifier_cascade_new(ccv_dense_matrix_t** posimg, int posnum, cha
  * @return A **ccv_array_t** of **ccv_comp_t** for detection results.
  */
 CCV_WARN_UNUSED(ccv_array_t*) ccv_bbf_detect_objects(ccv_dense_matrix_t* a, ccv_bbf_classifier_cascade_t** cascade, int count, ccv_bbf_param_t params);
+/**
+ * The same as ccv_bbf_detect_objects, but on an image pyramid that can be shared with other detectors. The levels (and their shifted variants with params.accurate) are reused if the interval of the pyramid matches params.interval and params.size is the size of the cascades, otherwise, a private pyramid is used.
+ * @param pyramid The image pyramid of the input image, see ccv_image_pyramid_new.
+ * @param cascade An array of classifier cascades.
+ * @param count How many classifier cascades you've passed in.
+ * @param params A **ccv_bbf_param_t** structure that defines various aspects of the detector.
+ * @return A **ccv_array_t** of **ccv_comp_t** for detection results.
+ */
+CCV_WARN_UNUSED(ccv_array_t*) ccv_bbf_detect_objects_in_pyramid(ccv_image_pyramid_t* pyramid, ccv_bbf_classifier_cascade_t** cascade, int count, ccv_bbf_param_t params);
 /**
  * Read BBF classifier cascade from working directory.
  * @param directory The working directory that trains a BBF classifier cascade.
@@ -1823,6 +2307,7 @@ typedef struct {
 	/** @} */
 	/**
 	 * @name Deformation parameters to apply perspective transforms on patches for robustness
+	 * The deformations of a frame are transformed from the whole frame in one batch, thus, what a deformed patch brings in from beyond its box is the frame around it, rather than black. It is intended, the patch sees what the camera would.
 	 * @{
 	 */
 	int new_deform; /**< Number of deformations should be applied at initialization */
@@ -2034,6 +2519,15 @@ void ccv_icf_multiscale_classifier_cascade_free(ccv_icf_multiscale_classifier_ca
  * @return A **ccv_array_t** of **ccv_comp_t** with detection results.
  */
 CCV_WARN_UNUSED(ccv_array_t*) ccv_icf_detect_objects(ccv_dense_matrix_t* a, void* cascade, int count, ccv_icf_param_t params);
+/**
+ * The same as ccv_icf_detect_objects, but on an image pyramid that can be shared with other detectors. Only the octaves of the pyramid are used, thus, it works with a pyramid of any interval.
+ * @param pyramid The image pyramid of the input image, see ccv_image_pyramid_new.
+ * @param cascade An array of classifier cascades.
+ * @param count How many classifier cascades you've passed in.
+ * @param params A **ccv_icf_param_t** structure that defines various aspects of the detector.
+ * @return A **ccv_array_t** of **ccv_comp_t** with detection results.
+ */
+CCV_WARN_UNUSED(ccv_array_t*) ccv_icf_detect_objects_in_pyramid(ccv_image_pyramid_t* pyramid, void* cascade, int count, ccv_icf_param_t params);
 /** @} */
 
 /* SCD: SURF-Cascade Detector
@@ -2176,6 +2670,15 @@ void ccv_scd(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type);
  * @return A **ccv_array_t** of **ccv_comp_t** with detection results.
  */
 CCV_WARN_UNUSED(ccv_array_t*) ccv_scd_detect_objects(ccv_dense_matrix_t* a, ccv_scd_classifier_cascade_t** cascades, int count, ccv_scd_param_t params);
+/**
+ * The same as ccv_scd_detect_objects, but on an image pyramid that can be shared with other detectors. Only the octaves of the pyramid are used, thus, it works with a pyramid of any interval. If the cascades are larger than params.size, the input has to be scaled up first, and a private pyramid is used.
+ * @param pyramid The image pyramid of the input image, see ccv_image_pyramid_new.
+ * @param cascades An array of classifier cascades.
+ * @param count How many classifier cascades you've passed in.
+ * @param params A **ccv_scd_param_t** structure that defines various aspects of the detector.
+ * @return A **ccv_array_t** of **ccv_comp_t** with detection results.
+ */
+CCV_WARN_UNUSED(ccv_array_t*) ccv_scd_detect_objects_in_pyramid(ccv_image_pyramid_t* pyramid, ccv_scd_classifier_cascade_t** cascades, int count, ccv_scd_param_t params);
 /** @} */
 
 /* categorization types and methods for training */
@@ -5,6 +5,16 @@
 #elif HAVE_CBLAS
 #include <cblas.h>
 #endif
+#if defined(HAVE_SSE2)
+#include <xmmintrin.h>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_DISPATCH
+#endif
+#elif defined(HAVE_NEON)
+#include <arm_neon.h>
+#endif
+#include "algebra/_ccv_gemm.inc"
 
 double ccv_trace(ccv_matrix_t* mat)
 {
@@ -76,6 +86,214 @@ double ccv_normalize(ccv_matrix_t* a, ccv_matrix_t** b, int btype, int flag)
 	return db->tb.f64 = sum;
 }
 
+// prefix sums (and prefix sums of squares if p2 is provided) of one row of 8U data, per channel
+static void _ccv_sat_8u_row(const unsigned char* a, const int n, const int ch, int* const p, int* const p2)
+{
+	int j = 0;
+	if (ch == 1)
+	{
+#if defined(HAVE_SSE2)
+		__m128i carry = _mm_setzero_si128();
+		__m128i carry2 = _mm_setzero_si128();
+		const __m128i z = _mm_setzero_si128();
+		for (; j + 16 <= n; j += 16)
+		{
+			const __m128i x = _mm_loadu_si128((const __m128i*)(a + j));
+			const __m128i x16[2] = { _mm_unpacklo_epi8(x, z), _mm_unpackhi_epi8(x, z) };
+			int k;
+			for (k = 0; k < 2; k++)
+			{
+				// 255 * 255 fits in unsigned 16-bit, thus, the low half of the product is exact
+				const __m128i x16sq = _mm_mullo_epi16(x16[k], x16[k]);
+				__m128i v[2] = { _mm_unpacklo_epi16(x16[k], z), _mm_unpackhi_epi16(x16[k], z) };
+				__m128i v2[2] = { _mm_unpacklo_epi16(x16sq, z), _mm_unpackhi_epi16(x16sq, z) };
+				int l;
+				for (l = 0; l < 2; l++)
+				{
+					v[l] = _mm_add_epi32(v[l], _mm_slli_si128(v[l], 4));
+					v[l] = _mm_add_epi32(v[l], _mm_slli_si128(v[l], 8));
+					v[l] = _mm_add_epi32(v[l], carry);
+					carry = _mm_shuffle_epi32(v[l], 0xff);
+					_mm_storeu_si128((__m128i*)(p + j + k * 8 + l * 4), v[l]);
+					if (p2)
+					{
+						v2[l] = _mm_add_epi32(v2[l], _mm_slli_si128(v2[l], 4));
+						v2[l] = _mm_add_epi32(v2[l], _mm_slli_si128(v2[l], 8));
+						v2[l] = _mm_add_epi32(v2[l], carry2);
+						carry2 = _mm_shuffle_epi32(v2[l], 0xff);
+						_mm_storeu_si128((__m128i*)(p2 + j + k * 8 + l * 4), v2[l]);
+					}
+				}
+			}
+		}
+#elif defined(HAVE_NEON)
+		uint32x4_t carry = vdupq_n_u32(0);
+		uint32x4_t carry2 = vdupq_n_u32(0);
+		const uint32x4_t z = vdupq_n_u32(0);
+		for (; j + 8 <= n; j += 8)
+		{
+			const uint8x8_t x = vld1_u8(a + j);
+			const uint16x8_t x16 = vmovl_u8(x);
+			const uint16x8_t x16sq = vmull_u8(x, x);
+			uint32x4_t v[2] = { vmovl_u16(vget_low_u16(x16)), vmovl_u16(vget_high_u16(x16)) };
+			uint32x4_t v2[2] = { vmovl_u16(vget_low_u16(x16sq)), vmovl_u16(vget_high_u16(x16sq)) };
+			int l;
+			for (l = 0; l < 2; l++)
+			{
+				v[l] = vaddq_u32(v[l], vextq_u32(z, v[l], 3));
+				v[l] = vaddq_u32(v[l], vextq_u32(z, v[l], 2));
+				v[l] = vaddq_u32(v[l], carry);
+				carry = vdupq_n_u32(vgetq_lane_u32(v[l], 3));
+				vst1q_s32(p + j + l * 4, vreinterpretq_s32_u32(v[l]));
+				if (p2)
+				{
+					v2[l] = vaddq_u32(v2[l], vextq_u32(z, v2[l], 3));
+					v2[l] = vaddq_u32(v2[l], vextq_u32(z, v2[l], 2));
+					v2[l] = vaddq_u32(v2[l], carry2);
+					carry2 = vdupq_n_u32(vgetq_lane_u32(v2[l], 3));
+					vst1q_s32(p2 + j + l * 4, vreinterpretq_s32_u32(v2[l]));
+				}
+			}
+		}
+#endif
+	}
+	for (; j < ch && j < n; j++)
+	{
+		p[j] = a[j];
+		if (p2)
+			p2[j] = a[j] * a[j];
+	}
+	for (; j < n; j++)
+	{
+		p[j] = p[j - ch] + a[j];
+		if (p2)
+			p2[j] = p2[j - ch] + a[j] * a[j];
+	}
+}
+
+// b[j] = prev[j] + p[j], or b[j] = p[j] if there is no previous row, these plain loops are vectorized by the compiler
+static void _ccv_sat_row_add(const int type, unsigned char* const b, const unsigned char* const prev, const int* const p, const int n)
+{
+	int j;
+	switch (CCV_GET_DATA_TYPE(type))
+	{
+#define for_block(_type) \
+		if (prev) \
+			for (j = 0; j < n; j++) \
+				((_type*)b)[j] = ((const _type*)prev)[j] + (_type)p[j]; \
+		else \
+			for (j = 0; j < n; j++) \
+				((_type*)b)[j] = (_type)p[j];
+		case CCV_32S:
+			for_block(int);
+			break;
+		case CCV_32F:
+			for_block(float);
+			break;
+		case CCV_64S:
+			for_block(int64_t);
+			break;
+		case CCV_64F:
+			for_block(double);
+			break;
+#undef for_block
+	}
+}
+
+// b[j] += carry[j]
+static void _ccv_sat_row_carry(const int type, unsigned char* const b, const unsigned char* const carry, const int n)
+{
+	int j;
+	switch (CCV_GET_DATA_TYPE(type))
+	{
+#define for_block(_type) \
+		for (j = 0; j < n; j++) \
+			((_type*)b)[j] += ((const _type*)carry)[j];
+		case CCV_32S:
+			for_block(int);
+			break;
+		case CCV_32F:
+			for_block(float);
+			break;
+		case CCV_64S:
+			for_block(int64_t);
+			break;
+		case CCV_64F:
+			for_block(double);
+			break;
+#undef for_block
+	}
+}
+
+#define CCV_SAT_BLOCK_ROWS (64)
+
+static int _ccv_sat_8u_supported(ccv_dense_matrix_t* a, int type)
+{
+	// the prefix sums of squares in a row are kept in 32-bit
+	return CCV_GET_DATA_TYPE(a->type) == CCV_8U && (type & (CCV_32S | CCV_32F | CCV_64S | CCV_64F)) && a->cols * CCV_GET_CHANNEL(a->type) < 0x8000;
+}
+
+/* Summed area table (and of squares if c is provided) for 8U input. Rows are split into blocks, each block computes
+ * its own table in parallel, then the last row of each block is carried over to the next block. */
+static void _ccv_sat_8u(ccv_dense_matrix_t* a, ccv_dense_matrix_t* db, ccv_dense_matrix_t* dc, int padding_pattern)
+{
+	const int ch = CCV_GET_CHANNEL(a->type);
+	const int n = a->cols * ch;
+	const int off = (padding_pattern == CCV_PADDING_ZERO) ? 1 : 0;
+	const int nb = (a->rows + CCV_SAT_BLOCK_ROWS - 1) / CCV_SAT_BLOCK_ROWS;
+	const size_t b_off = off * ch * CCV_GET_DATA_TYPE_SIZE(db->type);
+	const size_t c_off = dc ? off * ch * CCV_GET_DATA_TYPE_SIZE(dc->type) : 0;
+	if (off)
+	{
+		memset(db->data.u8, 0, db->step);
+		if (dc)
+			memset(dc->data.u8, 0, dc->step);
+	}
+	parallel_for(k, nb) {
+		int i;
+		int* const p = (int*)ccmalloc(sizeof(int) * n * (dc ? 2 : 1));
+		int* const p2 = dc ? p + n : 0;
+		const int end = ccv_min(a->rows, (k + 1) * CCV_SAT_BLOCK_ROWS);
+		for (i = k * CCV_SAT_BLOCK_ROWS; i < end; i++)
+		{
+			_ccv_sat_8u_row(a->data.u8 + i * a->step, n, ch, p, p2);
+			unsigned char* const b_ptr = db->data.u8 + (i + off) * db->step;
+			if (off)
+				memset(b_ptr, 0, b_off);
+			_ccv_sat_row_add(db->type, b_ptr + b_off, i > k * CCV_SAT_BLOCK_ROWS ? b_ptr + b_off - db->step : 0, p, n);
+			if (dc)
+			{
+				unsigned char* const c_ptr = dc->data.u8 + (i + off) * dc->step;
+				if (off)
+					memset(c_ptr, 0, c_off);
+				_ccv_sat_row_add(dc->type, c_ptr + c_off, i > k * CCV_SAT_BLOCK_ROWS ? c_ptr + c_off - dc->step : 0, p2, n);
+			}
+		}
+		ccfree(p);
+	} parallel_endfor
+	int k;
+	// carry over the last row of each block, sequentially, thus, each block's last row is final
+	for (k = 1; k < nb; k++)
+	{
+		const int carry = k * CCV_SAT_BLOCK_ROWS - 1 + off;
+		const int last = ccv_min(a->rows, (k + 1) * CCV_SAT_BLOCK_ROWS) - 1 + off;
+		_ccv_sat_row_carry(db->type, db->data.u8 + last * db->step + b_off, db->data.u8 + carry * db->step + b_off, n);
+		if (dc)
+			_ccv_sat_row_carry(dc->type, dc->data.u8 + last * dc->step + c_off, dc->data.u8 + carry * dc->step + c_off, n);
+	}
+	parallel_for(k, nb - 1) {
+		int i;
+		const int carry = (k + 1) * CCV_SAT_BLOCK_ROWS - 1 + off;
+		const int last = ccv_min(a->rows, (k + 2) * CCV_SAT_BLOCK_ROWS) - 1 + off;
+		for (i = carry + 1; i < last; i++)
+		{
+			_ccv_sat_row_carry(db->type, db->data.u8 + i * db->step + b_off, db->data.u8 + carry * db->step + b_off, n);
+			if (dc)
+				_ccv_sat_row_carry(dc->type, dc->data.u8 + i * dc->step + c_off, dc->data.u8 + carry * dc->step + c_off, n);
+		}
+	} parallel_endfor
+}
+
 void ccv_sat(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int padding_pattern)
 {
 	ccv_declare_derived_signature(sig, a->sig != 0, ccv_sign_with_format(20, "ccv_sat(%d)", padding_pattern), a->sig, CCV_EOF_SIGN);
@@ -91,6 +309,11 @@ void ccv_sat(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int paddin
 		case CCV_NO_PADDING:
 			db = *b = ccv_dense_matrix_renew(*b, a->rows, a->cols, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), type, sig);
 			ccv_object_return_if_cached(, db);
+			if (_ccv_sat_8u_supported(a, type))
+			{
+				_ccv_sat_8u(a, db, 0, padding_pattern);
+				break;
+			}
 			b_ptr = db->data.u8;
 #define for_block(_for_set_b, _for_get_b, _for_get) \
 			for (j = 0; j < ch; j++) \
@@ -114,6 +337,11 @@ void ccv_sat(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int paddin
 		case CCV_PADDING_ZERO:
 			db = *b = ccv_dense_matrix_renew(*b, a->rows + 1, a->cols + 1, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), type, sig);
 			ccv_object_return_if_cached(, db);
+			if (_ccv_sat_8u_supported(a, type))
+			{
+				_ccv_sat_8u(a, db, 0, padding_pattern);
+				break;
+			}
 			b_ptr = db->data.u8;
 #define for_block(_for_set_b, _for_get_b, _for_get) \
 			for (j = 0; j < db->cols * ch; j++) \
@@ -134,6 +362,33 @@ void ccv_sat(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int paddin
 	}
 }
 
+void ccv_sat_square(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, ccv_dense_matrix_t** c, int type, int padding_pattern)
+{
+	int btype = (a->type & CCV_8U) ? ((a->rows * a->cols >= 0x808080) ? CCV_64S : CCV_32S) : ((a->type & CCV_32S) ? CCV_64S : CCV_GET_DATA_TYPE(a->type));
+	int ctype = (a->type & (CCV_8U | CCV_32S)) ? CCV_64S : CCV_GET_DATA_TYPE(a->type);
+	if (type != 0)
+		btype = ctype = CCV_GET_DATA_TYPE(type);
+	if (!_ccv_sat_8u_supported(a, btype) || !_ccv_sat_8u_supported(a, ctype))
+	{
+		// not 8U, or rows are too wide to keep prefix sums of squares in 32-bit, compute them separately
+		ccv_sat(a, b, btype, padding_pattern);
+		ccv_dense_matrix_t* sq = 0;
+		ccv_multiply(a, a, (ccv_matrix_t**)&sq, 0);
+		ccv_sat(sq, c, ctype, padding_pattern);
+		ccv_matrix_free(sq);
+		return;
+	}
+	// b shares the signature with ccv_sat, thus, it can be picked up from the cache by either
+	ccv_declare_derived_signature(bsig, a->sig != 0, ccv_sign_with_format(20, "ccv_sat(%d)", padding_pattern), a->sig, CCV_EOF_SIGN);
+	ccv_declare_derived_signature(csig, a->sig != 0, ccv_sign_with_format(20, "ccv_sat_square(%d)", padding_pattern), a->sig, CCV_EOF_SIGN);
+	const int rows = (padding_pattern == CCV_PADDING_ZERO) ? a->rows + 1 : a->rows;
+	const int cols = (padding_pattern == CCV_PADDING_ZERO) ? a->cols + 1 : a->cols;
+	ccv_dense_matrix_t* db = *b = ccv_dense_matrix_renew(*b, rows, cols, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), btype | CCV_GET_CHANNEL(a->type), bsig);
+	ccv_dense_matrix_t* dc = *c = ccv_dense_matrix_renew(*c, rows, cols, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), ctype | CCV_GET_CHANNEL(a->type), csig);
+	ccv_object_return_if_cached(, db, dc);
+	_ccv_sat_8u(a, db, dc, padding_pattern);
+}
+
 double ccv_sum(ccv_matrix_t* mat, int flag)
 {
 	ccv_dense_matrix_t* dmt = ccv_get_dense_matrix(mat);
@@ -305,7 +560,42 @@ void ccv_scale(ccv_matrix_t* a, ccv_matrix_t** b, int type, double ds)
 	}
 }
 
-void ccv_gemm(ccv_matrix_t* a, ccv_matrix_t* b, double alpha, ccv_matrix_t* c, double beta, int transpose, ccv_matrix_t** d, int type)
+static void _ccv_gemm_native(ccv_dense_matrix_t* da, ccv_dense_matrix_t* db, double alpha, double beta, int transpose, ccv_dense_matrix_t* dd)
+{
+	int i, j;
+	const int k = (transpose & CCV_A_TRANSPOSE) ? da->rows : da->cols;
+	switch (CCV_GET_DATA_TYPE(dd->type))
+	{
+		case CCV_32F:
+		{
+			const int lda = da->step / sizeof(float), ldb = db->step / sizeof(float), ldd = dd->step / sizeof(float);
+			for (i = 0; i < dd->rows; i++)
+				for (j = 0; j < dd->cols; j++)
+					dd->data.f32[i * ldd + j] = (beta == 0) ? 0 : beta * dd->data.f32[i * ldd + j];
+			_ccv_gemm_32f(_ccv_gemm_kernel_32f(), dd->rows, dd->cols, k, alpha,
+				da->data.f32, (transpose & CCV_A_TRANSPOSE) ? 1 : lda, (transpose & CCV_A_TRANSPOSE) ? lda : 1,
+				db->data.f32, (transpose & CCV_B_TRANSPOSE) ? 1 : ldb, (transpose & CCV_B_TRANSPOSE) ? ldb : 1,
+				dd->data.f32, ldd);
+			break;
+		}
+		case CCV_64F:
+		{
+			const int lda = da->step / sizeof(double), ldb = db->step / sizeof(double), ldd = dd->step / sizeof(double);
+			for (i = 0; i < dd->rows; i++)
+				for (j = 0; j < dd->cols; j++)
+					dd->data.f64[i * ldd + j] = (beta == 0) ? 0 : beta * dd->data.f64[i * ldd + j];
+			_ccv_gemm_64f(_ccv_gemm_kernel_64f(), dd->rows, dd->cols, k, alpha,
+				da->data.f64, (transpose & CCV_A_TRANSPOSE) ? 1 : lda, (transpose & CCV_A_TRANSPOSE) ? lda : 1,
+				db->data.f64, (transpose & CCV_B_TRANSPOSE) ? 1 : ldb, (transpose & CCV_B_TRANSPOSE) ? ldb : 1,
+				dd->data.f64, ldd);
+			break;
+		}
+		default:
+			assert(0 && "ccv_gemm only supports 32F and 64F matrices");
+	}
+}
+
+static void _ccv_gemm(ccv_matrix_t* a, ccv_matrix_t* b, double alpha, ccv_matrix_t* c, double beta, int transpose, ccv_matrix_t** d, int type, int native)
 {
 	ccv_dense_matrix_t* da = ccv_get_dense_matrix(a);
 	ccv_dense_matrix_t* db = ccv_get_dense_matrix(b);
@@ -314,7 +604,7 @@ void ccv_gemm(ccv_matrix_t* a, ccv_matrix_t* b, double alpha, ccv_matrix_t* c, d
 	assert(CCV_GET_DATA_TYPE(da->type) == CCV_GET_DATA_TYPE(db->type) && CCV_GET_CHANNEL(da->type) == 1 && CCV_GET_CHANNEL(db->type) == 1 && ((transpose & CCV_A_TRANSPOSE) ? da->rows : da->cols) == ((transpose & CCV_B_TRANSPOSE) ? db->cols : db->rows));
 
 	if (dc != 0)
-		assert(CCV_GET_DATA_TYPE(dc->type) == CCV_GET_DATA_TYPE(da->type) && CCV_GET_CHANNEL(dc->type) == 1 && ((transpose & CCV_A_TRANSPOSE) ? da->cols : da->rows) == dc->rows && ((transpose & CCV_B_TRANSPOSE) ? db->rows : db->cols) == dc->cols);
+		assert(CCV_GET_DATA_TYPE(dc->type) == CCV_GET_DATA_TYPE(da->type) && CCV_GET_CHANNEL(dc->type) == 1 && ((transpose & CCV_A_TRANSPOSE) ? da->cols : da->rows) == ((transpose & CCV_C_TRANSPOSE) ? dc->cols : dc->rows) && ((transpose & CCV_B_TRANSPOSE) ? db->rows : db->cols) == ((transpose & CCV_C_TRANSPOSE) ? dc->rows : dc->cols));
 
 	ccv_declare_derived_signature_case(sig, ccv_sign_with_format(20, "ccv_gemm(%d)", transpose), ccv_sign_if(dc == 0 && da->sig != 0 && db->sig != 0, da->sig, db->sig, CCV_EOF_SIGN), ccv_sign_if(dc != 0 && da->sig != 0 && db->sig != 0 && dc->sig != 0, da->sig, db->sig, dc->sig, CCV_EOF_SIGN));
 	type = CCV_GET_DATA_TYPE(da->type) | CCV_GET_CHANNEL(da->type);
@@ -322,21 +612,51 @@ void ccv_gemm(ccv_matrix_t* a, ccv_matrix_t* b, double alpha, ccv_matrix_t* c, d
 	ccv_object_return_if_cached(, dd);
 
 	if (dd != dc && dc != 0)
-		memcpy(dd->data.u8, dc->data.u8, dc->step * dc->rows);
-	else if (dc == 0) // clean up dd if dc is not provided
+	{
+		if (transpose & CCV_C_TRANSPOSE)
+		{
+			int i, j;
+			if (CCV_GET_DATA_TYPE(dd->type) == CCV_32F)
+			{
+				for (i = 0; i < dd->rows; i++)
+					for (j = 0; j < dd->cols; j++)
+						((float*)(dd->data.u8 + i * dd->step))[j] = ((float*)(dc->data.u8 + j * dc->step))[i];
+			} else {
+				for (i = 0; i < dd->rows; i++)
+					for (j = 0; j < dd->cols; j++)
+						((double*)(dd->data.u8 + i * dd->step))[j] = ((double*)(dc->data.u8 + j * dc->step))[i];
+			}
+		} else
+			ccv_dense_matrix_copy_rows(dc, dd);
+	} else if (dc == 0) // clean up dd if dc is not provided
 		memset(dd->data.u8, 0, dd->step * dd->rows);
+	else // supply C as the output in place, therefore it cannot be transposed
+		assert(!(transpose & CCV_C_TRANSPOSE));
 
 #if (defined HAVE_CBLAS || defined HAVE_ACCELERATE_FRAMEWORK)
-	switch (CCV_GET_DATA_TYPE(dd->type))
+	if (!native)
 	{
-		case CCV_32F:
-			cblas_sgemm(CblasRowMajor, (transpose & CCV_A_TRANSPOSE) ? CblasTrans : CblasNoTrans, (transpose & CCV_B_TRANSPOSE) ? CblasTrans : CblasNoTrans, dd->rows, dd->cols, (transpose & CCV_A_TRANSPOSE) ? da->rows : da->cols, alpha, da->data.f32, da->cols, db->data.f32, db->cols, beta, dd->data.f32, dd->cols);
-			break;
-		case CCV_64F:
-			cblas_dgemm(CblasRowMajor, (transpose & CCV_A_TRANSPOSE) ? CblasTrans : CblasNoTrans, (transpose & CCV_B_TRANSPOSE) ? CblasTrans : CblasNoTrans, dd->rows, dd->cols, (transpose & CCV_A_TRANSPOSE) ? da->rows : da->cols, alpha, da->data.f64, da->cols, db->data.f64, db->cols, beta, dd->data.f64, dd->cols);
-			break;
+		switch (CCV_GET_DATA_TYPE(dd->type))
+		{
+			case CCV_32F:
+				cblas_sgemm(CblasRowMajor, (transpose & CCV_A_TRANSPOSE) ? CblasTrans : CblasNoTrans, (transpose & CCV_B_TRANSPOSE) ? CblasTrans : CblasNoTrans, dd->rows, dd->cols, (transpose & CCV_A_TRANSPOSE) ? da->rows : da->cols, alpha, da->data.f32, da->step / sizeof(float), db->data.f32, db->step / sizeof(float), beta, dd->data.f32, dd->step / sizeof(float));
+				break;
+			case CCV_64F:
+				cblas_dgemm(CblasRowMajor, (transpose & CCV_A_TRANSPOSE) ? CblasTrans : CblasNoTrans, (transpose & CCV_B_TRANSPOSE) ? CblasTrans : CblasNoTrans, dd->rows, dd->cols, (transpose & CCV_A_TRANSPOSE) ? da->rows : da->cols, alpha, da->data.f64, da->step / sizeof(double), db->data.f64, db->step / sizeof(double), beta, dd->data.f64, dd->step / sizeof(double));
+				break;
+		}
+		return;
 	}
-#else
-	assert(0 && "You need a BLAS compatible library for this function, e.g. libatlas.");
 #endif
+	_ccv_gemm_native(da, db, alpha, beta, transpose, dd);
+}
+
+void ccv_gemm(ccv_matrix_t* a, ccv_matrix_t* b, double alpha, ccv_matrix_t* c, double beta, int transpose, ccv_matrix_t** d, int type)
+{
+	_ccv_gemm(a, b, alpha, c, beta, transpose, d, type, 0);
+}
+
+void ccv_gemm_native(ccv_matrix_t* a, ccv_matrix_t* b, double alpha, ccv_matrix_t* c, double beta, int transpose, ccv_matrix_t** d, int type)
+{
+	_ccv_gemm(a, b, alpha, c, beta, transpose, d, type, 1);
 }
@@ -1,7 +1,7 @@
 #include "ccv.h"
 #include "ccv_internal.h"
 #if defined(HAVE_SSE2)
-#include <xmmintrin.h>
+#include <emmintrin.h>
 #elif defined(HAVE_NEON)
 #include <arm_neon.h>
 #endif
@@ -345,11 +345,252 @@ void ccv_gradient(ccv_dense_matrix_t* a, ccv_dense_matrix_t** theta, int ttype,
 	ccv_dense_matrix_t* ty = 0;
 	ccv_sobel(a, &tx, CCV_32F | ch, dx, 0);
 	ccv_sobel(a, &ty, CCV_32F | ch, 0, dy);
-	_ccv_atan2(tx->data.f32, ty->data.f32, dtheta->data.f32, dm->data.f32, ch * a->rows * a->cols);
+	if (dtheta->step == tx->step && dm->step == tx->step)
+		_ccv_atan2(tx->data.f32, ty->data.f32, dtheta->data.f32, dm->data.f32, ch * a->rows * a->cols);
+	else {
+		// output rows are padded (see ccv_dense_matrix_new_aligned), go row by row
+		int i;
+		for (i = 0; i < a->rows; i++)
+			_ccv_atan2((float*)(tx->data.u8 + i * tx->step), (float*)(ty->data.u8 + i * ty->step), (float*)(dtheta->data.u8 + i * dtheta->step), (float*)(dm->data.u8 + i * dm->step), ch * a->cols);
+	}
 	ccv_matrix_free(tx);
 	ccv_matrix_free(ty);
 }
 
+/* the gradient of row i with the same 1x3 / 3x1 windows (and the borders) as ccv_sobel with dx = 1 or dy = 1,
+ * for the first width columns */
+static void _ccv_gradient_row(ccv_dense_matrix_t* a, int i, int width, float* dx, float* dy)
+{
+	const int ch = CCV_GET_CHANNEL(a->type);
+	const int n = width * ch;
+	unsigned char* a_ptr = a->data.u8 + i * a->step;
+	unsigned char* prev_ptr = i > 0 ? a_ptr - a->step : a_ptr;
+	unsigned char* next_ptr = i < a->rows - 1 ? a_ptr + a->step : a_ptr;
+	const int fy = (i > 0 && i < a->rows - 1) ? 1 : 2;
+	int j, k;
+#define for_block(_, _for_get) \
+	for (k = 0; k < ch; k++) \
+		dx[k] = 2 * (_for_get(a_ptr, ch + k, 0) - _for_get(a_ptr, k, 0)); \
+	for (j = ch; j < ccv_min(n, (a->cols - 1) * ch); j++) \
+		dx[j] = _for_get(a_ptr, j + ch, 0) - _for_get(a_ptr, j - ch, 0); \
+	for (; j < n; j++) \
+		dx[j] = 2 * (_for_get(a_ptr, j, 0) - _for_get(a_ptr, j - ch, 0)); \
+	for (j = 0; j < n; j++) \
+		dy[j] = fy * (_for_get(next_ptr, j, 0) - _for_get(prev_ptr, j, 0));
+	ccv_matrix_getter(a->type, for_block);
+#undef for_block
+}
+
+// the orientation bin (the lower one of the two nearest) and the fraction towards the next one, for a row of angles
+static void _ccv_gradient_bin_row(const float* ag, int width, int nbin, int signed_orientation, int* bin, float* frac)
+{
+	const float range = signed_orientation ? 360 : 180;
+	const float upto = range - 0.01;
+	const float scale = nbin / range;
+	int j = 0;
+#if defined(HAVE_SSE2)
+	// for unsigned orientation, (180, 360) folds to (0, 180)
+	const __m128 half4 = _mm_set1_ps(180);
+	const __m128 fold4 = _mm_set1_ps(signed_orientation ? 0 : 180);
+	const __m128 upto4 = _mm_set1_ps(upto);
+	const __m128 scale4 = _mm_set1_ps(scale);
+	const __m128 zero4 = _mm_setzero_ps();
+	for (; j <= width - 4; j += 4)
+	{
+		__m128 v = _mm_loadu_ps(ag + j);
+		v = _mm_sub_ps(v, _mm_and_ps(_mm_cmpgt_ps(v, half4), fold4));
+		v = _mm_mul_ps(_mm_min_ps(_mm_max_ps(v, zero4), upto4), scale4);
+		__m128i b = _mm_cvttps_epi32(v);
+		_mm_storeu_si128((__m128i*)(bin + j), b);
+		_mm_storeu_ps(frac + j, _mm_sub_ps(v, _mm_cvtepi32_ps(b)));
+	}
+#elif defined(HAVE_NEON)
+	const float32x4_t fold4 = vdupq_n_f32(signed_orientation ? 0 : 180);
+	const float32x4_t upto4 = vdupq_n_f32(upto);
+	const float32x4_t scale4 = vdupq_n_f32(scale);
+	const float32x4_t zero4 = vdupq_n_f32(0);
+	const float32x4_t half4 = vdupq_n_f32(180);
+	for (; j <= width - 4; j += 4)
+	{
+		float32x4_t v = vld1q_f32(ag + j);
+		v = vbslq_f32(vcgtq_f32(v, half4), vsubq_f32(v, fold4), v);
+		v = vmulq_f32(vminq_f32(vmaxq_f32(v, zero4), upto4), scale4);
+		int32x4_t b = vcvtq_s32_f32(v);
+		vst1q_s32(bin + j, b);
+		vst1q_f32(frac + j, vsubq_f32(v, vcvtq_f32_s32(b)));
+	}
+#endif
+	for (; j < width; j++)
+	{
+		float v = (!signed_orientation && ag[j] > 180) ? ag[j] - 180 : ag[j];
+		v = ccv_clamp(v, 0, upto) * scale;
+		bin[j] = (int)v;
+		frac[j] = v - bin[j];
+	}
+}
+
+// accumulate the pixel rows [start, end) into the cells of db, buf holds the rows of gradient, 6 * width * channel floats
+static void _ccv_gradient_histogram_rows(ccv_dense_matrix_t* a, ccv_dense_matrix_t* db, int nbin, int size, int flag, const int* ixp, const float* vx, int start, int end, float* buf)
+{
+	const int magnitude = (flag & CCV_GRADIENT_HISTOGRAM_MAGNITUDE) ? 1 : 0;
+	const int bch = nbin + magnitude;
+	const int ch = CCV_GET_CHANNEL(a->type);
+	const int rows = db->rows;
+	const int cols = db->cols;
+	const int width = cols * size;
+	float* dx = buf;
+	float* dy = dx + width * ch;
+	float* ag = dy + width * ch;
+	float* mg = ag + width * ch;
+	float* frac = mg + width * ch;
+	int* bin = (int*)(frac + width * ch);
+	int i, j, k;
+	// split w * mgv between the two nearest orientation bins of the cell at bp
+#define ACC(_for_type, bp, w) \
+	{ \
+		_for_type* _bp = (bp); \
+		const _for_type _w = (w); \
+		_bp[ag0] += agr1 * _w; \
+		_bp[ag1] += agr0 * _w; \
+		if (magnitude) \
+			_bp[-1] += _w; \
+	}
+#define for_block(_, _for_type) \
+	for (i = start; i < end; i++) \
+	{ \
+		_ccv_gradient_row(a, i, width, dx, dy); \
+		_ccv_atan2(dx, dy, ag, mg, width * ch); \
+		if (ch > 1) \
+			for (j = 0; j < width; j++) \
+			{ \
+				float agv = ag[j * ch]; \
+				float mgv = mg[j * ch]; \
+				for (k = 1; k < ch; k++) \
+					if (mg[j * ch + k] > mgv) \
+					{ \
+						mgv = mg[j * ch + k]; \
+						agv = ag[j * ch + k]; \
+					} \
+				ag[j] = agv; \
+				mg[j] = mgv; \
+			} \
+		_ccv_gradient_bin_row(ag, width, nbin, flag & CCV_GRADIENT_HISTOGRAM_SIGNED, bin, frac); \
+		if (size == 1) \
+		{ \
+			_for_type* bp = (_for_type*)(db->data.u8 + i * db->step) + magnitude; \
+			for (j = 0; j < width; j++) \
+			{ \
+				const int ag0 = bin[j]; \
+				const int ag1 = (ag0 + 1 < nbin) ? ag0 + 1 : 0; \
+				const _for_type agr0 = frac[j]; \
+				const _for_type agr1 = 1.0 - agr0; \
+				ACC(_for_type, bp + j * bch, mg[j]); \
+			} \
+			continue; \
+		} \
+		_for_type yp = ((_for_type)i + 0.5) / (_for_type)size - 0.5; \
+		int iyp = (int)floor(yp); \
+		const _for_type vy0 = yp - iyp; \
+		const _for_type vy1 = 1.0 - vy0; \
+		_for_type* bp0 = iyp >= 0 ? (_for_type*)(db->data.u8 + iyp * db->step) + magnitude : 0; \
+		_for_type* bp1 = iyp + 1 < rows ? (_for_type*)(db->data.u8 + (iyp + 1) * db->step) + magnitude : 0; \
+		for (j = 0; j < width; j++) \
+		{ \
+			const int ag0 = bin[j]; \
+			const int ag1 = (ag0 + 1 < nbin) ? ag0 + 1 : 0; \
+			const _for_type agr0 = frac[j]; \
+			const _for_type agr1 = 1.0 - agr0; \
+			const _for_type mgv = mg[j]; \
+			const int x = ixp[j]; \
+			const _for_type vx0 = vx[j]; \
+			const _for_type vx1 = 1.0 - vx0; \
+			if (x >= 0) \
+			{ \
+				if (bp0) \
+					ACC(_for_type, bp0 + x * bch, vx1 * vy1 * mgv); \
+				if (bp1) \
+					ACC(_for_type, bp1 + x * bch, vx1 * vy0 * mgv); \
+			} \
+			if (x + 1 < cols) \
+			{ \
+				if (bp0) \
+					ACC(_for_type, bp0 + (x + 1) * bch, vx0 * vy1 * mgv); \
+				if (bp1) \
+					ACC(_for_type, bp1 + (x + 1) * bch, vx0 * vy0 * mgv); \
+			} \
+		} \
+	}
+	ccv_matrix_typeof(db->type, for_block);
+#undef for_block
+#undef ACC
+}
+
+void ccv_gradient_histogram(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int nbin, int size, int flag)
+{
+	assert(a->rows >= 3 && a->cols >= 3 && size > 0 && a->rows >= size && a->cols >= size);
+	const int magnitude = (flag & CCV_GRADIENT_HISTOGRAM_MAGNITUDE) ? 1 : 0;
+	const int bch = nbin + magnitude;
+	assert(nbin > 0 && bch <= CCV_MAX_CHANNEL);
+	ccv_declare_derived_signature(sig, a->sig != 0, ccv_sign_with_format(64, "ccv_gradient_histogram(%d,%d,%d)", nbin, size, flag), a->sig, CCV_EOF_SIGN);
+	type = (CCV_GET_DATA_TYPE(type) == CCV_64F) ? CCV_64F | bch : CCV_32F | bch;
+	ccv_dense_matrix_t* db = *b = ccv_dense_matrix_renew(*b, a->rows / size, a->cols / size, CCV_32F | CCV_64F | bch, type, sig);
+	ccv_object_return_if_cached(, db);
+	ccv_zero(db);
+	const int ch = CCV_GET_CHANNEL(a->type);
+	const int rows = db->rows;
+	const int cols = db->cols;
+	// only the first cols * size columns and rows * size rows fall into a cell
+	const int width = cols * size;
+	// the cell to the left of each column, and the weight of the one to the right
+	int* ixp = (int*)ccmalloc((sizeof(int) + sizeof(float)) * width + sizeof(int) * (rows + 2));
+	float* vx = (float*)(ixp + width);
+	int* band = (int*)(vx + width);
+	int i;
+	for (i = 0; i < width; i++)
+	{
+		const double xp = (i + 0.5) / size - 0.5;
+		ixp[i] = (int)floor(xp);
+		vx[i] = xp - ixp[i];
+	}
+	// band t holds the pixel rows that go into cell rows t - 1 and t (with size 1, a pixel row is a cell row of its own),
+	// bands 2 apart never write the same cells, thus, the even ones run in parallel, then the odd ones
+	int t = 0;
+	band[0] = 0;
+	for (i = 0; i < rows * size; i++)
+	{
+		const int iyp = size == 1 ? i : (int)floor((i + 0.5) / size - 0.5);
+		while (t < iyp + 1)
+			band[++t] = i;
+	}
+	while (t < rows + 1)
+		band[++t] = rows * size;
+	const size_t buf_size = sizeof(float) * width * ch * 6;
+	if (size == 1)
+	{
+		// every pixel row has its cell row, go in chunks of rows
+		parallel_for(k, (rows + 15) / 16) {
+			float* buf = (float*)ccmalloc(buf_size);
+			_ccv_gradient_histogram_rows(a, db, nbin, size, flag, ixp, vx, k * 16, ccv_min(k * 16 + 16, rows), buf);
+			ccfree(buf);
+		} parallel_endfor
+	} else {
+		int p;
+		for (p = 0; p < 2; p++)
+		{
+			parallel_for(k, (rows + 2 - p) / 2) {
+				const int u = k * 2 + p;
+				if (band[u] < band[u + 1])
+				{
+					float* buf = (float*)ccmalloc(buf_size);
+					_ccv_gradient_histogram_rows(a, db, nbin, size, flag, ixp, vx, band[u], band[u + 1], buf);
+					ccfree(buf);
+				}
+			} parallel_endfor
+		}
+	}
+	ccfree(ixp);
+}
+
 static void _ccv_flip_y_self(ccv_dense_matrix_t* a)
 {
 	int i;
@@ -407,7 +648,7 @@ void ccv_flip(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int btype, int type
 		*b = db = ccv_dense_matrix_renew(*b, a->rows, a->cols, btype, btype, sig);
 		ccv_object_return_if_cached(, db);
 		if (a->data.u8 != db->data.u8)
-			memcpy(db->data.u8, a->data.u8, a->rows * a->step);
+			ccv_dense_matrix_copy_rows(a, db);
 	}
 	if (type & CCV_FLIP_Y)
 		_ccv_flip_y_self(db);
@@ -495,3 +736,200 @@ void ccv_blur(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, double si
 	ccv_matrix_typeof_setter_getter(no_8u_type, ccv_matrix_setter_getter, db->type, for_block);
 #undef for_block
 }
+
+/* recursive Gaussian of Young and van Vliet (Recursive implementation of the Gaussian filter, 1995), a causal pass and
+ * an anti-causal pass of 3 poles each, thus, it costs the same for any sigma. The border is replicated as ccv_blur
+ * does, which needs the proper initial values for the anti-causal pass (Triggs and Sdika, Boundary conditions for
+ * Young - van Vliet recursive filtering, 2006), without them, the far end of each row and column would be off */
+typedef struct {
+	float b; // w[n] = b * x[n] + a[0] * w[n - 1] + a[1] * w[n - 2] + a[2] * w[n - 3], and the same backwards
+	float a[3];
+	float m[3][3]; // maps the last 3 of the causal pass to the first 3 of the anti-causal pass past the end
+} ccv_recursive_gaussian_t;
+
+static void _ccv_recursive_gaussian_coeffs(double sigma, ccv_recursive_gaussian_t* g)
+{
+	const double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * sqrt(1 - 0.26891 * sigma);
+	const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+	const double a1 = (2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q) / b0;
+	const double a2 = -(1.4281 * q * q + 1.26661 * q * q * q) / b0;
+	const double a3 = 0.422205 * q * q * q / b0;
+	g->b = 1 - (a1 + a2 + a3);
+	g->a[0] = a1;
+	g->a[1] = a2;
+	g->a[2] = a3;
+	/* past the end, the input is the last sample repeated, thus, the causal pass only carries on the difference of
+	 * its last 3 outputs to that sample, which dies out, and so does the anti-causal pass run back over it. Both are
+	 * linear, run them on each of the 3 differences alone to have the map, the closed form of it is in Triggs and Sdika.
+	 * They die out in about 10 sigma */
+	const int n = (int)(10 * sigma) + 32;
+	double* u = (double*)ccmalloc(sizeof(double) * (n + 6) * 2);
+	double* v = u + n + 6;
+	int i, k;
+	for (k = 0; k < 3; k++)
+	{
+		u[0] = (k == 2), u[1] = (k == 1), u[2] = (k == 0); // u[2] is the last output of the causal pass
+		for (i = 3; i < n + 3; i++)
+			u[i] = a1 * u[i - 1] + a2 * u[i - 2] + a3 * u[i - 3];
+		v[n + 3] = v[n + 4] = v[n + 5] = 0;
+		for (i = n + 2; i >= 3; i--)
+			v[i] = g->b * u[i] + a1 * v[i + 1] + a2 * v[i + 2] + a3 * v[i + 3];
+		g->m[0][k] = v[3];
+		g->m[1][k] = v[4];
+		g->m[2][k] = v[5];
+	}
+	ccfree(u);
+}
+
+// filter n samples that are ch apart in place
+static void _ccv_recursive_gaussian_row(const ccv_recursive_gaussian_t* g, float* x, const int n, const int ch)
+{
+	int i, k;
+	for (k = 0; k < ch; k++)
+	{
+		float* p = x + k;
+		const float x0 = p[0];
+		const float xn = p[(n - 1) * ch];
+		float w1 = x0, w2 = x0, w3 = x0;
+		for (i = 0; i < n; i++)
+		{
+			const float w = (g->b * p[i * ch] + g->a[0] * w1) + (g->a[1] * w2 + g->a[2] * w3);
+			p[i * ch] = w;
+			w3 = w2;
+			w2 = w1;
+			w1 = w;
+		}
+		const float u0 = w1 - xn, u1 = w2 - xn, u2 = w3 - xn;
+		w1 = g->m[0][0] * u0 + g->m[0][1] * u1 + g->m[0][2] * u2 + xn;
+		w2 = g->m[1][0] * u0 + g->m[1][1] * u1 + g->m[1][2] * u2 + xn;
+		w3 = g->m[2][0] * u0 + g->m[2][1] * u1 + g->m[2][2] * u2 + xn;
+		for (i = n - 1; i >= 0; i--)
+		{
+			const float w = (g->b * p[i * ch] + g->a[0] * w1) + (g->a[1] * w2 + g->a[2] * w3);
+			p[i * ch] = w;
+			w3 = w2;
+			w2 = w1;
+			w1 = w;
+		}
+	}
+}
+
+// p = b * p + a[0] * w1 + a[1] * w2 + a[2] * w3 for n adjacent columns
+static inline void _ccv_recursive_gaussian_step(const ccv_recursive_gaussian_t* g, float* p, const float* w1, const float* w2, const float* w3, const int n)
+{
+	int i = 0;
+#if defined(HAVE_SSE2)
+	const __m128 b = _mm_set1_ps(g->b);
+	const __m128 a0 = _mm_set1_ps(g->a[0]);
+	const __m128 a1 = _mm_set1_ps(g->a[1]);
+	const __m128 a2 = _mm_set1_ps(g->a[2]);
+	for (; i < n - 3; i += 4)
+		_mm_storeu_ps(p + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(b, _mm_loadu_ps(p + i)), _mm_mul_ps(a0, _mm_loadu_ps(w1 + i))), _mm_add_ps(_mm_mul_ps(a1, _mm_loadu_ps(w2 + i)), _mm_mul_ps(a2, _mm_loadu_ps(w3 + i)))));
+#elif defined(HAVE_NEON)
+	const float32x4_t b = vdupq_n_f32(g->b);
+	const float32x4_t a0 = vdupq_n_f32(g->a[0]);
+	const float32x4_t a1 = vdupq_n_f32(g->a[1]);
+	const float32x4_t a2 = vdupq_n_f32(g->a[2]);
+	for (; i < n - 3; i += 4)
+		vst1q_f32(p + i, vaddq_f32(vmlaq_f32(vmulq_f32(b, vld1q_f32(p + i)), a0, vld1q_f32(w1 + i)), vmlaq_f32(vmulq_f32(a1, vld1q_f32(w2 + i)), a2, vld1q_f32(w3 + i))));
+#endif
+	for (; i < n; i++)
+		p[i] = (g->b * p[i] + g->a[0] * w1[i]) + (g->a[1] * w2[i] + g->a[2] * w3[i]);
+}
+
+// filter n adjacent columns of rows rows in place, each row is step floats apart, it needs 5 * n floats of buf
+static void _ccv_recursive_gaussian_columns(const ccv_recursive_gaussian_t* g, float* x, const int rows, const int step, const int n, float* buf)
+{
+	float* const x0 = buf;
+	float* const xn = buf + n;
+	float* const y = buf + n * 2;
+	memcpy(x0, x, sizeof(float) * n);
+	memcpy(xn, x + (rows - 1) * step, sizeof(float) * n);
+	const float* w1 = x0;
+	const float* w2 = x0;
+	const float* w3 = x0;
+	int i, j;
+	for (i = 0; i < rows; i++)
+	{
+		float* p = x + i * step;
+		_ccv_recursive_gaussian_step(g, p, w1, w2, w3, n);
+		w3 = w2;
+		w2 = w1;
+		w1 = p;
+	}
+	for (j = 0; j < n; j++)
+	{
+		const float u0 = w1[j] - xn[j], u1 = w2[j] - xn[j], u2 = w3[j] - xn[j];
+		y[j] = g->m[0][0] * u0 + g->m[0][1] * u1 + g->m[0][2] * u2 + xn[j];
+		y[n + j] = g->m[1][0] * u0 + g->m[1][1] * u1 + g->m[1][2] * u2 + xn[j];
+		y[n * 2 + j] = g->m[2][0] * u0 + g->m[2][1] * u1 + g->m[2][2] * u2 + xn[j];
+	}
+	w1 = y;
+	w2 = y + n;
+	w3 = y + n * 2;
+	for (i = rows - 1; i >= 0; i--)
+	{
+		float* p = x + i * step;
+		_ccv_recursive_gaussian_step(g, p, w1, w2, w3, n);
+		w3 = w2;
+		w2 = w1;
+		w1 = p;
+	}
+}
+
+#define CCV_BLUR_COLUMN_BLOCK (64)
+
+static void _ccv_blur_recursive(ccv_dense_matrix_t* a, ccv_dense_matrix_t* db, double sigma)
+{
+	ccv_recursive_gaussian_t g;
+	_ccv_recursive_gaussian_coeffs(sigma, &g);
+	const int ch = CCV_GET_CHANNEL(a->type);
+	const int n = a->cols * ch;
+	float* x = (float*)ccmalloc(sizeof(float) * a->rows * n);
+	/* horizontal, one row at a time */
+	parallel_for(i, a->rows) {
+		int j;
+		unsigned char* a_ptr = a->data.u8 + i * a->step;
+		float* x_ptr = x + i * n;
+#define for_block(_, _for_get) \
+		for (j = 0; j < n; j++) \
+			x_ptr[j] = _for_get(a_ptr, j, 0);
+		ccv_matrix_getter(a->type, for_block);
+#undef for_block
+		_ccv_recursive_gaussian_row(&g, x_ptr, a->cols, ch);
+	} parallel_endfor
+	/* vertical, a block of adjacent columns at a time such that they run in SIMD */
+	parallel_for(i, (n + CCV_BLUR_COLUMN_BLOCK - 1) / CCV_BLUR_COLUMN_BLOCK) {
+		float buf[CCV_BLUR_COLUMN_BLOCK * 5];
+		_ccv_recursive_gaussian_columns(&g, x + i * CCV_BLUR_COLUMN_BLOCK, a->rows, n, ccv_min(CCV_BLUR_COLUMN_BLOCK, n - i * CCV_BLUR_COLUMN_BLOCK), buf);
+	} parallel_endfor
+	// round to the nearest for integer output, ccv_blur truncates, but it has no reason to skew the result down either
+	const float rounding = (db->type & (CCV_32F | CCV_64F)) ? 0 : 0.5;
+	parallel_for(i, a->rows) {
+		int j;
+		unsigned char* b_ptr = db->data.u8 + i * db->step;
+		const float* x_ptr = x + i * n;
+#define for_block(_, _for_set) \
+		for (j = 0; j < n; j++) \
+			_for_set(b_ptr, j, x_ptr[j] + rounding, 0);
+		ccv_matrix_setter(db->type, for_block);
+#undef for_block
+	} parallel_endfor
+	ccfree(x);
+}
+
+void ccv_blur_with_mode(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, double sigma, int mode)
+{
+	assert(mode == CCV_BLUR_KERNEL || mode == CCV_BLUR_RECURSIVE);
+	if (mode == CCV_BLUR_KERNEL)
+	{
+		ccv_blur(a, b, type, sigma);
+		return;
+	}
+	assert(sigma >= 0.5);
+	ccv_declare_derived_signature(sig, a->sig != 0, ccv_sign_with_format(64, "ccv_blur_with_mode(%la,%d)", sigma, mode), a->sig, CCV_EOF_SIGN);
+	type = (type == 0) ? CCV_GET_DATA_TYPE(a->type) | CCV_GET_CHANNEL(a->type) : CCV_GET_DATA_TYPE(type) | CCV_GET_CHANNEL(a->type);
+	ccv_dense_matrix_t* db = *b = ccv_dense_matrix_renew(*b, a->rows, a->cols, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), type, sig);
+	ccv_object_return_if_cached(, db);
+	_ccv_blur_recursive(a, db, sigma);
+}
@@ -1188,31 +1188,36 @@ static int _ccv_is_equal_same_class(const void* _r1, const void* _r2, void* data
 		   (int)(r2->rect.width * 1.5 + 0.5) >= r1->rect.width;
 }
 
-ccv_array_t* ccv_bbf_detect_objects(ccv_dense_matrix_t* a, ccv_bbf_classifier_cascade_t** _cascade, int count, ccv_bbf_param_t params)
+static ccv_rect_t _ccv_is_equal_hint(const void* _r, void* data)
+{
+	const ccv_comp_t* r = (const ccv_comp_t*)_r;
+	int distance = (int)(r->rect.width * 0.25 + 0.5);
+	// _ccv_is_equal(r, r2) requires r2's top left corner to be within distance of r's
+	return ccv_rect(r->rect.x - distance, r->rect.y - distance, distance * 2 + 1, distance * 2 + 1);
+}
+
+// scan the pyramid of the input scaled to the cascade size, rows and cols are of the input before the scaling
+static ccv_array_t* _ccv_bbf_detect_objects(ccv_image_pyramid_t* pyramid, int rows, int cols, ccv_bbf_classifier_cascade_t** _cascade, int count, ccv_bbf_param_t params)
 {
-	int hr = a->rows / params.size.height;
-	int wr = a->cols / params.size.width;
+	int hr = rows / params.size.height;
+	int wr = cols / params.size.width;
 	double scale = pow(2., 1. / (params.interval + 1.));
 	int next = params.interval + 1;
 	int scale_upto = (int)(log((double)ccv_min(hr, wr)) / log(scale));
+	assert(ccv_image_pyramid_interval(pyramid) == params.interval);
 	ccv_dense_matrix_t** pyr = (ccv_dense_matrix_t**)alloca((scale_upto + next * 2) * 4 * sizeof(ccv_dense_matrix_t*));
 	memset(pyr, 0, (scale_upto + next * 2) * 4 * sizeof(ccv_dense_matrix_t*));
-	if (params.size.height != _cascade[0]->size.height || params.size.width != _cascade[0]->size.width)
-		ccv_resample(a, &pyr[0], 0, a->rows * _cascade[0]->size.height / params.size.height, a->cols * _cascade[0]->size.width / params.size.width, CCV_INTER_AREA);
-	else
-		pyr[0] = a;
 	int i, j, k, t, x, y, q;
-	for (i = 1; i < ccv_min(params.interval + 1, scale_upto + next * 2); i++)
-		ccv_resample(pyr[0], &pyr[i * 4], 0, (int)(pyr[0]->rows / pow(scale, i)), (int)(pyr[0]->cols / pow(scale, i)), CCV_INTER_AREA);
-	for (i = next; i < scale_upto + next * 2; i++)
-		ccv_sample_down(pyr[i * 4 - next * 4], &pyr[i * 4], 0, 0, 0);
-	if (params.accurate)
-		for (i = next * 2; i < scale_upto + next * 2; i++)
-		{
-			ccv_sample_down(pyr[i * 4 - next * 4], &pyr[i * 4 + 1], 0, 1, 0);
-			ccv_sample_down(pyr[i * 4 - next * 4], &pyr[i * 4 + 2], 0, 0, 1);
-			ccv_sample_down(pyr[i * 4 - next * 4], &pyr[i * 4 + 3], 0, 1, 1);
-		}
+	ccv_image_pyramid_reserve(pyramid, scale_upto + next * 2, 1);
+	for (i = 0; i < scale_upto + next * 2; i++)
+		pyr[i * 4] = ccv_image_pyramid_level(pyramid, i);
+	if (params.accurate) // the shifted variants are only used two octaves below
+	{
+		parallel_for(i, scale_upto * 3) {
+			const int level = i / 3 + next * 2;
+			pyr[level * 4 + i % 3 + 1] = ccv_image_pyramid_derived(pyramid, level, CCV_IMAGE_PYRAMID_SHIFTED, i % 3 + 1);
+		} parallel_endfor
+	}
 	ccv_array_t* idx_seq;
 	ccv_array_t* seq = ccv_array_new(sizeof(ccv_comp_t), 64, 0);
 	ccv_array_t* seq2 = ccv_array_new(sizeof(ccv_comp_t), 64, 0);
@@ -1291,7 +1296,7 @@ ccv_array_t* ccv_bbf_detect_objects(ccv_dense_matrix_t* a, ccv_bbf_classifier_ca
 			idx_seq = 0;
 			ccv_array_clear(seq2);
 			// group retrieved rectangles in order to filter out noise
-			int ncomp = ccv_array_group(seq, &idx_seq, _ccv_is_equal_same_class, 0);
+			int ncomp = ccv_array_group_spatial(seq, &idx_seq, _ccv_is_equal_same_class, _ccv_is_equal_hint, 0);
 			ccv_comp_t* comps = (ccv_comp_t*)ccmalloc((ncomp + 1) * sizeof(ccv_comp_t));
 			memset(comps, 0, (ncomp + 1) * sizeof(ccv_comp_t));
 
@@ -1374,7 +1379,7 @@ ccv_array_t* ccv_bbf_detect_objects(ccv_dense_matrix_t* a, ccv_bbf_classifier_ca
 		result_seq2 = ccv_array_new(sizeof(ccv_comp_t), 64, 0);
 		idx_seq = 0;
 		// group retrieved rectangles in order to filter out noise
-		int ncomp = ccv_array_group(result_seq, &idx_seq, _ccv_is_equal, 0);
+		int ncomp = ccv_array_group_spatial(result_seq, &idx_seq, _ccv_is_equal, _ccv_is_equal_hint, 0);
 		ccv_comp_t* comps = (ccv_comp_t*)ccmalloc((ncomp + 1) * sizeof(ccv_comp_t));
 		memset(comps, 0, (ncomp + 1) * sizeof(ccv_comp_t));
 
@@ -1404,19 +1409,32 @@ ccv_array_t* ccv_bbf_detect_objects(ccv_dense_matrix_t* a, ccv_bbf_classifier_ca
 		result_seq2 = result_seq;
 	}
 
-	for (i = 1; i < scale_upto + next * 2; i++)
-		ccv_matrix_free(pyr[i * 4]);
-	if (params.accurate)
-		for (i = next * 2; i < scale_upto + next * 2; i++)
-		{
-			ccv_matrix_free(pyr[i * 4 + 1]);
-			ccv_matrix_free(pyr[i * 4 + 2]);
-			ccv_matrix_free(pyr[i * 4 + 3]);
-		}
+	return result_seq2;
+}
+
+ccv_array_t* ccv_bbf_detect_objects(ccv_dense_matrix_t* a, ccv_bbf_classifier_cascade_t** _cascade, int count, ccv_bbf_param_t params)
+{
+	ccv_dense_matrix_t* pyr0 = a;
 	if (params.size.height != _cascade[0]->size.height || params.size.width != _cascade[0]->size.width)
-		ccv_matrix_free(pyr[0]);
+	{
+		pyr0 = 0;
+		ccv_resample(a, &pyr0, 0, a->rows * _cascade[0]->size.height / params.size.height, a->cols * _cascade[0]->size.width / params.size.width, CCV_INTER_AREA);
+	}
+	ccv_image_pyramid_t* pyramid = ccv_image_pyramid_new(pyr0, params.interval);
+	ccv_array_t* seq = _ccv_bbf_detect_objects(pyramid, a->rows, a->cols, _cascade, count, params);
+	ccv_image_pyramid_free(pyramid);
+	if (pyr0 != a)
+		ccv_matrix_free(pyr0);
+	return seq;
+}
 
-	return result_seq2;
+ccv_array_t* ccv_bbf_detect_objects_in_pyramid(ccv_image_pyramid_t* pyramid, ccv_bbf_classifier_cascade_t** _cascade, int count, ccv_bbf_param_t params)
+{
+	ccv_dense_matrix_t* a = ccv_image_pyramid_source(pyramid);
+	// the levels are not the ones the cascade scans, use a private pyramid
+	if (params.size.height != _cascade[0]->size.height || params.size.width != _cascade[0]->size.width || ccv_image_pyramid_interval(pyramid) != params.interval)
+		return ccv_bbf_detect_objects(a, _cascade, count, params);
+	return _ccv_bbf_detect_objects(pyramid, a->rows, a->cols, _cascade, count, params);
 }
 
 ccv_bbf_classifier_cascade_t* ccv_bbf_read_classifier_cascade(const char* directory)
@@ -21,6 +21,7 @@ void ccv_cache_init(ccv_cache_t* cache, size_t up, int cache_types, ccv_cache_in
 		cache->ffree[i] = va_arg(arguments, ccv_cache_index_free_f);
 	va_end(arguments);
 	memset(&cache->origin, 0, sizeof(ccv_cache_index_t));
+	memset(cache->stats, 0, sizeof(cache->stats));
 }
 
 static int bits_in_16bits[0x1u << 16];
@@ -154,11 +155,14 @@ void* ccv_cache_get(ccv_cache_t* cache, uint64_t sign, uint8_t* type)
 		return 0;
 	if (branch->terminal.sign != sign)
 		return 0;
+	++cache->stats[CCV_GET_CACHE_TYPE(branch->terminal.type)].hits;
 	if (type)
 		*type = CCV_GET_CACHE_TYPE(branch->terminal.type);
 	return (void*)(branch->terminal.off - (branch->terminal.off & 0x3));
 }
 
+static void* _ccv_cache_out(ccv_cache_t* cache, uint64_t sign, uint8_t* type);
+
 // only call this function when the cache space is delpeted
 static void _ccv_cache_lru(ccv_cache_t* cache)
 {
@@ -172,6 +176,8 @@ static void _ccv_cache_lru(ccv_cache_t* cache)
 		{
 			assert(type >= 0 && type < 16);
 			cache->ffree[type](result);
+			++cache->stats[type].evictions;
+			cache->stats[type].size = 0;
 		}
 		cache->rnum = 0;
 		cache->size = 0;
@@ -185,7 +191,11 @@ static void _ccv_cache_lru(ccv_cache_t* cache)
 		int leaf = branch->terminal.off & 0x1;
 		if (leaf)
 		{
-			ccv_cache_delete(cache, branch->terminal.sign);
+			uint8_t type = 0;
+			void* result = _ccv_cache_out(cache, branch->terminal.sign, &type);
+			assert(result != 0 && type >= 0 && type < 16);
+			cache->ffree[type](result);
+			++cache->stats[type].evictions;
 			break;
 		} else {
 			ccv_cache_index_t* set = (ccv_cache_index_t*)(branch->branch.set - (branch->branch.set & 0x3));
@@ -212,11 +222,21 @@ static void _ccv_cache_depleted(ccv_cache_t* cache, size_t size)
 		_ccv_cache_lru(cache);
 }
 
+void ccv_cache_evict(ccv_cache_t* cache, size_t size)
+{
+	_ccv_cache_depleted(cache, size);
+}
+
 int ccv_cache_put(ccv_cache_t* cache, uint64_t sign, void* x, uint32_t size, uint8_t type)
 {
 	assert(((uint64_t)x & 0x3) == 0);
+	assert(type < 16);
+	ccv_cache_stats_t* const stats = cache->stats + type;
 	if (size > cache->up)
+	{
+		++stats->rejects;
 		return -1;
+	}
 	if (size + cache->size > cache->up)
 		_ccv_cache_depleted(cache, cache->up - size);
 	if (cache->rnum == 0)
@@ -227,6 +247,9 @@ int ccv_cache_put(ccv_cache_t* cache, uint64_t sign, void* x, uint32_t size, uin
 		cache->origin.terminal.type = CCV_SET_TERMINAL_TYPE(type, cache->age, size);
 		cache->size = size;
 		cache->rnum = 1;
+		++stats->puts;
+		stats->size += size;
+		stats->peak = ccv_max(stats->peak, stats->size);
 		return 0;
 	}
 	++cache->age;
@@ -241,10 +264,15 @@ int ccv_cache_put(ccv_cache_t* cache, uint64_t sign, void* x, uint32_t size, uin
 	{
 		if (sign == branch->terminal.sign)
 		{
-			cache->ffree[CCV_GET_CACHE_TYPE(branch->terminal.type)]((void*)(branch->terminal.off - (branch->terminal.off & 0x3)));
+			const uint8_t old_type = CCV_GET_CACHE_TYPE(branch->terminal.type);
+			cache->ffree[old_type]((void*)(branch->terminal.off - (branch->terminal.off & 0x3)));
 			branch->terminal.off = (uint64_t)x | 0x1;
 			uint32_t old_size = CCV_GET_TERMINAL_SIZE(branch->terminal.type);
 			cache->size = cache->size + size - old_size;
+			cache->stats[old_type].size -= old_size;
+			++stats->puts;
+			stats->size += size;
+			stats->peak = ccv_max(stats->peak, stats->size);
 			branch->terminal.type = CCV_SET_TERMINAL_TYPE(type, cache->age, size);
 			_ccv_cache_aging(&cache->origin, sign);
 			return 1;
@@ -304,6 +332,9 @@ int ccv_cache_put(ccv_cache_t* cache, uint64_t sign, void* x, uint32_t size, uin
 	}
 	cache->rnum++;
 	cache->size += size;
+	++stats->puts;
+	stats->size += size;
+	stats->peak = ccv_max(stats->peak, stats->size);
 	return 0;
 }
 
@@ -341,7 +372,7 @@ static void _ccv_cache_cleanup_and_free(ccv_cache_index_t* branch, ccv_cache_ind
 	}
 }
 
-void* ccv_cache_out(ccv_cache_t* cache, uint64_t sign, uint8_t* type)
+static void* _ccv_cache_out(ccv_cache_t* cache, uint64_t sign, uint8_t* type)
 {
 	if (!bits_in_16bits_init)
 		precomputed_16bits();
@@ -394,6 +425,7 @@ void* ccv_cache_out(ccv_cache_t* cache, uint64_t sign, uint8_t* type)
 	if (type)
 		*type = CCV_GET_CACHE_TYPE(branch->terminal.type);
 	uint32_t size = CCV_GET_TERMINAL_SIZE(branch->terminal.type);
+	cache->stats[CCV_GET_CACHE_TYPE(branch->terminal.type)].size -= size;
 	if (branch != &cache->origin)
 	{
 		uint64_t k = 1, j = 63;
@@ -426,10 +458,23 @@ void* ccv_cache_out(ccv_cache_t* cache, uint64_t sign, uint8_t* type)
 	return result;
 }
 
+void* ccv_cache_out(ccv_cache_t* cache, uint64_t sign, uint8_t* type)
+{
+	uint8_t result_type = 0;
+	void* result = _ccv_cache_out(cache, sign, &result_type);
+	if (result)
+	{
+		++cache->stats[result_type].hits;
+		if (type)
+			*type = result_type;
+	}
+	return result;
+}
+
 int ccv_cache_delete(ccv_cache_t* cache, uint64_t sign)
 {
 	uint8_t type = 0;
-	void* result = ccv_cache_out(cache, sign, &type);
+	void* result = _ccv_cache_out(cache, sign, &type);
 	if (result != 0)
 	{
 		assert(type >= 0 && type < 16);
@@ -444,6 +489,9 @@ void ccv_cache_cleanup(ccv_cache_t* cache)
 	if (cache->rnum > 0)
 	{
 		_ccv_cache_cleanup_and_free(&cache->origin, cache->ffree);
+		int i;
+		for (i = 0; i < 16; i++)
+			cache->stats[i].size = 0;
 		cache->size = 0;
 		cache->age = 0;
 		cache->rnum = 0;
@@ -1,7 +1,12 @@
 #include "ccv.h"
 #include "ccv_internal.h"
+#if defined(HAVE_SSE2)
+#include <emmintrin.h>
+#elif defined(HAVE_NEON)
+#include <arm_neon.h>
+#endif
 
-void ccv_hog(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int b_type, int sbin, int size)
+static int _ccv_hog_renew(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int b_type, int sbin, int size)
 {
 	assert(a->rows >= size && a->cols >= size && (4 + sbin * 3) <= CCV_MAX_CHANNEL);
 	int rows = a->rows / size;
@@ -9,190 +14,468 @@ void ccv_hog(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int b_type, int sbin
 	b_type = (CCV_GET_DATA_TYPE(b_type) == CCV_64F) ? CCV_64F | (4 + sbin * 3) : CCV_32F | (4 + sbin * 3);
 	ccv_declare_derived_signature(sig, a->sig != 0, ccv_sign_with_format(64, "ccv_hog(%d,%d)", sbin, size), a->sig, CCV_EOF_SIGN);
 	ccv_dense_matrix_t* db = *b = ccv_dense_matrix_renew(*b, rows, cols, CCV_64F | CCV_32F | (4 + sbin * 3), b_type, sig);
-	ccv_object_return_if_cached(, db);
-	ccv_dense_matrix_t* ag = 0;
-	ccv_dense_matrix_t* mg = 0;
-	ccv_gradient(a, &ag, 0, &mg, 0, 1, 1);
-	float* agp = ag->data.f32;
-	float* mgp = mg->data.f32;
-	int i, j, k, ch = CCV_GET_CHANNEL(a->type);
-	ccv_dense_matrix_t* cn = ccv_dense_matrix_new(rows, cols, CCV_GET_DATA_TYPE(db->type) | (sbin * 2), 0, 0);
-	ccv_dense_matrix_t* ca = ccv_dense_matrix_new(rows, cols, CCV_GET_DATA_TYPE(db->type) | CCV_C1, 0, 0);
-	ccv_zero(cn);
-	// normalize sbin direction-sensitive and sbin * 2 insensitive over 4 normalization factor
-	// accumulating them over sbin * 2 + sbin + 4 channels
-	// TNA - truncation - normalization - accumulation
-#define TNA(_for_type, idx, a, b, c, d) \
+	ccv_object_return_if_cached(1, db);
+	return 0;
+}
+
+// the energy of each cell in row i of cn, over its sbin direction-insensitive bins
+static void _ccv_hog_energy_row(ccv_dense_matrix_t* cn, ccv_dense_matrix_t* ca, int i, int sbin)
+{
+	double* cap = (double*)(ca->data.u8 + i * ca->step);
+	int j, k;
+#define for_block(_, _for_type) \
+	_for_type* cnp = (_for_type*)(cn->data.u8 + i * cn->step); \
+	for (j = 0; j < cn->cols; j++) \
 	{ \
-		_for_type norm = 1.0 / sqrt(cap[a] + cap[b] + cap[c] + cap[d] + 1e-4); \
-		for (k = 0; k < sbin * 2; k++) \
-		{ \
-			_for_type v = 0.5 * ccv_min(cnp[k] * norm, 0.2); \
-			dbp[4 + sbin + k] += v; \
-			dbp[idx] += v; \
-		} \
-		dbp[idx] *= 0.2357; \
+		double energy = 0; \
 		for (k = 0; k < sbin; k++) \
-		{ \
-			_for_type v = 0.5 * ccv_min((cnp[k] + cnp[k + sbin]) * norm, 0.2); \
-			dbp[4 + k] += v; \
-		} \
+			energy += (cnp[k] + cnp[k + sbin]) * (cnp[k] + cnp[k + sbin]); \
+		cap[j] = energy; \
+		cnp += 2 * sbin; \
 	}
-#define for_block(_, _for_type) \
-	_for_type* cnp = (_for_type*)ccv_get_dense_matrix_cell(cn, 0, 0, 0); \
-	for (i = 0; i < rows * size; i++) \
+	ccv_matrix_typeof(cn->type, for_block);
+#undef for_block
+}
+
+/* TNA - truncation - normalization - accumulation, normalize sbin * 2 direction-sensitive bins of a cell over the 4
+ * normalization factors of the 2x2 blocks it is in, and accumulate them into sbin * 2 + sbin + 4 channels */
+static void _ccv_hog_tna_32f(const float* cnp, const double* norm, float* dbp, int sbin)
+{
+	float s[4] = {0, 0, 0, 0};
+	int k = 0, n;
+#if defined(HAVE_SSE2)
+	const __m128 half4 = _mm_set1_ps(0.5);
+	const __m128 cap4 = _mm_set1_ps(0.2);
+	__m128 n4[4];
+	__m128 s4[4];
+	for (n = 0; n < 4; n++)
+	{
+		n4[n] = _mm_set1_ps(norm[n]);
+		s4[n] = _mm_setzero_ps();
+	}
+	for (; k <= sbin * 2 - 4; k += 4)
+	{
+		const __m128 c4 = _mm_loadu_ps(cnp + k);
+		__m128 v4 = _mm_setzero_ps();
+		for (n = 0; n < 4; n++)
+		{
+			const __m128 t4 = _mm_mul_ps(half4, _mm_min_ps(_mm_mul_ps(c4, n4[n]), cap4));
+			s4[n] = _mm_add_ps(s4[n], t4);
+			v4 = _mm_add_ps(v4, t4);
+		}
+		_mm_storeu_ps(dbp + 4 + sbin + k, v4);
+	}
+	for (n = 0; n < 4; n++)
+	{
+		float t[4];
+		_mm_storeu_ps(t, s4[n]);
+		s[n] = t[0] + t[1] + t[2] + t[3];
+	}
+#elif defined(HAVE_NEON)
+	const float32x4_t half4 = vdupq_n_f32(0.5);
+	const float32x4_t cap4 = vdupq_n_f32(0.2);
+	float32x4_t n4[4];
+	float32x4_t s4[4];
+	for (n = 0; n < 4; n++)
+	{
+		n4[n] = vdupq_n_f32(norm[n]);
+		s4[n] = vdupq_n_f32(0);
+	}
+	for (; k <= sbin * 2 - 4; k += 4)
+	{
+		const float32x4_t c4 = vld1q_f32(cnp + k);
+		float32x4_t v4 = vdupq_n_f32(0);
+		for (n = 0; n < 4; n++)
+		{
+			const float32x4_t t4 = vmulq_f32(half4, vminq_f32(vmulq_f32(c4, n4[n]), cap4));
+			s4[n] = vaddq_f32(s4[n], t4);
+			v4 = vaddq_f32(v4, t4);
+		}
+		vst1q_f32(dbp + 4 + sbin + k, v4);
+	}
+	for (n = 0; n < 4; n++)
+	{
+		float t[4];
+		vst1q_f32(t, s4[n]);
+		s[n] = t[0] + t[1] + t[2] + t[3];
+	}
+#endif
+	for (; k < sbin * 2; k++)
+	{
+		float v = 0;
+		for (n = 0; n < 4; n++)
+		{
+			const float t = 0.5f * ccv_min(cnp[k] * (float)norm[n], 0.2f);
+			s[n] += t;
+			v += t;
+		}
+		dbp[4 + sbin + k] = v;
+	}
+	for (n = 0; n < 4; n++)
+		dbp[n] = s[n] * 0.2357f;
+	k = 0;
+#if defined(HAVE_SSE2)
+	for (; k <= sbin - 4; k += 4)
+	{
+		const __m128 c4 = _mm_add_ps(_mm_loadu_ps(cnp + k), _mm_loadu_ps(cnp + k + sbin));
+		__m128 v4 = _mm_setzero_ps();
+		for (n = 0; n < 4; n++)
+			v4 = _mm_add_ps(v4, _mm_mul_ps(half4, _mm_min_ps(_mm_mul_ps(c4, n4[n]), cap4)));
+		_mm_storeu_ps(dbp + 4 + k, v4);
+	}
+#elif defined(HAVE_NEON)
+	for (; k <= sbin - 4; k += 4)
+	{
+		const float32x4_t c4 = vaddq_f32(vld1q_f32(cnp + k), vld1q_f32(cnp + k + sbin));
+		float32x4_t v4 = vdupq_n_f32(0);
+		for (n = 0; n < 4; n++)
+			v4 = vaddq_f32(v4, vmulq_f32(half4, vminq_f32(vmulq_f32(c4, n4[n]), cap4)));
+		vst1q_f32(dbp + 4 + k, v4);
+	}
+#endif
+	for (; k < sbin; k++)
+	{
+		float v = 0;
+		for (n = 0; n < 4; n++)
+			v += 0.5f * ccv_min((cnp[k] + cnp[k + sbin]) * (float)norm[n], 0.2f);
+		dbp[4 + k] = v;
+	}
+}
+
+static void _ccv_hog_tna_64f(const double* cnp, const double* norm, double* dbp, int sbin)
+{
+	double s[4] = {0, 0, 0, 0};
+	int k, n;
+	for (k = 0; k < sbin * 2; k++)
+	{
+		double v = 0;
+		for (n = 0; n < 4; n++)
+		{
+			const double t = 0.5 * ccv_min(cnp[k] * norm[n], 0.2);
+			s[n] += t;
+			v += t;
+		}
+		dbp[4 + sbin + k] = v;
+	}
+	for (n = 0; n < 4; n++)
+		dbp[n] = s[n] * 0.2357;
+	for (k = 0; k < sbin; k++)
+	{
+		double v = 0;
+		for (n = 0; n < 4; n++)
+			v += 0.5 * ccv_min((cnp[k] + cnp[k + sbin]) * norm[n], 0.2);
+		dbp[4 + k] = v;
+	}
+}
+
+// normalize row i of cn into row i of db, the blocks on the border replicate the cells on the border
+static void _ccv_hog_normalize_row(ccv_dense_matrix_t* cn, ccv_dense_matrix_t* ca, ccv_dense_matrix_t* db, int i, int sbin)
+{
+	const int rows = db->rows;
+	const int cols = db->cols;
+	const double* ca0 = (const double*)(ca->data.u8 + ccv_max(i - 1, 0) * ca->step);
+	const double* ca1 = (const double*)(ca->data.u8 + i * ca->step);
+	const double* ca2 = (const double*)(ca->data.u8 + ccv_min(i + 1, rows - 1) * ca->step);
+	unsigned char* cnp = cn->data.u8 + i * cn->step;
+	unsigned char* dbp = db->data.u8 + i * db->step;
+	const int cn_size = CCV_GET_DATA_TYPE_SIZE(cn->type) * sbin * 2;
+	const int db_size = CCV_GET_DATA_TYPE_SIZE(db->type) * (4 + sbin * 3);
+	int j;
+	for (j = 0; j < cols; j++)
+	{
+		const int j0 = ccv_max(j - 1, 0);
+		const int j1 = ccv_min(j + 1, cols - 1);
+		// the magnitude in cn is in 0~255, hence the 1 / 255 here
+		double norm[4];
+		norm[0] = (1.0 / 255.0) / sqrt((ca1[j] + ca1[j1] + ca2[j] + ca2[j1]) * (1.0 / (255.0 * 255.0)) + 1e-4);
+		norm[1] = (1.0 / 255.0) / sqrt((ca1[j] + ca1[j1] + ca0[j] + ca0[j1]) * (1.0 / (255.0 * 255.0)) + 1e-4);
+		norm[2] = (1.0 / 255.0) / sqrt((ca1[j] + ca1[j0] + ca2[j] + ca2[j0]) * (1.0 / (255.0 * 255.0)) + 1e-4);
+		norm[3] = (1.0 / 255.0) / sqrt((ca1[j] + ca1[j0] + ca0[j] + ca0[j0]) * (1.0 / (255.0 * 255.0)) + 1e-4);
+		if (CCV_GET_DATA_TYPE(db->type) == CCV_32F)
+			_ccv_hog_tna_32f((const float*)(cnp + j * cn_size), norm, (float*)(dbp + j * db_size), sbin);
+		else
+			_ccv_hog_tna_64f((const double*)(cnp + j * cn_size), norm, (double*)(dbp + j * db_size), sbin);
+	}
+}
+
+void ccv_hog_batch(ccv_dense_matrix_t** a, ccv_dense_matrix_t** b, int b_type, int sbin, const int* size, int count)
+{
+	int i;
+	int* cached = (int*)alloca(sizeof(int) * (count * 2 + 1));
+	int* offset = cached + count;
+	ccv_dense_matrix_t** cn = (ccv_dense_matrix_t**)alloca(sizeof(ccv_dense_matrix_t*) * count * 2);
+	ccv_dense_matrix_t** ca = cn + count;
+	for (i = 0; i < count; i++)
+	{
+		cached[i] = _ccv_hog_renew(a[i], b + i, b_type, sbin, size[i]);
+		cn[i] = ca[i] = 0;
+	}
+	// the direction-sensitive histogram of each cell, with the magnitude splitted between the 4 nearest cells,
+	// each one runs its bands of rows in parallel as well
+	parallel_for(i, count) {
+		if (!cached[i])
+		{
+			ccv_gradient_histogram(a[i], &cn[i], CCV_GET_DATA_TYPE(b[i]->type), sbin * 2, size[i], CCV_GRADIENT_HISTOGRAM_SIGNED);
+			ca[i] = ccv_dense_matrix_new(b[i]->rows, b[i]->cols, CCV_64F | CCV_C1, 0, 0);
+		}
+	} parallel_endfor
+	// from now on, a row of cells of any of them is a task of its own, thus, the small ones don't keep threads idle
+	offset[0] = 0;
+	for (i = 0; i < count; i++)
+		offset[i + 1] = offset[i] + (cached[i] ? 0 : b[i]->rows);
+	parallel_for(t, offset[count]) {
+		int k = 0;
+		while (offset[k + 1] <= t)
+			++k;
+		_ccv_hog_energy_row(cn[k], ca[k], t - offset[k], sbin);
+	} parallel_endfor
+	parallel_for(t, offset[count]) {
+		int k = 0;
+		while (offset[k + 1] <= t)
+			++k;
+		_ccv_hog_normalize_row(cn[k], ca[k], b[k], t - offset[k], sbin);
+	} parallel_endfor
+	for (i = 0; i < count; i++)
+		if (!cached[i])
+		{
+			ccv_matrix_free(cn[i]);
+			ccv_matrix_free(ca[i]);
+		}
+}
+
+void ccv_hog(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int b_type, int sbin, int size)
+{
+	ccv_hog_batch(&a, b, b_type, sbin, &size, 1);
+}
+
+/* the 3x3 Sobel of row i of an 8-bit matrix, replicating the border, the same as ccv_sobel with (3, 0) and (0, 3),
+ * v and w are cols + 2 elements to hold the vertical passes */
+static void _ccv_canny_sobel3_row(ccv_dense_matrix_t* a, int i, short* v, short* w, int* dx, int* dy)
+{
+	const int cols = a->cols;
+	const unsigned char* a0 = a->data.u8 + ccv_max(i - 1, 0) * a->step;
+	const unsigned char* a1 = a->data.u8 + i * a->step;
+	const unsigned char* a2 = a->data.u8 + ccv_min(i + 1, a->rows - 1) * a->step;
+	int j = 0;
+#if defined(HAVE_SSE2)
+	const __m128i z = _mm_setzero_si128();
+	for (; j <= cols - 16; j += 16)
+	{
+		const __m128i r0 = _mm_loadu_si128((const __m128i*)(a0 + j));
+		const __m128i r1 = _mm_loadu_si128((const __m128i*)(a1 + j));
+		const __m128i r2 = _mm_loadu_si128((const __m128i*)(a2 + j));
+		__m128i l0 = _mm_unpacklo_epi8(r0, z);
+		__m128i l1 = _mm_unpacklo_epi8(r1, z);
+		__m128i l2 = _mm_unpacklo_epi8(r2, z);
+		_mm_storeu_si128((__m128i*)(v + 1 + j), _mm_add_epi16(_mm_add_epi16(l0, l2), _mm_slli_epi16(l1, 1)));
+		_mm_storeu_si128((__m128i*)(w + 1 + j), _mm_sub_epi16(l2, l0));
+		l0 = _mm_unpackhi_epi8(r0, z);
+		l1 = _mm_unpackhi_epi8(r1, z);
+		l2 = _mm_unpackhi_epi8(r2, z);
+		_mm_storeu_si128((__m128i*)(v + 9 + j), _mm_add_epi16(_mm_add_epi16(l0, l2), _mm_slli_epi16(l1, 1)));
+		_mm_storeu_si128((__m128i*)(w + 9 + j), _mm_sub_epi16(l2, l0));
+	}
+#elif defined(HAVE_NEON)
+	for (; j <= cols - 8; j += 8)
+	{
+		const int16x8_t l0 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(a0 + j)));
+		const int16x8_t l1 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(a1 + j)));
+		const int16x8_t l2 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(a2 + j)));
+		vst1q_s16(v + 1 + j, vaddq_s16(vaddq_s16(l0, l2), vshlq_n_s16(l1, 1)));
+		vst1q_s16(w + 1 + j, vsubq_s16(l2, l0));
+	}
+#endif
+	for (; j < cols; j++)
+	{
+		v[1 + j] = a0[j] + 2 * a1[j] + a2[j];
+		w[1 + j] = a2[j] - a0[j];
+	}
+	v[0] = v[1];
+	w[0] = w[1];
+	v[cols + 1] = v[cols];
+	w[cols + 1] = w[cols];
+	j = 0;
+#if defined(HAVE_SSE2)
+	for (; j <= cols - 8; j += 8)
+	{
+		const __m128i dx8 = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)(v + j + 2)), _mm_loadu_si128((const __m128i*)(v + j)));
+		const __m128i dy8 = _mm_add_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i*)(w + j)), _mm_loadu_si128((const __m128i*)(w + j + 2))), _mm_slli_epi16(_mm_loadu_si128((const __m128i*)(w + j + 1)), 1));
+		// sign extend to 32-bit
+		const __m128i sx = _mm_srai_epi16(dx8, 15);
+		const __m128i sy = _mm_srai_epi16(dy8, 15);
+		_mm_storeu_si128((__m128i*)(dx + j), _mm_unpacklo_epi16(dx8, sx));
+		_mm_storeu_si128((__m128i*)(dx + j + 4), _mm_unpackhi_epi16(dx8, sx));
+		_mm_storeu_si128((__m128i*)(dy + j), _mm_unpacklo_epi16(dy8, sy));
+		_mm_storeu_si128((__m128i*)(dy + j + 4), _mm_unpackhi_epi16(dy8, sy));
+	}
+#elif defined(HAVE_NEON)
+	for (; j <= cols - 8; j += 8)
+	{
+		const int16x8_t dx8 = vsubq_s16(vld1q_s16(v + j + 2), vld1q_s16(v + j));
+		const int16x8_t dy8 = vaddq_s16(vaddq_s16(vld1q_s16(w + j), vld1q_s16(w + j + 2)), vshlq_n_s16(vld1q_s16(w + j + 1), 1));
+		vst1q_s32(dx + j, vmovl_s16(vget_low_s16(dx8)));
+		vst1q_s32(dx + j + 4, vmovl_s16(vget_high_s16(dx8)));
+		vst1q_s32(dy + j, vmovl_s16(vget_low_s16(dy8)));
+		vst1q_s32(dy + j + 4, vmovl_s16(vget_high_s16(dy8)));
+	}
+#endif
+	for (; j < cols; j++)
+	{
+		dx[j] = v[j + 2] - v[j];
+		dy[j] = w[j] + 2 * w[j + 1] + w[j + 2];
+	}
+}
+
+/* non-maximum suppression for rows [start, end), map is 0 for the suppressed, 1 for the edge candidates and 2 for the
+ * ones above the high threshold. The derivatives are either computed here (sobel3, for 8-bit input with the 3x3
+ * window), or taken from the dx and dy matrices */
+static void _ccv_canny_nms_rows(ccv_dense_matrix_t* a, ccv_dense_matrix_t* dx, ccv_dense_matrix_t* dy, int sobel3, int low, int high, int start, int end, unsigned char* map)
+{
+	const int cols = a->cols;
+	int* buf = (int*)ccmalloc(sizeof(int) * (cols + 2) * 3 + (sobel3 ? (sizeof(int) * cols * 6 + sizeof(short) * (cols + 2) * 2) : 0));
+	int* rows[3];
+	int* dxr[3];
+	int* dyr[3];
+	int i, j, k;
+	for (k = 0; k < 3; k++)
+	{
+		rows[k] = buf + (cols + 2) * k + 1;
+		rows[k][-1] = rows[k][cols] = 0;
+		if (sobel3)
+		{
+			dxr[k] = buf + (cols + 2) * 3 + cols * k;
+			dyr[k] = buf + (cols + 2) * 3 + cols * (k + 3);
+		}
+	}
+	short* v = sobel3 ? (short*)(buf + (cols + 2) * 3 + cols * 6) : 0;
+	short* w = v + cols + 2;
+	// the magnitude of row r into slot k, it is 0 outside of the matrix, the same as the original stack-based one
+#define LOAD(r, k) \
 	{ \
-		for (j = 0; j < cols * size; j++) \
-		{ \
-			_for_type agv = agp[j * ch]; \
-			_for_type mgv = mgp[j * ch]; \
-			for (k = 1; k < ch; k++) \
-				if (mgp[j * ch + k] > mgv) \
-				{ \
-					mgv = mgp[j * ch + k]; \
-					agv = agp[j * ch + k]; \
-				} \
-			_for_type agr0 = (ccv_clamp(agv, 0, 359.99) / 360.0) * (sbin * 2); \
-			int ag0 = (int)agr0; \
-			int ag1 = (ag0 + 1 < sbin * 2) ? ag0 + 1 : 0; \
-			agr0 = agr0 - ag0; \
-			_for_type agr1 = 1.0 - agr0; \
-			mgv = mgv / 255.0; \
-			_for_type yp = ((_for_type)i + 0.5) / (_for_type)size - 0.5; \
-			_for_type xp = ((_for_type)j + 0.5) / (_for_type)size - 0.5; \
-			int iyp = (int)floor(yp); \
-			assert(iyp < rows); \
-			int ixp = (int)floor(xp); \
-			assert(ixp < cols); \
-			_for_type vy0 = yp - iyp; \
-			_for_type vx0 = xp - ixp; \
-			_for_type vy1 = 1.0 - vy0; \
-			_for_type vx1 = 1.0 - vx0; \
-			if (ixp >= 0 && iyp >= 0) \
-			{ \
-				cnp[iyp * cn->cols * sbin * 2 + ixp * sbin * 2 + ag0] += agr1 * vx1 * vy1 * mgv; \
-				cnp[iyp * cn->cols * sbin * 2 + ixp * sbin * 2 + ag1] += agr0 * vx1 * vy1 * mgv; \
-			} \
-			if (ixp + 1 < cn->cols && iyp >= 0) \
-			{ \
-				cnp[iyp * cn->cols * sbin * 2 + (ixp + 1) * sbin * 2 + ag0] += agr1 * vx0 * vy1 * mgv; \
-				cnp[iyp * cn->cols * sbin * 2 + (ixp + 1) * sbin * 2 + ag1] += agr0 * vx0 * vy1 * mgv; \
-			} \
-			if (ixp >= 0 && iyp + 1 < cn->rows) \
-			{ \
-				cnp[(iyp + 1) * cn->cols * sbin * 2 + ixp * sbin * 2 + ag0] += agr1 * vx1 * vy0 * mgv; \
-				cnp[(iyp + 1) * cn->cols * sbin * 2 + ixp * sbin * 2 + ag1] += agr0 * vx1 * vy0 * mgv; \
-			} \
-			if (ixp + 1 < cn->cols && iyp + 1 < cn->rows) \
-			{ \
-				cnp[(iyp + 1) * cn->cols * sbin * 2 + (ixp + 1) * sbin * 2 + ag0] += agr1 * vx0 * vy0 * mgv; \
-				cnp[(iyp + 1) * cn->cols * sbin * 2 + (ixp + 1) * sbin * 2 + ag1] += agr0 * vx0 * vy0 * mgv; \
+		if ((r) < 0 || (r) >= a->rows) \
+			memset(rows[k], 0, sizeof(int) * cols); \
+		else { \
+			if (sobel3) \
+				_ccv_canny_sobel3_row(a, (r), v, w, dxr[k], dyr[k]); \
+			else { \
+				dxr[k] = dx->data.i32 + (r) * cols; \
+				dyr[k] = dy->data.i32 + (r) * cols; \
 			} \
+			for (j = 0; j < cols; j++) \
+				rows[k][j] = abs(dxr[k][j]) + abs(dyr[k][j]); \
 		} \
-		agp += a->cols * ch; \
-		mgp += a->cols * ch; \
-	} \
-	ccv_matrix_free(ag); \
-	ccv_matrix_free(mg); \
-	cnp = (_for_type*)ccv_get_dense_matrix_cell(cn, 0, 0, 0); \
-	_for_type* cap = (_for_type*)ccv_get_dense_matrix_cell(ca, 0, 0, 0); \
-	for (i = 0; i < rows; i++) \
-	{ \
-		for (j = 0; j < cols; j++) \
-		{ \
-			*cap = 0; \
-			for (k = 0; k < sbin; k++) \
-				*cap += (cnp[k] + cnp[k + sbin]) * (cnp[k] + cnp[k + sbin]); \
-			cnp += 2 * sbin; \
-			cap++; \
-		} \
-	} \
-	cnp = (_for_type*)ccv_get_dense_matrix_cell(cn, 0, 0, 0); \
-	cap = (_for_type*)ccv_get_dense_matrix_cell(ca, 0, 0, 0); \
-	ccv_zero(db); \
-	_for_type* dbp = (_for_type*)ccv_get_dense_matrix_cell(db, 0, 0, 0); \
-	TNA(_for_type, 0, 1, cols + 1, cols, 0); \
-	TNA(_for_type, 1, 1, 1, 0, 0); \
-	TNA(_for_type, 2, 0, cols, cols, 0); \
-	TNA(_for_type, 3, 0, 0, 0, 0); \
-	cnp += 2 * sbin; \
-	dbp += 3 * sbin + 4; \
-	cap++; \
-	for (j = 1; j < cols - 1; j++) \
-	{ \
-		TNA(_for_type, 0, 1, cols + 1, cols, 0); \
-		TNA(_for_type, 1, 1, 1, 0, 0); \
-		TNA(_for_type, 2, -1, cols - 1, cols, 0); \
-		TNA(_for_type, 3, -1, -1, 0, 0); \
-		cnp += 2 * sbin; \
-		dbp += 3 * sbin + 4; \
-		cap++; \
-	} \
-	TNA(_for_type, 0, 0, cols, cols, 0); \
-	TNA(_for_type, 1, 0, 0, 0, 0); \
-	TNA(_for_type, 2, -1, cols - 1, cols, 0); \
-	TNA(_for_type, 3, -1, -1, 0, 0); \
-	cnp += 2 * sbin; \
-	dbp += 3 * sbin + 4; \
-	cap++; \
-	for (i = 1; i < rows - 1; i++) \
-	{ \
-		TNA(_for_type, 0, 1, cols + 1, cols, 0); \
-		TNA(_for_type, 1, 1, -cols + 1, -cols, 0); \
-		TNA(_for_type, 2, 0, cols, cols, 0); \
-		TNA(_for_type, 3, 0, -cols, -cols, 0); \
-		cnp += 2 * sbin; \
-		dbp += 3 * sbin + 4; \
-		cap++; \
-		for (j = 1; j < cols - 1; j++) \
-		{ \
-			TNA(_for_type, 0, 1, cols + 1, cols, 0); \
-			TNA(_for_type, 1, 1, -cols + 1, -cols, 0); \
-			TNA(_for_type, 2, -1, cols - 1, cols, 0); \
-			TNA(_for_type, 3, -1, -cols - 1, -cols, 0); \
-			cnp += 2 * sbin; \
-			dbp += 3 * sbin + 4; \
-			cap++; \
-		} \
-		TNA(_for_type, 0, 0, cols, cols, 0); \
-		TNA(_for_type, 1, 0, -cols, -cols, 0); \
-		TNA(_for_type, 2, -1, cols - 1, cols, 0); \
-		TNA(_for_type, 3, -1, -cols - 1, -cols, 0); \
-		cnp += 2 * sbin; \
-		dbp += 3 * sbin + 4; \
-		cap++; \
-	} \
-	TNA(_for_type, 0, 1, 1, 0, 0); \
-	TNA(_for_type, 1, 1, -cols + 1, -cols, 0); \
-	TNA(_for_type, 2, 0, 0, 0, 0); \
-	TNA(_for_type, 3, 0, -cols, -cols, 0); \
-	cnp += 2 * sbin; \
-	dbp += 3 * sbin + 4; \
-	cap++; \
-	for (j = 1; j < cols - 1; j++) \
-	{ \
-		TNA(_for_type, 0, 1, 1, 0, 0); \
-		TNA(_for_type, 1, 1, -cols + 1, -cols, 0); \
-		TNA(_for_type, 2, -1, -1, 0, 0); \
-		TNA(_for_type, 3, -1, -cols - 1, -cols, 0); \
-		cnp += 2 * sbin; \
-		dbp += 3 * sbin + 4; \
-		cap++; \
-	} \
-	TNA(_for_type, 0, 0, 0, 0, 0); \
-	TNA(_for_type, 1, 0, -cols, -cols, 0); \
-	TNA(_for_type, 2, -1, -1, 0, 0); \
-	TNA(_for_type, 3, -1, -cols - 1, -cols, 0);
-	ccv_matrix_typeof(db->type, for_block);
-#undef for_block
-#undef TNA
-	ccv_matrix_free(cn);
-	ccv_matrix_free(ca);
+	}
+	LOAD(start - 1, 0);
+	LOAD(start, 1);
+#if defined(HAVE_SSE2)
+	const __m128i low4 = _mm_set1_epi32(low);
+#endif
+	for (i = start; i < end; i++)
+	{
+		LOAD(i + 1, 2);
+		const int* _dx = dxr[1];
+		const int* _dy = dyr[1];
+		unsigned char* map_ptr = map + i * cols;
+		j = 0;
+		while (j < cols)
+		{
+#if defined(HAVE_SSE2)
+			// most of them are below the low threshold, skip them 4 at a time
+			if (j <= cols - 4 && !_mm_movemask_epi8(_mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(rows[1] + j)), low4)))
+			{
+				map_ptr[j] = map_ptr[j + 1] = map_ptr[j + 2] = map_ptr[j + 3] = 0;
+				j += 4;
+				continue;
+			}
+#endif
+			const int f = rows[1][j];
+			map_ptr[j] = 0;
+			if (f > low)
+			{
+				int x = abs(_dx[j]);
+				int y = abs(_dy[j]);
+				int s = _dx[j] ^ _dy[j];
+				/* x * tan(22.5) */
+				int tg22x = x * (int)(0.4142135623730950488016887242097 * (1 << 15) + 0.5);
+				/* x * tan(67.5) == 2 * x + x * tan(22.5) */
+				int tg67x = tg22x + ((x + x) << 15);
+				y <<= 15;
+				/* it is a little different from the Canny original paper because we adopted the coordinate system of
+				 * top-left corner as origin. Thus, the derivative of y convolved with matrix:
+				 * |-1 -2 -1|
+				 * | 0  0  0|
+				 * | 1  2  1|
+				 * actually is the reverse of real y. Thus, the computed angle will be mirrored around x-axis.
+				 * In this case, when angle is -45 (135), we compare with north-east and south-west, and for 45,
+				 * we compare with north-west and south-east (in traditional coordinate system sense, the same if we
+				 * adopt top-left corner as origin for "north", "south", "east", "west" accordingly) */
+				/* sometimes, we end up with same f in integer domain, for that case, we will take the first occurrence */
+				int maximum;
+				if (y < tg22x)
+					maximum = (f > rows[1][j - 1] && f >= rows[1][j + 1]);
+				else if (y > tg67x)
+					maximum = (f > rows[0][j] && f >= rows[2][j]);
+				else {
+					s = s < 0 ? -1 : 1;
+					maximum = (f > rows[0][j - s] && f > rows[2][j + s]);
+				}
+				if (maximum)
+					map_ptr[j] = f > high ? 2 : 1;
+			}
+			++j;
+		}
+		int* row = rows[0];
+		rows[0] = rows[1];
+		rows[1] = rows[2];
+		rows[2] = row;
+		row = dxr[0];
+		dxr[0] = dxr[1];
+		dxr[1] = dxr[2];
+		dxr[2] = row;
+		row = dyr[0];
+		dyr[0] = dyr[1];
+		dyr[1] = dyr[2];
+		dyr[2] = row;
+	}
+#undef LOAD
+	ccfree(buf);
+}
+
+static inline int _ccv_canny_find(int* parent, int x)
+{
+	while (parent[x] != x)
+	{
+		parent[x] = parent[parent[x]];
+		x = parent[x];
+	}
+	return x;
+}
+
+// merge the components of x and y, the smaller index is the root, and the root is 2 if any of them is
+static inline void _ccv_canny_union(int* parent, unsigned char* map, int x, int y)
+{
+	x = _ccv_canny_find(parent, x);
+	y = _ccv_canny_find(parent, y);
+	if (x == y)
+		return;
+	if (x > y)
+	{
+		int t = x;
+		x = y;
+		y = t;
+	}
+	parent[y] = x;
+	map[x] = ccv_max(map[x], map[y]);
 }
 
+#define CCV_CANNY_BAND_ROWS (32)
+
 /* it is a supposely cleaner and faster implementation than original OpenCV (ccv_canny_deprecated,
  * removed, since the newer implementation achieve bit accuracy with OpenCV's), after a lot
- * profiling, the current implementation still uses integer to speed up */
+ * profiling, the current implementation still uses integer to speed up.
+ * The hysteresis is the connected components (8-connected) of the edge candidates, a component is kept if any of
+ * them is above the high threshold. It is the same as tracing from these above the high threshold, but it goes
+ * over bands of rows in parallel, and merges the components across the band borders afterwards */
 void ccv_canny(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int size, double low_thresh, double high_thresh)
 {
 	assert(CCV_GET_CHANNEL(a->type) == CCV_C1);
@@ -204,133 +487,93 @@ void ccv_canny(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int size
 	{
 		ccv_dense_matrix_t* dx = 0;
 		ccv_dense_matrix_t* dy = 0;
-		ccv_sobel(a, &dx, 0, size, 0);
-		ccv_sobel(a, &dy, 0, 0, size);
+		/* the 3x3 window on 8-bit input is computed row by row along with the suppression */
+		const int sobel3 = (size == 3 && (a->type & CCV_8U) && a->rows >= 3 && a->cols >= 3);
+		if (!sobel3)
+		{
+			ccv_sobel(a, &dx, 0, size, 0);
+			ccv_sobel(a, &dy, 0, 0, size);
+		}
 		/* special case, all integer */
 		int low = (int)(low_thresh + 0.5);
 		int high = (int)(high_thresh + 0.5);
-		int* dxi = dx->data.i32;
-		int* dyi = dy->data.i32;
-		int i, j;
-		int* mbuf = (int*)alloca(3 * (a->cols + 2) * sizeof(int));
-		memset(mbuf, 0, 3 * (a->cols + 2) * sizeof(int));
-		int* rows[3];
-		rows[0] = mbuf + 1;
-		rows[1] = mbuf + (a->cols + 2) + 1;
-		rows[2] = mbuf + 2 * (a->cols + 2) + 1;
-		for (j = 0; j < a->cols; j++)
-			rows[1][j] = abs(dxi[j]) + abs(dyi[j]);
-		dxi += a->cols;
-		dyi += a->cols;
-		int* map = (int*)ccmalloc(sizeof(int) * (a->rows + 2) * (a->cols + 2));
-		int map_cols = a->cols + 2;
-		memset(map, 0, sizeof(int) * map_cols);
-		int* map_ptr = map + map_cols + 1;
-		int** stack = (int**)ccmalloc(sizeof(int*) * a->rows * a->cols);
-		int** stack_top = stack;
-		int** stack_bottom = stack;
-		for (i = 1; i <= a->rows; i++)
-		{
-			/* the if clause should be unswitched automatically, no need to manually do so */
-			if (i == a->rows)
-				memset(rows[2], 0, sizeof(int) * a->cols);
-			else
-				for (j = 0; j < a->cols; j++)
-					rows[2][j] = abs(dxi[j]) + abs(dyi[j]);
-			int* _dx = dxi - a->cols;
-			int* _dy = dyi - a->cols;
-			map_ptr[-1] = 0;
-			int suppress = 0;
-			for (j = 0; j < a->cols; j++)
-			{
-				int f = rows[1][j];
-				if (f > low)
+		const int rows = a->rows;
+		const int cols = a->cols;
+		const int band_count = (rows + CCV_CANNY_BAND_ROWS - 1) / CCV_CANNY_BAND_ROWS;
+		unsigned char* map = (unsigned char*)ccmalloc(sizeof(unsigned char) * rows * cols);
+		int* parent = (int*)ccmalloc(sizeof(int) * rows * cols);
+		parallel_for(k, band_count) {
+			const int start = k * CCV_CANNY_BAND_ROWS;
+			const int end = ccv_min(start + CCV_CANNY_BAND_ROWS, rows);
+			_ccv_canny_nms_rows(a, dx, dy, sobel3, low, high, start, end, map);
+			// the components within the band, they only reach the pixels of the band
+			int i, j;
+			for (i = start; i < end; i++)
+				for (j = 0; j < cols; j++)
 				{
-					int x = abs(_dx[j]);
-					int y = abs(_dy[j]);
-					int s = _dx[j] ^ _dy[j];
-					/* x * tan(22.5) */
-					int tg22x = x * (int)(0.4142135623730950488016887242097 * (1 << 15) + 0.5);
-					/* x * tan(67.5) == 2 * x + x * tan(22.5) */
-					int tg67x = tg22x + ((x + x) << 15);
-					y <<= 15;
-					/* it is a little different from the Canny original paper because we adopted the coordinate system of
-					 * top-left corner as origin. Thus, the derivative of y convolved with matrix:
-					 * |-1 -2 -1|
-					 * | 0  0  0|
-					 * | 1  2  1|
-					 * actually is the reverse of real y. Thus, the computed angle will be mirrored around x-axis.
-					 * In this case, when angle is -45 (135), we compare with north-east and south-west, and for 45,
-					 * we compare with north-west and south-east (in traditional coordinate system sense, the same if we
-					 * adopt top-left corner as origin for "north", "south", "east", "west" accordingly) */
-#define high_block \
-					{ \
-						if (f > high && !suppress && map_ptr[j - map_cols] != 2) \
-						{ \
-							map_ptr[j] = 2; \
-							suppress = 1; \
-							*(stack_top++) = map_ptr + j; \
-						} else { \
-							map_ptr[j] = 1; \
-						} \
-						continue; \
-					}
-					/* sometimes, we end up with same f in integer domain, for that case, we will take the first occurrence
-					 * suppressing the second with flag */
-					if (y < tg22x)
-					{
-						if (f > rows[1][j - 1] && f >= rows[1][j + 1])
-							high_block;
-					} else if (y > tg67x) {
-						if (f > rows[0][j] && f >= rows[2][j])
-							high_block;
-					} else {
-						s = s < 0 ? -1 : 1;
-						if (f > rows[0][j - s] && f > rows[2][j + s])
-							high_block;
+					const int p = i * cols + j;
+					if (!map[p])
+						continue;
+					parent[p] = p;
+					// the north one, if any, is a neighbor of the north-west, the west and the north-east ones
+					if (i > start && map[p - cols])
+						_ccv_canny_union(parent, map, p, p - cols);
+					else {
+						if (j > 0 && map[p - 1])
+							_ccv_canny_union(parent, map, p, p - 1);
+						else if (i > start && j > 0 && map[p - cols - 1])
+							_ccv_canny_union(parent, map, p, p - cols - 1);
+						if (i > start && j < cols - 1 && map[p - cols + 1])
+							_ccv_canny_union(parent, map, p, p - cols + 1);
 					}
-#undef high_block
 				}
-				map_ptr[j] = 0;
-				suppress = 0;
-			}
-			map_ptr[a->cols] = 0;
-			map_ptr += map_cols;
-			dxi += a->cols;
-			dyi += a->cols;
-			int* row = rows[0];
-			rows[0] = rows[1];
-			rows[1] = rows[2];
-			rows[2] = row;
-		}
-		memset(map_ptr - 1, 0, sizeof(int) * map_cols);
-		int dr[] = {-1, 1, -map_cols - 1, -map_cols, -map_cols + 1, map_cols - 1, map_cols, map_cols + 1};
-		while (stack_top > stack_bottom)
+		} parallel_endfor
+		int i, j, k;
+		// merge them across the band borders
+		for (k = 1; k < band_count; k++)
 		{
-			map_ptr = *(--stack_top);
-			for (i = 0; i < 8; i++)
-				if (map_ptr[dr[i]] == 1)
-				{
-					map_ptr[dr[i]] = 2;
-					*(stack_top++) = map_ptr + dr[i];
-				}
+			i = k * CCV_CANNY_BAND_ROWS;
+			for (j = 0; j < cols; j++)
+			{
+				const int p = i * cols + j;
+				if (!map[p])
+					continue;
+				if (j > 0 && map[p - cols - 1])
+					_ccv_canny_union(parent, map, p, p - cols - 1);
+				if (map[p - cols])
+					_ccv_canny_union(parent, map, p, p - cols);
+				if (j < cols - 1 && map[p - cols + 1])
+					_ccv_canny_union(parent, map, p, p - cols + 1);
+			}
 		}
-		map_ptr = map + map_cols + 1;
-		unsigned char* b_ptr = db->data.u8;
+		parallel_for(k, band_count) {
+			const int start = k * CCV_CANNY_BAND_ROWS;
+			const int end = ccv_min(start + CCV_CANNY_BAND_ROWS, rows);
+			unsigned char* b_ptr = db->data.u8 + start * db->step;
+			int i, j;
 #define for_block(_, _for_set) \
-		for (i = 0; i < a->rows; i++) \
-		{ \
-			for (j = 0; j < a->cols; j++) \
-				_for_set(b_ptr, j, (map_ptr[j] == 2), 0); \
-			map_ptr += map_cols; \
-			b_ptr += db->step; \
-		}
-		ccv_matrix_setter(db->type, for_block);
+			for (i = start; i < end; i++) \
+			{ \
+				for (j = 0; j < cols; j++) \
+				{ \
+					int x = i * cols + j; \
+					if (map[x]) \
+						while (parent[x] != x) /* no path compression, others are reading it */ \
+							x = parent[x]; \
+					_for_set(b_ptr, j, (map[i * cols + j] && map[x] == 2), 0); \
+				} \
+				b_ptr += db->step; \
+			}
+			ccv_matrix_setter(db->type, for_block);
 #undef for_block
-		ccfree(stack);
+		} parallel_endfor
+		ccfree(parent);
 		ccfree(map);
-		ccv_matrix_free(dx);
-		ccv_matrix_free(dy);
+		if (!sobel3)
+		{
+			ccv_matrix_free(dx);
+			ccv_matrix_free(dy);
+		}
 	} else {
 		/* general case, use all ccv facilities to deal with it */
 		ccv_dense_matrix_t* mg = 0;
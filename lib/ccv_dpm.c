@@ -42,36 +42,30 @@ static int _ccv_dpm_scale_upto(ccv_dense_matrix_t* a, ccv_dpm_mixture_model_t**
 	return (int)(log((double)ccv_min(hr, wr)) / log(scale)) - next;
 }
 
+// only the training uses it, detection goes through ccv_image_pyramid_t
+#if defined(HAVE_LIBLINEAR) && defined(HAVE_GSL)
 static void _ccv_dpm_feature_pyramid(ccv_dense_matrix_t* a, ccv_dense_matrix_t** pyr, int scale_upto, int interval)
 {
 	int next = interval + 1;
-	double scale = pow(2.0, 1.0 / (interval + 1.0));
 	memset(pyr, 0, (scale_upto + next * 2) * sizeof(ccv_dense_matrix_t*));
-	pyr[next] = a;
+	ccv_pyramid_build(a, pyr + next, scale_upto + next, interval, 0);
 	int i;
-	for (i = 1; i <= interval; i++)
-		ccv_resample(pyr[next], &pyr[next + i], 0, (int)(pyr[next]->rows / pow(scale, i)), (int)(pyr[next]->cols / pow(scale, i)), CCV_INTER_AREA);
-	for (i = next; i < scale_upto + next; i++)
-		ccv_sample_down(pyr[i], &pyr[i + next], 0, 0, 0);
-	ccv_dense_matrix_t* hog;
-	/* a more efficient way to generate up-scaled hog (using smaller size) */
-	for (i = 0; i < next; i++)
+	/* a more efficient way to generate up-scaled hog (using smaller size), the first next ones are the HOG of
+	 * the first octave with half the cell size, followed by the HOG of every level */
+	ccv_dense_matrix_t** level = (ccv_dense_matrix_t**)alloca((scale_upto + next * 2) * sizeof(ccv_dense_matrix_t*));
+	int* cell = (int*)alloca((scale_upto + next * 2) * sizeof(int));
+	for (i = 0; i < scale_upto + next * 2; i++)
 	{
-		hog = 0;
-		ccv_hog(pyr[i + next], &hog, 0, 9, CCV_DPM_WINDOW_SIZE / 2 /* this is */);
-		pyr[i] = hog;
+		level[i] = pyr[i < next ? i + next : i];
+		cell[i] = i < next ? CCV_DPM_WINDOW_SIZE / 2 : CCV_DPM_WINDOW_SIZE;
+		pyr[i] = 0;
 	}
-	hog = 0;
-	ccv_hog(pyr[next], &hog, 0, 9, CCV_DPM_WINDOW_SIZE);
-	pyr[next] = hog;
+	ccv_hog_batch(level, pyr, 0, 9, cell, scale_upto + next * 2);
+	// the level at next is the input itself
 	for (i = next + 1; i < scale_upto + next * 2; i++)
-	{
-		hog = 0;
-		ccv_hog(pyr[i], &hog, 0, 9, CCV_DPM_WINDOW_SIZE);
-		ccv_matrix_free(pyr[i]);
-		pyr[i] = hog;
-	}
+		ccv_matrix_free(level[i]);
 }
+#endif
 
 static void _ccv_dpm_compute_score(ccv_dpm_root_classifier_t* root_classifier, ccv_dense_matrix_t* hog, ccv_dense_matrix_t* hog2x, ccv_dense_matrix_t** _response, ccv_dense_matrix_t** part_feature, ccv_dense_matrix_t** dx, ccv_dense_matrix_t** dy)
 {
@@ -87,17 +81,37 @@ static void _ccv_dpm_compute_score(ccv_dpm_root_classifier_t* root_classifier, c
 	int rwh = (root_classifier->root.w->rows - 1) / 2, rww = (root_classifier->root.w->cols - 1) / 2;
 	int rwh_1 = root_classifier->root.w->rows / 2, rww_1 = root_classifier->root.w->cols / 2;
 	int i, x, y;
+	if (root_classifier->count == 0)
+		return;
+	// all parts are convolved with hog2x, thus, transform it only once
+	ccv_dense_matrix_t** part_w = (ccv_dense_matrix_t**)alloca(sizeof(ccv_dense_matrix_t*) * root_classifier->count * 3);
+	ccv_dense_matrix_t** part_response = part_w + root_classifier->count;
+	ccv_dense_matrix_t** part_flat = part_response + root_classifier->count;
+	for (i = 0; i < root_classifier->count; i++)
+	{
+		part_w[i] = root_classifier->part[i].w;
+		part_response[i] = 0;
+	}
+	ccv_filter_bank(hog2x, part_w, root_classifier->count, part_response, 0, CCV_NO_PADDING);
+	// the parts' distance transforms are independent from each other, run them as one batch
+	double* coeff = (double*)alloca(sizeof(double) * root_classifier->count * 4);
 	for (i = 0; i < root_classifier->count; i++)
 	{
 		ccv_dpm_part_classifier_t* part = root_classifier->part + i;
-		ccv_dense_matrix_t* response = 0;
-		ccv_filter(hog2x, part->w, &response, 0, CCV_NO_PADDING);
-		ccv_dense_matrix_t* feature = 0;
-		ccv_flatten(response, (ccv_matrix_t**)&feature, 0, 0);
-		ccv_matrix_free(response);
+		part_flat[i] = 0;
+		ccv_flatten(part_response[i], (ccv_matrix_t**)&part_flat[i], 0, 0);
+		ccv_matrix_free(part_response[i]);
 		part_feature[i] = dx[i] = dy[i] = 0;
-		ccv_distance_transform(feature, &part_feature[i], 0, &dx[i], 0, &dy[i], 0, part->dx, part->dy, part->dxx, part->dyy, CCV_NEGATIVE | CCV_GSEDT);
-		ccv_matrix_free(feature);
+		coeff[i] = part->dx;
+		coeff[i + root_classifier->count] = part->dy;
+		coeff[i + root_classifier->count * 2] = part->dxx;
+		coeff[i + root_classifier->count * 3] = part->dyy;
+	}
+	ccv_distance_transform_batch(part_flat, part_feature, 0, dx, 0, dy, 0, coeff, coeff + root_classifier->count, coeff + root_classifier->count * 2, coeff + root_classifier->count * 3, root_classifier->count, CCV_NEGATIVE | CCV_GSEDT);
+	for (i = 0; i < root_classifier->count; i++)
+	{
+		ccv_dpm_part_classifier_t* part = root_classifier->part + i;
+		ccv_matrix_free(part_flat[i]);
 		int pwh = (part->w->rows - 1) / 2, pww = (part->w->cols - 1) / 2;
 		int offy = part->y + pwh - rwh * 2;
 		int miny = pwh, maxy = part_feature[i]->rows - part->w->rows + pwh;
@@ -2042,8 +2056,28 @@ static int _ccv_is_equal_same_class(const void* _r1, const void* _r2, void* data
 		(int)(r2->rect.height * 1.5 + 0.5) >= r1->rect.height;
 }
 
+static ccv_rect_t _ccv_is_equal_hint(const void* _r, void* data)
+{
+	const ccv_root_comp_t* r = (const ccv_root_comp_t*)_r;
+	int distance = (int)(ccv_min(r->rect.width, r->rect.height) * 0.25 + 0.5);
+	// _ccv_is_equal(r, r2) requires r2's top left corner to be within distance of r's
+	return ccv_rect(r->rect.x - distance, r->rect.y - distance, distance * 2 + 1, distance * 2 + 1);
+}
+
 ccv_array_t* ccv_dpm_detect_objects(ccv_dense_matrix_t* a, ccv_dpm_mixture_model_t** _model, int count, ccv_dpm_param_t params)
 {
+	ccv_image_pyramid_t* pyramid = ccv_image_pyramid_new(a, params.interval);
+	ccv_array_t* seq = ccv_dpm_detect_objects_in_pyramid(pyramid, _model, count, params);
+	ccv_image_pyramid_free(pyramid);
+	return seq;
+}
+
+ccv_array_t* ccv_dpm_detect_objects_in_pyramid(ccv_image_pyramid_t* pyramid, ccv_dpm_mixture_model_t** _model, int count, ccv_dpm_param_t params)
+{
+	ccv_dense_matrix_t* a = ccv_image_pyramid_source(pyramid);
+	// the levels are not the ones the models scan, use a private pyramid
+	if (ccv_image_pyramid_interval(pyramid) != params.interval)
+		return ccv_dpm_detect_objects(a, _model, count, params);
 	int c, i, j, k, x, y;
 	double scale = pow(2.0, 1.0 / (params.interval + 1.0));
 	int next = params.interval + 1;
@@ -2051,7 +2085,17 @@ ccv_array_t* ccv_dpm_detect_objects(ccv_dense_matrix_t* a, ccv_dpm_mixture_model
 	if (scale_upto < 0) // image is too small to be interesting
 		return 0;
 	ccv_dense_matrix_t** pyr = (ccv_dense_matrix_t**)alloca((scale_upto + next * 2) * sizeof(ccv_dense_matrix_t*));
-	_ccv_dpm_feature_pyramid(a, pyr, scale_upto, params.interval);
+	/* the first next ones are the HOG of the first octave with half the cell size (the up-scaled HOG for the parts),
+	 * followed by the HOG of every level. They are owned by the pyramid */
+	ccv_image_pyramid_reserve(pyramid, scale_upto + next, 1);
+	int* level = (int*)alloca((scale_upto + next * 2) * sizeof(int) * 2);
+	int* cell = level + scale_upto + next * 2;
+	for (i = 0; i < scale_upto + next * 2; i++)
+	{
+		level[i] = i < next ? i : i - next;
+		cell[i] = i < next ? CCV_DPM_WINDOW_SIZE / 2 : CCV_DPM_WINDOW_SIZE;
+	}
+	ccv_image_pyramid_derived_batch(pyramid, level, CCV_IMAGE_PYRAMID_HOG, cell, scale_upto + next * 2, pyr);
 	ccv_array_t* idx_seq;
 	ccv_array_t* seq = ccv_array_new(sizeof(ccv_root_comp_t), 64, 0);
 	ccv_array_t* seq2 = ccv_array_new(sizeof(ccv_root_comp_t), 64, 0);
@@ -2140,7 +2184,7 @@ ccv_array_t* ccv_dpm_detect_objects(ccv_dense_matrix_t* a, ccv_dpm_mixture_model
 			idx_seq = 0;
 			ccv_array_clear(seq2);
 			// group retrieved rectangles in order to filter out noise
-			int ncomp = ccv_array_group(seq, &idx_seq, _ccv_is_equal_same_class, 0);
+			int ncomp = ccv_array_group_spatial(seq, &idx_seq, _ccv_is_equal_same_class, _ccv_is_equal_hint, 0);
 			ccv_root_comp_t* comps = (ccv_root_comp_t*)ccmalloc((ncomp + 1) * sizeof(ccv_root_comp_t));
 			memset(comps, 0, (ncomp + 1) * sizeof(ccv_root_comp_t));
 
@@ -2228,9 +2272,6 @@ ccv_array_t* ccv_dpm_detect_objects(ccv_dense_matrix_t* a, ccv_dpm_mixture_model
 		}
 	}
 
-	for (i = 0; i < scale_upto + next * 2; i++)
-		ccv_matrix_free(pyr[i]);
-
 	ccv_array_free(seq);
 	ccv_array_free(seq2);
 
@@ -2241,7 +2282,7 @@ ccv_array_t* ccv_dpm_detect_objects(ccv_dense_matrix_t* a, ccv_dpm_mixture_model
 		result_seq2 = ccv_array_new(sizeof(ccv_root_comp_t), 64, 0);
 		idx_seq = 0;
 		// group retrieved rectangles in order to filter out noise
-		int ncomp = ccv_array_group(result_seq, &idx_seq, _ccv_is_equal, 0);
+		int ncomp = ccv_array_group_spatial(result_seq, &idx_seq, _ccv_is_equal, _ccv_is_equal_hint, 0);
 		ccv_root_comp_t* comps = (ccv_root_comp_t*)ccmalloc((ncomp + 1) * sizeof(ccv_root_comp_t));
 		memset(comps, 0, (ncomp + 1) * sizeof(ccv_root_comp_t));
 
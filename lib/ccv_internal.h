@@ -14,6 +14,19 @@ static int _CCV_PRINT_LOOP __attribute__ ((unused)) = 0;
 #define ccv_descale(x, n) (((x) + (1 << ((n) - 1))) >> (n))
 #define conditional_assert(x, expr) if ((x)) { assert(expr); }
 
+/* copy the data of a into b of the same size and type, either of them can have padded rows */
+static inline void ccv_dense_matrix_copy_rows(const ccv_dense_matrix_t* a, ccv_dense_matrix_t* b)
+{
+	if (a->step == b->step)
+		memcpy(b->data.u8, a->data.u8, (size_t)a->rows * a->step);
+	else {
+		int i;
+		const size_t len = ccv_min(a->step, b->step);
+		for (i = 0; i < a->rows; i++)
+			memcpy(b->data.u8 + (size_t)i * b->step, a->data.u8 + (size_t)i * a->step, len);
+	}
+}
+
 #define MACRO_STRINGIFY(x) #x
 
 #define UNROLL_PRAGMA0(x) MACRO_STRINGIFY(unroll x)
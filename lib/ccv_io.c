@@ -1,5 +1,109 @@
 #include "ccv.h"
 #include "ccv_internal.h"
+#if defined(HAVE_SSE2)
+#include <emmintrin.h>
+#elif defined(HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+/* a buffer that encoders write into, it is ccrealloc'ed as needed. A fixed one is the memory region of the caller,
+ * what doesn't fit is counted into len but dropped */
+typedef struct {
+	unsigned char** out;
+	size_t* size;
+	size_t len;
+	int fixed;
+} ccv_io_buffer_t;
+
+static unsigned char* _ccv_io_buffer_reserve(ccv_io_buffer_t* buffer, size_t len)
+{
+	assert(!buffer->fixed);
+	if (buffer->len + len > *buffer->size || !*buffer->out)
+	{
+		size_t size = ccv_max(*buffer->size, 4096);
+		while (size < buffer->len + len)
+			size *= 2;
+		*buffer->out = (unsigned char*)ccrealloc(*buffer->out, size);
+		*buffer->size = size;
+	}
+	return *buffer->out + buffer->len;
+}
+
+/* the i-th row of mat as 8-bit with the first dch channels, the row itself if it is already, otherwise converted
+ * (with the same truncation as ccv_set_value) into buf of cols * dch bytes */
+static unsigned char* _ccv_write_row_8u(ccv_dense_matrix_t* mat, int i, int dch, unsigned char* buf)
+{
+	const int ch = CCV_GET_CHANNEL(mat->type);
+	const int cols = mat->cols;
+	unsigned char* ptr = mat->data.u8 + (size_t)i * mat->step;
+	int j = 0, k;
+	assert(dch <= ch);
+	if (CCV_GET_DATA_TYPE(mat->type) == CCV_8U)
+	{
+		if (ch == dch)
+			return ptr;
+		if (ch == 4 && dch == 3)
+		{
+#if defined(HAVE_SSE2)
+			const __m128i lo = _mm_set_epi32(0, 0xffffff, 0, 0xffffff);
+			const __m128i hi = _mm_set_epi32(0xffffff, 0, 0xffffff, 0);
+			for (; j < cols - 7; j += 8)
+			{
+				// drop the 4th byte of every pixel, pack the 6 bytes left in each half, then the two halves into 12 bytes
+				__m128i p = _mm_loadu_si128((const __m128i*)(ptr + j * 4));
+				__m128i q = _mm_loadu_si128((const __m128i*)(ptr + j * 4 + 16));
+				p = _mm_or_si128(_mm_and_si128(p, lo), _mm_srli_epi64(_mm_and_si128(p, hi), 8));
+				q = _mm_or_si128(_mm_and_si128(q, lo), _mm_srli_epi64(_mm_and_si128(q, hi), 8));
+				p = _mm_or_si128(_mm_move_epi64(p), _mm_slli_si128(_mm_srli_si128(p, 8), 6));
+				q = _mm_or_si128(_mm_move_epi64(q), _mm_slli_si128(_mm_srli_si128(q, 8), 6));
+				_mm_storeu_si128((__m128i*)(buf + j * 3), _mm_or_si128(p, _mm_slli_si128(q, 12)));
+				_mm_storel_epi64((__m128i*)(buf + j * 3 + 16), _mm_srli_si128(q, 4));
+			}
+#elif defined(HAVE_NEON)
+			for (; j < cols - 7; j += 8)
+			{
+				uint8x8x4_t p = vld4_u8(ptr + j * 4);
+				uint8x8x3_t q;
+				q.val[0] = p.val[0], q.val[1] = p.val[1], q.val[2] = p.val[2];
+				vst3_u8(buf + j * 3, q);
+			}
+#endif
+			for (; j < cols; j++)
+				buf[j * 3] = ptr[j * 4], buf[j * 3 + 1] = ptr[j * 4 + 1], buf[j * 3 + 2] = ptr[j * 4 + 2];
+		} else
+			for (; j < cols; j++)
+				for (k = 0; k < dch; k++)
+					buf[j * dch + k] = ptr[j * ch + k];
+		return buf;
+	}
+	if (CCV_GET_DATA_TYPE(mat->type) == CCV_32F && ch == dch)
+	{
+		const int n = cols * ch;
+		const float* f = (const float*)ptr;
+#if defined(HAVE_SSE2)
+		for (; j < n - 15; j += 16)
+		{
+			__m128i a = _mm_packs_epi32(_mm_cvttps_epi32(_mm_loadu_ps(f + j)), _mm_cvttps_epi32(_mm_loadu_ps(f + j + 4)));
+			__m128i b = _mm_packs_epi32(_mm_cvttps_epi32(_mm_loadu_ps(f + j + 8)), _mm_cvttps_epi32(_mm_loadu_ps(f + j + 12)));
+			_mm_storeu_si128((__m128i*)(buf + j), _mm_packus_epi16(a, b));
+		}
+#elif defined(HAVE_NEON)
+		for (; j < n - 7; j += 8)
+		{
+			int16x8_t a = vcombine_s16(vqmovn_s32(vcvtq_s32_f32(vld1q_f32(f + j))), vqmovn_s32(vcvtq_s32_f32(vld1q_f32(f + j + 4))));
+			vst1_u8(buf + j, vqmovun_s16(a));
+		}
+#endif
+		for (; j < n; j++)
+			buf[j] = ccv_clamp((int)f[j], 0, 255);
+		return buf;
+	}
+	for (j = 0; j < cols; j++)
+		for (k = 0; k < dch; k++)
+			buf[j * dch + k] = ccv_clamp((int)ccv_get_value(mat->type, ptr, j * ch + k), 0, 255);
+	return buf;
+}
+
 #ifdef HAVE_LIBPNG
 #ifdef __APPLE__
 #include "TargetConditionals.h"
@@ -25,14 +129,25 @@
 #endif
 #if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
 #include <sys/param.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#define HAVE_MMAP
 #endif
 #include "io/_ccv_io_bmp.inc"
 #include "io/_ccv_io_binary.inc"
 #include "io/_ccv_io_raw.inc"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
-static int _ccv_read_and_close_fd(FILE* fd, ccv_dense_matrix_t** x, int type)
+static int _ccv_read_and_close_fd(FILE* fd, ccv_dense_matrix_t** x, int type, const ccv_io_read_param_t* param)
 {
 	int ctype = (type & 0xF00) ? CCV_8U | ((type & 0xF00) >> 8) : 0;
+	int status = CCV_IO_FINAL;
+	// only an actual file can be mapped, streams are backed by fmemopen
+	int no_copy = (type & CCV_IO_NO_COPY) && (type & CCV_IO_ANY_FILE);
 	if ((type & 0XFF) == CCV_IO_ANY_FILE)
 	{
 		unsigned char sig[8];
@@ -43,15 +158,20 @@ static int _ccv_read_and_close_fd(FILE* fd, ccv_dense_matrix_t** x, int type)
 			type = CCV_IO_JPEG_FILE;
 		else if (memcmp(sig, "BM", 2) == 0)
 			type = CCV_IO_BMP_FILE;
-		else if (memcmp(sig, "CCVBINDM", 8) == 0)
+		else if (memcmp(sig, "CCVBINDM", 8) == 0 || memcmp(sig, "CCVBINDA", 8) == 0)
 			type = CCV_IO_BINARY_FILE;
 		fseek(fd, 0, SEEK_SET);
 	}
+	// other than JPEG, decode the whole image and take the region of interest out of it afterwards
+	ccv_dense_matrix_t* full = 0;
+	ccv_dense_matrix_t** roi = x;
+	if (param && param->width > 0 && param->height > 0 && (type & 0xFF) != CCV_IO_JPEG_FILE)
+		x = &full;
 	switch (type & 0XFF)
 	{
 #ifdef HAVE_LIBJPEG
 		case CCV_IO_JPEG_FILE:
-			_ccv_read_jpeg_fd(fd, x, ctype);
+			_ccv_read_jpeg_fd(fd, x, ctype, param);
 			break;
 #endif
 #ifdef HAVE_LIBPNG
@@ -63,13 +183,53 @@ static int _ccv_read_and_close_fd(FILE* fd, ccv_dense_matrix_t** x, int type)
 			_ccv_read_bmp_fd(fd, x, ctype);
 			break;
 		case CCV_IO_BINARY_FILE:
+			// the binary file is read as it is, a matrix mapped in place cannot be converted either
+			if (no_copy && ctype)
+			{
+				status = CCV_IO_ERROR;
+				break;
+			}
+#ifdef HAVE_MMAP
+			if (no_copy)
+			{
+				_ccv_read_binary_mmap(fd, x);
+				// the mapped matrix has its signature already, fall back to copy if cannot map
+				if (*x != 0)
+					break;
+			}
+#endif
 			_ccv_read_binary_fd(fd, x, ctype);
 	}
-	if (*x != 0)
+	if (x != roi && full != 0)
+	{
+		const int x0 = ccv_clamp(param->x, 0, full->cols);
+		const int y0 = ccv_clamp(param->y, 0, full->rows);
+		const int x1 = ccv_clamp(param->x + param->width, x0, full->cols);
+		const int y1 = ccv_clamp(param->y + param->height, y0, full->rows);
+		x = roi;
+		if (x1 > x0 && y1 > y0)
+			ccv_slice(full, (ccv_matrix_t**)x, 0, y0, x0, y1 - y0, x1 - x0);
+		ccv_matrix_unmap(full);
+	}
+	if (*x != 0 && !((*x)->type & CCV_NO_DATA_ALLOC))
 		ccv_make_matrix_immutable(*x);
 	if (type & CCV_IO_ANY_FILE)
 		fclose(fd);
-	return CCV_IO_FINAL;
+	return status;
+}
+
+void ccv_matrix_unmap(ccv_dense_matrix_t* mat)
+{
+#ifdef HAVE_MMAP
+	// if the file cannot be mapped, ccv_read falls back to a regular copy
+	if (mat->type & CCV_NO_DATA_ALLOC)
+	{
+		size_t page = sysconf(_SC_PAGESIZE);
+		unsigned char* base = (unsigned char*)((uintptr_t)mat->data.u8 & ~(uintptr_t)(page - 1));
+		munmap(base, (size_t)(mat->data.u8 - base) + (size_t)mat->step * mat->rows);
+	}
+#endif
+	ccv_matrix_free(mat);
 }
 
 static int _ccv_read_raw(ccv_dense_matrix_t** x, void* data, int type, int rows, int cols, int scanline)
@@ -94,6 +254,10 @@ static int _ccv_read_raw(ccv_dense_matrix_t** x, void* data, int type, int rows,
 			case CCV_IO_ABGR_RAW:
 				ctype = CCV_8U | CCV_C4;
 				break;
+			case CCV_IO_I420_RAW:
+			case CCV_IO_NV12_RAW:
+			case CCV_IO_NV21_RAW:
+				/* the y plane */
 			case CCV_IO_GRAY_RAW:
 			default:
 				/* default one */
@@ -125,6 +289,11 @@ static int _ccv_read_raw(ccv_dense_matrix_t** x, void* data, int type, int rows,
 			case CCV_IO_GRAY_RAW:
 				_ccv_read_gray_raw(x, data, type, rows, cols, scanline);
 				break;
+			case CCV_IO_I420_RAW:
+			case CCV_IO_NV12_RAW:
+			case CCV_IO_NV21_RAW:
+				_ccv_read_yuv420_raw(x, data, type, rows, cols, scanline);
+				break;
 		}
 	}
 	if (*x != 0)
@@ -172,7 +341,7 @@ static fpos_t seekfn(void* context, fpos_t off, int whence)
 }
 #endif
 
-int ccv_read_impl(const void* in, ccv_dense_matrix_t** x, int type, int rows, int cols, int scanline)
+static int _ccv_read_with_param(const void* in, ccv_dense_matrix_t** x, int type, int rows, int cols, int scanline, const ccv_io_read_param_t* param)
 {
 	FILE* fd = 0;
 	if (type & CCV_IO_ANY_FILE)
@@ -181,7 +350,7 @@ int ccv_read_impl(const void* in, ccv_dense_matrix_t** x, int type, int rows, in
 		fd = fopen((const char*)in, "rb");
 		if (!fd)
 			return CCV_IO_ERROR;
-		return _ccv_read_and_close_fd(fd, x, type);
+		return _ccv_read_and_close_fd(fd, x, type, param);
 	} else if (type & CCV_IO_ANY_STREAM) {
 		assert(rows > 8 && cols == 0 && scanline == 0);
 		assert((type & 0xFF) != CCV_IO_DEFLATE_STREAM); // deflate stream (compressed stream) is not supported yet
@@ -201,16 +370,158 @@ int ccv_read_impl(const void* in, ccv_dense_matrix_t** x, int type, int rows, in
 			return CCV_IO_ERROR;
 		// mimicking itself as a "file"
 		type = (type & ~0x10) | 0x20;
-		return _ccv_read_and_close_fd(fd, x, type);
+		return _ccv_read_and_close_fd(fd, x, type, param);
 #endif
 	} else if (type & CCV_IO_ANY_RAW) {
+		assert(param == 0); // raw input is not decoded, slice it instead
 		return _ccv_read_raw(x, (void*)in /* it can be modifiable if it is NO_COPY mode */, type, rows, cols, scanline);
 	}
 	return CCV_IO_UNKNOWN;
 }
 
+int ccv_read_impl(const void* in, ccv_dense_matrix_t** x, int type, int rows, int cols, int scanline)
+{
+	return _ccv_read_with_param(in, x, type, rows, cols, scanline, 0);
+}
+
+int ccv_read_with_param(const void* in, ccv_dense_matrix_t** x, int type, int size, ccv_io_read_param_t params)
+{
+	return _ccv_read_with_param(in, x, type, size, 0, 0, &params);
+}
+
+struct ccv_image_encoder_s {
+	int type;
+	int conf;
+	size_t row_size;
+	unsigned char* row; // for the rows that need to be converted
+#ifdef HAVE_LIBJPEG
+	struct jpeg_compress_struct cinfo;
+	struct ccv_jpeg_error_mgr_t jerr;
+	ccv_jpeg_buffer_dest_t dest;
+#endif
+};
+
+// the JPEG quality is 95 and the PNG memory level is 0 (the fastest) by default
+static int _ccv_image_encoder_conf(int type, void* conf)
+{
+	return conf ? *(int*)conf : (type == CCV_IO_JPEG_STREAM ? 95 : 0);
+}
+
+ccv_image_encoder_t* ccv_image_encoder_new(int type, void* conf)
+{
+	ccv_image_encoder_t* encoder = (ccv_image_encoder_t*)ccmalloc(sizeof(ccv_image_encoder_t));
+	encoder->type = type;
+	encoder->row_size = 0;
+	encoder->row = 0;
+	switch (type)
+	{
+		case CCV_IO_JPEG_STREAM:
+#ifdef HAVE_LIBJPEG
+			encoder->conf = _ccv_image_encoder_conf(type, conf);
+			// libjpeg is set up once, and every image after reuses it
+			encoder->cinfo.err = jpeg_std_error(&encoder->jerr.pub);
+			encoder->jerr.pub.error_exit = error_exit;
+			jpeg_create_compress(&encoder->cinfo);
+			encoder->dest.pub.init_destination = _ccv_jpeg_buffer_init_destination;
+			encoder->dest.pub.empty_output_buffer = _ccv_jpeg_buffer_empty_output_buffer;
+			encoder->dest.pub.term_destination = _ccv_jpeg_buffer_term_destination;
+			encoder->cinfo.dest = &encoder->dest.pub;
+#else
+			assert(0 && "ccv_image_encoder_new requires libjpeg support for JPEG format");
+#endif
+			break;
+		case CCV_IO_PNG_STREAM:
+#ifdef HAVE_LIBPNG
+			encoder->conf = _ccv_image_encoder_conf(type, conf);
+#else
+			assert(0 && "ccv_image_encoder_new requires libpng support for PNG format");
+#endif
+			break;
+		default:
+			assert(0 && "ccv_image_encoder_new only supports CCV_IO_JPEG_STREAM and CCV_IO_PNG_STREAM");
+	}
+	return encoder;
+}
+
+static int _ccv_image_encode(ccv_image_encoder_t* encoder, ccv_dense_matrix_t* mat, ccv_io_buffer_t* buffer)
+{
+	const size_t row_size = (size_t)mat->cols * CCV_GET_CHANNEL(mat->type);
+	if (row_size > encoder->row_size)
+	{
+		encoder->row = (unsigned char*)ccrealloc(encoder->row, row_size);
+		encoder->row_size = row_size;
+	}
+	int result = CCV_IO_ERROR;
+	switch (encoder->type)
+	{
+#ifdef HAVE_LIBJPEG
+		case CCV_IO_JPEG_STREAM:
+			encoder->dest.buffer = buffer;
+			result = _ccv_jpeg_compress(&encoder->cinfo, &encoder->jerr, mat, encoder->conf, encoder->row);
+			break;
+#endif
+#ifdef HAVE_LIBPNG
+		case CCV_IO_PNG_STREAM:
+			result = _ccv_write_png(mat, 0, buffer, &encoder->conf, encoder->row);
+			break;
+#endif
+	}
+	return result;
+}
+
+int ccv_image_encode(ccv_image_encoder_t* encoder, ccv_dense_matrix_t* mat, unsigned char** out, size_t* size, size_t* len)
+{
+	ccv_io_buffer_t buffer = {
+		.out = out,
+		.size = size,
+		.len = 0,
+		.fixed = 0,
+	};
+	const int result = _ccv_image_encode(encoder, mat, &buffer);
+	if (len)
+		*len = buffer.len;
+	return result;
+}
+
+void ccv_image_encoder_free(ccv_image_encoder_t* encoder)
+{
+#ifdef HAVE_LIBJPEG
+	if (encoder->type == CCV_IO_JPEG_STREAM)
+		jpeg_destroy_compress(&encoder->cinfo);
+#endif
+	if (encoder->row)
+		ccfree(encoder->row);
+	ccfree(encoder);
+}
+
+static __thread ccv_image_encoder_t* ccv_write_encoder[2] = {0}; // for CCV_IO_JPEG_STREAM and CCV_IO_PNG_STREAM
+
 int ccv_write(ccv_dense_matrix_t* mat, char* out, int* len, int type, void* conf)
 {
+	if (type == CCV_IO_JPEG_STREAM || type == CCV_IO_PNG_STREAM)
+	{
+		// encode into the memory region of *len bytes, and set *len to the bytes written
+		assert(len != 0 && *len >= 0);
+		// the encoder of the thread is reused, thus, libjpeg is set up once per thread rather than per image
+		ccv_image_encoder_t** encoder = ccv_write_encoder + (type == CCV_IO_PNG_STREAM);
+		if (!*encoder)
+			*encoder = ccv_image_encoder_new(type, conf);
+		else
+			(*encoder)->conf = _ccv_image_encoder_conf(type, conf);
+		unsigned char* data = (unsigned char*)out;
+		size_t size = *len;
+		ccv_io_buffer_t buffer = {
+			.out = &data,
+			.size = &size,
+			.len = 0,
+			.fixed = 1,
+		};
+		int result = _ccv_image_encode(*encoder, mat, &buffer);
+		if (buffer.len > size)
+			result = CCV_IO_ERROR;
+		*len = (int)buffer.len;
+		return result;
+	}
 	FILE* fd = 0;
 	if (type & CCV_IO_ANY_FILE)
 	{
@@ -248,3 +559,568 @@ int ccv_write(ccv_dense_matrix_t* mat, char* out, int* len, int type, void* conf
 		fclose(fd);
 	return CCV_IO_FINAL;
 }
+
+enum {
+	CCV_IMAGE_LOADER_FREE = 0,
+	CCV_IMAGE_LOADER_DECODING,
+	CCV_IMAGE_LOADER_READY,
+};
+
+typedef struct {
+	int state;
+	int index;
+	ccv_dense_matrix_t* x;
+} ccv_image_loader_slot_t;
+
+struct ccv_image_loader_s {
+	const void* const* in;
+	const int* size;
+	int count;
+	int type;
+	ccv_image_loader_param_t params;
+	int next; // the next image to decode
+	int handed; // the number of images handed out
+	int stop;
+	ccv_image_loader_slot_t* slots;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t mutex;
+	pthread_cond_t decoded;
+	pthread_cond_t freed;
+	pthread_t* threads;
+#endif
+};
+
+static ccv_dense_matrix_t* _ccv_image_loader_decode(ccv_image_loader_t* loader, int i)
+{
+	ccv_dense_matrix_t* image = 0;
+	const int size = loader->size ? loader->size[i] : 0;
+	ccv_read_with_param(loader->in[i], &image, loader->type, size, loader->params.read);
+	if (image == 0)
+		return 0;
+	if (loader->params.rows > 0 && loader->params.cols > 0 && (image->rows != loader->params.rows || image->cols != loader->params.cols))
+	{
+		ccv_dense_matrix_t* resized = 0;
+		// area when scaling down, cubic otherwise
+		ccv_resample(image, &resized, 0, loader->params.rows, loader->params.cols, CCV_INTER_AREA | CCV_INTER_CUBIC);
+		ccv_matrix_free(image);
+		image = resized;
+	}
+	if (loader->params.transform)
+	{
+		ccv_dense_matrix_t* b = 0;
+		loader->params.transform(image, &b, loader->params.context);
+		ccv_matrix_free(image);
+		image = b;
+	}
+	return image;
+}
+
+#ifdef HAVE_PTHREAD
+// the slot an image can be decoded into, -1 if none is free
+static int _ccv_image_loader_free_slot(ccv_image_loader_t* loader, int index)
+{
+	if (loader->params.ordered)
+		// in order, image i always goes to slot i % capacity, thus, it is free once image i - capacity is handed out
+		return loader->slots[index % loader->params.capacity].state == CCV_IMAGE_LOADER_FREE ? index % loader->params.capacity : -1;
+	int i;
+	for (i = 0; i < loader->params.capacity; i++)
+		if (loader->slots[i].state == CCV_IMAGE_LOADER_FREE)
+			return i;
+	return -1;
+}
+
+static void* _ccv_image_loader_thread(void* arg)
+{
+	ccv_image_loader_t* loader = (ccv_image_loader_t*)arg;
+	pthread_mutex_lock(&loader->mutex);
+	for (;;)
+	{
+		int slot = -1;
+		while (!loader->stop && loader->next < loader->count && (slot = _ccv_image_loader_free_slot(loader, loader->next)) < 0)
+			pthread_cond_wait(&loader->freed, &loader->mutex);
+		if (loader->stop || loader->next >= loader->count)
+			break;
+		const int index = loader->next++;
+		loader->slots[slot].state = CCV_IMAGE_LOADER_DECODING;
+		loader->slots[slot].index = index;
+		pthread_mutex_unlock(&loader->mutex);
+		ccv_dense_matrix_t* x = _ccv_image_loader_decode(loader, index);
+		pthread_mutex_lock(&loader->mutex);
+		loader->slots[slot].x = x;
+		loader->slots[slot].state = CCV_IMAGE_LOADER_READY;
+		pthread_cond_broadcast(&loader->decoded);
+	}
+	pthread_mutex_unlock(&loader->mutex);
+	return 0;
+}
+#endif
+
+ccv_image_loader_t* ccv_image_loader_new(const void* const* in, const int* size, int count, int type, ccv_image_loader_param_t params)
+{
+	assert(count >= 0);
+	assert(!!(type & CCV_IO_ANY_STREAM) == !!size);
+	ccv_image_loader_t* loader = (ccv_image_loader_t*)ccmalloc(sizeof(ccv_image_loader_t));
+	loader->in = in;
+	loader->size = size;
+	loader->count = count;
+	loader->type = type;
+	loader->next = loader->handed = loader->stop = 0;
+#ifdef HAVE_PTHREAD
+	if (params.threads <= 0)
+#ifdef _SC_NPROCESSORS_ONLN
+		params.threads = ccv_max(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+#else
+		params.threads = 1;
+#endif
+	params.threads = ccv_min(params.threads, ccv_max(count, 1));
+	if (params.capacity <= 0)
+		params.capacity = params.threads * 2;
+	loader->params = params;
+	loader->slots = (ccv_image_loader_slot_t*)cccalloc(params.capacity, sizeof(ccv_image_loader_slot_t));
+	pthread_mutex_init(&loader->mutex, 0);
+	pthread_cond_init(&loader->decoded, 0);
+	pthread_cond_init(&loader->freed, 0);
+	loader->threads = (pthread_t*)ccmalloc(sizeof(pthread_t) * params.threads);
+	int i;
+	for (i = 0; i < params.threads; i++)
+		if (pthread_create(loader->threads + i, 0, _ccv_image_loader_thread, loader) != 0)
+			break;
+	if (i < params.threads)
+	{
+		// stop and join the threads already started, and take back what they decoded
+		loader->params.threads = i;
+		ccv_image_loader_free(loader);
+		return 0;
+	}
+#else
+	// without threads, images are decoded when they are asked for
+	loader->params = params;
+	loader->slots = 0;
+#endif
+	return loader;
+}
+
+int ccv_image_loader_next(ccv_image_loader_t* loader, ccv_dense_matrix_t** x)
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&loader->mutex);
+	if (loader->handed >= loader->count)
+	{
+		pthread_mutex_unlock(&loader->mutex);
+		return -1;
+	}
+	int i, slot = -1;
+	for (;;)
+	{
+		if (loader->params.ordered)
+		{
+			i = loader->handed % loader->params.capacity;
+			if (loader->slots[i].state == CCV_IMAGE_LOADER_READY && loader->slots[i].index == loader->handed)
+				slot = i;
+		} else
+			for (i = 0; slot < 0 && i < loader->params.capacity; i++)
+				if (loader->slots[i].state == CCV_IMAGE_LOADER_READY)
+					slot = i;
+		if (slot >= 0)
+			break;
+		pthread_cond_wait(&loader->decoded, &loader->mutex);
+	}
+	const int index = loader->slots[slot].index;
+	*x = loader->slots[slot].x;
+	loader->slots[slot].x = 0;
+	loader->slots[slot].state = CCV_IMAGE_LOADER_FREE;
+	++loader->handed;
+	pthread_cond_broadcast(&loader->freed);
+	pthread_mutex_unlock(&loader->mutex);
+	return index;
+#else
+	if (loader->handed >= loader->count)
+		return -1;
+	const int index = loader->handed++;
+	*x = _ccv_image_loader_decode(loader, index);
+	return index;
+#endif
+}
+
+void ccv_image_loader_free(ccv_image_loader_t* loader)
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&loader->mutex);
+	loader->stop = 1;
+	pthread_cond_broadcast(&loader->freed);
+	pthread_mutex_unlock(&loader->mutex);
+	int i;
+	for (i = 0; i < loader->params.threads; i++)
+		pthread_join(loader->threads[i], 0);
+	for (i = 0; i < loader->params.capacity; i++)
+		if (loader->slots[i].x)
+			ccv_matrix_free(loader->slots[i].x);
+	ccfree(loader->threads);
+	ccfree(loader->slots);
+	pthread_cond_destroy(&loader->freed);
+	pthread_cond_destroy(&loader->decoded);
+	pthread_mutex_destroy(&loader->mutex);
+#endif
+	ccfree(loader);
+}
+
+/* the record file: a header of CCV_RECORD_ALIGN bytes, the payloads each starting at a multiple of CCV_RECORD_ALIGN,
+ * and the index of all records at the end, the header is rewritten with the index offset when the writer is freed */
+#define CCV_RECORD_ALIGN (64)
+#define CCV_RECORD_VERSION (1)
+// ccv_dense_matrix_new does its size arithmetic in int, a record has to fit it with room to spare, both as stored and packed
+#define CCV_RECORD_MAX_SIZE ((uint64_t)1 << 30)
+
+typedef struct {
+	int type;
+	int rows;
+	int cols;
+	int step;
+	uint64_t offset;
+	uint64_t size; // the bytes stored, less than step * rows if it is deflated
+	int compression;
+	int reserved;
+} ccv_record_index_t;
+
+struct ccv_record_writer_s {
+	FILE* w;
+	int compression;
+	uint64_t offset;
+	ccv_array_t* index;
+	unsigned char* buf;
+	size_t size;
+};
+
+struct ccv_record_reader_s {
+	int count;
+	ccv_record_index_t* index;
+	uint64_t id[4];
+	unsigned char* map; // 0 if the file is not mapped, the records are read from r instead
+	size_t len;
+	FILE* r;
+#if !defined(HAVE_MMAP) && defined(HAVE_PTHREAD)
+	pthread_mutex_t mutex; // no pread, fseek and fread on the shared r have to be serialized
+#endif
+};
+
+static int _ccv_record_write_header(FILE* w, int count, uint64_t index)
+{
+	const int version = CCV_RECORD_VERSION;
+	unsigned char header[CCV_RECORD_ALIGN];
+	memset(header, 0, sizeof(header));
+	memcpy(header, "CCVRECRD", 8);
+	memcpy(header + 8, &version, 4);
+	memcpy(header + 12, &count, 4);
+	memcpy(header + 16, &index, 8);
+	return fwrite(header, 1, sizeof(header), w) == sizeof(header) ? 0 : -1;
+}
+
+static int _ccv_record_write_padding(ccv_record_writer_t* writer)
+{
+	static const unsigned char zeros[CCV_RECORD_ALIGN] = {0};
+	const size_t padding = (size_t)(-writer->offset & (CCV_RECORD_ALIGN - 1));
+	if (fwrite(zeros, 1, padding, writer->w) != padding)
+		return -1;
+	writer->offset += padding;
+	return 0;
+}
+
+ccv_record_writer_t* ccv_record_writer_new(const char* filename, int compression)
+{
+	assert(compression >= 0 && compression <= 9);
+	FILE* w = fopen(filename, "wb");
+	if (!w)
+		return 0;
+	ccv_record_writer_t* writer = (ccv_record_writer_t*)ccmalloc(sizeof(ccv_record_writer_t));
+	writer->w = w;
+	writer->compression = compression;
+	writer->index = ccv_array_new(sizeof(ccv_record_index_t), 64, 0);
+	writer->buf = 0;
+	writer->size = 0;
+	// the header is filled in when the writer is freed
+	_ccv_record_write_header(w, 0, 0);
+	writer->offset = CCV_RECORD_ALIGN;
+	return writer;
+}
+
+int ccv_record_write(ccv_record_writer_t* writer, ccv_dense_matrix_t* mat)
+{
+	// the reader takes nothing bigger
+	if ((uint64_t)mat->step * mat->rows > CCV_RECORD_MAX_SIZE)
+		return -1;
+	ccv_record_index_t record = {
+		.type = mat->type & 0xFFFFF,
+		.rows = mat->rows,
+		.cols = mat->cols,
+		.step = mat->step,
+		.size = (uint64_t)mat->step * mat->rows,
+		.compression = 0,
+		.reserved = 0,
+	};
+	unsigned char* data = mat->data.u8;
+	// zlib comes with libpng
+#ifdef HAVE_LIBPNG
+	if (writer->compression > 0)
+	{
+		uLongf len = compressBound(record.size);
+		if (len > writer->size)
+		{
+			writer->buf = (unsigned char*)ccrealloc(writer->buf, len);
+			writer->size = len;
+		}
+		// keep it as is if deflate doesn't make it smaller, then it can still be mapped in place
+		if (compress2(writer->buf, &len, data, record.size, writer->compression) == Z_OK && len < record.size)
+		{
+			data = writer->buf;
+			record.size = len;
+			record.compression = writer->compression;
+		}
+	}
+#endif
+	const uint64_t offset = writer->offset;
+	if (_ccv_record_write_padding(writer) != 0 || fwrite(data, 1, record.size, writer->w) != record.size)
+	{
+		// roll back to where the last record ended, the next one (or the index) is written over what is there
+		writer->offset = offset;
+		clearerr(writer->w);
+		fseek(writer->w, (long)offset, SEEK_SET);
+		return -1;
+	}
+	record.offset = writer->offset;
+	writer->offset += record.size;
+	ccv_array_push(writer->index, &record);
+	return writer->index->rnum - 1;
+}
+
+int ccv_record_writer_free(ccv_record_writer_t* writer)
+{
+	int status = _ccv_record_write_padding(writer);
+	const uint64_t index = writer->offset;
+	if (status == 0 && fwrite(writer->index->data, sizeof(ccv_record_index_t), writer->index->rnum, writer->w) != writer->index->rnum)
+		status = -1;
+	// the header points to the index only if the index is all there
+	if (status == 0 && (fseek(writer->w, 0, SEEK_SET) != 0 || _ccv_record_write_header(writer->w, writer->index->rnum, index) != 0))
+		status = -1;
+	if (fclose(writer->w) != 0)
+		status = -1;
+	ccv_array_free(writer->index);
+	if (writer->buf)
+		ccfree(writer->buf);
+	ccfree(writer);
+	return status;
+}
+
+static int _ccv_record_pread(ccv_record_reader_t* reader, void* buf, size_t size, uint64_t offset)
+{
+#ifdef HAVE_MMAP
+	// pread doesn't move the file offset, thus, many threads can read from the same file at the same time
+	const int fd = fileno(reader->r);
+	size_t done = 0;
+	while (done < size)
+	{
+		const ssize_t n = pread(fd, (unsigned char*)buf + done, size - done, (off_t)(offset + done));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		done += n;
+	}
+	return 0;
+#else
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&reader->mutex);
+#endif
+	const int status = (fseek(reader->r, (long)offset, SEEK_SET) == 0 && fread(buf, 1, size, reader->r) == size) ? 0 : -1;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&reader->mutex);
+#endif
+	return status;
+#endif
+}
+
+static int _ccv_record_index_is_valid(const ccv_record_index_t* record, uint64_t index)
+{
+	// as the binary header, nothing in the index is trusted
+	const int data_type = CCV_GET_DATA_TYPE(record->type) >> 12;
+	if ((record->type & ~0xFFFFF) || data_type > 16 || _ccv_get_data_type_size[data_type] <= 0 || CCV_GET_CHANNEL(record->type) <= 0 ||
+		record->rows < 0 || record->cols < 0 || record->compression < 0 || record->compression > 9)
+		return 0;
+	const int size = _ccv_get_data_type_size[data_type];
+	// a record mapped in place has to be aligned to its element
+	if (record->offset < CCV_RECORD_ALIGN || record->offset % size != 0 || record->step % size != 0)
+		return 0;
+	// in 64-bit, a row is at most 46-bit, the step and the rows are 31-bit, and a row is checked before it is multiplied by the rows
+	const uint64_t row = (uint64_t)size * CCV_GET_CHANNEL(record->type) * record->cols;
+	const uint64_t data_size = (uint64_t)record->step * record->rows;
+	if ((uint64_t)record->step < row || row > CCV_RECORD_MAX_SIZE || data_size > CCV_RECORD_MAX_SIZE ||
+		((row + 3) & ~(uint64_t)3) * record->rows > CCV_RECORD_MAX_SIZE)
+		return 0;
+	if (record->offset > index || record->size > index - record->offset ||
+		(record->compression == 0 && record->size != data_size))
+		return 0;
+	return 1;
+}
+
+ccv_record_reader_t* ccv_record_reader_new(const char* filename, int type)
+{
+	FILE* r = fopen(filename, "rb");
+	if (!r)
+		return 0;
+	unsigned char header[CCV_RECORD_ALIGN];
+	int version, count;
+	uint64_t index;
+	fseek(r, 0, SEEK_END);
+	const uint64_t len = ftell(r);
+	fseek(r, 0, SEEK_SET);
+	if (fread(header, 1, sizeof(header), r) != sizeof(header) || memcmp(header, "CCVRECRD", 8) != 0)
+	{
+		fclose(r);
+		return 0;
+	}
+	memcpy(&version, header + 8, 4);
+	memcpy(&count, header + 12, 4);
+	memcpy(&index, header + 16, 8);
+	// a file whose writer never finished has no index
+	if (version != CCV_RECORD_VERSION || count < 0 || index < CCV_RECORD_ALIGN || (index & (CCV_RECORD_ALIGN - 1)) || index > len || (uint64_t)count * sizeof(ccv_record_index_t) > len - index)
+	{
+		fclose(r);
+		return 0;
+	}
+	ccv_record_reader_t* reader = (ccv_record_reader_t*)ccmalloc(sizeof(ccv_record_reader_t));
+	reader->count = count;
+	reader->map = 0;
+	reader->len = len;
+	reader->r = r;
+	memset(reader->id, 0, sizeof(reader->id));
+#ifdef HAVE_MMAP
+	if (type & CCV_IO_NO_COPY)
+	{
+		struct stat st;
+		// same as CCV_IO_BINARY_FILE, a private writable mapping, pages are shared with the page cache until written
+		void* map = (fstat(fileno(r), &st) == 0) ? mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(r), 0) : MAP_FAILED;
+		// read it as if there is no CCV_IO_NO_COPY if it cannot be mapped
+		if (map != MAP_FAILED)
+		{
+			fclose(r);
+			reader->r = 0;
+			reader->map = (unsigned char*)map;
+			reader->index = (ccv_record_index_t*)(reader->map + index);
+			reader->id[0] = (uint64_t)st.st_dev;
+			reader->id[1] = (uint64_t)st.st_ino;
+			reader->id[2] = (uint64_t)st.st_size;
+			reader->id[3] = (uint64_t)st.st_mtime;
+		}
+	}
+#endif
+	if (!reader->map)
+	{
+#if !defined(HAVE_MMAP) && defined(HAVE_PTHREAD)
+		pthread_mutex_init(&reader->mutex, 0);
+#endif
+		reader->index = (ccv_record_index_t*)ccmalloc(sizeof(ccv_record_index_t) * ccv_max(count, 1));
+		if (_ccv_record_pread(reader, reader->index, sizeof(ccv_record_index_t) * count, index) != 0)
+		{
+			ccv_record_reader_free(reader);
+			return 0;
+		}
+	}
+	int i;
+	for (i = 0; i < count; i++)
+		if (!_ccv_record_index_is_valid(reader->index + i, index))
+		{
+			ccv_record_reader_free(reader);
+			return 0;
+		}
+	return reader;
+}
+
+int ccv_record_count(ccv_record_reader_t* reader)
+{
+	return reader->count;
+}
+
+int ccv_record_read(ccv_record_reader_t* reader, int i, ccv_dense_matrix_t** x, int type)
+{
+	assert(i >= 0 && i < reader->count);
+	const ccv_record_index_t* record = reader->index + i;
+	if ((type & CCV_IO_NO_COPY) && reader->map && record->compression == 0)
+	{
+		*x = ccv_dense_matrix_new(record->rows, record->cols, record->type | CCV_NO_DATA_ALLOC, reader->map + record->offset, 0);
+		(*x)->step = record->step;
+		(*x)->sig = ccv_cache_generate_signature((const char*)reader->id, sizeof(reader->id), (uint64_t)i, (uint64_t)record->type, CCV_EOF_SIGN);
+		return CCV_IO_FINAL;
+	}
+	unsigned char* buf = 0;
+	if (!reader->map)
+	{
+		buf = (unsigned char*)ccmalloc(ccv_max(record->size, 1));
+		if (_ccv_record_pread(reader, buf, record->size, record->offset) != 0)
+		{
+			ccfree(buf);
+			return CCV_IO_ERROR;
+		}
+	}
+	const unsigned char* data = reader->map ? reader->map + record->offset : buf;
+	ccv_dense_matrix_t* mat = *x = ccv_dense_matrix_new(record->rows, record->cols, record->type, 0, 0);
+	int status = CCV_IO_FINAL;
+	if (record->compression == 0)
+	{
+		if (record->step == mat->step)
+			memcpy(mat->data.u8, data, record->size);
+		else {
+			int j;
+			const size_t row = ccv_min(record->step, mat->step);
+			for (j = 0; j < mat->rows; j++)
+				memcpy(mat->data.u8 + (size_t)j * mat->step, data + (size_t)j * record->step, row);
+		}
+	} else {
+#ifdef HAVE_LIBPNG
+		// the index is checked that this is at most CCV_RECORD_MAX_SIZE, and it has to inflate to exactly that
+		const uLongf data_size = (uLongf)record->step * record->rows;
+		uLongf len = data_size;
+		if (record->step == mat->step)
+		{
+			if (uncompress(mat->data.u8, &len, data, record->size) != Z_OK || len != data_size)
+				status = CCV_IO_ERROR;
+		} else {
+			unsigned char* buf = (unsigned char*)ccmalloc(ccv_max(data_size, 1));
+			if (uncompress(buf, &len, data, record->size) != Z_OK || len != data_size)
+				status = CCV_IO_ERROR;
+			else {
+				int j;
+				const size_t row = ccv_min(record->step, mat->step);
+				for (j = 0; j < mat->rows; j++)
+					memcpy(mat->data.u8 + (size_t)j * mat->step, buf + (size_t)j * record->step, row);
+			}
+			ccfree(buf);
+		}
+#else
+		status = CCV_IO_ERROR; // deflated records need zlib
+#endif
+	}
+	if (buf)
+		ccfree(buf);
+	if (status != CCV_IO_FINAL)
+	{
+		ccv_matrix_free(mat);
+		*x = 0;
+	}
+	return status;
+}
+
+void ccv_record_reader_free(ccv_record_reader_t* reader)
+{
+#ifdef HAVE_MMAP
+	if (reader->map)
+		munmap(reader->map, reader->len);
+#endif
+	if (!reader->map)
+	{
+		fclose(reader->r);
+		ccfree(reader->index);
+#if !defined(HAVE_MMAP) && defined(HAVE_PTHREAD)
+		pthread_mutex_destroy(&reader->mutex);
+#endif
+	}
+	ccfree(reader);
+}
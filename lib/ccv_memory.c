@@ -1,6 +1,9 @@
 #include "ccv.h"
 #include "ccv_internal.h"
 #include "3rdparty/siphash/siphash24.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 static __thread ccv_cache_t ccv_cache;
 
@@ -13,13 +16,266 @@ static __thread ccv_cache_t ccv_cache;
 /* option to enable/disable cache */
 static __thread int ccv_cache_opt = 0;
 
+/* look up the cache, and count the miss against the type we asked for, which the cache itself cannot tell */
+static void* _ccv_cache_lookup(ccv_cache_t* cache, uint64_t sig, uint8_t expect, uint8_t* type)
+{
+	void* x = ccv_cache_out(cache, sig, type);
+	if (!x)
+		++cache->stats[expect].misses;
+	return x;
+}
+
+#ifdef HAVE_PTHREAD
+/* The process-wide cache is split into shards by the top bits of the signature (the radix tree inside
+ * each shard consumes the signature from the low bits), each shard guarded by its own mutex, therefore,
+ * threads only contend when they touch the same shard. The shards only split the lookup, the byte budget
+ * is one for all of them: each shard can hold up to the whole budget, and the bytes held across shards
+ * are counted in one atomic counter, when it goes over, objects are evicted from the shard at hand first,
+ * then from the others. */
+#define CCV_CACHE_SHARD_BITS (4)
+#define CCV_CACHE_SHARDS (1 << CCV_CACHE_SHARD_BITS)
+#define CCV_GET_CACHE_SHARD(sig) ((sig) >> (64 - CCV_CACHE_SHARD_BITS))
+
+typedef struct {
+	pthread_mutex_t mutex;
+	ccv_cache_t cache;
+} ccv_cache_shard_t;
+
+static ccv_cache_shard_t ccv_shared_cache[CCV_CACHE_SHARDS];
+/* the mutexes are created once and never destroyed, a thread can still be on its way into a shard when the cache is disabled */
+static pthread_once_t ccv_shared_cache_once = PTHREAD_ONCE_INIT;
+static size_t ccv_shared_cache_up = 0;
+static size_t ccv_shared_cache_size = 0;
+
+/* option to enable/disable the process-wide cache, it is checked again with the shard locked */
+static int ccv_shared_cache_opt = 0;
+
+static void _ccv_shared_cache_once(void)
+{
+	int i;
+	for (i = 0; i < CCV_CACHE_SHARDS; i++)
+	{
+		pthread_mutex_init(&ccv_shared_cache[i].mutex, 0);
+		ccv_cache_init(&ccv_shared_cache[i].cache, 0, 2, ccv_matrix_free_immediately, ccv_array_free_immediately);
+	}
+}
+
+static inline int _ccv_shared_cache_enabled(void)
+{
+	return __atomic_load_n(&ccv_shared_cache_opt, __ATOMIC_ACQUIRE);
+}
+
+/* account for the bytes a shard gained or lost since before, with the shard locked */
+static inline size_t _ccv_shared_cache_account(ccv_cache_shard_t* shard, size_t before)
+{
+	if (shard->cache.size >= before)
+		return __atomic_add_fetch(&ccv_shared_cache_size, shard->cache.size - before, __ATOMIC_RELAXED);
+	return __atomic_sub_fetch(&ccv_shared_cache_size, before - shard->cache.size, __ATOMIC_RELAXED);
+}
+
+static void* _ccv_shared_cache_out(uint64_t sig, uint8_t expect, uint8_t* type)
+{
+	ccv_cache_shard_t* shard = ccv_shared_cache + CCV_GET_CACHE_SHARD(sig);
+	pthread_mutex_lock(&shard->mutex);
+	void* x = 0;
+	if (_ccv_shared_cache_enabled())
+	{
+		const size_t before = shard->cache.size;
+		x = _ccv_cache_lookup(&shard->cache, sig, expect, type);
+		_ccv_shared_cache_account(shard, before);
+	}
+	pthread_mutex_unlock(&shard->mutex);
+	return x;
+}
+
+static int _ccv_shared_cache_put(uint64_t sig, void* x, uint32_t size, uint8_t type)
+{
+	const int k = CCV_GET_CACHE_SHARD(sig);
+	ccv_cache_shard_t* shard = ccv_shared_cache + k;
+	pthread_mutex_lock(&shard->mutex);
+	if (!_ccv_shared_cache_enabled())
+	{
+		pthread_mutex_unlock(&shard->mutex);
+		return -1;
+	}
+	size_t before = shard->cache.size;
+	const int result = ccv_cache_put(&shard->cache, sig, x, size, type);
+	size_t total = _ccv_shared_cache_account(shard, before);
+	const size_t up = __atomic_load_n(&ccv_shared_cache_up, __ATOMIC_RELAXED);
+	if (result >= 0 && total > up)
+	{
+		// the least recently used of this shard goes first, the object just put stays
+		before = shard->cache.size;
+		ccv_cache_evict(&shard->cache, ccv_max(shard->cache.size - ccv_min(total - up, shard->cache.size), size));
+		total = _ccv_shared_cache_account(shard, before);
+	}
+	pthread_mutex_unlock(&shard->mutex);
+	int i;
+	// one shard is locked at a time, thus, no lock order to keep
+	for (i = 1; i < CCV_CACHE_SHARDS && total > up; i++)
+	{
+		ccv_cache_shard_t* other = ccv_shared_cache + ((k + i) & (CCV_CACHE_SHARDS - 1));
+		pthread_mutex_lock(&other->mutex);
+		total = __atomic_load_n(&ccv_shared_cache_size, __ATOMIC_RELAXED);
+		if (total > up)
+		{
+			before = other->cache.size;
+			ccv_cache_evict(&other->cache, other->cache.size - ccv_min(total - up, other->cache.size));
+			total = _ccv_shared_cache_account(other, before);
+		}
+		pthread_mutex_unlock(&other->mutex);
+	}
+	return result;
+}
+
+/* free everything in the shards one at a time, and set the budget for what comes after */
+static void _ccv_shared_cache_drain(size_t up)
+{
+	int i;
+	if (up > 0)
+		__atomic_store_n(&ccv_shared_cache_up, up, __ATOMIC_RELAXED);
+	for (i = 0; i < CCV_CACHE_SHARDS; i++)
+	{
+		ccv_cache_shard_t* shard = ccv_shared_cache + i;
+		pthread_mutex_lock(&shard->mutex);
+		const size_t before = shard->cache.size;
+		ccv_cache_cleanup(&shard->cache);
+		_ccv_shared_cache_account(shard, before);
+		if (up > 0)
+			ccv_cache_init(&shard->cache, up, 2, ccv_matrix_free_immediately, ccv_array_free_immediately);
+		pthread_mutex_unlock(&shard->mutex);
+	}
+}
+#endif
+
+static void* _ccv_cache_out(uint64_t sig, uint8_t expect, uint8_t* type)
+{
+	if (ccv_cache_opt)
+		return _ccv_cache_lookup(&ccv_cache, sig, expect, type);
+#ifdef HAVE_PTHREAD
+	if (_ccv_shared_cache_enabled())
+		return _ccv_shared_cache_out(sig, expect, type);
+#endif
+	return 0;
+}
+
+static int _ccv_cache_put(uint64_t sig, void* x, uint32_t size, uint8_t type)
+{
+	if (ccv_cache_opt)
+		return ccv_cache_put(&ccv_cache, sig, x, size, type);
+#ifdef HAVE_PTHREAD
+	if (_ccv_shared_cache_enabled())
+		return _ccv_shared_cache_put(sig, x, size, type);
+#endif
+	return -1;
+}
+
+#ifdef HAVE_PTHREAD
+#define CCV_CACHE_ENABLED (ccv_cache_opt || _ccv_shared_cache_enabled())
+#else
+#define CCV_CACHE_ENABLED (ccv_cache_opt)
+#endif
+
+/* The arena is a stack of blocks, allocation bumps the offset in the top block, a new block is pushed if
+ * it doesn't fit. Nested scopes record where the arena was (the mark is allocated from the arena itself),
+ * and roll back to there. */
+typedef struct ccv_arena_block_s {
+	struct ccv_arena_block_s* prev;
+	size_t size;
+	size_t used;
+} ccv_arena_block_t;
+
+typedef struct ccv_arena_mark_s {
+	struct ccv_arena_mark_s* prev;
+	ccv_arena_block_t* block;
+	size_t used;
+} ccv_arena_mark_t;
+
+#define CCV_ARENA_BLOCK_SIZE (1024 * 1024)
+#define CCV_ARENA_ALIGN(x) (((x) + 15) & -16)
+
+static __thread ccv_arena_block_t* ccv_arena = 0;
+static __thread ccv_arena_mark_t* ccv_arena_mark = 0;
+static __thread size_t ccv_arena_reserve = CCV_ARENA_BLOCK_SIZE; // the size of the first block for next outermost scope
+
+static void* _ccv_arena_alloc(size_t size)
+{
+	size = CCV_ARENA_ALIGN(size);
+	if (!ccv_arena || ccv_arena->used + size > ccv_arena->size)
+	{
+		const size_t block_size = ccv_max(ccv_arena ? ccv_arena->size * 2 : ccv_arena_reserve, size);
+		ccv_arena_block_t* block = (ccv_arena_block_t*)ccmalloc(CCV_ARENA_ALIGN(sizeof(ccv_arena_block_t)) + block_size);
+		block->prev = ccv_arena;
+		block->size = block_size;
+		block->used = 0;
+		ccv_arena = block;
+	}
+	void* ptr = (unsigned char*)ccv_arena + CCV_ARENA_ALIGN(sizeof(ccv_arena_block_t)) + ccv_arena->used;
+	ccv_arena->used += size;
+	return ptr;
+}
+
+void* ccv_arena_alloc(size_t size)
+{
+	assert(ccv_arena_mark);
+	return _ccv_arena_alloc(size);
+}
+
+void ccv_arena_begin(void)
+{
+	ccv_arena_block_t* block = ccv_arena;
+	const size_t used = block ? block->used : 0;
+	ccv_arena_mark_t* mark = (ccv_arena_mark_t*)_ccv_arena_alloc(sizeof(ccv_arena_mark_t));
+	mark->prev = ccv_arena_mark;
+	mark->block = block;
+	mark->used = used;
+	ccv_arena_mark = mark;
+}
+
+void ccv_arena_end(void)
+{
+	assert(ccv_arena_mark);
+	ccv_arena_mark_t* mark = ccv_arena_mark;
+	ccv_arena_mark = mark->prev;
+	if (ccv_arena_mark)
+	{
+		// nested scope, roll back to the block and offset where it began
+		ccv_arena_block_t* block = mark->block;
+		const size_t used = mark->used;
+		while (ccv_arena != block)
+		{
+			ccv_arena_block_t* prev = ccv_arena->prev;
+			ccfree(ccv_arena);
+			ccv_arena = prev;
+		}
+		ccv_arena->used = used;
+		return;
+	}
+	if (!ccv_arena->prev)
+	{
+		// everything fits in one block, keep it around for the next scope
+		ccv_arena->used = 0;
+		return;
+	}
+	// otherwise free them all, the next scope will start with one block big enough for what this scope used
+	size_t total = 0;
+	while (ccv_arena)
+	{
+		ccv_arena_block_t* prev = ccv_arena->prev;
+		total += ccv_arena->size;
+		ccfree(ccv_arena);
+		ccv_arena = prev;
+	}
+	ccv_arena_reserve = total;
+}
+
 ccv_dense_matrix_t* ccv_dense_matrix_new(int rows, int cols, int type, void* data, uint64_t sig)
 {
 	ccv_dense_matrix_t* mat;
-	if (ccv_cache_opt && sig != 0 && !data && !(type & CCV_NO_DATA_ALLOC))
+	if (CCV_CACHE_ENABLED && sig != 0 && !data && !(type & CCV_NO_DATA_ALLOC))
 	{
 		uint8_t type;
-		mat = (ccv_dense_matrix_t*)ccv_cache_out(&ccv_cache, sig, &type);
+		mat = (ccv_dense_matrix_t*)_ccv_cache_out(sig, 0 /* type 0 */, &type);
 		if (mat)
 		{
 			assert(type == 0);
@@ -28,21 +284,34 @@ ccv_dense_matrix_t* ccv_dense_matrix_new(int rows, int cols, int type, void* dat
 			return mat;
 		}
 	}
+	// ccv_matrix_free only checks the arena tag in the header, the type has no spare bit for it
 	if (type & CCV_NO_DATA_ALLOC)
 	{
-		mat = (ccv_dense_matrix_t*)ccmalloc(sizeof(ccv_dense_matrix_t));
+		mat = (ccv_dense_matrix_t*)(ccv_arena_mark ? _ccv_arena_alloc(sizeof(ccv_dense_matrix_t)) : ccmalloc(sizeof(ccv_dense_matrix_t)));
 		mat->type = (CCV_GET_CHANNEL(type) | CCV_GET_DATA_TYPE(type) | CCV_MATRIX_DENSE | CCV_NO_DATA_ALLOC) & ~CCV_GARBAGE;
+		mat->arena = !!ccv_arena_mark;
 		mat->data.u8 = data;
 	} else {
 		const size_t hdr_size = (sizeof(ccv_dense_matrix_t) + 15) & -16;
-		mat = (ccv_dense_matrix_t*)(data ? data : ccmalloc(ccv_compute_dense_matrix_size(rows, cols, type)));
-		mat->type = (CCV_GET_CHANNEL(type) | CCV_GET_DATA_TYPE(type) | CCV_MATRIX_DENSE) & ~CCV_GARBAGE;
-		mat->type |= data ? CCV_UNMANAGED : CCV_REUSABLE; // it still could be reusable because the signature could be derived one.
+		if (data)
+		{
+			mat = (ccv_dense_matrix_t*)data;
+			mat->type = (CCV_GET_CHANNEL(type) | CCV_GET_DATA_TYPE(type) | CCV_MATRIX_DENSE | CCV_UNMANAGED) & ~CCV_GARBAGE;
+			mat->arena = 0;
+		} else if (ccv_arena_mark) {
+			// matrix in the arena goes away with the scope, therefore, it is not reusable
+			mat = (ccv_dense_matrix_t*)_ccv_arena_alloc(ccv_compute_dense_matrix_size(rows, cols, type));
+			mat->type = (CCV_GET_CHANNEL(type) | CCV_GET_DATA_TYPE(type) | CCV_MATRIX_DENSE) & ~CCV_GARBAGE;
+			mat->arena = 1;
+		} else {
+			mat = (ccv_dense_matrix_t*)ccmalloc(ccv_compute_dense_matrix_size(rows, cols, type));
+			mat->type = (CCV_GET_CHANNEL(type) | CCV_GET_DATA_TYPE(type) | CCV_MATRIX_DENSE | CCV_REUSABLE) & ~CCV_GARBAGE; // it still could be reusable because the signature could be derived one.
+			mat->arena = 0;
+		}
 		mat->data.u8 = (unsigned char*)mat + hdr_size;
 	}
 	mat->sig = sig;
 #if CCV_NNC_TENSOR_TFB
-	mat->reserved0 = 0;
 	mat->resides = CCV_TENSOR_CPU_MEMORY;
 	mat->format = CCV_TENSOR_FORMAT_NHWC;
 	mat->datatype = CCV_GET_DATA_TYPE(type);
@@ -56,6 +325,33 @@ ccv_dense_matrix_t* ccv_dense_matrix_new(int rows, int cols, int type, void* dat
 	return mat;
 }
 
+ccv_dense_matrix_t* ccv_dense_matrix_new_aligned(int rows, int cols, int type, uint64_t sig)
+{
+	ccv_dense_matrix_t* mat;
+	const size_t hdr_size = (sizeof(ccv_dense_matrix_t) + CCV_ALIGN_SIZE - 1) & -CCV_ALIGN_SIZE;
+	// the arena only aligns to 16 bytes, therefore, it is always from the heap
+	void* ptr = 0;
+	ccmemalign(&ptr, CCV_ALIGN_SIZE, ccv_compute_aligned_dense_matrix_size(rows, cols, type));
+	mat = (ccv_dense_matrix_t*)ptr;
+	// not reusable, it cannot be handed out from cache to someone that expects contiguous rows
+	mat->type = (CCV_GET_CHANNEL(type) | CCV_GET_DATA_TYPE(type) | CCV_MATRIX_DENSE) & ~CCV_GARBAGE;
+	mat->data.u8 = (unsigned char*)mat + hdr_size;
+	mat->arena = 0;
+	mat->sig = sig;
+#if CCV_NNC_TENSOR_TFB
+	mat->resides = CCV_TENSOR_CPU_MEMORY;
+	mat->format = CCV_TENSOR_FORMAT_NHWC;
+	mat->datatype = CCV_GET_DATA_TYPE(type);
+	mat->channels = CCV_GET_CHANNEL(type);
+	mat->reserved1 = 0;
+#endif
+	mat->rows = rows;
+	mat->cols = cols;
+	mat->step = CCV_GET_ALIGNED_STEP(cols, type);
+	mat->refcount = 1;
+	return mat;
+}
+
 ccv_dense_matrix_t* ccv_dense_matrix_renew(ccv_dense_matrix_t* x, int rows, int cols, int types, int prefer_type, uint64_t sig)
 {
 	if (x != 0)
@@ -102,7 +398,7 @@ void ccv_make_matrix_immutable(ccv_matrix_t* mat)
 ccv_dense_matrix_t ccv_dense_matrix(int rows, int cols, int type, void* data, uint64_t sig)
 {
 	ccv_dense_matrix_t mat;
-	mat.reserved0 = 0;
+	mat.arena = 0;
 	mat.sig = sig;
 	mat.type = (CCV_GET_CHANNEL(type) | CCV_GET_DATA_TYPE(type) | CCV_MATRIX_DENSE | CCV_NO_DATA_ALLOC | CCV_UNMANAGED) & ~CCV_GARBAGE;
 	mat.rows = rows;
@@ -110,7 +406,6 @@ ccv_dense_matrix_t ccv_dense_matrix(int rows, int cols, int type, void* data, ui
 	mat.step = CCV_GET_STEP(cols, type);
 	mat.refcount = 1;
 #if CCV_NNC_TENSOR_TFB
-	mat.reserved0 = 0;
 	mat.resides = CCV_TENSOR_CPU_MEMORY;
 	mat.format = CCV_TENSOR_FORMAT_NHWC | CCV_GET_DATA_TYPE(type);
 	mat.channels = CCV_GET_CHANNEL(type);
@@ -145,7 +440,8 @@ void ccv_matrix_free_immediately(ccv_matrix_t* mat)
 	{
 		ccv_dense_matrix_t* dmt = (ccv_dense_matrix_t*)mat;
 		dmt->refcount = 0;
-		ccfree(dmt);
+		if (!dmt->arena)
+			ccfree(dmt);
 	} else if (type & CCV_MATRIX_SPARSE) {
 		ccv_sparse_matrix_t* smt = (ccv_sparse_matrix_t*)mat;
 		int i;
@@ -169,7 +465,10 @@ void ccv_matrix_free(ccv_matrix_t* mat)
 	{
 		ccv_dense_matrix_t* dmt = (ccv_dense_matrix_t*)mat;
 		dmt->refcount = 0;
-		if (!ccv_cache_opt || // e don't enable cache
+		// it will be released with the arena scope, or it is already, either way, it is not the heap's to free
+		if (dmt->arena)
+			return;
+		if (!CCV_CACHE_ENABLED || // e don't enable cache
 			!(dmt->type & CCV_REUSABLE) || // or this is not a reusable piece
 			dmt->sig == 0 || // or this doesn't have valid signature
 			(dmt->type & CCV_NO_DATA_ALLOC)) // or this matrix is allocated as header-only, therefore we cannot cache it
@@ -181,7 +480,8 @@ void ccv_matrix_free(ccv_matrix_t* mat)
 				   CCV_GET_DATA_TYPE(dmt->type) == CCV_64S ||
 				   CCV_GET_DATA_TYPE(dmt->type) == CCV_64F);
 			size_t size = ccv_compute_dense_matrix_size(dmt->rows, dmt->cols, dmt->type);
-			ccv_cache_put(&ccv_cache, dmt->sig, dmt, size, 0 /* type 0 */);
+			if (_ccv_cache_put(dmt->sig, dmt, size, 0 /* type 0 */) < 0) // the cache refused it (too large), free it now
+				ccfree(dmt);
 		}
 	} else if (type & CCV_MATRIX_SPARSE) {
 		ccv_sparse_matrix_t* smt = (ccv_sparse_matrix_t*)mat;
@@ -204,10 +504,10 @@ void ccv_matrix_free(ccv_matrix_t* mat)
 ccv_array_t* ccv_array_new(int rsize, int rnum, uint64_t sig)
 {
 	ccv_array_t* array;
-	if (ccv_cache_opt && sig != 0)
+	if (CCV_CACHE_ENABLED && sig != 0)
 	{
 		uint8_t type;
-		array = (ccv_array_t*)ccv_cache_out(&ccv_cache, sig, &type);
+		array = (ccv_array_t*)_ccv_cache_out(sig, 1 /* type 1 */, &type);
 		if (array)
 		{
 			assert(type == 1);
@@ -216,13 +516,21 @@ ccv_array_t* ccv_array_new(int rsize, int rnum, uint64_t sig)
 			return array;
 		}
 	}
-	array = (ccv_array_t*)ccmalloc(sizeof(ccv_array_t));
+	if (ccv_arena_mark)
+	{
+		array = (ccv_array_t*)_ccv_arena_alloc(sizeof(ccv_array_t));
+		array->type = 0;
+		array->arena = 1;
+	} else {
+		array = (ccv_array_t*)ccmalloc(sizeof(ccv_array_t));
+		array->type = CCV_REUSABLE & ~CCV_GARBAGE;
+		array->arena = 0;
+	}
 	array->sig = sig;
-	array->type = CCV_REUSABLE & ~CCV_GARBAGE;
 	array->rnum = 0;
 	array->rsize = rsize;
 	array->size = ccv_max(rnum, 2 /* allocate memory for at least 2 items */);
-	array->data = ccmalloc((size_t)array->size * (size_t)rsize);
+	array->data = array->arena ? _ccv_arena_alloc((size_t)array->size * (size_t)rsize) : ccmalloc((size_t)array->size * (size_t)rsize);
 	return array;
 }
 
@@ -243,20 +551,28 @@ void ccv_make_array_immutable(ccv_array_t* array)
 void ccv_array_free_immediately(ccv_array_t* array)
 {
 	array->refcount = 0;
+	if (array->arena)
+		return;
 	ccfree(array->data);
 	ccfree(array);
 }
 
 void ccv_array_free(ccv_array_t* array)
 {
-	if (!ccv_cache_opt || !(array->type & CCV_REUSABLE) || array->sig == 0)
+	if (array->arena)
+	{
+		array->refcount = 0;
+		return;
+	}
+	if (!CCV_CACHE_ENABLED || !(array->type & CCV_REUSABLE) || array->sig == 0)
 	{
 		array->refcount = 0;
 		ccfree(array->data);
 		ccfree(array);
 	} else {
 		size_t size = sizeof(ccv_array_t) + array->size * array->rsize;
-		ccv_cache_put(&ccv_cache, array->sig, array, size, 1 /* type 1 */);
+		if (_ccv_cache_put(array->sig, array, size, 1 /* type 1 */) < 0)
+			ccv_array_free_immediately(array);
 	}
 }
 
@@ -264,6 +580,10 @@ void ccv_drain_cache(void)
 {
 	if (ccv_cache.rnum > 0)
 		ccv_cache_cleanup(&ccv_cache);
+#ifdef HAVE_PTHREAD
+	if (_ccv_shared_cache_enabled())
+		_ccv_shared_cache_drain(0);
+#endif
 }
 
 void ccv_disable_cache(void)
@@ -283,6 +603,72 @@ void ccv_enable_default_cache(void)
 	ccv_enable_cache(CCV_DEFAULT_CACHE_SIZE);
 }
 
+static void _ccv_cache_stats_collect(ccv_cache_t* cache, ccv_cache_stats_t stats[2], int reset)
+{
+	int i;
+	for (i = 0; i < 2; i++)
+	{
+		stats[i].hits += cache->stats[i].hits;
+		stats[i].misses += cache->stats[i].misses;
+		stats[i].puts += cache->stats[i].puts;
+		stats[i].rejects += cache->stats[i].rejects;
+		stats[i].evictions += cache->stats[i].evictions;
+		stats[i].size += cache->stats[i].size;
+		stats[i].peak += cache->stats[i].peak;
+		if (reset)
+		{
+			const size_t size = cache->stats[i].size;
+			memset(cache->stats + i, 0, sizeof(ccv_cache_stats_t));
+			cache->stats[i].size = cache->stats[i].peak = size;
+		}
+	}
+}
+
+void ccv_cache_stats(ccv_cache_stats_t stats[2], int reset)
+{
+	memset(stats, 0, sizeof(ccv_cache_stats_t) * 2);
+	if (ccv_cache_opt)
+		_ccv_cache_stats_collect(&ccv_cache, stats, reset);
+#ifdef HAVE_PTHREAD
+	if (_ccv_shared_cache_enabled())
+	{
+		int i;
+		for (i = 0; i < CCV_CACHE_SHARDS; i++)
+		{
+			pthread_mutex_lock(&ccv_shared_cache[i].mutex);
+			_ccv_cache_stats_collect(&ccv_shared_cache[i].cache, stats, reset);
+			pthread_mutex_unlock(&ccv_shared_cache[i].mutex);
+		}
+	}
+#endif
+}
+
+void ccv_enable_shared_cache(size_t size)
+{
+#ifdef HAVE_PTHREAD
+	pthread_once(&ccv_shared_cache_once, _ccv_shared_cache_once);
+	__atomic_store_n(&ccv_shared_cache_opt, 0, __ATOMIC_RELEASE);
+	_ccv_shared_cache_drain(size);
+	__atomic_store_n(&ccv_shared_cache_opt, 1, __ATOMIC_RELEASE);
+#else
+	// without threading support, there is only one thread to share with
+	ccv_enable_cache(size);
+#endif
+}
+
+void ccv_disable_shared_cache(void)
+{
+#ifdef HAVE_PTHREAD
+	if (!_ccv_shared_cache_enabled())
+		return;
+	// a thread on its way in checks the option again with the shard locked, thus, nothing is put back after the drain
+	__atomic_store_n(&ccv_shared_cache_opt, 0, __ATOMIC_RELEASE);
+	_ccv_shared_cache_drain(0);
+#else
+	ccv_disable_cache();
+#endif
+}
+
 static uint8_t key_siphash[16] = "libccvky4siphash";
 
 uint64_t ccv_cache_generate_signature(const char* msg, int len, uint64_t sig_start, ...)
@@ -5,10 +5,61 @@
 #include <pthread.h>
 #include <fftw3.h>
 #else
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include "3rdparty/kissfft/kiss_fftndr.h"
 #include "3rdparty/kissfft/kissf_fftndr.h"
 #endif
 
+typedef struct {
+	int ch;
+	int fft_type;
+	int rows; // the FFT size
+	int cols;
+#ifdef HAVE_FFTW3
+	void* forward;
+	void* inverse;
+#else
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t mutex;
+#endif
+	void* cfgs;
+#endif
+} ccv_filter_fft_t;
+
+struct ccv_filter_plan_s {
+	int a_rows; // the image size the plan is made for
+	int a_cols;
+	int type; // the output type
+	int krows;
+	int kcols;
+	uint64_t ksig;
+	ccv_dense_matrix_t* kernel; // a copy of the kernel if it is convolved directly, thus, no FFT
+	void* spectrum; // the flipped kernel zero-padded to the tile size, in frequency domain
+	ccv_filter_fft_t fft;
+};
+
+typedef struct {
+	int krows;
+	int kcols;
+	int count;
+	int* index; // the kernels of this size in the bank
+	void** spectrum;
+	ccv_filter_fft_t fft;
+} ccv_filter_bank_group_t;
+
+struct ccv_filter_bank_s {
+	int a_rows; // the image size the bank is made for
+	int a_cols;
+	int type; // the output type
+	int count;
+	uint64_t* ksig;
+	ccv_filter_plan_t** direct; // the plan if a kernel is convolved directly, thus, no FFT
+	int group_count;
+	ccv_filter_bank_group_t* group; // the kernels of the same size share the FFT of the image
+};
+
 const ccv_minimize_param_t ccv_minimize_default_params = {
 	.interp = 0.1,
 	.extrap = 3.0,
@@ -36,6 +87,8 @@ void ccv_eigen(ccv_dense_matrix_t* a, ccv_dense_matrix_t** vector, ccv_dense_mat
 	ccv_dense_matrix_t* dvector = *vector = ccv_dense_matrix_renew(*vector, a->rows, a->cols, CCV_32F | CCV_64F | CCV_C1, type, vsig);
 	ccv_dense_matrix_t* dlambda = *lambda = ccv_dense_matrix_renew(*lambda, 1, a->cols, CCV_32F | CCV_64F | CCV_C1, type, lsig);
 	assert(CCV_GET_DATA_TYPE(dvector->type) == CCV_GET_DATA_TYPE(dlambda->type));
+	// the vectors are indexed as one array
+	assert(ccv_dense_matrix_is_packed(dvector) && ccv_dense_matrix_is_packed(dlambda));
 	ccv_object_return_if_cached(, dvector, dlambda);
 	double* ja = (double*)ccmalloc(sizeof(double) * a->rows * a->cols);
 	int i, j;
@@ -129,6 +182,8 @@ void ccv_eigen(ccv_dense_matrix_t* a, ccv_dense_matrix_t** vector, ccv_dense_mat
 
 void ccv_minimize(ccv_dense_matrix_t* x, int length, double red, ccv_minimize_f func, ccv_minimize_param_t params, void* data)
 {
+	// x is copied around as one array, with the matrices below, it cannot have padded rows
+	assert(ccv_dense_matrix_is_packed(x));
 	ccv_dense_matrix_t* df0 = ccv_dense_matrix_new(x->rows, x->cols, x->type, 0, 0);
 	ccv_zero(df0);
 	ccv_dense_matrix_t* df3 = ccv_dense_matrix_new(x->rows, x->cols, x->type, 0, 0);
@@ -582,52 +637,75 @@ static int _ccv_get_optimal_fft_size(int size)
 
 static pthread_mutex_t fftw_plan_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static void _ccv_filter_fftw(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b, ccv_dense_matrix_t* d, int padding_pattern)
+static int _ccv_filter_fft_tile_size(int a, int b)
 {
-	int ch = CCV_GET_CHANNEL(a->type);
-	int fft_type = (CCV_GET_DATA_TYPE(d->type) == CCV_8U || CCV_GET_DATA_TYPE(d->type) == CCV_32F) ? CCV_32F : CCV_64F;
-	int rows = ccv_min(a->rows + b->rows - 1, _ccv_get_optimal_fft_size(b->rows * 3));
-	int cols = ccv_min(a->cols + b->cols - 1, _ccv_get_optimal_fft_size(b->cols * 3));
-	int cols_2c = 2 * (cols / 2 + 1);
-	void* fftw_a;
-	void* fftw_b;
-	void* fftw_d;
-	fftw_plan p, pinv;
-	fftwf_plan pf, pinvf;
-	if (fft_type == CCV_32F)
+	return ccv_min(a + b - 1, _ccv_get_optimal_fft_size(b * 3));
+}
+
+// planning in FFTW is not thread-safe, the plans are created once here, and executed with the new-array interface thereafter, which is thread-safe
+static void _ccv_filter_fft_init(ccv_filter_fft_t* fft)
+{
+	const int ch = fft->ch;
+	int ndim[] = {fft->rows, fft->cols};
+	pthread_mutex_lock(&fftw_plan_mutex);
+	if (fft->fft_type == CCV_32F)
 	{
-		fftw_a = fftwf_malloc(rows * cols_2c * ch * sizeof(float));
-		fftw_b = fftwf_malloc(rows * cols_2c * ch * sizeof(float));
-		fftw_d = fftwf_malloc(rows * cols_2c * ch * sizeof(float));
-		pthread_mutex_lock(&fftw_plan_mutex);
 		if (ch == 1)
 		{
-			pf = fftwf_plan_dft_r2c_2d(rows, cols, 0, 0, FFTW_ESTIMATE);
-			pinvf = fftwf_plan_dft_c2r_2d(rows, cols, 0, 0, FFTW_ESTIMATE);
+			fft->forward = fftwf_plan_dft_r2c_2d(fft->rows, fft->cols, 0, 0, FFTW_ESTIMATE);
+			fft->inverse = fftwf_plan_dft_c2r_2d(fft->rows, fft->cols, 0, 0, FFTW_ESTIMATE);
 		} else {
-			int ndim[] = {rows, cols};
-			pf = fftwf_plan_many_dft_r2c(2, ndim, ch, 0, 0, ch, 1, 0, 0, ch, 1, FFTW_ESTIMATE);
-			pinvf = fftwf_plan_many_dft_c2r(2, ndim, ch, 0, 0, ch, 1, 0, 0, ch, 1, FFTW_ESTIMATE);
+			fft->forward = fftwf_plan_many_dft_r2c(2, ndim, ch, 0, 0, ch, 1, 0, 0, ch, 1, FFTW_ESTIMATE);
+			fft->inverse = fftwf_plan_many_dft_c2r(2, ndim, ch, 0, 0, ch, 1, 0, 0, ch, 1, FFTW_ESTIMATE);
 		}
-		pthread_mutex_unlock(&fftw_plan_mutex);
 	} else {
-		fftw_a = fftw_malloc(rows * cols_2c * ch * sizeof(double));
-		fftw_b = fftw_malloc(rows * cols_2c * ch * sizeof(double));
-		fftw_d = fftw_malloc(rows * cols_2c * ch * sizeof(double));
-		pthread_mutex_lock(&fftw_plan_mutex);
 		if (ch == 1)
 		{
-			p = fftw_plan_dft_r2c_2d(rows, cols, 0, 0, FFTW_ESTIMATE);
-			pinv = fftw_plan_dft_c2r_2d(rows, cols, 0, 0, FFTW_ESTIMATE);
+			fft->forward = fftw_plan_dft_r2c_2d(fft->rows, fft->cols, 0, 0, FFTW_ESTIMATE);
+			fft->inverse = fftw_plan_dft_c2r_2d(fft->rows, fft->cols, 0, 0, FFTW_ESTIMATE);
 		} else {
-			int ndim[] = {rows, cols};
-			p = fftw_plan_many_dft_r2c(2, ndim, ch, 0, 0, ch, 1, 0, 0, ch, 1, FFTW_ESTIMATE);
-			pinv = fftw_plan_many_dft_c2r(2, ndim, ch, 0, 0, ch, 1, 0, 0, ch, 1, FFTW_ESTIMATE);
+			fft->forward = fftw_plan_many_dft_r2c(2, ndim, ch, 0, 0, ch, 1, 0, 0, ch, 1, FFTW_ESTIMATE);
+			fft->inverse = fftw_plan_many_dft_c2r(2, ndim, ch, 0, 0, ch, 1, 0, 0, ch, 1, FFTW_ESTIMATE);
 		}
-		pthread_mutex_unlock(&fftw_plan_mutex);
 	}
-	memset(fftw_b, 0, rows * cols_2c * ch * CCV_GET_DATA_TYPE_SIZE(fft_type));
+	pthread_mutex_unlock(&fftw_plan_mutex);
+}
+
+static void _ccv_filter_fft_free(ccv_filter_fft_t* fft)
+{
+	pthread_mutex_lock(&fftw_plan_mutex);
+	if (fft->fft_type == CCV_32F)
+	{
+		fftwf_destroy_plan((fftwf_plan)fft->forward);
+		fftwf_destroy_plan((fftwf_plan)fft->inverse);
+	} else {
+		fftw_destroy_plan((fftw_plan)fft->forward);
+		fftw_destroy_plan((fftw_plan)fft->inverse);
+	}
+	pthread_mutex_unlock(&fftw_plan_mutex);
+}
+
+static void* _ccv_filter_fft_malloc(ccv_filter_fft_t* fft)
+{
+	const size_t size = fft->rows * 2 * (fft->cols / 2 + 1) * fft->ch * CCV_GET_DATA_TYPE_SIZE(fft->fft_type);
+	return (fft->fft_type == CCV_32F) ? fftwf_malloc(size) : fftw_malloc(size);
+}
+
+static void _ccv_filter_fft_spectrum_free(ccv_filter_fft_t* fft, void* spectrum)
+{
+	if (fft->fft_type == CCV_32F)
+		fftwf_free(spectrum);
+	else
+		fftw_free(spectrum);
+}
 
+// the flipped kernel zero-padded to the FFT size, in frequency domain
+static void* _ccv_filter_fft_spectrum(ccv_filter_fft_t* fft, ccv_dense_matrix_t* b)
+{
+	const int ch = fft->ch;
+	const int cols_2c = 2 * (fft->cols / 2 + 1);
+	void* fftw_b = _ccv_filter_fft_malloc(fft);
+	memset(fftw_b, 0, fft->rows * cols_2c * ch * CCV_GET_DATA_TYPE_SIZE(fft->fft_type));
 	int i, j, k;
 	unsigned char* m_ptr = b->data.u8;
 	// to flip matrix b is crucial, this problem only shows when I changed to a more sophisticated test case
@@ -641,170 +719,228 @@ static void _ccv_filter_fftw(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b, ccv_d
 		fftw_ptr -= cols_2c * ch; \
 		m_ptr += b->step; \
 	}
-	ccv_matrix_typeof(fft_type, ccv_matrix_getter, b->type, for_block);
+	ccv_matrix_typeof(fft->fft_type, ccv_matrix_getter, b->type, for_block);
 #undef for_block
-	if (fft_type == CCV_32F)
-		fftwf_execute_dft_r2c(pf, (float*)fftw_b, (fftwf_complex*)fftw_b);
+	if (fft->fft_type == CCV_32F)
+		fftwf_execute_dft_r2c((fftwf_plan)fft->forward, (float*)fftw_b, (fftwf_complex*)fftw_b);
 	else
-		fftw_execute_dft_r2c(p, (double*)fftw_b, (fftw_complex*)fftw_b);
-	/* why a->cols + cols - 2 * (b->cols & ~1) ?
-	 * what we really want is ceiling((a->cols - (b->cols & ~1)) / (cols - (b->cols & ~1)))
+		fftw_execute_dft_r2c((fftw_plan)fft->forward, (double*)fftw_b, (fftw_complex*)fftw_b);
+	return fftw_b;
+}
+
+// copy h x w from the inverse transformed tile at (sy, sx) to d at (oy, ox)
+static void _ccv_filter_fft_copy(ccv_filter_fft_t* fft, const void* fftw_d, const int sy, const int sx, ccv_dense_matrix_t* d, const int oy, const int ox, const int h, const int w)
+{
+	const int ch = fft->ch;
+	const int cols_2c = 2 * (fft->cols / 2 + 1);
+	int x, y;
+	unsigned char* m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(d, oy, ox, 0);
+#define for_block(_for_type, _for_set) \
+	const _for_type* fftw_ptr = (const _for_type*)fftw_d + (sy * cols_2c + sx) * ch; \
+	for (y = 0; y < h; y++) \
+	{ \
+		for (x = 0; x < w * ch; x++) \
+			_for_set(m_ptr, x, fftw_ptr[x], 0); \
+		m_ptr += d->step; \
+		fftw_ptr += cols_2c * ch; \
+	}
+	ccv_matrix_typeof(fft->fft_type, ccv_matrix_setter, d->type, for_block);
+#undef for_block
+}
+
+/* convolve a with count kernels of the same size, one tile at a time, each tile of a is transformed only once,
+ * and multiplied with the spectrum of each kernel in parallel */
+static void _ccv_filter_fftw(ccv_filter_fft_t* fft, const int krows, const int kcols, void** const spectrum, const int count, ccv_dense_matrix_t* a, ccv_dense_matrix_t** d)
+{
+	const int ch = fft->ch;
+	const int rows = fft->rows;
+	const int cols = fft->cols;
+	const int cols_2c = 2 * (cols / 2 + 1);
+	void* fftw_a = _ccv_filter_fft_malloc(fft);
+	void** fftw_d = (void**)alloca(sizeof(void*) * count);
+	int i, j, n;
+	for (n = 0; n < count; n++)
+		fftw_d[n] = _ccv_filter_fft_malloc(fft);
+	/* why a->cols + cols - 2 * (kcols & ~1) ?
+	 * what we really want is ceiling((a->cols - (kcols & ~1)) / (cols - (kcols & ~1)))
 	 * in this case, we strip out paddings on the left/right, and compute how many tiles
 	 * we need. It then be interpreted in the above integer division form */
-	int tile_x = ccv_max(1, (a->cols + cols - 2 * (b->cols & ~1)) / (cols - (b->cols & ~1)));
-	int tile_y = ccv_max(1, (a->rows + rows - 2 * (b->rows & ~1)) / (rows - (b->rows & ~1)));
-	int brows2 = b->rows / 2;
-	int bcols2 = b->cols / 2;
-#define for_block(_for_type, _cpx_type, _for_set, _for_get) \
-	_for_type scale = 1.0 / (rows * cols); \
-	for (i = 0; i < tile_y; i++) \
-		for (j = 0; j < tile_x; j++) \
-		{ \
-			int x, y; \
-			memset(fftw_a, 0, rows * cols_2c * ch * sizeof(_for_type)); \
-			int iy = ccv_min(i * (rows - (b->rows & ~1)), ccv_max(a->rows - rows, 0)); \
-			int ix = ccv_min(j * (cols - (b->cols & ~1)), ccv_max(a->cols - cols, 0)); \
+	const int tile_x = ccv_max(1, (a->cols + cols - 2 * (kcols & ~1)) / (cols - (kcols & ~1)));
+	const int tile_y = ccv_max(1, (a->rows + rows - 2 * (krows & ~1)) / (rows - (krows & ~1)));
+	const int brows2 = krows / 2;
+	const int bcols2 = kcols / 2;
+	for (i = 0; i < tile_y; i++)
+		for (j = 0; j < tile_x; j++)
+		{
+			int x, y;
+			const int iy = ccv_min(i * (rows - (krows & ~1)), ccv_max(a->rows - rows, 0));
+			const int ix = ccv_min(j * (cols - (kcols & ~1)), ccv_max(a->cols - cols, 0));
+			memset(fftw_a, 0, rows * cols_2c * ch * CCV_GET_DATA_TYPE_SIZE(fft->fft_type));
+			int end_y = ccv_min(rows, a->rows - iy);
+			int end_x = ccv_min(cols, a->cols - ix);
+			unsigned char* m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(a, iy, ix, 0);
+#define for_block(_for_type, _for_get) \
 			_for_type* fftw_ptr = (_for_type*)fftw_a; \
-			int end_y = ccv_min(rows, a->rows - iy); \
-			int end_x = ccv_min(cols, a->cols - ix); \
-			m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(a, iy, ix, 0); \
 			for (y = 0; y < end_y; y++) \
 			{ \
 				for (x = 0; x < end_x * ch; x++) \
 					fftw_ptr[x] = _for_get(m_ptr, x, 0); \
 				fftw_ptr += cols_2c * ch; \
 				m_ptr += a->step; \
-			} \
-			_cpx_type* fftw_ac = (_cpx_type*)fftw_a; \
-			_cpx_type* fftw_bc = (_cpx_type*)fftw_b; \
-			_cpx_type* fftw_dc = (_cpx_type*)fftw_d; \
-			fft_execute_dft_r2c((_for_type*)fftw_a, (_cpx_type*)fftw_ac); \
-			for (x = 0; x < rows * ch * (cols / 2 + 1); x++) \
-				fftw_dc[x] = (fftw_ac[x] * fftw_bc[x]) * scale; \
-			fft_execute_dft_c2r((_cpx_type*)fftw_dc, (_for_type*)fftw_d); \
-			fftw_ptr = (_for_type*)fftw_d + ((1 + (i > 0)) * brows2 * cols_2c + (1 + (j > 0)) * bcols2) * ch; \
-			end_y = ccv_min(d->rows - (iy + (i > 0) * brows2), \
-							(rows - (b->rows & ~1)) + (i == 0) * brows2); \
-			end_x = ccv_min(d->cols - (ix + (j > 0) * bcols2), \
-							(cols - (b->cols & ~1)) + (j == 0) * bcols2); \
-			m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(d, iy + (i > 0) * brows2, ix + (j > 0) * bcols2, 0); \
-			for (y = 0; y < end_y; y++) \
-			{ \
-				for (x = 0; x < end_x * ch; x++) \
-					_for_set(m_ptr, x, fftw_ptr[x], 0); \
-				m_ptr += d->step; \
-				fftw_ptr += cols_2c * ch; \
-			} \
-			int end_tile_y, end_tile_x; \
-			/* handle edge cases: */ \
-			if (i + 1 == tile_y && end_y + iy + (i > 0) * brows2 < d->rows) \
-			{ \
-				end_tile_y = ccv_min(brows2, d->rows - (iy + (i > 0) * brows2 + end_y)); \
-				fftw_ptr = (_for_type*)fftw_d + (1 + (j > 0)) * bcols2 * ch; \
-				m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(d, iy + (i > 0) * brows2 + end_y, ix + (j > 0) * bcols2, 0); \
-				for (y = 0; y < end_tile_y; y++) \
-				{ \
-					for (x = 0; x < end_x * ch; x++) \
-						_for_set(m_ptr, x, fftw_ptr[x], 0); \
-					m_ptr += d->step; \
-					fftw_ptr += cols_2c * ch; \
-				} \
-			} \
-			if (j + 1 == tile_x && end_x + ix + (j > 0) * bcols2 < d->cols) \
-			{ \
-				end_tile_x = ccv_min(bcols2, d->cols - (ix + (j > 0) * bcols2 + end_x)); \
-				fftw_ptr = (_for_type*)fftw_d + (1 + (i > 0)) * brows2 * cols_2c * ch; \
-				m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(d, iy + (i > 0) * brows2, ix + (j > 0) * bcols2 + end_x, 0); \
-				for (y = 0; y < end_y; y++) \
-				{ \
-					for (x = 0; x < end_tile_x * ch; x++) \
-						_for_set(m_ptr, x, fftw_ptr[x], 0); \
-					m_ptr += d->step; \
-					fftw_ptr += cols_2c * ch; \
-				} \
-			} \
-			if (i + 1 == tile_y && end_y + iy + (i > 0) * brows2 < d->rows && \
-				j + 1 == tile_x && end_x + ix + (j > 0) * bcols2 < d->cols) \
-			{ \
-				fftw_ptr = (_for_type*)fftw_d; \
-				m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(d, iy + (i > 0) * brows2 + end_y, ix + (j > 0) * bcols2 + end_x, 0); \
-				for (y = 0; y < end_tile_y; y++) \
-				{ \
-					for (x = 0; x < end_tile_x * ch; x++) \
-						_for_set(m_ptr, x, fftw_ptr[x], 0); \
-					m_ptr += d->step; \
-					fftw_ptr += cols_2c * ch; \
-				} \
-			} \
+			}
+			ccv_matrix_typeof(fft->fft_type, ccv_matrix_getter, a->type, for_block);
+#undef for_block
+			if (fft->fft_type == CCV_32F)
+				fftwf_execute_dft_r2c((fftwf_plan)fft->forward, (float*)fftw_a, (fftwf_complex*)fftw_a);
+			else
+				fftw_execute_dft_r2c((fftw_plan)fft->forward, (double*)fftw_a, (fftw_complex*)fftw_a);
+			// the region of this tile in the output, see the edge cases below
+			const int oy = iy + (i > 0) * brows2;
+			const int ox = ix + (j > 0) * bcols2;
+			end_y = ccv_min(a->rows - oy, (rows - (krows & ~1)) + (i == 0) * brows2);
+			end_x = ccv_min(a->cols - ox, (cols - (kcols & ~1)) + (j == 0) * bcols2);
+			const int edge_y = (i + 1 == tile_y && oy + end_y < a->rows) ? ccv_min(brows2, a->rows - (oy + end_y)) : 0;
+			const int edge_x = (j + 1 == tile_x && ox + end_x < a->cols) ? ccv_min(bcols2, a->cols - (ox + end_x)) : 0;
+			parallel_for(k, count) {
+				int z;
+				if (fft->fft_type == CCV_32F)
+				{
+					const float scale = 1.0 / (rows * cols);
+					fftwf_complex* fftw_ac = (fftwf_complex*)fftw_a;
+					fftwf_complex* fftw_bc = (fftwf_complex*)spectrum[k];
+					fftwf_complex* fftw_dc = (fftwf_complex*)fftw_d[k];
+					for (z = 0; z < rows * ch * (cols / 2 + 1); z++)
+						fftw_dc[z] = (fftw_ac[z] * fftw_bc[z]) * scale;
+					fftwf_execute_dft_c2r((fftwf_plan)fft->inverse, fftw_dc, (float*)fftw_d[k]);
+				} else {
+					const double scale = 1.0 / (rows * cols);
+					fftw_complex* fftw_ac = (fftw_complex*)fftw_a;
+					fftw_complex* fftw_bc = (fftw_complex*)spectrum[k];
+					fftw_complex* fftw_dc = (fftw_complex*)fftw_d[k];
+					for (z = 0; z < rows * ch * (cols / 2 + 1); z++)
+						fftw_dc[z] = (fftw_ac[z] * fftw_bc[z]) * scale;
+					fftw_execute_dft_c2r((fftw_plan)fft->inverse, fftw_dc, (double*)fftw_d[k]);
+				}
+				_ccv_filter_fft_copy(fft, fftw_d[k], (1 + (i > 0)) * brows2, (1 + (j > 0)) * bcols2, d[k], oy, ox, end_y, end_x);
+				/* handle edge cases: */
+				if (edge_y)
+					_ccv_filter_fft_copy(fft, fftw_d[k], 0, (1 + (j > 0)) * bcols2, d[k], oy + end_y, ox, edge_y, end_x);
+				if (edge_x)
+					_ccv_filter_fft_copy(fft, fftw_d[k], (1 + (i > 0)) * brows2, 0, d[k], oy, ox + end_x, end_y, edge_x);
+				if (edge_y && edge_x)
+					_ccv_filter_fft_copy(fft, fftw_d[k], 0, 0, d[k], oy + end_y, ox + end_x, edge_y, edge_x);
+			} parallel_endfor
 		}
-	if (fft_type == CCV_32F)
+	for (n = 0; n < count; n++)
+		_ccv_filter_fft_spectrum_free(fft, fftw_d[n]);
+	_ccv_filter_fft_spectrum_free(fft, fftw_a);
+}
+#else
+static int _ccv_filter_fft_tile_size(int a, int b)
+{
+	return ((ccv_min(a + b - 1, kiss_fftr_next_fast_size_real(b * 3)) + 1) >> 1) << 1;
+}
+
+// kissfft configurations carry scratch buffers, thus, one configuration cannot be executed from two threads at the same time. A free list of them is kept instead.
+typedef struct ccv_filter_kissfft_cfg_s {
+	void* forward;
+	void* inverse;
+	struct ccv_filter_kissfft_cfg_s* next;
+} ccv_filter_kissfft_cfg_t;
+
+static ccv_filter_kissfft_cfg_t* _ccv_filter_kissfft_cfg_get(ccv_filter_fft_t* fft)
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&fft->mutex);
+#endif
+	ccv_filter_kissfft_cfg_t* cfg = (ccv_filter_kissfft_cfg_t*)fft->cfgs;
+	if (cfg)
+		fft->cfgs = cfg->next;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&fft->mutex);
+#endif
+	if (cfg)
+		return cfg;
+	int ndim[] = {fft->rows, fft->cols};
+	cfg = (ccv_filter_kissfft_cfg_t*)ccmalloc(sizeof(ccv_filter_kissfft_cfg_t));
+	if (fft->fft_type == CCV_32F)
 	{
-#define fft_execute_dft_r2c(r, c) fftwf_execute_dft_r2c(pf, r, c)
-#define fft_execute_dft_c2r(c, r) fftwf_execute_dft_c2r(pinvf, c, r)
-		ccv_matrix_setter(d->type, ccv_matrix_getter, a->type, for_block, float, fftwf_complex);
-#undef fft_execute_dft_r2c
-#undef fft_execute_dft_c2r
-		pthread_mutex_lock(&fftw_plan_mutex);
-		fftwf_destroy_plan(pf);
-		fftwf_destroy_plan(pinvf);
-		pthread_mutex_unlock(&fftw_plan_mutex);
-		fftwf_free(fftw_a);
-		fftwf_free(fftw_b);
-		fftwf_free(fftw_d);
+		cfg->forward = kissf_fftndr_alloc(ndim, 2, 0, 0, 0);
+		cfg->inverse = kissf_fftndr_alloc(ndim, 2, 1, 0, 0);
 	} else {
-#define fft_execute_dft_r2c(r, c) fftw_execute_dft_r2c(p, r, c)
-#define fft_execute_dft_c2r(c, r) fftw_execute_dft_c2r(pinv, c, r)
-		ccv_matrix_setter(d->type, ccv_matrix_getter, a->type, for_block, double, fftw_complex);
-#undef fft_execute_dft_r2c
-#undef fft_execute_dft_c2r
-		pthread_mutex_lock(&fftw_plan_mutex);
-		fftw_destroy_plan(p);
-		fftw_destroy_plan(pinv);
-		pthread_mutex_unlock(&fftw_plan_mutex);
-		fftw_free(fftw_a);
-		fftw_free(fftw_b);
-		fftw_free(fftw_d);
+		cfg->forward = kiss_fftndr_alloc(ndim, 2, 0, 0, 0);
+		cfg->inverse = kiss_fftndr_alloc(ndim, 2, 1, 0, 0);
 	}
-#undef for_block
+	return cfg;
 }
-#else
-static void _ccv_filter_kissfft(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b, ccv_dense_matrix_t* d, int padding_pattern)
+
+static void _ccv_filter_kissfft_cfg_put(ccv_filter_fft_t* fft, ccv_filter_kissfft_cfg_t* cfg)
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&fft->mutex);
+#endif
+	cfg->next = (ccv_filter_kissfft_cfg_t*)fft->cfgs;
+	fft->cfgs = cfg;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&fft->mutex);
+#endif
+}
+
+static void _ccv_filter_fft_init(ccv_filter_fft_t* fft)
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&fft->mutex, 0);
+#endif
+	fft->cfgs = 0;
+}
+
+static void _ccv_filter_fft_free(ccv_filter_fft_t* fft)
+{
+	ccv_filter_kissfft_cfg_t* cfg = (ccv_filter_kissfft_cfg_t*)fft->cfgs;
+	while (cfg)
+	{
+		ccv_filter_kissfft_cfg_t* next = cfg->next;
+		if (fft->fft_type == CCV_32F)
+		{
+			kissf_fft_free(cfg->forward);
+			kissf_fft_free(cfg->inverse);
+		} else {
+			kiss_fft_free(cfg->forward);
+			kiss_fft_free(cfg->inverse);
+		}
+		ccfree(cfg);
+		cfg = next;
+	}
+#ifdef HAVE_PTHREAD
+	pthread_mutex_destroy(&fft->mutex);
+#endif
+}
+
+static void* _ccv_filter_fft_malloc(ccv_filter_fft_t* fft)
+{
+	return ccmalloc(fft->rows * (fft->cols / 2 + 1) * fft->ch * ((fft->fft_type == CCV_32F) ? sizeof(kissf_fft_cpx) : sizeof(kiss_fft_cpx)));
+}
+
+static void _ccv_filter_fft_spectrum_free(ccv_filter_fft_t* fft, void* spectrum)
+{
+	ccfree(spectrum);
+}
+
+// the flipped kernel zero-padded to the FFT size, in frequency domain, one channel after another
+static void* _ccv_filter_fft_spectrum(ccv_filter_fft_t* fft, ccv_dense_matrix_t* b)
 {
-	int ch = CCV_GET_CHANNEL(a->type);
-	int fft_type = (CCV_GET_DATA_TYPE(d->type) == CCV_8U || CCV_GET_DATA_TYPE(d->type) == CCV_32F) ? CCV_32F : CCV_64F;
-	int rows = ((ccv_min(a->rows + b->rows - 1, kiss_fftr_next_fast_size_real(b->rows * 3)) + 1) >> 1) << 1;
-	int cols = ((ccv_min(a->cols + b->cols - 1, kiss_fftr_next_fast_size_real(b->cols * 3)) + 1) >> 1) << 1;
-	int ndim[] = {rows, cols};
-	void* kiss_a;
+	const int ch = fft->ch;
+	const int rows = fft->rows;
+	const int cols = fft->cols;
+	ccv_filter_kissfft_cfg_t* cfg = _ccv_filter_kissfft_cfg_get(fft);
 	void* kiss_b;
-	void* kiss_d;
-	void* kiss_ac;
-	void* kiss_bc;
-	void* kiss_dc;
-	kiss_fftndr_cfg p;
-	kiss_fftndr_cfg pinv;
-	kissf_fftndr_cfg pf;
-	kissf_fftndr_cfg pinvf;
-	if (fft_type == CCV_32F)
+	void* kiss_bc = _ccv_filter_fft_malloc(fft);
+	if (fft->fft_type == CCV_32F)
 	{
-		pf = kissf_fftndr_alloc(ndim, 2, 0, 0, 0);
-		pinvf = kissf_fftndr_alloc(ndim, 2, 1, 0, 0);
-		kiss_a = ccmalloc(rows * cols * ch * sizeof(kissf_fft_scalar));
 		kiss_b = ccmalloc(rows * cols * ch * sizeof(kissf_fft_scalar));
-		kiss_d = ccmalloc(rows * cols * ch * sizeof(kissf_fft_scalar));
-		kiss_ac = ccmalloc(rows * (cols / 2 + 1) * ch * sizeof(kissf_fft_cpx));
-		kiss_bc = ccmalloc(rows * (cols / 2 + 1) * ch * sizeof(kissf_fft_cpx));
-		kiss_dc = ccmalloc(rows * (cols / 2 + 1) * ch * sizeof(kissf_fft_cpx));
 		memset(kiss_b, 0, rows * cols * ch * sizeof(kissf_fft_scalar));
 	} else {
-		p = kiss_fftndr_alloc(ndim, 2, 0, 0, 0);
-		pinv = kiss_fftndr_alloc(ndim, 2, 1, 0, 0);
-		kiss_a = ccmalloc(rows * cols * ch * sizeof(kiss_fft_scalar));
 		kiss_b = ccmalloc(rows * cols * ch * sizeof(kiss_fft_scalar));
-		kiss_d = ccmalloc(rows * cols * ch * sizeof(kiss_fft_scalar));
-		kiss_ac = ccmalloc(rows * (cols / 2 + 1) * ch * sizeof(kiss_fft_cpx));
-		kiss_bc = ccmalloc(rows * (cols / 2 + 1) * ch * sizeof(kiss_fft_cpx));
-		kiss_dc = ccmalloc(rows * (cols / 2 + 1) * ch * sizeof(kiss_fft_cpx));
 		memset(kiss_b, 0, rows * cols * ch * sizeof(kiss_fft_scalar));
 	}
 	int nch = rows * cols, nchc = rows * (cols / 2 + 1);
@@ -821,35 +957,81 @@ static void _ccv_filter_kissfft(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b, cc
 		kiss_ptr -= cols; \
 		m_ptr += b->step; \
 	}
-	ccv_matrix_typeof(fft_type, ccv_matrix_getter, b->type, for_block);
+	ccv_matrix_typeof(fft->fft_type, ccv_matrix_getter, b->type, for_block);
 #undef for_block
-	if (fft_type == CCV_32F)
+	if (fft->fft_type == CCV_32F)
 		for (k = 0; k < ch; k++)
-			kissf_fftndr(pf, (kissf_fft_scalar*)kiss_b + nch * k, (kissf_fft_cpx*)kiss_bc + nchc * k);
+			kissf_fftndr((kissf_fftndr_cfg)cfg->forward, (kissf_fft_scalar*)kiss_b + nch * k, (kissf_fft_cpx*)kiss_bc + nchc * k);
 	else
 		for (k = 0; k < ch; k++)
-			kiss_fftndr(p, (kiss_fft_scalar*)kiss_b + nch * k, (kiss_fft_cpx*)kiss_bc + nchc * k);
-	/* why a->cols + cols - 2 * (b->cols & ~1) ?
-	 * what we really want is ceiling((a->cols - (b->cols & ~1)) / (cols - (b->cols & ~1)))
+			kiss_fftndr((kiss_fftndr_cfg)cfg->forward, (kiss_fft_scalar*)kiss_b + nch * k, (kiss_fft_cpx*)kiss_bc + nchc * k);
+	_ccv_filter_kissfft_cfg_put(fft, cfg);
+	ccfree(kiss_b);
+	return kiss_bc;
+}
+
+// copy h x w from the inverse transformed tile at (sy, sx) to d at (oy, ox)
+static void _ccv_filter_fft_copy(ccv_filter_fft_t* fft, const void* kiss_d, const int sy, const int sx, ccv_dense_matrix_t* d, const int oy, const int ox, const int h, const int w)
+{
+	const int ch = fft->ch;
+	const int cols = fft->cols;
+	const int nch = fft->rows * fft->cols;
+	int x, y, k;
+	unsigned char* m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(d, oy, ox, 0);
+#define for_block(_for_type, _for_set) \
+	const _for_type* kiss_ptr = (const _for_type*)kiss_d + sy * cols + sx; \
+	for (y = 0; y < h; y++) \
+	{ \
+		for (x = 0; x < w; x++) \
+			for (k = 0; k < ch; k++) \
+				_for_set(m_ptr, x * ch + k, kiss_ptr[k * nch + x], 0); \
+		m_ptr += d->step; \
+		kiss_ptr += cols; \
+	}
+	ccv_matrix_typeof(fft->fft_type, ccv_matrix_setter, d->type, for_block);
+#undef for_block
+}
+
+/* convolve a with count kernels of the same size, one tile at a time, each tile of a is transformed only once,
+ * and multiplied with the spectrum of each kernel in parallel */
+static void _ccv_filter_kissfft(ccv_filter_fft_t* fft, const int krows, const int kcols, void** const spectrum, const int count, ccv_dense_matrix_t* a, ccv_dense_matrix_t** d)
+{
+	const int ch = fft->ch;
+	const int rows = fft->rows;
+	const int cols = fft->cols;
+	const int nch = rows * cols, nchc = rows * (cols / 2 + 1);
+	const size_t scalar_size = (fft->fft_type == CCV_32F) ? sizeof(kissf_fft_scalar) : sizeof(kiss_fft_scalar);
+	void* kiss_a = ccmalloc(rows * cols * ch * scalar_size);
+	void* kiss_ac = _ccv_filter_fft_malloc(fft);
+	void** kiss_d = (void**)alloca(sizeof(void*) * count * 2);
+	void** kiss_dc = kiss_d + count;
+	int i, j, k, n;
+	for (n = 0; n < count; n++)
+	{
+		kiss_d[n] = ccmalloc(rows * cols * ch * scalar_size);
+		kiss_dc[n] = _ccv_filter_fft_malloc(fft);
+	}
+	ccv_filter_kissfft_cfg_t* cfg = _ccv_filter_kissfft_cfg_get(fft);
+	/* why a->cols + cols - 2 * (kcols & ~1) ?
+	 * what we really want is ceiling((a->cols - (kcols & ~1)) / (cols - (kcols & ~1)))
 	 * in this case, we strip out paddings on the left/right, and compute how many tiles
 	 * we need. It then be interpreted in the above integer division form */
-	int tile_x = ccv_max(1, (a->cols + cols - 2 * (b->cols & ~1)) / (cols - (b->cols & ~1)));
-	int tile_y = ccv_max(1, (a->rows + rows - 2 * (b->rows & ~1)) / (rows - (b->rows & ~1)));
-	int brows2 = b->rows / 2;
-	int bcols2 = b->cols / 2;
-#define for_block(_for_type, _cpx_type, _for_set, _for_get) \
-	_for_type scale = 1.0 / (rows * cols); \
-	for (i = 0; i < tile_y; i++) \
-		for (j = 0; j < tile_x; j++) \
-		{ \
-			int x, y; \
-			memset(kiss_a, 0, rows * cols * ch * sizeof(_for_type)); \
-			int iy = ccv_min(i * (rows - (b->rows & ~1)), ccv_max(a->rows - rows, 0)); \
-			int ix = ccv_min(j * (cols - (b->cols & ~1)), ccv_max(a->cols - cols, 0)); \
+	const int tile_x = ccv_max(1, (a->cols + cols - 2 * (kcols & ~1)) / (cols - (kcols & ~1)));
+	const int tile_y = ccv_max(1, (a->rows + rows - 2 * (krows & ~1)) / (rows - (krows & ~1)));
+	const int brows2 = krows / 2;
+	const int bcols2 = kcols / 2;
+	for (i = 0; i < tile_y; i++)
+		for (j = 0; j < tile_x; j++)
+		{
+			int x, y;
+			const int iy = ccv_min(i * (rows - (krows & ~1)), ccv_max(a->rows - rows, 0));
+			const int ix = ccv_min(j * (cols - (kcols & ~1)), ccv_max(a->cols - cols, 0));
+			memset(kiss_a, 0, rows * cols * ch * scalar_size);
+			int end_y = ccv_min(rows, a->rows - iy);
+			int end_x = ccv_min(cols, a->cols - ix);
+			unsigned char* m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(a, iy, ix, 0);
+#define for_block(_for_type, _for_get) \
 			_for_type* kiss_ptr = (_for_type*)kiss_a; \
-			int end_y = ccv_min(rows, a->rows - iy); \
-			int end_x = ccv_min(cols, a->cols - ix); \
-			m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(a, iy, ix, 0); \
 			for (y = 0; y < end_y; y++) \
 			{ \
 				for (x = 0; x < end_x; x++) \
@@ -857,102 +1039,63 @@ static void _ccv_filter_kissfft(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b, cc
 						kiss_ptr[k * nch + x] = _for_get(m_ptr, x * ch + k, 0); \
 				kiss_ptr += cols; \
 				m_ptr += a->step; \
-			} \
-			for (k = 0; k < ch; k++) \
-				fft_ndr((_for_type*)kiss_a + nch * k, (_cpx_type*)kiss_ac + nchc * k); \
-			_cpx_type* fft_ac = (_cpx_type*)kiss_ac; \
-			_cpx_type* fft_bc = (_cpx_type*)kiss_bc; \
-			_cpx_type* fft_dc = (_cpx_type*)kiss_dc; \
-			for (x = 0; x < rows * ch * (cols / 2 + 1); x++) \
-			{ \
-				fft_dc[x].r = (fft_ac[x].r * fft_bc[x].r - fft_ac[x].i * fft_bc[x].i) * scale; \
-				fft_dc[x].i = (fft_ac[x].i * fft_bc[x].r + fft_ac[x].r * fft_bc[x].i) * scale; \
-			} \
-			for (k = 0; k < ch; k++) \
-				fft_ndri((_cpx_type*)kiss_dc + nchc * k, (_for_type*)kiss_d + nch * k); \
-			kiss_ptr = (_for_type*)kiss_d + (1 + (i > 0)) * brows2 * cols + (1 + (j > 0)) * bcols2; \
-			end_y = ccv_min(d->rows - (iy + (i > 0) * brows2), \
-							(rows - (b->rows & ~1)) + (i == 0) * brows2); \
-			end_x = ccv_min(d->cols - (ix + (j > 0) * bcols2), \
-							(cols - (b->cols & ~1)) + (j == 0) * bcols2); \
-			m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(d, iy + (i > 0) * brows2, ix + (j > 0) * bcols2, 0); \
-			for (y = 0; y < end_y; y++) \
-			{ \
-				for (x = 0; x < end_x; x++) \
-					for (k = 0; k < ch; k++) \
-						_for_set(m_ptr, x * ch + k, kiss_ptr[k * nch + x], 0); \
-				m_ptr += d->step; \
-				kiss_ptr += cols; \
-			} \
-			int end_tile_y, end_tile_x; \
-			/* handle edge cases: */ \
-			if (i + 1 == tile_y && end_y + iy + (i > 0) * brows2 < d->rows) \
-			{ \
-				end_tile_y = ccv_min(brows2, d->rows - (iy + (i > 0) * brows2 + end_y)); \
-				kiss_ptr = (_for_type*)kiss_d + (1 + (j > 0)) * bcols2; \
-				m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(d, iy + (i > 0) * brows2 + end_y, ix + (j > 0) * bcols2, 0); \
-				for (y = 0; y < end_tile_y; y++) \
-				{ \
-					for (x = 0; x < end_x; x++) \
-						for (k = 0; k < ch; k++) \
-							_for_set(m_ptr, x * ch + k, kiss_ptr[k * nch + x], 0); \
-					m_ptr += d->step; \
-					kiss_ptr += cols; \
-				} \
-			} \
-			if (j + 1 == tile_x && end_x + ix + (j > 0) * bcols2 < d->cols) \
-			{ \
-				end_tile_x = ccv_min(bcols2, d->cols - (ix + (j > 0) * bcols2 + end_x)); \
-				kiss_ptr = (_for_type*)kiss_d + (1 + (i > 0)) * brows2 * cols; \
-				m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(d, iy + (i > 0) * brows2, ix + (j > 0) * bcols2 + end_x, 0); \
-				for (y = 0; y < end_y; y++) \
-				{ \
-					for (x = 0; x < end_tile_x; x++) \
-						for (k = 0; k < ch; k++) \
-							_for_set(m_ptr, x * ch + k, kiss_ptr[k * nch + x], 0); \
-					m_ptr += d->step; \
-					kiss_ptr += cols; \
-				} \
-			} \
-			if (i + 1 == tile_y && end_y + iy + (i > 0) * brows2 < d->rows && \
-				j + 1 == tile_x && end_x + ix + (j > 0) * bcols2 < d->cols) \
-			{ \
-				kiss_ptr = (_for_type*)kiss_d; \
-				m_ptr = (unsigned char*)ccv_get_dense_matrix_cell(d, iy + (i > 0) * brows2 + end_y, ix + (j > 0) * bcols2 + end_x, 0); \
-				for (y = 0; y < end_tile_y; y++) \
+			}
+			ccv_matrix_typeof(fft->fft_type, ccv_matrix_getter, a->type, for_block);
+#undef for_block
+			if (fft->fft_type == CCV_32F)
+				for (k = 0; k < ch; k++)
+					kissf_fftndr((kissf_fftndr_cfg)cfg->forward, (kissf_fft_scalar*)kiss_a + nch * k, (kissf_fft_cpx*)kiss_ac + nchc * k);
+			else
+				for (k = 0; k < ch; k++)
+					kiss_fftndr((kiss_fftndr_cfg)cfg->forward, (kiss_fft_scalar*)kiss_a + nch * k, (kiss_fft_cpx*)kiss_ac + nchc * k);
+			// the region of this tile in the output, see the edge cases below
+			const int oy = iy + (i > 0) * brows2;
+			const int ox = ix + (j > 0) * bcols2;
+			end_y = ccv_min(a->rows - oy, (rows - (krows & ~1)) + (i == 0) * brows2);
+			end_x = ccv_min(a->cols - ox, (cols - (kcols & ~1)) + (j == 0) * bcols2);
+			const int edge_y = (i + 1 == tile_y && oy + end_y < a->rows) ? ccv_min(brows2, a->rows - (oy + end_y)) : 0;
+			const int edge_x = (j + 1 == tile_x && ox + end_x < a->cols) ? ccv_min(bcols2, a->cols - (ox + end_x)) : 0;
+			parallel_for(t, count) {
+				int z, c;
+				// the configuration of the forward transform is still in use by this thread, thus, the inverse one is taken from the free list
+				ccv_filter_kissfft_cfg_t* icfg = _ccv_filter_kissfft_cfg_get(fft);
+#define for_block(_for_type, _cpx_type, _fft_ndri) \
+				const _for_type scale = 1.0 / (rows * cols); \
+				_cpx_type* fft_ac = (_cpx_type*)kiss_ac; \
+				_cpx_type* fft_bc = (_cpx_type*)spectrum[t]; \
+				_cpx_type* fft_dc = (_cpx_type*)kiss_dc[t]; \
+				for (z = 0; z < rows * ch * (cols / 2 + 1); z++) \
 				{ \
-					for (x = 0; x < end_tile_x; x++) \
-						for (k = 0; k < ch; k++) \
-							_for_set(m_ptr, x * ch + k, kiss_ptr[k * nch + x], 0); \
-					m_ptr += d->step; \
-					kiss_ptr += cols; \
+					fft_dc[z].r = (fft_ac[z].r * fft_bc[z].r - fft_ac[z].i * fft_bc[z].i) * scale; \
+					fft_dc[z].i = (fft_ac[z].i * fft_bc[z].r + fft_ac[z].r * fft_bc[z].i) * scale; \
 				} \
-			} \
+				for (c = 0; c < ch; c++) \
+					_fft_ndri(icfg->inverse, fft_dc + nchc * c, (_for_type*)kiss_d[t] + nch * c);
+				if (fft->fft_type == CCV_32F)
+				{
+					for_block(kissf_fft_scalar, kissf_fft_cpx, kissf_fftndri);
+				} else {
+					for_block(kiss_fft_scalar, kiss_fft_cpx, kiss_fftndri);
+				}
+#undef for_block
+				_ccv_filter_kissfft_cfg_put(fft, icfg);
+				_ccv_filter_fft_copy(fft, kiss_d[t], (1 + (i > 0)) * brows2, (1 + (j > 0)) * bcols2, d[t], oy, ox, end_y, end_x);
+				/* handle edge cases: */
+				if (edge_y)
+					_ccv_filter_fft_copy(fft, kiss_d[t], 0, (1 + (j > 0)) * bcols2, d[t], oy + end_y, ox, edge_y, end_x);
+				if (edge_x)
+					_ccv_filter_fft_copy(fft, kiss_d[t], (1 + (i > 0)) * brows2, 0, d[t], oy, ox + end_x, end_y, edge_x);
+				if (edge_y && edge_x)
+					_ccv_filter_fft_copy(fft, kiss_d[t], 0, 0, d[t], oy + end_y, ox + end_x, edge_y, edge_x);
+			} parallel_endfor
 		}
-	if (fft_type == CCV_32F)
+	_ccv_filter_kissfft_cfg_put(fft, cfg);
+	for (n = 0; n < count; n++)
 	{
-#define fft_ndr(r, c) kissf_fftndr(pf, r, c)
-#define fft_ndri(c, r) kissf_fftndri(pinvf, c, r)
-		ccv_matrix_setter(d->type, ccv_matrix_getter, a->type, for_block, kissf_fft_scalar, kissf_fft_cpx);
-#undef fft_ndr
-#undef fft_ndri
-		kissf_fft_free(pf);
-		kissf_fft_free(pinvf);
-	} else {
-#define fft_ndr(r, c) kiss_fftndr(p, r, c)
-#define fft_ndri(c, r) kiss_fftndri(pinv, c, r)
-		ccv_matrix_setter(d->type, ccv_matrix_getter, a->type, for_block, kiss_fft_scalar, kiss_fft_cpx);
-#undef fft_ndr
-#undef fft_ndri
-		kiss_fft_free(p);
-		kiss_fft_free(pinv);
+		ccfree(kiss_d[n]);
+		ccfree(kiss_dc[n]);
 	}
-#undef for_block
-	ccfree(kiss_dc);
-	ccfree(kiss_bc);
 	ccfree(kiss_ac);
-	ccfree(kiss_d);
-	ccfree(kiss_b);
 	ccfree(kiss_a);
 }
 #endif
@@ -1033,13 +1176,19 @@ static void _ccv_filter_direct_8u(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b,
 	ccfree(cy);
 }
 
-void ccv_filter(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b, ccv_dense_matrix_t** d, int type, int padding_pattern)
+ccv_filter_plan_t* ccv_filter_plan_new(ccv_dense_matrix_t* b, int rows, int cols, int atype, int type)
 {
-	ccv_declare_derived_signature(sig, a->sig != 0 && b->sig != 0, ccv_sign_with_literal("ccv_filter"), a->sig, b->sig, CCV_EOF_SIGN);
-	type = (type == 0) ? CCV_GET_DATA_TYPE(a->type) | CCV_GET_CHANNEL(a->type) : CCV_GET_DATA_TYPE(type) | CCV_GET_CHANNEL(a->type);
-	ccv_dense_matrix_t* dd = *d = ccv_dense_matrix_renew(*d, a->rows, a->cols, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), type, sig);
-	ccv_object_return_if_cached(, dd);
-
+	ccv_filter_plan_t* plan = (ccv_filter_plan_t*)ccmalloc(sizeof(ccv_filter_plan_t));
+	plan->a_rows = rows;
+	plan->a_cols = cols;
+	plan->fft.ch = CCV_GET_CHANNEL(atype);
+	plan->type = (type == 0) ? CCV_GET_DATA_TYPE(atype) | plan->fft.ch : CCV_GET_DATA_TYPE(type) | plan->fft.ch;
+	plan->fft.fft_type = (CCV_GET_DATA_TYPE(plan->type) == CCV_8U || CCV_GET_DATA_TYPE(plan->type) == CCV_32F) ? CCV_32F : CCV_64F;
+	plan->krows = b->rows;
+	plan->kcols = b->cols;
+	plan->ksig = b->sig;
+	plan->kernel = 0;
+	plan->spectrum = 0;
 	/* 15 is the constant to indicate the high cost of FFT (even with O(nlog(m)) for
 	 * integer image.
 	 * NOTE: FFT has time complexity of O(nlog(n)), however, for convolution, it
@@ -1048,18 +1197,191 @@ void ccv_filter(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b, ccv_dense_matrix_t
 	 * to do FFT for the whole image. The image can be divided to n/m part, and
 	 * the FFT itself is O(mlog(m)), so, the convolution process has time complexity
 	 * of O(nlog(m)) */
-	if ((b->rows * b->cols < (log((double)(b->rows * b->cols)) + 1) * 15) && (a->type & CCV_8U))
+	if ((b->rows * b->cols < (log((double)(b->rows * b->cols)) + 1) * 15) && (atype & CCV_8U))
 	{
-		_ccv_filter_direct_8u(a, b, dd, padding_pattern);
+		plan->kernel = ccv_dense_matrix_new(b->rows, b->cols, b->type, 0, 0);
+		ccv_dense_matrix_copy_rows(b, plan->kernel);
 	} else {
+		plan->fft.rows = _ccv_filter_fft_tile_size(rows, b->rows);
+		plan->fft.cols = _ccv_filter_fft_tile_size(cols, b->cols);
+		_ccv_filter_fft_init(&plan->fft);
+		plan->spectrum = _ccv_filter_fft_spectrum(&plan->fft, b);
+	}
+	return plan;
+}
+
+static void _ccv_filter_plan_execute(ccv_filter_plan_t* plan, ccv_dense_matrix_t* a, ccv_dense_matrix_t* d, int padding_pattern)
+{
+	if (plan->kernel)
+		_ccv_filter_direct_8u(a, plan->kernel, d, padding_pattern);
+	else {
+#ifdef HAVE_FFTW3
+		_ccv_filter_fftw(&plan->fft, plan->krows, plan->kcols, &plan->spectrum, 1, a, &d);
+#else
+		_ccv_filter_kissfft(&plan->fft, plan->krows, plan->kcols, &plan->spectrum, 1, a, &d);
+#endif
+	}
+}
+
+void ccv_filter_plan_execute(ccv_filter_plan_t* plan, ccv_dense_matrix_t* a, ccv_dense_matrix_t** d, int padding_pattern)
+{
+	assert(a->rows == plan->a_rows && a->cols == plan->a_cols && CCV_GET_CHANNEL(a->type) == plan->fft.ch);
+	ccv_declare_derived_signature(sig, a->sig != 0 && plan->ksig != 0, ccv_sign_with_literal("ccv_filter"), a->sig, plan->ksig, CCV_EOF_SIGN);
+	ccv_dense_matrix_t* dd = *d = ccv_dense_matrix_renew(*d, a->rows, a->cols, CCV_ALL_DATA_TYPE | plan->fft.ch, plan->type, sig);
+	ccv_object_return_if_cached(, dd);
+	_ccv_filter_plan_execute(plan, a, dd, padding_pattern);
+}
+
+void ccv_filter_plan_free(ccv_filter_plan_t* plan)
+{
+	if (plan->kernel)
+		ccv_matrix_free(plan->kernel);
+	else {
+		_ccv_filter_fft_spectrum_free(&plan->fft, plan->spectrum);
+		_ccv_filter_fft_free(&plan->fft);
+	}
+	ccfree(plan);
+}
+
+ccv_filter_bank_t* ccv_filter_bank_new(ccv_dense_matrix_t** b, int count, int rows, int cols, int atype, int type)
+{
+	assert(count > 0);
+	ccv_filter_bank_t* bank = (ccv_filter_bank_t*)ccmalloc(sizeof(ccv_filter_bank_t) + (sizeof(uint64_t) + sizeof(ccv_filter_plan_t*) + sizeof(ccv_filter_bank_group_t) + sizeof(int) + sizeof(void*)) * count);
+	bank->ksig = (uint64_t*)(bank + 1);
+	bank->direct = (ccv_filter_plan_t**)(bank->ksig + count);
+	bank->group = (ccv_filter_bank_group_t*)(bank->direct + count);
+	void** spectrum = (void**)(bank->group + count);
+	int* index = (int*)(spectrum + count);
+	bank->a_rows = rows;
+	bank->a_cols = cols;
+	bank->count = count;
+	const int ch = CCV_GET_CHANNEL(atype);
+	bank->type = (type == 0) ? CCV_GET_DATA_TYPE(atype) | ch : CCV_GET_DATA_TYPE(type) | ch;
+	bank->group_count = 0;
+	int i, j;
+	for (i = 0; i < count; i++)
+	{
+		assert(CCV_GET_CHANNEL(b[i]->type) == ch);
+		bank->ksig[i] = b[i]->sig;
+		bank->direct[i] = 0;
+		// the same condition as ccv_filter_plan_new, these small kernels are not worth the FFT
+		if ((b[i]->rows * b[i]->cols < (log((double)(b[i]->rows * b[i]->cols)) + 1) * 15) && (atype & CCV_8U))
+		{
+			bank->direct[i] = ccv_filter_plan_new(b[i], rows, cols, atype, type);
+			continue;
+		}
+		for (j = 0; j < bank->group_count; j++)
+			if (bank->group[j].krows == b[i]->rows && bank->group[j].kcols == b[i]->cols)
+				break;
+		if (j == bank->group_count)
+		{
+			ccv_filter_bank_group_t* group = bank->group + bank->group_count;
+			group->krows = b[i]->rows;
+			group->kcols = b[i]->cols;
+			group->count = 0;
+			++bank->group_count;
+		}
+		++bank->group[j].count;
+	}
+	// lay out the index and the spectrum of each group consecutively
+	for (i = 0, j = 0; i < bank->group_count; i++)
+	{
+		ccv_filter_bank_group_t* group = bank->group + i;
+		group->index = index + j;
+		group->spectrum = spectrum + j;
+		j += group->count;
+		group->count = 0;
+		group->fft.ch = ch;
+		group->fft.fft_type = (CCV_GET_DATA_TYPE(bank->type) == CCV_8U || CCV_GET_DATA_TYPE(bank->type) == CCV_32F) ? CCV_32F : CCV_64F;
+		group->fft.rows = _ccv_filter_fft_tile_size(rows, group->krows);
+		group->fft.cols = _ccv_filter_fft_tile_size(cols, group->kcols);
+		_ccv_filter_fft_init(&group->fft);
+	}
+	for (i = 0; i < count; i++)
+		if (!bank->direct[i])
+			for (j = 0; j < bank->group_count; j++)
+				if (bank->group[j].krows == b[i]->rows && bank->group[j].kcols == b[i]->cols)
+				{
+					bank->group[j].index[bank->group[j].count++] = i;
+					break;
+				}
+	for (i = 0; i < bank->group_count; i++)
+	{
+		ccv_filter_bank_group_t* group = bank->group + i;
+		parallel_for(k, group->count) {
+			group->spectrum[k] = _ccv_filter_fft_spectrum(&group->fft, b[group->index[k]]);
+		} parallel_endfor
+	}
+	return bank;
+}
+
+void ccv_filter_bank_execute(ccv_filter_bank_t* bank, ccv_dense_matrix_t* a, ccv_dense_matrix_t** d, int padding_pattern)
+{
+	assert(a->rows == bank->a_rows && a->cols == bank->a_cols && CCV_GET_CHANNEL(a->type) == CCV_GET_CHANNEL(bank->type));
+	int i, cached = 1;
+	for (i = 0; i < bank->count; i++)
+	{
+		ccv_declare_derived_signature(sig, a->sig != 0 && bank->ksig[i] != 0, ccv_sign_with_literal("ccv_filter"), a->sig, bank->ksig[i], CCV_EOF_SIGN);
+		d[i] = ccv_dense_matrix_renew(d[i], a->rows, a->cols, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(bank->type), bank->type, sig);
+		// a kernel's output revived from the cache is computed again unless all of them are cached
+		cached = cached && (d[i]->type & CCV_GARBAGE);
+		d[i]->type &= ~CCV_GARBAGE;
+	}
+	if (cached)
+		return;
+	parallel_for(k, bank->count) {
+		if (bank->direct[k])
+			_ccv_filter_plan_execute(bank->direct[k], a, d[k], padding_pattern);
+	} parallel_endfor
+	ccv_dense_matrix_t** dd = (ccv_dense_matrix_t**)alloca(sizeof(ccv_dense_matrix_t*) * bank->count);
+	for (i = 0; i < bank->group_count; i++)
+	{
+		ccv_filter_bank_group_t* group = bank->group + i;
+		int j;
+		for (j = 0; j < group->count; j++)
+			dd[j] = d[group->index[j]];
 #ifdef HAVE_FFTW3
-		_ccv_filter_fftw(a, b, dd, padding_pattern);
+		_ccv_filter_fftw(&group->fft, group->krows, group->kcols, group->spectrum, group->count, a, dd);
 #else
-		_ccv_filter_kissfft(a, b, dd, padding_pattern);
+		_ccv_filter_kissfft(&group->fft, group->krows, group->kcols, group->spectrum, group->count, a, dd);
 #endif
 	}
 }
 
+void ccv_filter_bank_free(ccv_filter_bank_t* bank)
+{
+	int i, j;
+	for (i = 0; i < bank->count; i++)
+		if (bank->direct[i])
+			ccv_filter_plan_free(bank->direct[i]);
+	for (i = 0; i < bank->group_count; i++)
+	{
+		ccv_filter_bank_group_t* group = bank->group + i;
+		for (j = 0; j < group->count; j++)
+			_ccv_filter_fft_spectrum_free(&group->fft, group->spectrum[j]);
+		_ccv_filter_fft_free(&group->fft);
+	}
+	ccfree(bank);
+}
+
+void ccv_filter_bank(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int count, ccv_dense_matrix_t** d, int type, int padding_pattern)
+{
+	ccv_filter_bank_t* bank = ccv_filter_bank_new(b, count, a->rows, a->cols, a->type, type);
+	ccv_filter_bank_execute(bank, a, d, padding_pattern);
+	ccv_filter_bank_free(bank);
+}
+
+void ccv_filter(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b, ccv_dense_matrix_t** d, int type, int padding_pattern)
+{
+	ccv_declare_derived_signature(sig, a->sig != 0 && b->sig != 0, ccv_sign_with_literal("ccv_filter"), a->sig, b->sig, CCV_EOF_SIGN);
+	type = (type == 0) ? CCV_GET_DATA_TYPE(a->type) | CCV_GET_CHANNEL(a->type) : CCV_GET_DATA_TYPE(type) | CCV_GET_CHANNEL(a->type);
+	ccv_dense_matrix_t* dd = *d = ccv_dense_matrix_renew(*d, a->rows, a->cols, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), type, sig);
+	ccv_object_return_if_cached(, dd);
+	ccv_filter_plan_t* plan = ccv_filter_plan_new(b, a->rows, a->cols, a->type, dd->type);
+	_ccv_filter_plan_execute(plan, a, dd, padding_pattern);
+	ccv_filter_plan_free(plan);
+}
+
 void ccv_filter_kernel(ccv_dense_matrix_t* x, ccv_filter_kernel_f func, void* data)
 {
 	int i, j, k, ch = CCV_GET_CHANNEL(x->type);
@@ -1082,166 +1404,160 @@ void ccv_filter_kernel(ccv_dense_matrix_t* x, ccv_filter_kernel_f func, void* da
 	ccv_make_matrix_immutable(x);
 }
 
-void ccv_distance_transform(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, ccv_dense_matrix_t** x, int x_type, ccv_dense_matrix_t** y, int y_type, double dx, double dy, double dxx, double dyy, int flag)
+#define CCV_DISTANCE_TRANSFORM_BLOCK (16)
+
+/* the 1-d lower envelope passes over rows, and then over columns, are independent from each other, thus, they are run
+ * in parallel, a block of rows or columns at a time */
+static void _ccv_distance_transform(ccv_dense_matrix_t* a, ccv_dense_matrix_t* db, ccv_dense_matrix_t* mx, ccv_dense_matrix_t* my, double dx, double dy, double dxx, double dyy, int flag)
 {
-	assert(!(flag & CCV_L2_NORM) && (flag & CCV_GSEDT));
-	ccv_declare_derived_signature(sig, a->sig != 0, ccv_sign_with_format(64, "ccv_distance_transform(%la,%la,%la,%la,%d)", dx, dy, dxx, dyy, flag), a->sig, CCV_EOF_SIGN);
-	type = (CCV_GET_DATA_TYPE(type) == CCV_64F || CCV_GET_DATA_TYPE(a->type) == CCV_64F || CCV_GET_DATA_TYPE(a->type) == CCV_64S) ? CCV_GET_CHANNEL(a->type) | CCV_64F : CCV_GET_CHANNEL(a->type) | CCV_32F;
-	ccv_dense_matrix_t* db = *b = ccv_dense_matrix_renew(*b, a->rows, a->cols, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), type, sig);
-	ccv_dense_matrix_t* mx = 0;
-	ccv_dense_matrix_t* my = 0;
-	if (x != 0)
-	{
-		ccv_declare_derived_signature(xsig, a->sig != 0, ccv_sign_with_format(64, "ccv_distance_transform_x(%la,%la,%la,%la,%d)", dx, dy, dxx, dyy, flag), a->sig, CCV_EOF_SIGN);
-		mx = *x = ccv_dense_matrix_renew(*x, a->rows, a->cols, CCV_32S | CCV_C1, CCV_32S | CCV_C1, xsig);
-	}
-	if (y != 0)
-	{
-		ccv_declare_derived_signature(ysig, a->sig != 0, ccv_sign_with_format(64, "ccv_distance_transform_y(%la,%la,%la,%la,%d)", dx, dy, dxx, dyy, flag), a->sig, CCV_EOF_SIGN);
-		my = *y = ccv_dense_matrix_renew(*y, a->rows, a->cols, CCV_32S | CCV_C1, CCV_32S | CCV_C1, ysig);
-	}
-	ccv_object_return_if_cached(, db, mx, my);
-	ccv_revive_object_if_cached(db, mx, my);
-	int i, j, k;
-	unsigned char* a_ptr = a->data.u8;
-	unsigned char* b_ptr = db->data.u8;
-	int* v = (int*)alloca(sizeof(int) * ccv_max(db->rows, db->cols));
-	unsigned char* c_ptr = (unsigned char*)alloca(CCV_GET_DATA_TYPE_SIZE(db->type) * db->rows);
-	int* x_ptr = mx ? mx->data.i32 : 0;
-	int* y_ptr = my ? my->data.i32 : 0;
+	const int size = ccv_max(db->rows, db->cols);
 #define for_block(_for_max, _for_type_b, _for_set_b, _for_get_b, _for_get_a) \
 	_for_type_b _dx = dx, _dy = dy, _dxx = dxx, _dyy = dyy; \
-	_for_type_b* z = (_for_type_b*)alloca(sizeof(_for_type_b) * (ccv_max(db->rows, db->cols) + 1)); \
 	if (_dxx > 1e-6) \
 	{ \
-		for (i = 0; i < a->rows; i++) \
-		{ \
-			k = 0; \
-			v[0] = 0; \
-			z[0] = (_for_type_b)-_for_max; \
-			z[1] = (_for_type_b)_for_max; \
-			for (j = 1; j < a->cols; j++) \
-			{ \
-				_for_type_b s; \
-				for (;;) \
-				{ \
-					assert(k >= 0 && k < ccv_max(db->rows, db->cols)); \
-					s = ((SGN _for_get_a(a_ptr, j, 0) + _dxx * j * j - _dx * j) - (SGN _for_get_a(a_ptr, v[k], 0) + _dxx * v[k] * v[k] - _dx * v[k])) / (2.0 * _dxx * (j - v[k])); \
-					if (s > z[k]) break; \
-					--k; \
-				} \
-				++k; \
-				assert(k >= 0 && k < ccv_max(db->rows, db->cols)); \
-				v[k] = j; \
-				z[k] = s; \
-				z[k + 1] = (_for_type_b)_for_max; \
-			} \
-			assert(z[k + 1] >= a->cols - 1); \
-			k = 0; \
-			if (mx) \
+		parallel_for(t, (a->rows + CCV_DISTANCE_TRANSFORM_BLOCK - 1) / CCV_DISTANCE_TRANSFORM_BLOCK) { \
+			int i, j, k; \
+			_for_type_b* z = (_for_type_b*)ccmalloc(sizeof(_for_type_b) * (size + 1) + sizeof(int) * size); \
+			int* v = (int*)(z + size + 1); \
+			const int end = ccv_min(a->rows, (t + 1) * CCV_DISTANCE_TRANSFORM_BLOCK); \
+			for (i = t * CCV_DISTANCE_TRANSFORM_BLOCK; i < end; i++) \
 			{ \
-				for (j = 0; j < a->cols; j++) \
+				unsigned char* a_ptr = a->data.u8 + i * a->step; \
+				unsigned char* b_ptr = db->data.u8 + i * db->step; \
+				k = 0; \
+				v[0] = 0; \
+				z[0] = (_for_type_b)-_for_max; \
+				z[1] = (_for_type_b)_for_max; \
+				for (j = 1; j < a->cols; j++) \
 				{ \
-					while (z[k + 1] < j) \
+					_for_type_b s; \
+					for (;;) \
 					{ \
-						assert(k >= 0 && k < ccv_max(db->rows, db->cols) - 1); \
-						++k; \
+						assert(k >= 0 && k < size); \
+						s = ((SGN _for_get_a(a_ptr, j, 0) + _dxx * j * j - _dx * j) - (SGN _for_get_a(a_ptr, v[k], 0) + _dxx * v[k] * v[k] - _dx * v[k])) / (2.0 * _dxx * (j - v[k])); \
+						if (s > z[k]) break; \
+						--k; \
 					} \
-					_for_set_b(b_ptr, j, _dx * (j - v[k]) + _dxx * (j - v[k]) * (j - v[k]) SGN _for_get_a(a_ptr, v[k], 0), 0); \
-					x_ptr[j] = j - v[k]; \
+					++k; \
+					assert(k >= 0 && k < size); \
+					v[k] = j; \
+					z[k] = s; \
+					z[k + 1] = (_for_type_b)_for_max; \
 				} \
-				x_ptr += mx->cols; \
-			} else { \
-				for (j = 0; j < a->cols; j++) \
+				assert(z[k + 1] >= a->cols - 1); \
+				k = 0; \
+				if (mx) \
 				{ \
-					while (z[k + 1] < j) \
+					int* x_ptr = mx->data.i32 + i * mx->cols; \
+					for (j = 0; j < a->cols; j++) \
 					{ \
-						assert(k >= 0 && k < ccv_max(db->rows, db->cols) - 1); \
-						++k; \
+						while (z[k + 1] < j) \
+						{ \
+							assert(k >= 0 && k < size - 1); \
+							++k; \
+						} \
+						_for_set_b(b_ptr, j, _dx * (j - v[k]) + _dxx * (j - v[k]) * (j - v[k]) SGN _for_get_a(a_ptr, v[k], 0), 0); \
+						x_ptr[j] = j - v[k]; \
+					} \
+				} else { \
+					for (j = 0; j < a->cols; j++) \
+					{ \
+						while (z[k + 1] < j) \
+						{ \
+							assert(k >= 0 && k < size - 1); \
+							++k; \
+						} \
+						_for_set_b(b_ptr, j, _dx * (j - v[k]) + _dxx * (j - v[k]) * (j - v[k]) SGN _for_get_a(a_ptr, v[k], 0), 0); \
 					} \
-					_for_set_b(b_ptr, j, _dx * (j - v[k]) + _dxx * (j - v[k]) * (j - v[k]) SGN _for_get_a(a_ptr, v[k], 0), 0); \
 				} \
 			} \
-			a_ptr += a->step; \
-			b_ptr += db->step; \
-		} \
+			ccfree(z); \
+		} parallel_endfor \
 	} else { /* above algorithm cannot handle dxx == 0 properly, below is special casing for that */ \
 		assert(mx == 0); \
-		for (i = 0; i < a->rows; i++) \
-		{ \
+		parallel_for(i, a->rows) { \
+			int j; \
+			unsigned char* a_ptr = a->data.u8 + i * a->step; \
+			unsigned char* b_ptr = db->data.u8 + i * db->step; \
 			for (j = 0; j < a->cols; j++) \
 				_for_set_b(b_ptr, j, SGN _for_get_a(a_ptr, j, 0), 0); \
 			for (j = 1; j < a->cols; j++) \
 				_for_set_b(b_ptr, j, ccv_min(_for_get_b(b_ptr, j, 0), _for_get_b(b_ptr, j - 1, 0) + _dx), 0); \
 			for (j = a->cols - 2; j >= 0; j--) \
 				_for_set_b(b_ptr, j, ccv_min(_for_get_b(b_ptr, j, 0), _for_get_b(b_ptr, j + 1, 0) - _dx), 0); \
-			a_ptr += a->step; \
-			b_ptr += db->step; \
-		} \
+		} parallel_endfor \
 	} \
-	b_ptr = db->data.u8; \
+	unsigned char* b_ptr = db->data.u8; \
 	if (_dyy > 1e-6) \
 	{ \
-		for (j = 0; j < db->cols; j++) \
-		{ \
-			for (i = 0; i < db->rows; i++) \
-				_for_set_b(c_ptr, i, _for_get_b(b_ptr + i * db->step, j, 0), 0); \
-			k = 0; \
-			v[0] = 0; \
-			z[0] = (_for_type_b)-_for_max; \
-			z[1] = (_for_type_b)_for_max; \
-			for (i = 1; i < db->rows; i++) \
-			{ \
-				_for_type_b s; \
-				for (;;) \
-				{ \
-					assert(k >= 0 && k < ccv_max(db->rows, db->cols)); \
-					s = ((_for_get_b(c_ptr, i, 0) + _dyy * i * i - _dy * i) - (_for_get_b(c_ptr, v[k], 0) + _dyy * v[k] * v[k] - _dy * v[k])) / (2.0 * _dyy * (i - v[k])); \
-					if (s > z[k]) break; \
-					--k; \
-				} \
-				++k; \
-				assert(k >= 0 && k < ccv_max(db->rows, db->cols)); \
-				v[k] = i; \
-				z[k] = s; \
-				z[k + 1] = (_for_type_b)_for_max; \
-			} \
-			assert(z[k + 1] >= db->rows - 1); \
-			k = 0; \
-			if (my) \
+		parallel_for(t, (db->cols + CCV_DISTANCE_TRANSFORM_BLOCK - 1) / CCV_DISTANCE_TRANSFORM_BLOCK) { \
+			int i, j, k; \
+			_for_type_b* z = (_for_type_b*)ccmalloc(sizeof(_for_type_b) * (size + 1 + db->rows) + sizeof(int) * size); \
+			unsigned char* c_ptr = (unsigned char*)(z + size + 1); \
+			int* v = (int*)(z + size + 1 + db->rows); \
+			const int end = ccv_min(db->cols, (t + 1) * CCV_DISTANCE_TRANSFORM_BLOCK); \
+			for (j = t * CCV_DISTANCE_TRANSFORM_BLOCK; j < end; j++) \
 			{ \
 				for (i = 0; i < db->rows; i++) \
+					_for_set_b(c_ptr, i, _for_get_b(b_ptr + i * db->step, j, 0), 0); \
+				k = 0; \
+				v[0] = 0; \
+				z[0] = (_for_type_b)-_for_max; \
+				z[1] = (_for_type_b)_for_max; \
+				for (i = 1; i < db->rows; i++) \
 				{ \
-					while (z[k + 1] < i) \
+					_for_type_b s; \
+					for (;;) \
 					{ \
-						assert(k >= 0 && k < ccv_max(db->rows, db->cols) - 1); \
-						++k; \
+						assert(k >= 0 && k < size); \
+						s = ((_for_get_b(c_ptr, i, 0) + _dyy * i * i - _dy * i) - (_for_get_b(c_ptr, v[k], 0) + _dyy * v[k] * v[k] - _dy * v[k])) / (2.0 * _dyy * (i - v[k])); \
+						if (s > z[k]) break; \
+						--k; \
 					} \
-					_for_set_b(b_ptr + i * db->step, j, _dy * (i - v[k]) + _dyy * (i - v[k]) * (i - v[k]) + _for_get_b(c_ptr, v[k], 0), 0); \
-					y_ptr[i * my->cols] = i - v[k]; \
+					++k; \
+					assert(k >= 0 && k < size); \
+					v[k] = i; \
+					z[k] = s; \
+					z[k + 1] = (_for_type_b)_for_max; \
 				} \
-				++y_ptr; \
-			} else { \
-				for (i = 0; i < db->rows; i++) \
+				assert(z[k + 1] >= db->rows - 1); \
+				k = 0; \
+				if (my) \
 				{ \
-					while (z[k + 1] < i) \
+					int* y_ptr = my->data.i32 + j; \
+					for (i = 0; i < db->rows; i++) \
 					{ \
-						assert(k >= 0 && k < ccv_max(db->rows, db->cols) - 1); \
-						++k; \
+						while (z[k + 1] < i) \
+						{ \
+							assert(k >= 0 && k < size - 1); \
+							++k; \
+						} \
+						_for_set_b(b_ptr + i * db->step, j, _dy * (i - v[k]) + _dyy * (i - v[k]) * (i - v[k]) + _for_get_b(c_ptr, v[k], 0), 0); \
+						y_ptr[i * my->cols] = i - v[k]; \
+					} \
+				} else { \
+					for (i = 0; i < db->rows; i++) \
+					{ \
+						while (z[k + 1] < i) \
+						{ \
+							assert(k >= 0 && k < size - 1); \
+							++k; \
+						} \
+						_for_set_b(b_ptr + i * db->step, j, _dy * (i - v[k]) + _dyy * (i - v[k]) * (i - v[k]) + _for_get_b(c_ptr, v[k], 0), 0); \
 					} \
-					_for_set_b(b_ptr + i * db->step, j, _dy * (i - v[k]) + _dyy * (i - v[k]) * (i - v[k]) + _for_get_b(c_ptr, v[k], 0), 0); \
 				} \
 			} \
-		} \
+			ccfree(z); \
+		} parallel_endfor \
 	} else { \
 		assert(my == 0); \
-		for (j = 0; j < db->cols; j++) \
-		{ \
+		parallel_for(j, db->cols) { \
+			int i; \
 			for (i = 1; i < db->rows; i++) \
 				_for_set_b(b_ptr + i * db->step, j, ccv_min(_for_get_b(b_ptr + i * db->step, j, 0), _for_get_b(b_ptr + (i - 1) * db->step, j, 0) + _dy), 0); \
 			for (i = db->rows - 2; i >= 0; i--) \
 				_for_set_b(b_ptr + i * db->step, j, ccv_min(_for_get_b(b_ptr + i * db->step, j, 0), _for_get_b(b_ptr + (i + 1) * db->step, j, 0) - _dy), 0); \
-		} \
+		} parallel_endfor \
 	}
 	if (flag & CCV_NEGATIVE)
 	{
@@ -1265,3 +1581,48 @@ void ccv_distance_transform(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int t
 	}
 #undef for_block
 }
+
+// returns 1 if all the outputs are cached, thus, nothing needs to be computed
+static int _ccv_distance_transform_renew(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, ccv_dense_matrix_t** x, ccv_dense_matrix_t** y, double dx, double dy, double dxx, double dyy, int flag)
+{
+	ccv_declare_derived_signature(sig, a->sig != 0, ccv_sign_with_format(64, "ccv_distance_transform(%la,%la,%la,%la,%d)", dx, dy, dxx, dyy, flag), a->sig, CCV_EOF_SIGN);
+	type = (CCV_GET_DATA_TYPE(type) == CCV_64F || CCV_GET_DATA_TYPE(a->type) == CCV_64F || CCV_GET_DATA_TYPE(a->type) == CCV_64S) ? CCV_GET_CHANNEL(a->type) | CCV_64F : CCV_GET_CHANNEL(a->type) | CCV_32F;
+	ccv_dense_matrix_t* db = *b = ccv_dense_matrix_renew(*b, a->rows, a->cols, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), type, sig);
+	ccv_dense_matrix_t* mx = 0;
+	ccv_dense_matrix_t* my = 0;
+	if (x != 0)
+	{
+		ccv_declare_derived_signature(xsig, a->sig != 0, ccv_sign_with_format(64, "ccv_distance_transform_x(%la,%la,%la,%la,%d)", dx, dy, dxx, dyy, flag), a->sig, CCV_EOF_SIGN);
+		mx = *x = ccv_dense_matrix_renew(*x, a->rows, a->cols, CCV_32S | CCV_C1, CCV_32S | CCV_C1, xsig);
+	}
+	if (y != 0)
+	{
+		ccv_declare_derived_signature(ysig, a->sig != 0, ccv_sign_with_format(64, "ccv_distance_transform_y(%la,%la,%la,%la,%d)", dx, dy, dxx, dyy, flag), a->sig, CCV_EOF_SIGN);
+		my = *y = ccv_dense_matrix_renew(*y, a->rows, a->cols, CCV_32S | CCV_C1, CCV_32S | CCV_C1, ysig);
+	}
+	ccv_object_return_if_cached(1, db, mx, my);
+	ccv_revive_object_if_cached(db, mx, my);
+	return 0;
+}
+
+void ccv_distance_transform(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, ccv_dense_matrix_t** x, int x_type, ccv_dense_matrix_t** y, int y_type, double dx, double dy, double dxx, double dyy, int flag)
+{
+	assert(!(flag & CCV_L2_NORM) && (flag & CCV_GSEDT));
+	if (_ccv_distance_transform_renew(a, b, type, x, y, dx, dy, dxx, dyy, flag))
+		return;
+	_ccv_distance_transform(a, *b, x ? *x : 0, y ? *y : 0, dx, dy, dxx, dyy, flag);
+}
+
+void ccv_distance_transform_batch(ccv_dense_matrix_t** a, ccv_dense_matrix_t** b, int type, ccv_dense_matrix_t** x, int x_type, ccv_dense_matrix_t** y, int y_type, const double* dx, const double* dy, const double* dxx, const double* dyy, int count, int flag)
+{
+	assert(!(flag & CCV_L2_NORM) && (flag & CCV_GSEDT));
+	int i;
+	int* cached = (int*)alloca(sizeof(int) * count);
+	for (i = 0; i < count; i++)
+		cached[i] = _ccv_distance_transform_renew(a[i], b + i, type, x ? x + i : 0, y ? y + i : 0, dx[i], dy[i], dxx[i], dyy[i], flag);
+	// each one runs its passes in parallel as well, thus, big and small ones together keep all threads busy
+	parallel_for(i, count) {
+		if (!cached[i])
+			_ccv_distance_transform(a[i], b[i], x ? x[i] : 0, y ? y[i] : 0, dx[i], dy[i], dxx[i], dyy[i], flag);
+	} parallel_endfor
+}
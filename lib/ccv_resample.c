@@ -1,5 +1,19 @@
 #include "ccv.h"
 #include "ccv_internal.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#if defined(HAVE_SSE2)
+#include <emmintrin.h>
+#elif defined(HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+/* both resamplers below are separable, a horizontal pass to a row buffer followed by a vertical pass over these
+ * buffers. Destination rows are split into tiles of CCV_RESAMPLE_TILE_ROWS, each tile carries its own row buffers
+ * and only recomputes the few source rows it shares with its neighbors, thus, tiles run in parallel and the result
+ * stays bit-exact with a single sequential pass */
+#define CCV_RESAMPLE_TILE_ROWS (32)
 
 /* area interpolation resample is adopted from OpenCV */
 
@@ -8,6 +22,17 @@ typedef struct {
 	unsigned int alpha;
 } ccv_int_alpha;
 
+/* the vertical pass of area interpolation carries the partial source row between two destination rows, this
+ * finds the source row that ends each destination row, thus, a tile can restore that carry on its own */
+static void _ccv_resample_area_row_ends(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b, double scale_y, int* yend)
+{
+	int sy, dy = 0;
+	for (sy = 0; sy < a->rows && dy < b->rows; sy++)
+		if ((dy + 1) * scale_y <= sy + 1 || sy == a->rows - 1)
+			yend[dy++] = sy;
+	assert(dy == b->rows);
+}
+
 static void _ccv_resample_area_8u(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b)
 {
 	assert(a->cols > 0 && b->cols > 0);
@@ -17,7 +42,7 @@ static void _ccv_resample_area_8u(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b)
 	double scale_y = (double)a->rows / b->rows;
 	// double scale = 1.f / (scale_x * scale_y);
 	unsigned int inv_scale_256 = (int)(scale_x * scale_y * 0x10000);
-	int dx, dy, sx, sy, i, k;
+	int dx, sx, k;
 	for (dx = 0, k = 0; dx < b->cols; dx++)
 	{
 		double fsx1 = dx * scale_x, fsx2 = fsx1 + scale_x;
@@ -46,53 +71,78 @@ static void _ccv_resample_area_8u(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b)
 			xofs[k++].alpha = (unsigned int)((fsx2 - sx2) * 256);
 		}
 	}
-	int xofs_count = k;
-	unsigned int* buf = (unsigned int*)alloca(b->cols * ch * sizeof(unsigned int));
-	unsigned int* sum = (unsigned int*)alloca(b->cols * ch * sizeof(unsigned int));
-	for (dx = 0; dx < b->cols * ch; dx++)
-		buf[dx] = sum[dx] = 0;
-	dy = 0;
-	for (sy = 0; sy < a->rows; sy++)
-	{
-		unsigned char* a_ptr = a->data.u8 + a->step * sy;
-		for (k = 0; k < xofs_count; k++)
+	const int xofs_count = k;
+	int* yend = (int*)alloca(sizeof(int) * b->rows);
+	_ccv_resample_area_row_ends(a, b, scale_y, yend);
+	parallel_for(t, (b->rows + CCV_RESAMPLE_TILE_ROWS - 1) / CCV_RESAMPLE_TILE_ROWS) {
+		int dx, dy, sy, i, k;
+		unsigned int* buf = (unsigned int*)ccmalloc(b->cols * ch * sizeof(unsigned int) * 2);
+		unsigned int* sum = buf + b->cols * ch;
+		for (dx = 0; dx < b->cols * ch; dx++)
+			buf[dx] = sum[dx] = 0;
+		dy = t * CCV_RESAMPLE_TILE_ROWS;
+		const int dy_end = ccv_min(b->rows, dy + CCV_RESAMPLE_TILE_ROWS);
+		sy = 0;
+		if (dy > 0)
 		{
-			int dxn = xofs[k].di;
-			unsigned int alpha = xofs[k].alpha;
-			for (i = 0; i < ch; i++)
-				buf[dxn + i] += a_ptr[xofs[k].si + i] * alpha;
-		}
-		if ((dy + 1) * scale_y <= sy + 1 || sy == a->rows - 1)
-		{
-			unsigned int beta = (int)(ccv_max(sy + 1 - (dy + 1) * scale_y, 0.f) * 256);
-			unsigned int beta1 = 256 - beta;
-			unsigned char* b_ptr = b->data.u8 + b->step * dy;
-			if (beta <= 0)
+			// restore the carry from the last source row of the previous destination row
+			sy = yend[dy - 1];
+			unsigned int beta = (int)(ccv_max(sy + 1 - dy * scale_y, 0.f) * 256);
+			if (beta > 0)
 			{
+				unsigned char* a_ptr = a->data.u8 + a->step * sy;
+				for (k = 0; k < xofs_count; k++)
+					for (i = 0; i < ch; i++)
+						buf[xofs[k].di + i] += a_ptr[xofs[k].si + i] * xofs[k].alpha;
 				for (dx = 0; dx < b->cols * ch; dx++)
 				{
-					b_ptr[dx] = ccv_clamp((sum[dx] + buf[dx] * 256) / inv_scale_256, 0, 255);
-					sum[dx] = buf[dx] = 0;
-				}
-			} else {
-				for (dx = 0; dx < b->cols * ch; dx++)
-				{
-					b_ptr[dx] = ccv_clamp((sum[dx] + buf[dx] * beta1) / inv_scale_256, 0, 255);
 					sum[dx] = buf[dx] * beta;
 					buf[dx] = 0;
 				}
 			}
-			dy++;
+			++sy;
 		}
-		else
+		for (; dy < dy_end; sy++)
 		{
-			for(dx = 0; dx < b->cols * ch; dx++)
+			unsigned char* a_ptr = a->data.u8 + a->step * sy;
+			for (k = 0; k < xofs_count; k++)
 			{
-				sum[dx] += buf[dx] * 256;
-				buf[dx] = 0;
+				int dxn = xofs[k].di;
+				unsigned int alpha = xofs[k].alpha;
+				for (i = 0; i < ch; i++)
+					buf[dxn + i] += a_ptr[xofs[k].si + i] * alpha;
+			}
+			if (sy == yend[dy])
+			{
+				unsigned int beta = (int)(ccv_max(sy + 1 - (dy + 1) * scale_y, 0.f) * 256);
+				unsigned int beta1 = 256 - beta;
+				unsigned char* b_ptr = b->data.u8 + b->step * dy;
+				if (beta <= 0)
+				{
+					for (dx = 0; dx < b->cols * ch; dx++)
+					{
+						b_ptr[dx] = ccv_clamp((sum[dx] + buf[dx] * 256) / inv_scale_256, 0, 255);
+						sum[dx] = buf[dx] = 0;
+					}
+				} else {
+					for (dx = 0; dx < b->cols * ch; dx++)
+					{
+						b_ptr[dx] = ccv_clamp((sum[dx] + buf[dx] * beta1) / inv_scale_256, 0, 255);
+						sum[dx] = buf[dx] * beta;
+						buf[dx] = 0;
+					}
+				}
+				dy++;
+			} else {
+				for (dx = 0; dx < b->cols * ch; dx++)
+				{
+					sum[dx] += buf[dx] * 256;
+					buf[dx] = 0;
+				}
 			}
 		}
-	}
+		ccfree(buf);
+	} parallel_endfor
 }
 
 typedef struct {
@@ -100,6 +150,92 @@ typedef struct {
 	float alpha;
 } ccv_area_alpha_t;
 
+// sum += buf, buf = 0
+static void _ccv_resample_area_accumulate(float* sum, float* buf, int n)
+{
+	int i = 0;
+#if defined(HAVE_SSE2)
+	const __m128 zero = _mm_setzero_ps();
+	for (; i < n - 3; i += 4)
+	{
+		_mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_loadu_ps(buf + i)));
+		_mm_storeu_ps(buf + i, zero);
+	}
+#elif defined(HAVE_NEON)
+	const float32x4_t zero = vdupq_n_f32(0);
+	for (; i < n - 3; i += 4)
+	{
+		vst1q_f32(sum + i, vaddq_f32(vld1q_f32(sum + i), vld1q_f32(buf + i)));
+		vst1q_f32(buf + i, zero);
+	}
+#endif
+	for (; i < n; i++)
+	{
+		sum[i] += buf[i];
+		buf[i] = 0;
+	}
+}
+
+// b = sum + buf * beta1, sum = buf * beta, buf = 0, whereas beta1 == 1 and beta == 0 are taken literally
+static void _ccv_resample_area_emit_32f(float* sum, float* buf, float* b, int n, int whole, float beta, float beta1)
+{
+	int i = 0;
+	if (whole)
+	{
+#if defined(HAVE_SSE2)
+		const __m128 zero = _mm_setzero_ps();
+		for (; i < n - 3; i += 4)
+		{
+			_mm_storeu_ps(b + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_loadu_ps(buf + i)));
+			_mm_storeu_ps(sum + i, zero);
+			_mm_storeu_ps(buf + i, zero);
+		}
+#elif defined(HAVE_NEON)
+		const float32x4_t zero = vdupq_n_f32(0);
+		for (; i < n - 3; i += 4)
+		{
+			vst1q_f32(b + i, vaddq_f32(vld1q_f32(sum + i), vld1q_f32(buf + i)));
+			vst1q_f32(sum + i, zero);
+			vst1q_f32(buf + i, zero);
+		}
+#endif
+		for (; i < n; i++)
+		{
+			b[i] = sum[i] + buf[i];
+			sum[i] = buf[i] = 0;
+		}
+	} else {
+#if defined(HAVE_SSE2)
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 beta4 = _mm_set1_ps(beta);
+		const __m128 beta14 = _mm_set1_ps(beta1);
+		for (; i < n - 3; i += 4)
+		{
+			const __m128 buf4 = _mm_loadu_ps(buf + i);
+			_mm_storeu_ps(b + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(buf4, beta14)));
+			_mm_storeu_ps(sum + i, _mm_mul_ps(buf4, beta4));
+			_mm_storeu_ps(buf + i, zero);
+		}
+#elif defined(HAVE_NEON)
+		const float32x4_t zero = vdupq_n_f32(0);
+		for (; i < n - 3; i += 4)
+		{
+			const float32x4_t buf4 = vld1q_f32(buf + i);
+			// multiply and add separately, a fused one rounds differently
+			vst1q_f32(b + i, vaddq_f32(vld1q_f32(sum + i), vmulq_n_f32(buf4, beta1)));
+			vst1q_f32(sum + i, vmulq_n_f32(buf4, beta));
+			vst1q_f32(buf + i, zero);
+		}
+#endif
+		for (; i < n; i++)
+		{
+			b[i] = sum[i] + buf[i] * beta1;
+			sum[i] = buf[i] * beta;
+			buf[i] = 0;
+		}
+	}
+}
+
 static void _ccv_resample_area(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b)
 {
 	assert(a->cols > 0 && b->cols > 0);
@@ -108,7 +244,7 @@ static void _ccv_resample_area(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b)
 	double scale_x = (double)a->cols / b->cols;
 	double scale_y = (double)a->rows / b->rows;
 	double scale = 1.f / (scale_x * scale_y);
-	int dx, dy, sx, sy, i, k;
+	int dx, sx, k;
 	for (dx = 0, k = 0; dx < b->cols; dx++)
 	{
 		double fsx1 = dx * scale_x, fsx2 = fsx1 + scale_x;
@@ -137,56 +273,79 @@ static void _ccv_resample_area(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b)
 			xofs[k++].alpha = (float)((fsx2 - sx2) * scale);
 		}
 	}
-	int xofs_count = k;
-	float* buf = (float*)alloca(b->cols * ch * sizeof(float));
-	float* sum = (float*)alloca(b->cols * ch * sizeof(float));
-	for (dx = 0; dx < b->cols * ch; dx++)
-		buf[dx] = sum[dx] = 0;
-	dy = 0;
-#define for_block(_for_get, _for_set) \
-	for (sy = 0; sy < a->rows; sy++) \
+	const int xofs_count = k;
+	int* yend = (int*)alloca(sizeof(int) * b->rows);
+	_ccv_resample_area_row_ends(a, b, scale_y, yend);
+	const int b_32f = (CCV_GET_DATA_TYPE(b->type) == CCV_32F);
+#define x_block(_for_get) \
+	for (k = 0; k < xofs_count; k++) \
 	{ \
-		unsigned char* a_ptr = a->data.u8 + a->step * sy; \
-		for (k = 0; k < xofs_count; k++) \
-		{ \
-			int dxn = xofs[k].di; \
-			float alpha = xofs[k].alpha; \
-			for (i = 0; i < ch; i++) \
-				buf[dxn + i] += _for_get(a_ptr, xofs[k].si + i, 0) * alpha; \
-		} \
-		if ((dy + 1) * scale_y <= sy + 1 || sy == a->rows - 1) \
+		int dxn = xofs[k].di; \
+		float alpha = xofs[k].alpha; \
+		for (i = 0; i < ch; i++) \
+			buf[dxn + i] += _for_get(a_ptr, xofs[k].si + i, 0) * alpha; \
+	}
+#define for_block(_for_get, _for_set) \
+	parallel_for(t, (b->rows + CCV_RESAMPLE_TILE_ROWS - 1) / CCV_RESAMPLE_TILE_ROWS) { \
+		int dx, dy, sy, i, k; \
+		float* buf = (float*)ccmalloc(b->cols * ch * sizeof(float) * 2); \
+		float* sum = buf + b->cols * ch; \
+		for (dx = 0; dx < b->cols * ch; dx++) \
+			buf[dx] = sum[dx] = 0; \
+		dy = t * CCV_RESAMPLE_TILE_ROWS; \
+		const int dy_end = ccv_min(b->rows, dy + CCV_RESAMPLE_TILE_ROWS); \
+		sy = 0; \
+		if (dy > 0) \
 		{ \
-			float beta = ccv_max(sy + 1 - (dy + 1) * scale_y, 0.f); \
-			float beta1 = 1 - beta; \
-			unsigned char* b_ptr = b->data.u8 + b->step * dy; \
-			if (fabs(beta) < 1e-3) \
+			/* restore the carry from the last source row of the previous destination row */ \
+			sy = yend[dy - 1]; \
+			float beta = ccv_max(sy + 1 - dy * scale_y, 0.f); \
+			if (!(fabs(beta) < 1e-3)) \
 			{ \
+				unsigned char* a_ptr = a->data.u8 + a->step * sy; \
+				x_block(_for_get); \
 				for (dx = 0; dx < b->cols * ch; dx++) \
 				{ \
-					_for_set(b_ptr, dx, sum[dx] + buf[dx], 0); \
-					sum[dx] = buf[dx] = 0; \
-				} \
-			} else { \
-				for (dx = 0; dx < b->cols * ch; dx++) \
-				{ \
-					_for_set(b_ptr, dx, sum[dx] + buf[dx] * beta1, 0); \
 					sum[dx] = buf[dx] * beta; \
 					buf[dx] = 0; \
 				} \
 			} \
-			dy++; \
+			++sy; \
 		} \
-		else \
+		for (; dy < dy_end; sy++) \
 		{ \
-			for(dx = 0; dx < b->cols * ch; dx++) \
+			unsigned char* a_ptr = a->data.u8 + a->step * sy; \
+			x_block(_for_get); \
+			if (sy == yend[dy]) \
 			{ \
-				sum[dx] += buf[dx]; \
-				buf[dx] = 0; \
-			} \
+				float beta = ccv_max(sy + 1 - (dy + 1) * scale_y, 0.f); \
+				float beta1 = 1 - beta; \
+				unsigned char* b_ptr = b->data.u8 + b->step * dy; \
+				if (b_32f) \
+					_ccv_resample_area_emit_32f(sum, buf, (float*)b_ptr, b->cols * ch, fabs(beta) < 1e-3, beta, beta1); \
+				else if (fabs(beta) < 1e-3) { \
+					for (dx = 0; dx < b->cols * ch; dx++) \
+					{ \
+						_for_set(b_ptr, dx, sum[dx] + buf[dx], 0); \
+						sum[dx] = buf[dx] = 0; \
+					} \
+				} else { \
+					for (dx = 0; dx < b->cols * ch; dx++) \
+					{ \
+						_for_set(b_ptr, dx, sum[dx] + buf[dx] * beta1, 0); \
+						sum[dx] = buf[dx] * beta; \
+						buf[dx] = 0; \
+					} \
+				} \
+				dy++; \
+			} else \
+				_ccv_resample_area_accumulate(sum, buf, b->cols * ch); \
 		} \
-	}
+		ccfree(buf); \
+	} parallel_endfor
 	ccv_matrix_getter(a->type, ccv_matrix_setter, b->type, for_block);
 #undef for_block
+#undef x_block
 }
 
 typedef struct {
@@ -213,10 +372,37 @@ static void _ccv_init_cubic_coeffs(int si, int sz, float s, ccv_cubic_coeffs_t*
 	coeff->coeffs[3] = 1.f - coeff->coeffs[0] - coeff->coeffs[1] - coeff->coeffs[2];
 }
 
+// the vertical pass of cubic interpolation from 4 rows of 32F, summed in the same order as the scalar one
+static void _ccv_resample_cubic_vertical_32f(float* const* row, const float* coeffs, float* b, int n)
+{
+	int i = 0;
+#if defined(HAVE_SSE2)
+	const __m128 c0 = _mm_set1_ps(coeffs[0]);
+	const __m128 c1 = _mm_set1_ps(coeffs[1]);
+	const __m128 c2 = _mm_set1_ps(coeffs[2]);
+	const __m128 c3 = _mm_set1_ps(coeffs[3]);
+	for (; i < n - 3; i += 4)
+	{
+		__m128 s = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(row[0] + i), c0), _mm_mul_ps(_mm_loadu_ps(row[1] + i), c1));
+		s = _mm_add_ps(s, _mm_mul_ps(_mm_loadu_ps(row[2] + i), c2));
+		_mm_storeu_ps(b + i, _mm_add_ps(s, _mm_mul_ps(_mm_loadu_ps(row[3] + i), c3)));
+	}
+#elif defined(HAVE_NEON)
+	for (; i < n - 3; i += 4)
+	{
+		float32x4_t s = vaddq_f32(vmulq_n_f32(vld1q_f32(row[0] + i), coeffs[0]), vmulq_n_f32(vld1q_f32(row[1] + i), coeffs[1]));
+		s = vaddq_f32(s, vmulq_n_f32(vld1q_f32(row[2] + i), coeffs[2]));
+		vst1q_f32(b + i, vaddq_f32(s, vmulq_n_f32(vld1q_f32(row[3] + i), coeffs[3])));
+	}
+#endif
+	for (; i < n; i++)
+		b[i] = row[0][i] * coeffs[0] + row[1][i] * coeffs[1] + row[2][i] * coeffs[2] + row[3][i] * coeffs[3];
+}
+
 static void _ccv_resample_cubic_float_only(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b)
 {
 	assert(CCV_GET_DATA_TYPE(b->type) == CCV_32F || CCV_GET_DATA_TYPE(b->type) == CCV_64F);
-	int i, j, k, ch = CCV_GET_CHANNEL(a->type);
+	int i, ch = CCV_GET_CHANNEL(a->type);
 	assert(b->cols > 0 && b->step > 0);
 	ccv_cubic_coeffs_t* xofs = (ccv_cubic_coeffs_t*)alloca(sizeof(ccv_cubic_coeffs_t) * b->cols);
 	float scale_x = (float)a->cols / b->cols;
@@ -226,45 +412,50 @@ static void _ccv_resample_cubic_float_only(ccv_dense_matrix_t* a, ccv_dense_matr
 		_ccv_init_cubic_coeffs((int)sx, a->cols, sx, xofs + i);
 	}
 	float scale_y = (float)a->rows / b->rows;
-	unsigned char* buf = (unsigned char*)alloca(b->step * 4);
-#ifdef __clang_analyzer__
-	memset(buf, 0, b->step * 4);
-#endif
-	unsigned char* a_ptr = a->data.u8;
-	unsigned char* b_ptr = b->data.u8;
-	int psi = -1, siy = 0;
+	const int b_32f = (CCV_GET_DATA_TYPE(b->type) == CCV_32F);
 #define for_block(_for_get, _for_set_b, _for_get_b) \
-	for (i = 0; i < b->rows; i++) \
-	{ \
-		ccv_cubic_coeffs_t yofs; \
-		float sy = (i + 0.5) * scale_y - 0.5; \
-		_ccv_init_cubic_coeffs((int)sy, a->rows, sy, &yofs); \
-		if (yofs.si[3] > psi) \
+	parallel_for(t, (b->rows + CCV_RESAMPLE_TILE_ROWS - 1) / CCV_RESAMPLE_TILE_ROWS) { \
+		int i, j, k; \
+		unsigned char* buf = (unsigned char*)ccmalloc(b->step * 4); \
+		int psi = -1, siy = 0; \
+		const int i_end = ccv_min(b->rows, (t + 1) * CCV_RESAMPLE_TILE_ROWS); \
+		for (i = t * CCV_RESAMPLE_TILE_ROWS; i < i_end; i++) \
 		{ \
-			for (; siy <= yofs.si[3]; siy++) \
+			ccv_cubic_coeffs_t yofs; \
+			float sy = (i + 0.5) * scale_y - 0.5; \
+			_ccv_init_cubic_coeffs((int)sy, a->rows, sy, &yofs); \
+			if (yofs.si[3] > psi) \
 			{ \
-				unsigned char* row = buf + (siy & 0x3) * b->step; \
-				for (j = 0; j < b->cols; j++) \
-					for (k = 0; k < ch; k++) \
-						_for_set_b(row, j * ch + k, _for_get(a_ptr, xofs[j].si[0] * ch + k, 0) * xofs[j].coeffs[0] + \
-													_for_get(a_ptr, xofs[j].si[1] * ch + k, 0) * xofs[j].coeffs[1] + \
-													_for_get(a_ptr, xofs[j].si[2] * ch + k, 0) * xofs[j].coeffs[2] + \
-													_for_get(a_ptr, xofs[j].si[3] * ch + k, 0) * xofs[j].coeffs[3], 0); \
-				a_ptr += a->step; \
+				/* rows before si[0] are never used again */ \
+				for (siy = ccv_max(siy, yofs.si[0]); siy <= yofs.si[3]; siy++) \
+				{ \
+					unsigned char* row = buf + (siy & 0x3) * b->step; \
+					unsigned char* a_ptr = a->data.u8 + a->step * siy; \
+					for (j = 0; j < b->cols; j++) \
+						for (k = 0; k < ch; k++) \
+							_for_set_b(row, j * ch + k, _for_get(a_ptr, xofs[j].si[0] * ch + k, 0) * xofs[j].coeffs[0] + \
+														_for_get(a_ptr, xofs[j].si[1] * ch + k, 0) * xofs[j].coeffs[1] + \
+														_for_get(a_ptr, xofs[j].si[2] * ch + k, 0) * xofs[j].coeffs[2] + \
+														_for_get(a_ptr, xofs[j].si[3] * ch + k, 0) * xofs[j].coeffs[3], 0); \
+				} \
+				psi = yofs.si[3]; \
 			} \
-			psi = yofs.si[3]; \
+			unsigned char* row[4] = { \
+				buf + (yofs.si[0] & 0x3) * b->step, \
+				buf + (yofs.si[1] & 0x3) * b->step, \
+				buf + (yofs.si[2] & 0x3) * b->step, \
+				buf + (yofs.si[3] & 0x3) * b->step, \
+			}; \
+			unsigned char* b_ptr = b->data.u8 + b->step * i; \
+			if (b_32f) \
+				_ccv_resample_cubic_vertical_32f((float* const*)row, yofs.coeffs, (float*)b_ptr, b->cols * ch); \
+			else \
+				for (j = 0; j < b->cols * ch; j++) \
+					_for_set_b(b_ptr, j, _for_get_b(row[0], j, 0) * yofs.coeffs[0] + _for_get_b(row[1], j, 0) * yofs.coeffs[1] + \
+										 _for_get_b(row[2], j, 0) * yofs.coeffs[2] + _for_get_b(row[3], j, 0) * yofs.coeffs[3], 0); \
 		} \
-		unsigned char* row[4] = { \
-			buf + (yofs.si[0] & 0x3) * b->step, \
-			buf + (yofs.si[1] & 0x3) * b->step, \
-			buf + (yofs.si[2] & 0x3) * b->step, \
-			buf + (yofs.si[3] & 0x3) * b->step, \
-		}; \
-		for (j = 0; j < b->cols * ch; j++) \
-			_for_set_b(b_ptr, j, _for_get_b(row[0], j, 0) * yofs.coeffs[0] + _for_get_b(row[1], j, 0) * yofs.coeffs[1] + \
-								 _for_get_b(row[2], j, 0) * yofs.coeffs[2] + _for_get_b(row[3], j, 0) * yofs.coeffs[3], 0); \
-		b_ptr += b->step; \
-	}
+		ccfree(buf); \
+	} parallel_endfor
 	ccv_matrix_getter(a->type, ccv_matrix_setter_getter_float_only, b->type, for_block);
 #undef for_block
 }
@@ -284,10 +475,49 @@ static void _ccv_init_cubic_integer_coeffs(int si, int sz, float s, ccv_cubic_in
 	coeff->coeffs[3] = W_BITS - coeff->coeffs[0] - coeff->coeffs[1] - coeff->coeffs[2];
 }
 
+/* the vertical pass of cubic interpolation from 4 rows of 32S to 8U. The rows come from 8U input with 6-bit
+ * coefficients, they fit in 16-bit, thus, SSE2 can multiply and add pairs of them with madd exactly */
+static void _ccv_resample_cubic_vertical_8u(int* const* row, const int* coeffs, unsigned char* b, int n)
+{
+	int i = 0;
+#if defined(HAVE_SSE2)
+	const __m128i c01 = _mm_set1_epi32((coeffs[0] & 0xffff) | (coeffs[1] << 16));
+	const __m128i c23 = _mm_set1_epi32((coeffs[2] & 0xffff) | (coeffs[3] << 16));
+	const __m128i half = _mm_set1_epi32(1 << 11);
+	for (; i < n - 7; i += 8)
+	{
+		const __m128i r0 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(row[0] + i)), _mm_loadu_si128((const __m128i*)(row[0] + i + 4)));
+		const __m128i r1 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(row[1] + i)), _mm_loadu_si128((const __m128i*)(row[1] + i + 4)));
+		const __m128i r2 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(row[2] + i)), _mm_loadu_si128((const __m128i*)(row[2] + i + 4)));
+		const __m128i r3 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(row[3] + i)), _mm_loadu_si128((const __m128i*)(row[3] + i + 4)));
+		__m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r0, r1), c01), _mm_madd_epi16(_mm_unpacklo_epi16(r2, r3), c23));
+		__m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r0, r1), c01), _mm_madd_epi16(_mm_unpackhi_epi16(r2, r3), c23));
+		lo = _mm_srai_epi32(_mm_add_epi32(lo, half), 12);
+		hi = _mm_srai_epi32(_mm_add_epi32(hi, half), 12);
+		_mm_storel_epi64((__m128i*)(b + i), _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128()));
+	}
+#elif defined(HAVE_NEON)
+	for (; i < n - 7; i += 8)
+	{
+		int32x4_t lo = vmulq_n_s32(vld1q_s32(row[0] + i), coeffs[0]);
+		int32x4_t hi = vmulq_n_s32(vld1q_s32(row[0] + i + 4), coeffs[0]);
+		lo = vmlaq_n_s32(lo, vld1q_s32(row[1] + i), coeffs[1]);
+		hi = vmlaq_n_s32(hi, vld1q_s32(row[1] + i + 4), coeffs[1]);
+		lo = vmlaq_n_s32(lo, vld1q_s32(row[2] + i), coeffs[2]);
+		hi = vmlaq_n_s32(hi, vld1q_s32(row[2] + i + 4), coeffs[2]);
+		lo = vmlaq_n_s32(lo, vld1q_s32(row[3] + i), coeffs[3]);
+		hi = vmlaq_n_s32(hi, vld1q_s32(row[3] + i + 4), coeffs[3]);
+		vst1_u8(b + i, vqmovun_s16(vcombine_s16(vqmovn_s32(vrshrq_n_s32(lo, 12)), vqmovn_s32(vrshrq_n_s32(hi, 12)))));
+	}
+#endif
+	for (; i < n; i++)
+		b[i] = ccv_clamp(ccv_descale(row[0][i] * coeffs[0] + row[1][i] * coeffs[1] + row[2][i] * coeffs[2] + row[3][i] * coeffs[3], 12), 0, 255);
+}
+
 static void _ccv_resample_cubic_integer_only(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b)
 {
 	assert(CCV_GET_DATA_TYPE(b->type) == CCV_8U || CCV_GET_DATA_TYPE(b->type) == CCV_32S || CCV_GET_DATA_TYPE(b->type) == CCV_64S);
-	int i, j, k, ch = CCV_GET_CHANNEL(a->type);
+	int i, ch = CCV_GET_CHANNEL(a->type);
 	int no_8u_type = (b->type & CCV_8U) ? CCV_32S : b->type;
 	assert(b->cols > 0);
 	ccv_cubic_integer_coeffs_t* xofs = (ccv_cubic_integer_coeffs_t*)alloca(sizeof(ccv_cubic_integer_coeffs_t) * b->cols);
@@ -299,45 +529,50 @@ static void _ccv_resample_cubic_integer_only(ccv_dense_matrix_t* a, ccv_dense_ma
 	}
 	float scale_y = (float)a->rows / b->rows;
 	int bufstep = b->cols * ch * CCV_GET_DATA_TYPE_SIZE(no_8u_type);
-	unsigned char* buf = (unsigned char*)alloca(bufstep * 4);
-#ifdef __clang_analyzer__
-	memset(buf, 0, bufstep * 4);
-#endif
-	unsigned char* a_ptr = a->data.u8;
-	unsigned char* b_ptr = b->data.u8;
-	int psi = -1, siy = 0;
+	const int u8 = (CCV_GET_DATA_TYPE(a->type) == CCV_8U && CCV_GET_DATA_TYPE(b->type) == CCV_8U);
 #define for_block(_for_get_a, _for_set, _for_get, _for_set_b) \
-	for (i = 0; i < b->rows; i++) \
-	{ \
-		ccv_cubic_integer_coeffs_t yofs; \
-		float sy = (i + 0.5) * scale_y - 0.5; \
-		_ccv_init_cubic_integer_coeffs((int)sy, a->rows, sy, &yofs); \
-		if (yofs.si[3] > psi) \
+	parallel_for(t, (b->rows + CCV_RESAMPLE_TILE_ROWS - 1) / CCV_RESAMPLE_TILE_ROWS) { \
+		int i, j, k; \
+		unsigned char* buf = (unsigned char*)ccmalloc(bufstep * 4); \
+		int psi = -1, siy = 0; \
+		const int i_end = ccv_min(b->rows, (t + 1) * CCV_RESAMPLE_TILE_ROWS); \
+		for (i = t * CCV_RESAMPLE_TILE_ROWS; i < i_end; i++) \
 		{ \
-			for (; siy <= yofs.si[3]; siy++) \
+			ccv_cubic_integer_coeffs_t yofs; \
+			float sy = (i + 0.5) * scale_y - 0.5; \
+			_ccv_init_cubic_integer_coeffs((int)sy, a->rows, sy, &yofs); \
+			if (yofs.si[3] > psi) \
 			{ \
-				unsigned char* row = buf + (siy & 0x3) * bufstep; \
-				for (j = 0; j < b->cols; j++) \
-					for (k = 0; k < ch; k++) \
-						_for_set(row, j * ch + k, _for_get_a(a_ptr, xofs[j].si[0] * ch + k, 0) * xofs[j].coeffs[0] + \
-												  _for_get_a(a_ptr, xofs[j].si[1] * ch + k, 0) * xofs[j].coeffs[1] + \
-												  _for_get_a(a_ptr, xofs[j].si[2] * ch + k, 0) * xofs[j].coeffs[2] + \
-												  _for_get_a(a_ptr, xofs[j].si[3] * ch + k, 0) * xofs[j].coeffs[3], 0); \
-				a_ptr += a->step; \
+				/* rows before si[0] are never used again */ \
+				for (siy = ccv_max(siy, yofs.si[0]); siy <= yofs.si[3]; siy++) \
+				{ \
+					unsigned char* row = buf + (siy & 0x3) * bufstep; \
+					unsigned char* a_ptr = a->data.u8 + a->step * siy; \
+					for (j = 0; j < b->cols; j++) \
+						for (k = 0; k < ch; k++) \
+							_for_set(row, j * ch + k, _for_get_a(a_ptr, xofs[j].si[0] * ch + k, 0) * xofs[j].coeffs[0] + \
+													  _for_get_a(a_ptr, xofs[j].si[1] * ch + k, 0) * xofs[j].coeffs[1] + \
+													  _for_get_a(a_ptr, xofs[j].si[2] * ch + k, 0) * xofs[j].coeffs[2] + \
+													  _for_get_a(a_ptr, xofs[j].si[3] * ch + k, 0) * xofs[j].coeffs[3], 0); \
+				} \
+				psi = yofs.si[3]; \
 			} \
-			psi = yofs.si[3]; \
+			unsigned char* row[4] = { \
+				buf + (yofs.si[0] & 0x3) * bufstep, \
+				buf + (yofs.si[1] & 0x3) * bufstep, \
+				buf + (yofs.si[2] & 0x3) * bufstep, \
+				buf + (yofs.si[3] & 0x3) * bufstep, \
+			}; \
+			unsigned char* b_ptr = b->data.u8 + b->step * i; \
+			if (u8) \
+				_ccv_resample_cubic_vertical_8u((int* const*)row, yofs.coeffs, b_ptr, b->cols * ch); \
+			else \
+				for (j = 0; j < b->cols * ch; j++) \
+					_for_set_b(b_ptr, j, ccv_descale(_for_get(row[0], j, 0) * yofs.coeffs[0] + _for_get(row[1], j, 0) * yofs.coeffs[1] + \
+													 _for_get(row[2], j, 0) * yofs.coeffs[2] + _for_get(row[3], j, 0) * yofs.coeffs[3], 12), 0); \
 		} \
-		unsigned char* row[4] = { \
-			buf + (yofs.si[0] & 0x3) * bufstep, \
-			buf + (yofs.si[1] & 0x3) * bufstep, \
-			buf + (yofs.si[2] & 0x3) * bufstep, \
-			buf + (yofs.si[3] & 0x3) * bufstep, \
-		}; \
-		for (j = 0; j < b->cols * ch; j++) \
-			_for_set_b(b_ptr, j, ccv_descale(_for_get(row[0], j, 0) * yofs.coeffs[0] + _for_get(row[1], j, 0) * yofs.coeffs[1] + \
-											 _for_get(row[2], j, 0) * yofs.coeffs[2] + _for_get(row[3], j, 0) * yofs.coeffs[3], 12), 0); \
-		b_ptr += b->step; \
-	}
+		ccfree(buf); \
+	} parallel_endfor
 	ccv_matrix_getter(a->type, ccv_matrix_setter_getter_integer_only, no_8u_type, ccv_matrix_setter_integer_only, b->type, for_block);
 #undef for_block
 }
@@ -352,7 +587,7 @@ void ccv_resample(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int btype, int
 	if (a->rows == db->rows && a->cols == db->cols)
 	{
 		if (CCV_GET_CHANNEL(a->type) == CCV_GET_CHANNEL(db->type) && CCV_GET_DATA_TYPE(db->type) == CCV_GET_DATA_TYPE(a->type))
-			memcpy(db->data.u8, a->data.u8, a->rows * a->step);
+			ccv_dense_matrix_copy_rows(a, db);
 		else {
 			ccv_shift(a, (ccv_matrix_t**)&db, 0, 0, 0);
 		}
@@ -377,6 +612,104 @@ void ccv_resample(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int btype, int
 	}
 }
 
+/* the horizontal pass of sample down for single channel 8U, 8 destination columns at a time from a row that is
+ * offset by src_x already; the 5 taps sum up to at most 16 * 255, thus, they are computed in 16-bit. It returns
+ * the next column to compute */
+static int _ccv_sample_down_h_8u(const unsigned char* a_ptr, int* row, int dx, int cols0, int width)
+{
+#if defined(HAVE_SSE2)
+	const __m128i mask = _mm_set1_epi16(0xff);
+	const __m128i zero = _mm_setzero_si128();
+	for (; dx + 8 <= cols0 && dx * 2 + 18 <= width; dx += 8)
+	{
+		const __m128i v0 = _mm_loadu_si128((const __m128i*)(a_ptr + dx * 2 - 2));
+		const __m128i v1 = _mm_loadu_si128((const __m128i*)(a_ptr + dx * 2));
+		const __m128i v2 = _mm_loadu_si128((const __m128i*)(a_ptr + dx * 2 + 2));
+		// even bytes are columns 2 * dx - 2, 2 * dx and 2 * dx + 2, odd ones are 2 * dx - 1 and 2 * dx + 1
+		const __m128i c = _mm_and_si128(v1, mask);
+		const __m128i n = _mm_add_epi16(_mm_srli_epi16(v0, 8), _mm_srli_epi16(v1, 8));
+		const __m128i f = _mm_add_epi16(_mm_and_si128(v0, mask), _mm_and_si128(v2, mask));
+		const __m128i s = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(c, 2), _mm_slli_epi16(c, 1)), _mm_slli_epi16(n, 2)), f);
+		_mm_storeu_si128((__m128i*)(row + dx), _mm_unpacklo_epi16(s, zero));
+		_mm_storeu_si128((__m128i*)(row + dx + 4), _mm_unpackhi_epi16(s, zero));
+	}
+#elif defined(HAVE_NEON)
+	for (; dx + 8 <= cols0 && dx * 2 + 18 <= width; dx += 8)
+	{
+		const uint8x8x2_t v0 = vld2_u8(a_ptr + dx * 2 - 2);
+		const uint8x8x2_t v1 = vld2_u8(a_ptr + dx * 2);
+		const uint8x8_t v2 = vld2_u8(a_ptr + dx * 2 + 2).val[0];
+		uint16x8_t s = vaddl_u8(v0.val[0], v2);
+		s = vmlaq_n_u16(s, vaddl_u8(v0.val[1], v1.val[1]), 4);
+		s = vmlaq_n_u16(s, vmovl_u8(v1.val[0]), 6);
+		vst1q_s32(row + dx, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(s))));
+		vst1q_s32(row + dx + 4, vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(s))));
+	}
+#endif
+	return dx;
+}
+
+// the vertical pass of sample down from 5 rows of 32S to 8U, it returns the next column to compute
+static int _ccv_sample_down_v_8u(int* const* rows, unsigned char* b, int n)
+{
+	int i = 0;
+#if defined(HAVE_SSE2)
+	for (; i < n - 7; i += 8)
+	{
+		__m128i s[2];
+		int j;
+		for (j = 0; j < 2; j++)
+		{
+			const __m128i r2 = _mm_loadu_si128((const __m128i*)(rows[2] + i + j * 4));
+			const __m128i r13 = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(rows[1] + i + j * 4)), _mm_loadu_si128((const __m128i*)(rows[3] + i + j * 4)));
+			const __m128i r04 = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(rows[0] + i + j * 4)), _mm_loadu_si128((const __m128i*)(rows[4] + i + j * 4)));
+			s[j] = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(r2, 2), _mm_slli_epi32(r2, 1)), _mm_add_epi32(_mm_slli_epi32(r13, 2), r04));
+			s[j] = _mm_srli_epi32(s[j], 8);
+		}
+		_mm_storel_epi64((__m128i*)(b + i), _mm_packus_epi16(_mm_packs_epi32(s[0], s[1]), _mm_setzero_si128()));
+	}
+#elif defined(HAVE_NEON)
+	for (; i < n - 7; i += 8)
+	{
+		int32x4_t s[2];
+		int j;
+		for (j = 0; j < 2; j++)
+		{
+			s[j] = vaddq_s32(vld1q_s32(rows[0] + i + j * 4), vld1q_s32(rows[4] + i + j * 4));
+			s[j] = vmlaq_n_s32(s[j], vaddq_s32(vld1q_s32(rows[1] + i + j * 4), vld1q_s32(rows[3] + i + j * 4)), 4);
+			s[j] = vmlaq_n_s32(s[j], vld1q_s32(rows[2] + i + j * 4), 6);
+		}
+		vst1_u8(b + i, vqmovun_s16(vcombine_s16(vqmovn_s32(vshrq_n_s32(s[0], 8)), vqmovn_s32(vshrq_n_s32(s[1], 8)))));
+	}
+#endif
+	return i;
+}
+
+// the vertical pass of sample down from 5 rows of 32F, summed in the same order as the scalar one
+static int _ccv_sample_down_v_32f(float* const* rows, float* b, int n)
+{
+	int i = 0;
+#if defined(HAVE_SSE2)
+	const __m128 six = _mm_set1_ps(6);
+	const __m128 four = _mm_set1_ps(4);
+	const __m128 scale = _mm_set1_ps(1.0 / 256);
+	for (; i < n - 3; i += 4)
+	{
+		__m128 s = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(rows[2] + i), six), _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(rows[1] + i), _mm_loadu_ps(rows[3] + i)), four));
+		s = _mm_add_ps(_mm_add_ps(s, _mm_loadu_ps(rows[0] + i)), _mm_loadu_ps(rows[4] + i));
+		_mm_storeu_ps(b + i, _mm_mul_ps(s, scale));
+	}
+#elif defined(HAVE_NEON)
+	for (; i < n - 3; i += 4)
+	{
+		float32x4_t s = vaddq_f32(vmulq_n_f32(vld1q_f32(rows[2] + i), 6), vmulq_n_f32(vaddq_f32(vld1q_f32(rows[1] + i), vld1q_f32(rows[3] + i)), 4));
+		s = vaddq_f32(vaddq_f32(s, vld1q_f32(rows[0] + i)), vld1q_f32(rows[4] + i));
+		vst1q_f32(b + i, vmulq_n_f32(s, 1.0 / 256));
+	}
+#endif
+	return i;
+}
+
 /* the following code is adopted from OpenCV cvPyrDown */
 void ccv_sample_down(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int src_x, int src_y)
 {
@@ -387,45 +720,54 @@ void ccv_sample_down(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, in
 	ccv_object_return_if_cached(, db);
 	int ch = CCV_GET_CHANNEL(a->type);
 	int cols0 = db->cols - 1 - src_x;
-	int dy, sy = -2 + src_y, sx = src_x * ch, dx, k;
+	int dx, sx = src_x * ch, k;
 	int* tab = (int*)alloca((a->cols + src_x + 2) * ch * sizeof(int));
 	for (dx = 0; dx < a->cols + src_x + 2; dx++)
 		for (k = 0; k < ch; k++)
 			tab[dx * ch + k] = ((dx >= a->cols) ? a->cols * 2 - 1 - dx : dx) * ch + k;
-	unsigned char* buf = (unsigned char*)alloca(5 * db->cols * ch * ccv_max(CCV_GET_DATA_TYPE_SIZE(db->type), sizeof(int)));
 	int bufstep = db->cols * ch * ccv_max(CCV_GET_DATA_TYPE_SIZE(db->type), sizeof(int));
-#ifdef __clang_analyzer__
-	memset(buf, 0, 5 * bufstep);
-#endif
-	unsigned char* b_ptr = db->data.u8;
+	const int u8 = (CCV_GET_DATA_TYPE(a->type) == CCV_8U && CCV_GET_DATA_TYPE(db->type) == CCV_8U);
+	const int u8_c1 = (u8 && ch == 1);
+	const int f32 = (CCV_GET_DATA_TYPE(a->type) == CCV_32F && CCV_GET_DATA_TYPE(db->type) == CCV_32F);
 	/* why is src_y * 4 in computing the offset of row?
 	 * Essentially, it means sy - src_y but in a manner that doesn't result negative number.
 	 * notice that we added src_y before when computing sy in the first place, however,
 	 * it is not desirable to have that offset when we try to wrap it into our 5-row buffer (
 	 * because in later rearrangement, we have no src_y to backup the arrangement). In
-	 * such micro scope, we managed to stripe 5 addition into one shift and addition. */
+	 * such micro scope, we managed to stripe 5 addition into one shift and addition.
+	 * Destination rows are computed in tiles, each tile fills its own 5-row buffer from 2 rows above its first row. */
 #define for_block(_for_get_a, _for_set, _for_get, _for_set_b) \
-	for (dy = 0; dy < db->rows; dy++) \
-	{ \
-		for(; sy <= dy * 2 + 2 + src_y; sy++) \
+	parallel_for(t, (db->rows + CCV_RESAMPLE_TILE_ROWS - 1) / CCV_RESAMPLE_TILE_ROWS) { \
+		int dy, dx, k; \
+		unsigned char* buf = (unsigned char*)ccmalloc(5 * bufstep); \
+		const int dy_end = ccv_min(db->rows, (t + 1) * CCV_RESAMPLE_TILE_ROWS); \
+		int sy = t * CCV_RESAMPLE_TILE_ROWS * 2 - 2 + src_y; \
+		unsigned char* b_ptr = db->data.u8 + db->step * t * CCV_RESAMPLE_TILE_ROWS; \
+		for (dy = t * CCV_RESAMPLE_TILE_ROWS; dy < dy_end; dy++) \
 		{ \
-			unsigned char* row = buf + ((sy + src_y * 4 + 2) % 5) * bufstep; \
-			int _sy = (sy < 0) ? -1 - sy : (sy >= a->rows) ? a->rows * 2 - 1 - sy : sy; \
-			unsigned char* a_ptr = a->data.u8 + a->step * _sy; \
-			for (k = 0; k < ch; k++) \
-				_for_set(row, k, _for_get_a(a_ptr, sx + k, 0) * 10 + _for_get_a(a_ptr, ch + sx + k, 0) * 5 + _for_get_a(a_ptr, 2 * ch + sx + k, 0), 0); \
-			for(dx = ch; dx < cols0 * ch; dx += ch) \
+			for(; sy <= dy * 2 + 2 + src_y; sy++) \
+			{ \
+				unsigned char* row = buf + ((sy + src_y * 4 + 2) % 5) * bufstep; \
+				int _sy = (sy < 0) ? -1 - sy : (sy >= a->rows) ? a->rows * 2 - 1 - sy : sy; \
+				unsigned char* a_ptr = a->data.u8 + a->step * _sy; \
 				for (k = 0; k < ch; k++) \
-					_for_set(row, dx + k, _for_get_a(a_ptr, dx * 2 + sx + k, 0) * 6 + (_for_get_a(a_ptr, dx * 2 + sx + k - ch, 0) + _for_get_a(a_ptr, dx * 2 + sx + k + ch, 0)) * 4 + _for_get_a(a_ptr, dx * 2 + sx + k - ch * 2, 0) + _for_get_a(a_ptr, dx * 2 + sx + k + ch * 2, 0), 0); \
-			x_block(_for_get_a, _for_set, _for_get, _for_set_b); \
+					_for_set(row, k, _for_get_a(a_ptr, sx + k, 0) * 10 + _for_get_a(a_ptr, ch + sx + k, 0) * 5 + _for_get_a(a_ptr, 2 * ch + sx + k, 0), 0); \
+				dx = u8_c1 ? _ccv_sample_down_h_8u(a_ptr + sx, (int*)row, 1, cols0, a->cols - sx) : ch; \
+				for(; dx < cols0 * ch; dx += ch) \
+					for (k = 0; k < ch; k++) \
+						_for_set(row, dx + k, _for_get_a(a_ptr, dx * 2 + sx + k, 0) * 6 + (_for_get_a(a_ptr, dx * 2 + sx + k - ch, 0) + _for_get_a(a_ptr, dx * 2 + sx + k + ch, 0)) * 4 + _for_get_a(a_ptr, dx * 2 + sx + k - ch * 2, 0) + _for_get_a(a_ptr, dx * 2 + sx + k + ch * 2, 0), 0); \
+				x_block(_for_get_a, _for_set, _for_get, _for_set_b); \
+			} \
+			unsigned char* rows[5]; \
+			for(k = 0; k < 5; k++) \
+				rows[k] = buf + ((dy * 2 + k) % 5) * bufstep; \
+			dx = u8 ? _ccv_sample_down_v_8u((int* const*)rows, b_ptr, db->cols * ch) : f32 ? _ccv_sample_down_v_32f((float* const*)rows, (float*)b_ptr, db->cols * ch) : 0; \
+			for(; dx < db->cols * ch; dx++) \
+				_for_set_b(b_ptr, dx, (_for_get(rows[2], dx, 0) * 6 + (_for_get(rows[1], dx, 0) + _for_get(rows[3], dx, 0)) * 4 + _for_get(rows[0], dx, 0) + _for_get(rows[4], dx, 0)) / 256, 0); \
+			b_ptr += db->step; \
 		} \
-		unsigned char* rows[5]; \
-		for(k = 0; k < 5; k++) \
-			rows[k] = buf + ((dy * 2 + k) % 5) * bufstep; \
-		for(dx = 0; dx < db->cols * ch; dx++) \
-			_for_set_b(b_ptr, dx, (_for_get(rows[2], dx, 0) * 6 + (_for_get(rows[1], dx, 0) + _for_get(rows[3], dx, 0)) * 4 + _for_get(rows[0], dx, 0) + _for_get(rows[4], dx, 0)) / 256, 0); \
-		b_ptr += db->step; \
-	}
+		ccfree(buf); \
+	} parallel_endfor
 	int no_8u_type = (a->type & CCV_8U) ? CCV_32S : a->type;
 	if (src_x > 0)
 	{
@@ -445,6 +787,86 @@ void ccv_sample_down(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, in
 #undef for_block
 }
 
+/* the horizontal pass of sample up for single channel 8U, 8 source columns (16 destination columns) at a time
+ * from a row that is offset by src_x already, with weights of 8, 23 and 1 that sum up to 32, thus, 16-bit is
+ * enough. It returns the next source column to compute */
+static int _ccv_sample_up_h_8u(const unsigned char* a_ptr, int* row, int x, int cols0, int width)
+{
+#if defined(HAVE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i g025 = _mm_set1_epi16(23);
+	for (; x + 8 <= cols0 && x + 9 <= width; x += 8)
+	{
+		const __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(a_ptr + x - 1)), zero);
+		const __m128i c = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(a_ptr + x)), zero), g025);
+		const __m128i n = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(a_ptr + x + 1)), zero);
+		const __m128i e = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(p, 3), c), n);
+		const __m128i o = _mm_add_epi16(_mm_add_epi16(p, c), _mm_slli_epi16(n, 3));
+		const __m128i lo = _mm_unpacklo_epi16(e, o);
+		const __m128i hi = _mm_unpackhi_epi16(e, o);
+		_mm_storeu_si128((__m128i*)(row + x * 2), _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*)(row + x * 2 + 4), _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*)(row + x * 2 + 8), _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128((__m128i*)(row + x * 2 + 12), _mm_unpackhi_epi16(hi, zero));
+	}
+#elif defined(HAVE_NEON)
+	for (; x + 8 <= cols0 && x + 9 <= width; x += 8)
+	{
+		const uint16x8_t p = vmovl_u8(vld1_u8(a_ptr + x - 1));
+		const uint16x8_t c = vmulq_n_u16(vmovl_u8(vld1_u8(a_ptr + x)), 23);
+		const uint16x8_t n = vmovl_u8(vld1_u8(a_ptr + x + 1));
+		const uint16x8x2_t eo = vzipq_u16(vaddq_u16(vmlaq_n_u16(c, p, 8), n), vaddq_u16(vmlaq_n_u16(c, n, 8), p));
+		vst1q_s32(row + x * 2, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(eo.val[0]))));
+		vst1q_s32(row + x * 2 + 4, vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(eo.val[0]))));
+		vst1q_s32(row + x * 2 + 8, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(eo.val[1]))));
+		vst1q_s32(row + x * 2 + 12, vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(eo.val[1]))));
+	}
+#endif
+	return x;
+}
+
+// the vertical pass of sample up from 3 rows of 32S to 2 rows of 8U, it returns the next column to compute
+static int _ccv_sample_up_v_8u(int* const* rows, unsigned char* b0, unsigned char* b1, int n)
+{
+	int i = 0;
+#if defined(HAVE_SSE2)
+	// the rows are at most 32 * 255, pack them to 16-bit and multiply add pairs of them
+	const __m128i c01 = _mm_set1_epi32(8 | (23 << 16));
+	const __m128i c10 = _mm_set1_epi32(1 | (23 << 16));
+	const __m128i c2 = _mm_set1_epi32(1);
+	const __m128i c3 = _mm_set1_epi32(8);
+	for (; i < n - 7; i += 8)
+	{
+		const __m128i r0 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(rows[0] + i)), _mm_loadu_si128((const __m128i*)(rows[0] + i + 4)));
+		const __m128i r1 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(rows[1] + i)), _mm_loadu_si128((const __m128i*)(rows[1] + i + 4)));
+		const __m128i r2 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(rows[2] + i)), _mm_loadu_si128((const __m128i*)(rows[2] + i + 4)));
+		const __m128i r01l = _mm_unpacklo_epi16(r0, r1), r01h = _mm_unpackhi_epi16(r0, r1);
+		const __m128i r2l = _mm_unpacklo_epi16(r2, _mm_setzero_si128()), r2h = _mm_unpackhi_epi16(r2, _mm_setzero_si128());
+		const __m128i e = _mm_packs_epi32(_mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(r01l, c01), _mm_madd_epi16(r2l, c2)), 10), _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(r01h, c01), _mm_madd_epi16(r2h, c2)), 10));
+		const __m128i o = _mm_packs_epi32(_mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(r01l, c10), _mm_madd_epi16(r2l, c3)), 10), _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(r01h, c10), _mm_madd_epi16(r2h, c3)), 10));
+		_mm_storel_epi64((__m128i*)(b0 + i), _mm_packus_epi16(e, e));
+		_mm_storel_epi64((__m128i*)(b1 + i), _mm_packus_epi16(o, o));
+	}
+#elif defined(HAVE_NEON)
+	for (; i < n - 7; i += 8)
+	{
+		int32x4_t e[2], o[2];
+		int j;
+		for (j = 0; j < 2; j++)
+		{
+			const int32x4_t r0 = vld1q_s32(rows[0] + i + j * 4);
+			const int32x4_t r1 = vmulq_n_s32(vld1q_s32(rows[1] + i + j * 4), 23);
+			const int32x4_t r2 = vld1q_s32(rows[2] + i + j * 4);
+			e[j] = vshrq_n_s32(vaddq_s32(vmlaq_n_s32(r1, r0, 8), r2), 10);
+			o[j] = vshrq_n_s32(vaddq_s32(vmlaq_n_s32(r1, r2, 8), r0), 10);
+		}
+		vst1_u8(b0 + i, vqmovun_s16(vcombine_s16(vqmovn_s32(e[0]), vqmovn_s32(e[1]))));
+		vst1_u8(b1 + i, vqmovun_s16(vcombine_s16(vqmovn_s32(o[0]), vqmovn_s32(o[1]))));
+	}
+#endif
+	return i;
+}
+
 void ccv_sample_up(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int src_x, int src_y)
 {
 	assert(src_x >= 0 && src_y >= 0);
@@ -455,69 +877,78 @@ void ccv_sample_up(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int
 	int ch = CCV_GET_CHANNEL(a->type);
 	int cols0 = a->cols - 1 - src_x;
 	assert(a->cols > 0 && cols0 > 0);
-	int y, x, sy = -1 + src_y, sx = src_x * ch, k;
+	int x, sx = src_x * ch, k;
 	int* tab = (int*)alloca((a->cols + src_x + 2) * ch * sizeof(int));
 	for (x = 0; x < a->cols + src_x + 2; x++)
 		for (k = 0; k < ch; k++)
 			tab[x * ch + k] = ((x >= a->cols) ? a->cols * 2 - 1 - x : x) * ch + k;
-	unsigned char* buf = (unsigned char*)alloca(3 * db->cols * ch * ccv_max(CCV_GET_DATA_TYPE_SIZE(db->type), sizeof(int)));
 	int bufstep = db->cols * ch * ccv_max(CCV_GET_DATA_TYPE_SIZE(db->type), sizeof(int));
-#ifdef __clang_analyzer__
-	memset(buf, 0, 3 * bufstep);
-#endif
-	unsigned char* b_ptr = db->data.u8;
-	/* why src_y * 2: the same argument as in ccv_sample_down */
+	const int u8 = (CCV_GET_DATA_TYPE(a->type) == CCV_8U && CCV_GET_DATA_TYPE(db->type) == CCV_8U);
+	const int u8_c1 = (u8 && ch == 1);
+	/* why src_y * 2: the same argument as in ccv_sample_down, and the same tiling of destination rows (in pairs) */
 #define for_block(_for_get_a, _for_set, _for_get, _for_set_b) \
-	for (y = 0; y < a->rows; y++) \
-	{ \
-		for (; sy <= y + 1 + src_y; sy++) \
+	parallel_for(t, (a->rows + CCV_RESAMPLE_TILE_ROWS - 1) / CCV_RESAMPLE_TILE_ROWS) { \
+		int y, x, k; \
+		unsigned char* buf = (unsigned char*)ccmalloc(3 * bufstep); \
+		const int y_end = ccv_min(a->rows, (t + 1) * CCV_RESAMPLE_TILE_ROWS); \
+		int sy = t * CCV_RESAMPLE_TILE_ROWS - 1 + src_y; \
+		unsigned char* b_ptr = db->data.u8 + db->step * 2 * t * CCV_RESAMPLE_TILE_ROWS; \
+		for (y = t * CCV_RESAMPLE_TILE_ROWS; y < y_end; y++) \
 		{ \
-			unsigned char* row = buf + ((sy + src_y * 2 + 1) % 3) * bufstep; \
-			int _sy = (sy < 0) ? -1 - sy : (sy >= a->rows) ? a->rows * 2 - 1 - sy : sy; \
-			unsigned char* a_ptr = a->data.u8 + a->step * _sy; \
-			if (a->cols == 1) \
+			for (; sy <= y + 1 + src_y; sy++) \
 			{ \
-				for (k = 0; k < ch; k++) \
+				unsigned char* row = buf + ((sy + src_y * 2 + 1) % 3) * bufstep; \
+				int _sy = (sy < 0) ? -1 - sy : (sy >= a->rows) ? a->rows * 2 - 1 - sy : sy; \
+				unsigned char* a_ptr = a->data.u8 + a->step * _sy; \
+				if (a->cols == 1) \
 				{ \
-					_for_set(row, k, _for_get_a(a_ptr, k, 0) * (G025 + G075 + G125), 0); \
-					_for_set(row, k + ch, _for_get_a(a_ptr, k, 0) * (G025 + G075 + G125), 0); \
+					for (k = 0; k < ch; k++) \
+					{ \
+						_for_set(row, k, _for_get_a(a_ptr, k, 0) * (G025 + G075 + G125), 0); \
+						_for_set(row, k + ch, _for_get_a(a_ptr, k, 0) * (G025 + G075 + G125), 0); \
+					} \
+					continue; \
 				} \
-				continue; \
-			} \
-			if (sx == 0) \
-			{ \
-				for (k = 0; k < ch; k++) \
+				if (sx == 0) \
 				{ \
-					_for_set(row, k, _for_get_a(a_ptr, k + sx, 0) * (G025 + G075) + _for_get_a(a_ptr, k + sx + ch, 0) * G125, 0); \
-					_for_set(row, k + ch, _for_get_a(a_ptr, k + sx, 0) * (G125 + G025) + _for_get_a(a_ptr, k + sx + ch, 0) * G075, 0); \
+					for (k = 0; k < ch; k++) \
+					{ \
+						_for_set(row, k, _for_get_a(a_ptr, k + sx, 0) * (G025 + G075) + _for_get_a(a_ptr, k + sx + ch, 0) * G125, 0); \
+						_for_set(row, k + ch, _for_get_a(a_ptr, k + sx, 0) * (G125 + G025) + _for_get_a(a_ptr, k + sx + ch, 0) * G075, 0); \
+					} \
 				} \
-			} \
-			/* some serious flaw in computing Gaussian weighting in previous version
-			 * specially, we are doing perfect upsampling (2x) so, it concerns a grid like:
-			 * XXYY
-			 * XXYY
-			 * in this case, to upsampling, the weight should be from distance 0.25 and 1.25, and 0.25 and 0.75
-			 * previously, it was mistakingly be 0.0 1.0, 0.5 0.5 (imperfect upsampling (2x - 1)) */ \
-			for (x = (sx == 0) ? ch : 0; x < cols0 * ch; x += ch) \
-			{ \
-				for (k = 0; k < ch; k++) \
+				/* some serious flaw in computing Gaussian weighting in previous version
+				 * specially, we are doing perfect upsampling (2x) so, it concerns a grid like:
+				 * XXYY
+				 * XXYY
+				 * in this case, to upsampling, the weight should be from distance 0.25 and 1.25, and 0.25 and 0.75
+				 * previously, it was mistakingly be 0.0 1.0, 0.5 0.5 (imperfect upsampling (2x - 1)) */ \
+				x = (sx == 0) ? ch : 0; \
+				if (u8_c1) \
+					x = _ccv_sample_up_h_8u(a_ptr + sx, (int*)row, x, cols0, a->cols - sx); \
+				for (; x < cols0 * ch; x += ch) \
 				{ \
-					_for_set(row, x * 2 + k, _for_get_a(a_ptr, x + sx - ch + k, 0) * G075 + _for_get_a(a_ptr, x + sx + k, 0) * G025 + _for_get_a(a_ptr, x + sx + ch + k, 0) * G125, 0); \
-					_for_set(row, x * 2 + ch + k, _for_get_a(a_ptr, x + sx - ch + k, 0) * G125 + _for_get_a(a_ptr, x + sx + k, 0) * G025 + _for_get_a(a_ptr, x + sx + ch + k, 0) * G075, 0); \
+					for (k = 0; k < ch; k++) \
+					{ \
+						_for_set(row, x * 2 + k, _for_get_a(a_ptr, x + sx - ch + k, 0) * G075 + _for_get_a(a_ptr, x + sx + k, 0) * G025 + _for_get_a(a_ptr, x + sx + ch + k, 0) * G125, 0); \
+						_for_set(row, x * 2 + ch + k, _for_get_a(a_ptr, x + sx - ch + k, 0) * G125 + _for_get_a(a_ptr, x + sx + k, 0) * G025 + _for_get_a(a_ptr, x + sx + ch + k, 0) * G075, 0); \
+					} \
 				} \
+				x_block(_for_get_a, _for_set, _for_get, _for_set_b); \
 			} \
-			x_block(_for_get_a, _for_set, _for_get, _for_set_b); \
-		} \
-		unsigned char* rows[3]; \
-		for (k = 0; k < 3; k++) \
-			rows[k] = buf + ((y + k) % 3) * bufstep; \
-		for (x = 0; x < db->cols * ch; x++) \
-		{ \
-			_for_set_b(b_ptr, x, (_for_get(rows[0], x, 0) * G075 + _for_get(rows[1], x, 0) * G025 + _for_get(rows[2], x, 0) * G125) / GALL, 0); \
-			_for_set_b(b_ptr + db->step, x, (_for_get(rows[0], x, 0) * G125 + _for_get(rows[1], x, 0) * G025 + _for_get(rows[2], x, 0) * G075) / GALL, 0); \
+			unsigned char* rows[3]; \
+			for (k = 0; k < 3; k++) \
+				rows[k] = buf + ((y + k) % 3) * bufstep; \
+			x = u8 ? _ccv_sample_up_v_8u((int* const*)rows, b_ptr, b_ptr + db->step, db->cols * ch) : 0; \
+			for (; x < db->cols * ch; x++) \
+			{ \
+				_for_set_b(b_ptr, x, (_for_get(rows[0], x, 0) * G075 + _for_get(rows[1], x, 0) * G025 + _for_get(rows[2], x, 0) * G125) / GALL, 0); \
+				_for_set_b(b_ptr + db->step, x, (_for_get(rows[0], x, 0) * G125 + _for_get(rows[1], x, 0) * G025 + _for_get(rows[2], x, 0) * G075) / GALL, 0); \
+			} \
+			b_ptr += 2 * db->step; \
 		} \
-		b_ptr += 2 * db->step; \
-	}
+		ccfree(buf); \
+	} parallel_endfor
 	int no_8u_type = (a->type & CCV_8U) ? CCV_32S : a->type;
 	/* unswitch if condition in manual way */
 	if ((a->type & CCV_8U) || (a->type & CCV_32S) || (a->type & CCV_64S))
@@ -584,3 +1015,299 @@ void ccv_sample_up(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, int
 	}
 #undef for_block
 }
+
+void ccv_pyramid_build(ccv_dense_matrix_t* a, ccv_dense_matrix_t** pyr, int levels, int interval, int shifted)
+{
+	assert(levels > 0 && interval >= 0);
+	const int next = interval + 1;
+	assert(shifted == 0 || shifted >= next);
+	const int stride = shifted > 0 ? 4 : 1;
+	const double scale = pow(2., 1. / (interval + 1.));
+	memset(pyr, 0, sizeof(ccv_dense_matrix_t*) * levels * stride);
+	pyr[0] = a;
+	/* a level only depends on the one an octave above (or the input for the first octave), thus, all levels of an
+	 * octave (and their shifted variants) are computed together, and they read the same octave above while it is
+	 * still in cache */
+	parallel_for(i, ccv_min(next, levels) - 1) {
+		ccv_resample(a, &pyr[(i + 1) * stride], 0, (int)(a->rows / pow(scale, i + 1)), (int)(a->cols / pow(scale, i + 1)), CCV_INTER_AREA);
+	} parallel_endfor
+	int octave;
+	for (octave = next; octave < levels; octave += next)
+	{
+		parallel_for(i, ccv_min(next, levels - octave) * stride) {
+			const int level = octave + i / stride;
+			const int shift = i % stride;
+			if (shift == 0 || level >= shifted)
+				ccv_sample_down(pyr[(level - next) * stride], &pyr[level * stride + shift], 0, shift & 1, shift >> 1);
+		} parallel_endfor
+	}
+}
+
+typedef struct {
+	int level;
+	int product;
+	int param;
+	ccv_dense_matrix_t* x;
+} ccv_image_pyramid_product_t;
+
+struct ccv_image_pyramid_s {
+	int refcount;
+	int interval;
+	int size; // the capacity of levels, a level is 0 until it is computed
+	ccv_dense_matrix_t* a;
+	ccv_dense_matrix_t** levels;
+	ccv_array_t* products;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t mutex;
+#endif
+};
+
+static inline void _ccv_image_pyramid_lock(ccv_image_pyramid_t* pyramid)
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&pyramid->mutex);
+#endif
+}
+
+static inline void _ccv_image_pyramid_unlock(ccv_image_pyramid_t* pyramid)
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&pyramid->mutex);
+#endif
+}
+
+ccv_image_pyramid_t* ccv_image_pyramid_new(ccv_dense_matrix_t* a, int interval)
+{
+	assert(interval >= 0);
+	ccv_image_pyramid_t* pyramid = (ccv_image_pyramid_t*)ccmalloc(sizeof(ccv_image_pyramid_t));
+	pyramid->refcount = 1;
+	pyramid->interval = interval;
+	pyramid->size = interval + 1;
+	pyramid->a = a;
+	pyramid->levels = (ccv_dense_matrix_t**)cccalloc(pyramid->size, sizeof(ccv_dense_matrix_t*));
+	pyramid->levels[0] = a;
+	pyramid->products = ccv_array_new(sizeof(ccv_image_pyramid_product_t), 16, 0);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&pyramid->mutex, 0);
+#endif
+	return pyramid;
+}
+
+ccv_image_pyramid_t* ccv_image_pyramid_retain(ccv_image_pyramid_t* pyramid)
+{
+	_ccv_image_pyramid_lock(pyramid);
+	assert(pyramid->refcount > 0);
+	++pyramid->refcount;
+	_ccv_image_pyramid_unlock(pyramid);
+	return pyramid;
+}
+
+void ccv_image_pyramid_free(ccv_image_pyramid_t* pyramid)
+{
+	_ccv_image_pyramid_lock(pyramid);
+	assert(pyramid->refcount > 0);
+	const int refcount = --pyramid->refcount;
+	_ccv_image_pyramid_unlock(pyramid);
+	if (refcount > 0)
+		return;
+	int i;
+	for (i = 0; i < pyramid->products->rnum; i++)
+		ccv_matrix_free(((ccv_image_pyramid_product_t*)ccv_array_get(pyramid->products, i))->x);
+	ccv_array_free(pyramid->products);
+	for (i = 1; i < pyramid->size; i++)
+		if (pyramid->levels[i])
+			ccv_matrix_free(pyramid->levels[i]);
+	ccfree(pyramid->levels);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_destroy(&pyramid->mutex);
+#endif
+	ccfree(pyramid);
+}
+
+ccv_dense_matrix_t* ccv_image_pyramid_source(ccv_image_pyramid_t* pyramid)
+{
+	return pyramid->a;
+}
+
+int ccv_image_pyramid_interval(ccv_image_pyramid_t* pyramid)
+{
+	return pyramid->interval;
+}
+
+// compute the levels last, last - step, last - 2 * step ... down to 0 and whatever they depend on, with the mutex held
+static void _ccv_image_pyramid_reserve(ccv_image_pyramid_t* pyramid, int last, int step)
+{
+	const int next = pyramid->interval + 1;
+	if (last >= pyramid->size)
+	{
+		const int size = ccv_max(last + 1, pyramid->size * 2);
+		pyramid->levels = (ccv_dense_matrix_t**)ccrealloc(pyramid->levels, sizeof(ccv_dense_matrix_t*) * size);
+		memset(pyramid->levels + pyramid->size, 0, sizeof(ccv_dense_matrix_t*) * (size - pyramid->size));
+		pyramid->size = size;
+	}
+	const double scale = pow(2., 1. / (pyramid->interval + 1.));
+	ccv_dense_matrix_t* a = pyramid->a;
+	ccv_dense_matrix_t** levels = pyramid->levels;
+	int octave;
+	// the same order as ccv_pyramid_build, a level only depends on the one an octave above
+	for (octave = 0; octave <= last; octave += next)
+	{
+		parallel_for(i, ccv_min(next, last + 1 - octave)) {
+			const int level = octave + i;
+			int k, wanted = 0;
+			// a level is wanted if itself or one below it by whole octaves is
+			for (k = level; !wanted && k <= last; k += next)
+				wanted = ((last - k) % step == 0);
+			if (wanted && !levels[level])
+			{
+				if (octave == 0)
+					ccv_resample(a, &levels[level], 0, (int)(a->rows / pow(scale, i)), (int)(a->cols / pow(scale, i)), CCV_INTER_AREA);
+				else
+					ccv_sample_down(levels[level - next], &levels[level], 0, 0, 0);
+			}
+		} parallel_endfor
+	}
+}
+
+void ccv_image_pyramid_reserve(ccv_image_pyramid_t* pyramid, int count, int step)
+{
+	assert(count > 0 && step > 0);
+	_ccv_image_pyramid_lock(pyramid);
+	_ccv_image_pyramid_reserve(pyramid, (count - 1) * step, step);
+	_ccv_image_pyramid_unlock(pyramid);
+}
+
+ccv_dense_matrix_t* ccv_image_pyramid_level(ccv_image_pyramid_t* pyramid, int level)
+{
+	assert(level >= 0);
+	_ccv_image_pyramid_lock(pyramid);
+	_ccv_image_pyramid_reserve(pyramid, level, level + 1);
+	ccv_dense_matrix_t* x = pyramid->levels[level];
+	_ccv_image_pyramid_unlock(pyramid);
+	return x;
+}
+
+static ccv_dense_matrix_t* _ccv_image_pyramid_find_product(ccv_image_pyramid_t* pyramid, int level, int product, int param)
+{
+	int i;
+	for (i = 0; i < pyramid->products->rnum; i++)
+	{
+		ccv_image_pyramid_product_t* p = (ccv_image_pyramid_product_t*)ccv_array_get(pyramid->products, i);
+		if (p->level == level && p->product == product && p->param == param)
+			return p->x;
+	}
+	return 0;
+}
+
+ccv_dense_matrix_t* ccv_image_pyramid_derived(ccv_image_pyramid_t* pyramid, int level, int product, int param)
+{
+	const int next = pyramid->interval + 1;
+	assert(level >= 0);
+	assert(product != CCV_IMAGE_PYRAMID_SHIFTED || (level >= next && param >= 1 && param <= 3));
+	_ccv_image_pyramid_lock(pyramid);
+	ccv_dense_matrix_t* x = _ccv_image_pyramid_find_product(pyramid, level, product, param);
+	if (x)
+	{
+		_ccv_image_pyramid_unlock(pyramid);
+		return x;
+	}
+	// a shifted variant is sampled down from the level one octave above
+	const int source = product == CCV_IMAGE_PYRAMID_SHIFTED ? level - next : level;
+	_ccv_image_pyramid_reserve(pyramid, source, source + 1);
+	ccv_dense_matrix_t* a = pyramid->levels[source];
+	_ccv_image_pyramid_unlock(pyramid);
+	switch (product)
+	{
+		case CCV_IMAGE_PYRAMID_GRAY:
+			if (CCV_GET_CHANNEL(a->type) == CCV_C1)
+				return a;
+			ccv_color_transform(a, &x, 0, CCV_RGB_TO_GRAY);
+			break;
+		case CCV_IMAGE_PYRAMID_LUV:
+			ccv_color_transform(a, &x, 0, CCV_RGB_TO_LUV);
+			break;
+		case CCV_IMAGE_PYRAMID_HOG:
+			ccv_hog(a, &x, 0, 9, param);
+			break;
+		case CCV_IMAGE_PYRAMID_SAT:
+			ccv_sat(a, &x, 0, param);
+			break;
+		case CCV_IMAGE_PYRAMID_SHIFTED:
+			ccv_sample_down(a, &x, 0, param & 1, param >> 1);
+			break;
+		default:
+			assert(0 && "unknown image pyramid product");
+	}
+	// computed without the mutex, thus, another thread may have got the same product in the mean time, keep the first one
+	_ccv_image_pyramid_lock(pyramid);
+	ccv_dense_matrix_t* y = _ccv_image_pyramid_find_product(pyramid, level, product, param);
+	if (y)
+	{
+		_ccv_image_pyramid_unlock(pyramid);
+		ccv_matrix_free(x);
+		return y;
+	}
+	ccv_image_pyramid_product_t p;
+	p.level = level;
+	p.product = product;
+	p.param = param;
+	p.x = x;
+	ccv_array_push(pyramid->products, &p);
+	_ccv_image_pyramid_unlock(pyramid);
+	return x;
+}
+
+void ccv_image_pyramid_derived_batch(ccv_image_pyramid_t* pyramid, const int* level, int product, const int* param, int count, ccv_dense_matrix_t** x)
+{
+	int i;
+	if (product != CCV_IMAGE_PYRAMID_HOG)
+	{
+		parallel_for(i, count) {
+			x[i] = ccv_image_pyramid_derived(pyramid, level[i], product, param[i]);
+		} parallel_endfor
+		return;
+	}
+	// the missing HOG products are computed together with ccv_hog_batch, which keeps all threads busy over the whole batch
+	int* missing = (int*)alloca(sizeof(int) * count * 2);
+	int* size = missing + count;
+	ccv_dense_matrix_t** a = (ccv_dense_matrix_t**)alloca(sizeof(ccv_dense_matrix_t*) * count * 2);
+	ccv_dense_matrix_t** y = a + count;
+	int n = 0;
+	_ccv_image_pyramid_lock(pyramid);
+	for (i = 0; i < count; i++)
+	{
+		assert(level[i] >= 0);
+		x[i] = _ccv_image_pyramid_find_product(pyramid, level[i], product, param[i]);
+		if (!x[i])
+		{
+			_ccv_image_pyramid_reserve(pyramid, level[i], level[i] + 1);
+			missing[n] = i;
+			a[n] = pyramid->levels[level[i]];
+			size[n] = param[i];
+			y[n] = 0;
+			++n;
+		}
+	}
+	_ccv_image_pyramid_unlock(pyramid);
+	if (!n)
+		return;
+	ccv_hog_batch(a, y, 0, 9, size, n);
+	_ccv_image_pyramid_lock(pyramid);
+	for (i = 0; i < n; i++)
+	{
+		const int k = missing[i];
+		// the same product can be in the batch twice, or another thread got it in the mean time, keep the first one
+		x[k] = _ccv_image_pyramid_find_product(pyramid, level[k], product, param[k]);
+		if (x[k])
+			ccv_matrix_free(y[i]);
+		else {
+			ccv_image_pyramid_product_t p;
+			p.level = level[k];
+			p.product = product;
+			p.param = param[k];
+			p.x = x[k] = y[i];
+			ccv_array_push(pyramid->products, &p);
+		}
+	}
+	_ccv_image_pyramid_unlock(pyramid);
+}
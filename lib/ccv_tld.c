@@ -113,15 +113,14 @@ static ccv_rect_t _ccv_tld_short_term_track(ccv_dense_matrix_t* a, ccv_dense_mat
 	ccv_array_t* point_c = 0;
 	ccv_optical_flow_lucas_kanade(b, a, point_b, &point_c, params.win_size, params.level, params.min_eigen);
 	// compute forward-backward error
-	ccv_dense_matrix_t* r0 = (ccv_dense_matrix_t*)alloca(ccv_compute_dense_matrix_size(TLD_PATCH_SIZE, TLD_PATCH_SIZE, CCV_8U | CCV_C1));
-	ccv_dense_matrix_t* r1 = (ccv_dense_matrix_t*)alloca(ccv_compute_dense_matrix_size(TLD_PATCH_SIZE, TLD_PATCH_SIZE, CCV_8U | CCV_C1));
-	r0 = ccv_dense_matrix_new(TLD_PATCH_SIZE, TLD_PATCH_SIZE, CCV_8U | CCV_C1, r0, 0);
-	r1 = ccv_dense_matrix_new(TLD_PATCH_SIZE, TLD_PATCH_SIZE, CCV_8U | CCV_C1, r1, 0);
+	const int patch_size = ccv_compute_dense_matrix_size(TLD_PATCH_SIZE, TLD_PATCH_SIZE, CCV_8U | CCV_C1);
 	int i, j, k, size;
 	int* wrt = (int*)alloca(sizeof(int) * point_a->rnum);
 	{ // will reclaim the stack
 	float* fberr = (float*)alloca(sizeof(float) * point_a->rnum);
 	float* sim = (float*)alloca(sizeof(float) * point_a->rnum);
+	ccv_decimal_point_t* q0 = (ccv_decimal_point_t*)alloca(sizeof(ccv_decimal_point_t) * point_a->rnum * 2);
+	ccv_decimal_point_t* q1 = q0 + point_a->rnum;
 	for (i = 0, k = 0; i < point_a->rnum; i++)
 	{
 		ccv_decimal_point_t* p0 = (ccv_decimal_point_t*)ccv_array_get(point_a, i);
@@ -132,13 +131,26 @@ static ccv_rect_t _ccv_tld_short_term_track(ccv_dense_matrix_t* a, ccv_dense_mat
 			p2->point.x >= 0 && p2->point.x < a->cols && p2->point.y >= 0 && p2->point.y < a->rows)
 		{
 			fberr[k] = (p2->point.x - p0->x) * (p2->point.x - p0->x) + (p2->point.y - p0->y) * (p2->point.y - p0->y);
-			ccv_decimal_slice(a, &r0, 0, p0->y - (TLD_PATCH_SIZE - 1) * 0.5, p0->x - (TLD_PATCH_SIZE - 1) * 0.5, TLD_PATCH_SIZE, TLD_PATCH_SIZE);
-			ccv_decimal_slice(b, &r1, 0, p1->point.y - (TLD_PATCH_SIZE - 1) * 0.5, p1->point.x - (TLD_PATCH_SIZE - 1) * 0.5, TLD_PATCH_SIZE, TLD_PATCH_SIZE);
-			sim[k] = _ccv_tld_norm_cross_correlate(r0, r1);
+			q0[k] = ccv_decimal_point(p0->x - (TLD_PATCH_SIZE - 1) * 0.5, p0->y - (TLD_PATCH_SIZE - 1) * 0.5);
+			q1[k] = ccv_decimal_point(p1->point.x - (TLD_PATCH_SIZE - 1) * 0.5, p1->point.y - (TLD_PATCH_SIZE - 1) * 0.5);
 			wrt[k] = i;
 			++k;
 		}
 	}
+	// slice all the patches around these points at once
+	unsigned char* patches = (unsigned char*)ccmalloc(patch_size * k * 2 + 1);
+	ccv_dense_matrix_t** r0 = (ccv_dense_matrix_t**)alloca(sizeof(ccv_dense_matrix_t*) * (k * 2 + 1));
+	ccv_dense_matrix_t** r1 = r0 + k;
+	for (i = 0; i < k; i++)
+	{
+		r0[i] = ccv_dense_matrix_new(TLD_PATCH_SIZE, TLD_PATCH_SIZE, CCV_8U | CCV_C1, patches + patch_size * i, 0);
+		r1[i] = ccv_dense_matrix_new(TLD_PATCH_SIZE, TLD_PATCH_SIZE, CCV_8U | CCV_C1, patches + patch_size * (k + i), 0);
+	}
+	ccv_decimal_slice_batch(a, r0, 0, q0, TLD_PATCH_SIZE, TLD_PATCH_SIZE, k);
+	ccv_decimal_slice_batch(b, r1, 0, q1, TLD_PATCH_SIZE, TLD_PATCH_SIZE, k);
+	for (i = 0; i < k; i++)
+		sim[i] = _ccv_tld_norm_cross_correlate(r0[i], r1[i]);
+	ccfree(patches);
 	ccv_array_free(point_c);
 	if (k == 0)
 	{
@@ -381,59 +393,111 @@ static ccv_comp_t _ccv_tld_generate_box_for(ccv_size_t image_size, ccv_size_t in
 	return best_box;
 }
 
-static void _ccv_tld_ferns_feature_for(ccv_ferns_t* ferns, ccv_dense_matrix_t* a, ccv_comp_t box, uint32_t* fern, dsfmt_t* dsfmt, float deform_angle, float deform_scale, float deform_shift)
+static void _ccv_tld_ferns_feature_for(ccv_ferns_t* ferns, ccv_dense_matrix_t* a, ccv_comp_t box, uint32_t* fern)
+{
+	assert(box.rect.x >= 0 && box.rect.x < a->cols);
+	assert(box.rect.y >= 0 && box.rect.y < a->rows);
+	assert(box.rect.x + box.rect.width <= a->cols);
+	assert(box.rect.y + box.rect.height <= a->rows);
+	ccv_dense_matrix_t roi = ccv_dense_matrix(box.rect.height, box.rect.width, CCV_GET_DATA_TYPE(a->type) | CCV_GET_CHANNEL(a->type), ccv_get_dense_matrix_cell(a, box.rect.y, box.rect.x, 0), 0);
+	roi.step = a->step;
+	ccv_ferns_feature(ferns, &roi, box.classification.id, fern);
+}
+
+// the random deformation of the box is about the center of its hull (the box with some padding), normalized by the size of the hull,
+// rewrite it about the center of a and normalized by the size of a, thus, it picks the same pixels when transforming a itself
+static void _ccv_tld_deform_for(ccv_dense_matrix_t* a, ccv_comp_t box, dsfmt_t* dsfmt, float deform_angle, float deform_scale, float deform_shift, float* m, ccv_rect_t* rect)
 {
 	assert(box.rect.x >= 0 && box.rect.x < a->cols);
 	assert(box.rect.y >= 0 && box.rect.y < a->rows);
 	assert(box.rect.x + box.rect.width <= a->cols);
 	assert(box.rect.y + box.rect.height <= a->rows);
-	if (!dsfmt)
+	float rotate_x = (deform_angle * 2 * dsfmt_genrand_close_open(dsfmt) - deform_angle) * CCV_PI / 180;
+	float rotate_y = (deform_angle * 2 * dsfmt_genrand_close_open(dsfmt) - deform_angle) * CCV_PI / 180;
+	float rotate_z = (deform_angle * 2 * dsfmt_genrand_close_open(dsfmt) - deform_angle) * CCV_PI / 180;
+	float scale = 1 + deform_scale  - deform_scale * 2 * dsfmt_genrand_close_open(dsfmt);
+	float m00 = cosf(rotate_z) * scale;
+	float m01 = cosf(rotate_y) * sinf(rotate_z) * scale;
+	float m02 = (deform_shift * 2 * dsfmt_genrand_close_open(dsfmt) - deform_shift) * box.rect.width;
+	float m10 = (sinf(rotate_y) * cosf(rotate_z) - cosf(rotate_x) * sinf(rotate_z)) * scale;
+	float m11 = (sinf(rotate_y) * sinf(rotate_z) + cosf(rotate_x) * cosf(rotate_z)) * scale;
+	float m12 = (deform_shift * dsfmt_genrand_close_open(dsfmt) - deform_shift) * box.rect.height;
+	float m20 = (sinf(rotate_y) * cosf(rotate_z) + sinf(rotate_x) * sinf(rotate_z)) * scale;
+	float m21 = (sinf(rotate_y) * sinf(rotate_z) - sinf(rotate_x) * cosf(rotate_z)) * scale;
+	float m22 = cosf(rotate_x) * cosf(rotate_y);
+	ccv_decimal_point_t p00 = ccv_perspective_transform_apply(ccv_decimal_point(0, 0), ccv_size(box.rect.width, box.rect.height), m00, m01, m02, m10, m11, m12, m20, m21, m22);
+	ccv_decimal_point_t p01 = ccv_perspective_transform_apply(ccv_decimal_point(box.rect.width, 0), ccv_size(box.rect.width, box.rect.height), m00, m01, m02, m10, m11, m12, m20, m21, m22);
+	ccv_decimal_point_t p10 = ccv_perspective_transform_apply(ccv_decimal_point(0, box.rect.height), ccv_size(box.rect.width, box.rect.height), m00, m01, m02, m10, m11, m12, m20, m21, m22);
+	ccv_decimal_point_t p11 = ccv_perspective_transform_apply(ccv_decimal_point(box.rect.width, box.rect.height), ccv_size(box.rect.width, box.rect.height), m00, m01, m02, m10, m11, m12, m20, m21, m22);
+	int padding_top = (int)(ccv_max(0, -ccv_min(p00.y, p01.y)) + 0.5) + 5;
+	padding_top = box.rect.y - ccv_max(box.rect.y - padding_top, 0);
+	int padding_right = (int)(ccv_max(0, ccv_max(p01.x, p11.x) - box.rect.width) + 0.5) + 5;
+	padding_right = ccv_min(box.rect.x + box.rect.width + padding_right, a->cols) - (box.rect.x + box.rect.width);
+	int padding_bottom = (int)(ccv_max(0, ccv_max(p10.y, p11.y) - box.rect.height) + 0.5) + 5;
+	padding_bottom = ccv_min(box.rect.y + box.rect.height + padding_bottom, a->rows) - (box.rect.y + box.rect.height);
+	int padding_left = (int)(ccv_max(0, -ccv_min(p00.x, p10.x)) + 0.5) + 5;
+	padding_left = box.rect.x - ccv_max(box.rect.x - padding_left, 0);
+	ccv_rect_t hull = ccv_rect(box.rect.x - padding_left, box.rect.y - padding_top,
+							   box.rect.width + padding_left + padding_right,
+							   box.rect.height + padding_top + padding_bottom);
+	assert(hull.x >= 0 && hull.x < a->cols);
+	assert(hull.y >= 0 && hull.y < a->rows);
+	assert(hull.x + hull.width <= a->cols);
+	assert(hull.y + hull.height <= a->rows);
+	// the same scaling ccv_perspective_transform_batch applies for the field of view, but with the size of the hull
+	const double hs = 1.0 / ccv_max(hull.width, hull.height);
+	const double n00 = m00 * hs, n01 = m01 * hs, n02 = m02 * hs;
+	const double n10 = m10 * hs, n11 = m11 * hs, n12 = m12 * hs;
+	const double n20 = m20 * hs * hs, n21 = m21 * hs * hs, n22 = m22 * hs;
+	// offset from the center of a to the center of the hull
+	const double tx = hull.x + hull.width * 0.5 - a->cols * 0.5;
+	const double ty = hull.y + hull.height * 0.5 - a->rows * 0.5;
+	const double f22 = n22 - n20 * tx - n21 * ty;
+	const double s = ccv_max(a->rows, a->cols);
+	m[0] = (n00 + tx * n20) * s;
+	m[1] = (n01 + tx * n21) * s;
+	m[2] = (n02 - n00 * tx - n01 * ty + tx * f22) * s;
+	m[3] = (n10 + ty * n20) * s;
+	m[4] = (n11 + ty * n21) * s;
+	m[5] = (n12 - n10 * tx - n11 * ty + ty * f22) * s;
+	m[6] = n20 * s * s;
+	m[7] = n21 * s * s;
+	m[8] = f22 * s;
+	// only the box of the transformed hull is needed
+	*rect = box.rect;
+}
+
+// the ferns features of the good boxes with random deformation, in the order they are visited by idx (for the given rounds),
+// thus, the same order they draw from dsfmt, all the transforms are done in one batch
+static uint32_t* _ccv_tld_deformed_ferns_for(ccv_ferns_t* ferns, ccv_dense_matrix_t* a, ccv_array_t* good, const int* idx, int badex, int rounds, dsfmt_t* dsfmt, float deform_angle, float deform_scale, float deform_shift)
+{
+	const int count = good->rnum * rounds;
+	uint32_t* fern = (uint32_t*)ccmalloc(sizeof(uint32_t) * ferns->structs * ccv_max(count, 1));
+	if (count == 0)
+		return fern;
+	ccv_dense_matrix_t** b = (ccv_dense_matrix_t**)cccalloc(count, sizeof(ccv_dense_matrix_t*));
+	ccv_comp_t* boxes = (ccv_comp_t*)ccmalloc((sizeof(ccv_comp_t) + sizeof(ccv_rect_t) + sizeof(float) * 9) * count);
+	ccv_rect_t* rect = (ccv_rect_t*)(boxes + count);
+	float* m = (float*)(rect + count);
+	int i, j, k = 0;
+	for (i = 0; i < rounds; i++)
+		for (j = 0; j < badex + good->rnum; j++)
+			if (idx[j] >= badex)
+			{
+				boxes[k] = *(ccv_comp_t*)ccv_array_get(good, idx[j] - badex);
+				_ccv_tld_deform_for(a, boxes[k], dsfmt, deform_angle, deform_scale, deform_shift, m + k * 9, rect + k);
+				++k;
+			}
+	assert(k == count);
+	ccv_perspective_transform_batch(a, b, 0, m, rect, count);
+	for (i = 0; i < count; i++)
 	{
-		ccv_dense_matrix_t roi = ccv_dense_matrix(box.rect.height, box.rect.width, CCV_GET_DATA_TYPE(a->type) | CCV_GET_CHANNEL(a->type), ccv_get_dense_matrix_cell(a, box.rect.y, box.rect.x, 0), 0);
-		roi.step = a->step;
-		ccv_ferns_feature(ferns, &roi, box.classification.id, fern);
-	} else {
-		float rotate_x = (deform_angle * 2 * dsfmt_genrand_close_open(dsfmt) - deform_angle) * CCV_PI / 180;
-		float rotate_y = (deform_angle * 2 * dsfmt_genrand_close_open(dsfmt) - deform_angle) * CCV_PI / 180;
-		float rotate_z = (deform_angle * 2 * dsfmt_genrand_close_open(dsfmt) - deform_angle) * CCV_PI / 180;
-		float scale = 1 + deform_scale  - deform_scale * 2 * dsfmt_genrand_close_open(dsfmt);
-		float m00 = cosf(rotate_z) * scale;
-		float m01 = cosf(rotate_y) * sinf(rotate_z) * scale;
-		float m02 = (deform_shift * 2 * dsfmt_genrand_close_open(dsfmt) - deform_shift) * box.rect.width;
-		float m10 = (sinf(rotate_y) * cosf(rotate_z) - cosf(rotate_x) * sinf(rotate_z)) * scale;
-		float m11 = (sinf(rotate_y) * sinf(rotate_z) + cosf(rotate_x) * cosf(rotate_z)) * scale;
-		float m12 = (deform_shift * dsfmt_genrand_close_open(dsfmt) - deform_shift) * box.rect.height;
-		float m20 = (sinf(rotate_y) * cosf(rotate_z) + sinf(rotate_x) * sinf(rotate_z)) * scale;
-		float m21 = (sinf(rotate_y) * sinf(rotate_z) - sinf(rotate_x) * cosf(rotate_z)) * scale;
-		float m22 = cosf(rotate_x) * cosf(rotate_y);
-		ccv_decimal_point_t p00 = ccv_perspective_transform_apply(ccv_decimal_point(0, 0), ccv_size(box.rect.width, box.rect.height), m00, m01, m02, m10, m11, m12, m20, m21, m22);
-		ccv_decimal_point_t p01 = ccv_perspective_transform_apply(ccv_decimal_point(box.rect.width, 0), ccv_size(box.rect.width, box.rect.height), m00, m01, m02, m10, m11, m12, m20, m21, m22);
-		ccv_decimal_point_t p10 = ccv_perspective_transform_apply(ccv_decimal_point(0, box.rect.height), ccv_size(box.rect.width, box.rect.height), m00, m01, m02, m10, m11, m12, m20, m21, m22);
-		ccv_decimal_point_t p11 = ccv_perspective_transform_apply(ccv_decimal_point(box.rect.width, box.rect.height), ccv_size(box.rect.width, box.rect.height), m00, m01, m02, m10, m11, m12, m20, m21, m22);
-		int padding_top = (int)(ccv_max(0, -ccv_min(p00.y, p01.y)) + 0.5) + 5;
-		padding_top = box.rect.y - ccv_max(box.rect.y - padding_top, 0);
-		int padding_right = (int)(ccv_max(0, ccv_max(p01.x, p11.x) - box.rect.width) + 0.5) + 5;
-		padding_right = ccv_min(box.rect.x + box.rect.width + padding_right, a->cols) - (box.rect.x + box.rect.width);
-		int padding_bottom = (int)(ccv_max(0, ccv_max(p10.y, p11.y) - box.rect.height) + 0.5) + 5;
-		padding_bottom = ccv_min(box.rect.y + box.rect.height + padding_bottom, a->rows) - (box.rect.y + box.rect.height);
-		int padding_left = (int)(ccv_max(0, -ccv_min(p00.x, p10.x)) + 0.5) + 5;
-		padding_left = box.rect.x - ccv_max(box.rect.x - padding_left, 0);
-		ccv_rect_t hull = ccv_rect(box.rect.x - padding_left, box.rect.y - padding_top,
-								   box.rect.width + padding_left + padding_right,
-								   box.rect.height + padding_top + padding_bottom);
-		assert(hull.x >= 0 && hull.x < a->cols);
-		assert(hull.y >= 0 && hull.y < a->rows);
-		assert(hull.x + hull.width <= a->cols);
-		assert(hull.y + hull.height <= a->rows);
-		ccv_dense_matrix_t roi = ccv_dense_matrix(hull.height, hull.width, CCV_GET_DATA_TYPE(a->type) | CCV_GET_CHANNEL(a->type), ccv_get_dense_matrix_cell(a, hull.y, hull.x, 0), 0);
-		roi.step = a->step;
-		ccv_dense_matrix_t* b = 0;
-		ccv_perspective_transform(&roi, &b, 0, m00, m01, m02, m10, m11, m12, m20, m21, m22);
-		roi = ccv_dense_matrix(box.rect.height, box.rect.width, CCV_GET_DATA_TYPE(b->type) | CCV_GET_CHANNEL(b->type), ccv_get_dense_matrix_cell(b, padding_top, padding_left, 0), 0);
-		roi.step = b->step;
-		ccv_ferns_feature(ferns, &roi, box.classification.id, fern);
-		ccv_matrix_free(b);
+		ccv_ferns_feature(ferns, b[i], boxes[i].classification.id, fern + i * ferns->structs);
+		ccv_matrix_free(b[i]);
 	}
+	ccfree(boxes);
+	ccfree(b);
+	return fern;
 }
 
 static void _ccv_tld_fetch_patch(ccv_tld_t* tld, ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, ccv_rect_t box)
@@ -564,7 +628,7 @@ static float _ccv_tld_ferns_compute_threshold(ccv_ferns_t* ferns, float ferns_th
 		ccv_comp_t* box = (ccv_comp_t*)ccv_array_get(bad, i);
 		if (_ccv_tld_box_variance(sat, sqsat, box->rect) > var_thres)
 		{
-			_ccv_tld_ferns_feature_for(ferns, ga, *box, fern, 0, 0, 0, 0);
+			_ccv_tld_ferns_feature_for(ferns, ga, *box, fern);
 			float c = ccv_ferns_predict(ferns, fern);
 			if (c > ferns_thres)
 				ferns_thres = c;
@@ -651,16 +715,14 @@ ccv_tld_t* ccv_tld_new(ccv_dense_matrix_t* a, ccv_rect_t box, ccv_tld_param_t pa
 	tld->var_thres = ccv_variance(b) * 0.5;
 	ccv_array_push(tld->sv[1], &b);
 	ccv_dense_matrix_t* sat = 0;
-	ccv_sat(a, &sat, 0, CCV_NO_PADDING);
-	ccv_dense_matrix_t* sq = 0;
-	ccv_multiply(a, a, (ccv_matrix_t**)&sq, 0);
 	ccv_dense_matrix_t* sqsat = 0;
-	ccv_sat(sq, &sqsat, 0, CCV_NO_PADDING);
-	ccv_matrix_free(sq);
+	ccv_sat_square(a, &sat, &sqsat, 0, CCV_NO_PADDING);
 	dsfmt_t* dsfmt = (dsfmt_t*)tld->dsfmt;
 	dsfmt_init_gen_rand(dsfmt, (uint32_t)tld);
 	{ // save stack fr alloca
 	uint32_t* fern = (uint32_t*)alloca(sizeof(uint32_t) * tld->ferns->structs);
+	uint32_t* gfern = _ccv_tld_deformed_ferns_for(tld->ferns, ga, good, idx, badex, 2, dsfmt, params.new_deform_angle, params.new_deform_scale, params.new_deform_shift);
+	uint32_t* pgfern = gfern;
 	for (i = 0; i < 2; i++) // run twice to take into account when warm up, we missed a few examples
 	{
 		for (j = 0; j < badex + good->rnum; j++)
@@ -672,20 +734,20 @@ ccv_tld_t* ccv_tld_new(ccv_dense_matrix_t* a, ccv_rect_t box, ccv_tld_param_t pa
 				assert(box->neighbors >= 0 && box->neighbors < best_box.neighbors);
 				if (_ccv_tld_box_variance(sat, sqsat, box->rect) > tld->var_thres * 0.5)
 				{
-					_ccv_tld_ferns_feature_for(tld->ferns, ga, *box, fern, 0, 0, 0, 0);
+					_ccv_tld_ferns_feature_for(tld->ferns, ga, *box, fern);
 					// fix the thresholding for negative
 					if (ccv_ferns_predict(tld->ferns, fern) >= tld->ferns->threshold)
 						ccv_ferns_correct(tld->ferns, fern, 0, 2);
 				}
 			} else {
-				ccv_comp_t* box = (ccv_comp_t*)ccv_array_get(good, k - badex);
-				_ccv_tld_ferns_feature_for(tld->ferns, ga, *box, fern, dsfmt, params.new_deform_angle, params.new_deform_scale, params.new_deform_shift);
 				// fix the thresholding for positive
-				if (ccv_ferns_predict(tld->ferns, fern) <= tld->ferns->threshold)
-					ccv_ferns_correct(tld->ferns, fern, 1, 2);
+				if (ccv_ferns_predict(tld->ferns, pgfern) <= tld->ferns->threshold)
+					ccv_ferns_correct(tld->ferns, pgfern, 1, 2);
+				pgfern += tld->ferns->structs;
 			}
 		}
 	}
+	ccfree(gfern);
 	} // reclaim stack
 	tld->ferns_thres = _ccv_tld_ferns_compute_threshold(tld->ferns, tld->ferns->threshold, ga, sat, sqsat, tld->var_thres * 0.5, bad, badex);
 	ccv_array_free(good);
@@ -757,6 +819,8 @@ static int _ccv_tld_quick_learn(ccv_tld_t* tld, ccv_dense_matrix_t* ga, ccv_dens
 		sfmt_genrand_shuffle(sfmt, idx, badex + good->rnum, sizeof(int));
 		dsfmt_t* dsfmt = (dsfmt_t*)tld->dsfmt;
 		uint32_t* fern = (uint32_t*)ccmalloc(sizeof(uint32_t) * tld->ferns->structs * (badex + 1));
+		uint32_t* gfern = _ccv_tld_deformed_ferns_for(tld->ferns, ga, good, idx, badex, 2, dsfmt, tld->params.track_deform_angle, tld->params.track_deform_scale, tld->params.track_deform_shift);
+		uint32_t* pgfern = gfern;
 		int r0 = tld->count % (tld->params.rotation + 1), r1 = tld->params.rotation + 1;
 		// train the fern classifier
 		for (i = 0; i < 2; i++) // run it twice to take into account the cases we missed when warm up
@@ -790,14 +854,14 @@ static int _ccv_tld_quick_learn(ccv_tld_t* tld, ccv_dense_matrix_t* ga, ccv_dens
 						pfern += tld->ferns->structs;
 					}
 				} else {
-					ccv_comp_t *box = (ccv_comp_t*)ccv_array_get(good, k - badex);
-					_ccv_tld_ferns_feature_for(tld->ferns, ga, *box, fern, dsfmt, tld->params.track_deform_angle, tld->params.track_deform_scale, tld->params.track_deform_shift);
 					// fix the thresholding for positive
-					if (ccv_ferns_predict(tld->ferns, fern) <= tld->ferns_thres)
-						ccv_ferns_correct(tld->ferns, fern, 1, 1);
+					if (ccv_ferns_predict(tld->ferns, pgfern) <= tld->ferns_thres)
+						ccv_ferns_correct(tld->ferns, pgfern, 1, 1);
+					pgfern += tld->ferns->structs;
 				}
 			}
 		}
+		ccfree(gfern);
 		ccfree(fern);
 		ccv_array_free(bad);
 		ccv_array_free(good);
@@ -835,7 +899,7 @@ static ccv_array_t* _ccv_tld_long_term_detect(ccv_tld_t* tld, ccv_dense_matrix_t
 		if (i % r1 == r0 &&
 			_ccv_tld_box_variance(sat, sqsat, box.rect) > tld->var_thres)
 		{
-			_ccv_tld_ferns_feature_for(tld->ferns, ga, box, fern, 0, 0, 0, 0);
+			_ccv_tld_ferns_feature_for(tld->ferns, ga, box, fern);
 			box.classification.confidence = ccv_ferns_predict(tld->ferns, fern);
 			if (box.classification.confidence > tld->ferns_thres)
 			{
@@ -919,12 +983,8 @@ ccv_comp_t ccv_tld_track_object(ccv_tld_t* tld, ccv_dense_matrix_t* a, ccv_dense
 	if (info)
 		info->track_success = tracked;
 	ccv_dense_matrix_t* sat = 0;
-	ccv_sat(b, &sat, 0, CCV_NO_PADDING);
-	ccv_dense_matrix_t* sq = 0;
-	ccv_multiply(b, b, (ccv_matrix_t**)&sq, 0);
 	ccv_dense_matrix_t* sqsat = 0;
-	ccv_sat(sq, &sqsat, 0, CCV_NO_PADDING);
-	ccv_matrix_free(sq);
+	ccv_sat_square(b, &sat, &sqsat, 0, CCV_NO_PADDING);
 	ccv_array_t* dd = _ccv_tld_long_term_detect(tld, gb, sat, sqsat, info);
 	if (info)
 	{
@@ -1,5 +1,51 @@
 #include "ccv.h"
 #include "ccv_internal.h"
+#if defined(HAVE_SSE2)
+#include <emmintrin.h>
+#elif defined(HAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+// the bilinear interpolation of n 8-bit values between two rows with 14-bit fixed point weights
+static void _ccv_decimal_slice_row_8u(const unsigned char* a0, const unsigned char* a1, unsigned char* b, int n, int ch, int w00, int w01, int w10, int w11)
+{
+	int j = 0;
+#if defined(HAVE_SSE2)
+	const __m128i z = _mm_setzero_si128();
+	const __m128i w0 = _mm_set1_epi32((w01 << 16) | (w00 & 0xffff));
+	const __m128i w1 = _mm_set1_epi32((w11 << 16) | (w10 & 0xffff));
+	for (; j <= n - 8; j += 8)
+	{
+		const __m128i p00 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(a0 + j)), z);
+		const __m128i p01 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(a0 + j + ch)), z);
+		const __m128i p10 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(a1 + j)), z);
+		const __m128i p11 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(a1 + j + ch)), z);
+		// negative sums (when w11 is rounded to -1) end up as 0 either way
+		const __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(p00, p01), w0), _mm_madd_epi16(_mm_unpacklo_epi16(p10, p11), w1)), 14);
+		const __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(p00, p01), w0), _mm_madd_epi16(_mm_unpackhi_epi16(p10, p11), w1)), 14);
+		_mm_storel_epi64((__m128i*)(b + j), _mm_packus_epi16(_mm_packs_epi32(lo, hi), z));
+	}
+#elif defined(HAVE_NEON)
+	for (; j <= n - 8; j += 8)
+	{
+		const int16x8_t p00 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(a0 + j)));
+		const int16x8_t p01 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(a0 + j + ch)));
+		const int16x8_t p10 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(a1 + j)));
+		const int16x8_t p11 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(a1 + j + ch)));
+		int32x4_t lo = vmull_n_s16(vget_low_s16(p00), w00);
+		lo = vmlal_n_s16(lo, vget_low_s16(p01), w01);
+		lo = vmlal_n_s16(lo, vget_low_s16(p10), w10);
+		lo = vshrq_n_s32(vmlal_n_s16(lo, vget_low_s16(p11), w11), 14);
+		int32x4_t hi = vmull_n_s16(vget_high_s16(p00), w00);
+		hi = vmlal_n_s16(hi, vget_high_s16(p01), w01);
+		hi = vmlal_n_s16(hi, vget_high_s16(p10), w10);
+		hi = vshrq_n_s32(vmlal_n_s16(hi, vget_high_s16(p11), w11), 14);
+		vst1_u8(b + j, vqmovun_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi))));
+	}
+#endif
+	for (; j < n; j++)
+		b[j] = ccv_clamp((a0[j] * w00 + a0[j + ch] * w01 + a1[j] * w10 + a1[j + ch] * w11) / (1 << 14), 0, 255);
+}
 
 void ccv_decimal_slice(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, float y, float x, int rows, int cols)
 {
@@ -72,7 +118,25 @@ void ccv_decimal_slice(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type,
 #define G11 (iw11)
 #define GCOM (1 << (W_BITS14 - 1))
 #define GALL (1 << (W_BITS14))
-		ccv_matrix_setter(db->type, ccv_matrix_getter_integer_only, a->type, for_block);
+		if (CCV_GET_DATA_TYPE(a->type) == CCV_8U && CCV_GET_DATA_TYPE(db->type) == CCV_8U)
+		{
+			for (i = 0; i < rows; i++)
+			{
+				_ccv_decimal_slice_row_8u(a_ptr, a_ptr + a->step, b_ptr, cols * ch, ch, iw00, iw01, iw10, iw11);
+				j = cols * ch;
+				if (cols_1)
+					_ccv_set_8u_value(b_ptr, j, (_ccv_get_8u_value(a_ptr, j, 0) * (G00 + G01) + _ccv_get_8u_value(a_ptr + a->step, j, 0) * G10 + _ccv_get_8u_value(a_ptr + a->step, j + ch, 0) * G11) / GALL, 0);
+				a_ptr += a->step;
+				b_ptr += db->step;
+			}
+			if (rows_1)
+			{
+				_ccv_decimal_slice_row_8u(a_ptr, a_ptr, b_ptr, cols * ch, ch, iw00 + iw10, iw01 + iw11, 0, 0);
+				if (cols_1)
+					b_ptr[cols * ch] = a_ptr[cols * ch];
+			}
+		} else
+			ccv_matrix_setter(db->type, ccv_matrix_getter_integer_only, a->type, for_block);
 #undef G00
 #undef G01
 #undef G10
@@ -116,41 +180,72 @@ ccv_decimal_point_t ccv_perspective_transform_apply(ccv_decimal_point_t point, c
 	return ccv_decimal_point(wx, wy);
 }
 
-// this method is a merely baseline implementation and has no optimization effort ever put into it, if at all
-void ccv_perspective_transform(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, float m00, float m01, float m02, float m10, float m11, float m12, float m20, float m21, float m22)
+// the source coordinates of the row cy of the output, from column x on, it is the same float arithmetics 4 at a time
+static void _ccv_perspective_transform_coordinates(ccv_dense_matrix_t* a, const float* m, float cy, int x, int cols, float* wxs, float* wys)
+{
+	const float crx = cy * m[1] + m[2];
+	const float cry = cy * m[4] + m[5];
+	const float crz = cy * m[7] + m[8];
+	int j = 0;
+#if defined(HAVE_SSE2)
+	const __m128 m00 = _mm_set1_ps(m[0]);
+	const __m128 m10 = _mm_set1_ps(m[3]);
+	const __m128 m20 = _mm_set1_ps(m[6]);
+	const __m128 crx4 = _mm_set1_ps(crx);
+	const __m128 cry4 = _mm_set1_ps(cry);
+	const __m128 crz4 = _mm_set1_ps(crz);
+	const __m128 hx = _mm_set1_ps(a->cols * 0.5);
+	const __m128 hy = _mm_set1_ps(a->rows * 0.5);
+	const __m128 one = _mm_set1_ps(1);
+	const __m128 four = _mm_set1_ps(4);
+	const float cx0 = x - a->cols * 0.5;
+	__m128 cx = _mm_setr_ps(cx0, cx0 + 1, cx0 + 2, cx0 + 3);
+	for (; j <= cols - 4; j += 4)
+	{
+		const __m128 wz = _mm_div_ps(one, _mm_add_ps(_mm_mul_ps(cx, m20), crz4));
+		_mm_storeu_ps(wxs + j, _mm_add_ps(hx, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(cx, m00), crx4), wz)));
+		_mm_storeu_ps(wys + j, _mm_add_ps(hy, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(cx, m10), cry4), wz)));
+		cx = _mm_add_ps(cx, four);
+	}
+#endif
+	for (; j < cols; j++)
+	{
+		float cx = x + j - a->cols * 0.5;
+		float wz = 1.0 / (cx * m[6] + crz);
+		wxs[j] = a->cols * 0.5 + (cx * m[0] + crx) * wz;
+		wys[j] = a->rows * 0.5 + (cx * m[3] + cry) * wz;
+	}
+}
+
+// rows [start, end) of db, which sits at (x, y) of the transformed a, with m already scaled for the field of view,
+// whatever outside of the transformed a is 0, the same as ccv_slice
+static void _ccv_perspective_transform_rows(ccv_dense_matrix_t* a, ccv_dense_matrix_t* db, const float* m, int x, int y, int start, int end)
 {
-	ccv_declare_derived_signature(sig, a->sig != 0, ccv_sign_with_format(64, "ccv_perspective_transform(%a,%a,%a,%a,%a,%a,%a,%a,%a)", m00, m01, m02, m10, m11, m12, m20, m21, m22), a->sig, CCV_EOF_SIGN);
-	type = (type == 0) ? CCV_GET_DATA_TYPE(a->type) | CCV_GET_CHANNEL(a->type) : CCV_GET_DATA_TYPE(type) | CCV_GET_CHANNEL(a->type);
-	ccv_dense_matrix_t* db = *b = ccv_dense_matrix_renew(*b, a->rows, a->cols, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), type, sig);
-	ccv_object_return_if_cached(, db);
 	// with default of bilinear interpolation
 	int i, j, k, ch = CCV_GET_CHANNEL(a->type);
+	const int j0 = ccv_max(0, -x);
+	const int j1 = ccv_max(j0, ccv_min(db->cols, a->cols - x));
+	const size_t pixel_size = CCV_GET_DATA_TYPE_SIZE(db->type) * ch;
+	float* wxs = (float*)alloca(sizeof(float) * (j1 - j0) * 2);
+	float* wys = wxs + (j1 - j0);
 	unsigned char* a_ptr = a->data.u8;
-	unsigned char* b_ptr = db->data.u8;
-	// assume field of view is 60, modify the matrix value to reflect that
-	// (basically, apply x / ccv_max(a->rows, a->cols), y / ccv_max(a->rows, a->cols) before hand
-	m00 *= 1.0 / ccv_max(a->rows, a->cols);
-	m01 *= 1.0 / ccv_max(a->rows, a->cols);
-	m02 *= 1.0 / ccv_max(a->rows, a->cols);
-	m10 *= 1.0 / ccv_max(a->rows, a->cols);
-	m11 *= 1.0 / ccv_max(a->rows, a->cols);
-	m12 *= 1.0 / ccv_max(a->rows, a->cols);
-	m20 *= 1.0 / (ccv_max(a->rows, a->cols) * ccv_max(a->rows, a->cols));
-	m21 *= 1.0 / (ccv_max(a->rows, a->cols) * ccv_max(a->rows, a->cols));
-	m22 *= 1.0 / ccv_max(a->rows, a->cols);
+	unsigned char* b_ptr = db->data.u8 + start * db->step;
 #define for_block(_for_set, _for_get) \
-	for (i = 0; i < db->rows; i++) \
+	for (i = start; i < end; i++) \
 	{ \
-		float cy = i - db->rows * 0.5; \
-		float crx = cy * m01 + m02; \
-		float cry = cy * m11 + m12; \
-		float crz = cy * m21 + m22; \
-		for (j = 0; j < db->cols; j++) \
+		if (y + i < 0 || y + i >= a->rows || j0 == j1) \
+		{ \
+			memset(b_ptr, 0, pixel_size * db->cols); \
+			b_ptr += db->step; \
+			continue; \
+		} \
+		memset(b_ptr, 0, pixel_size * j0); \
+		memset(b_ptr + pixel_size * j1, 0, pixel_size * (db->cols - j1)); \
+		_ccv_perspective_transform_coordinates(a, m, y + i - a->rows * 0.5, x + j0, j1 - j0, wxs, wys); \
+		for (j = j0; j < j1; j++) \
 		{ \
-			float cx = j - db->cols * 0.5; \
-			float wz = 1.0 / (cx * m20 + crz); \
-			float wx = a->cols * 0.5 + (cx * m00 + crx) * wz; \
-			float wy = a->rows * 0.5 + (cx * m10 + cry) * wz; \
+			float wx = wxs[j - j0]; \
+			float wy = wys[j - j0]; \
 			int iwx = (int)wx; \
 			int iwy = (int)wy; \
 			wx = wx - iwx; \
@@ -172,3 +267,78 @@ void ccv_perspective_transform(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, in
 	ccv_matrix_setter(db->type, ccv_matrix_getter, a->type, for_block);
 #undef for_block
 }
+
+static int _ccv_perspective_transform_renew(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, const float* m, ccv_rect_t rect)
+{
+	if (rect.x == 0 && rect.y == 0 && rect.width == a->cols && rect.height == a->rows)
+	{
+		ccv_declare_derived_signature(sig, a->sig != 0, ccv_sign_with_format(64, "ccv_perspective_transform(%a,%a,%a,%a,%a,%a,%a,%a,%a)", m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8]), a->sig, CCV_EOF_SIGN);
+		ccv_dense_matrix_t* db = *b = ccv_dense_matrix_renew(*b, a->rows, a->cols, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), type, sig);
+		ccv_object_return_if_cached(1, db);
+	} else {
+		ccv_declare_derived_signature(sig, a->sig != 0, ccv_sign_with_format(128, "ccv_perspective_transform(%d,%d,%d,%d,%a,%a,%a,%a,%a,%a,%a,%a,%a)", rect.x, rect.y, rect.width, rect.height, m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8]), a->sig, CCV_EOF_SIGN);
+		ccv_dense_matrix_t* db = *b = ccv_dense_matrix_renew(*b, rect.height, rect.width, CCV_ALL_DATA_TYPE | CCV_GET_CHANNEL(a->type), type, sig);
+		ccv_object_return_if_cached(1, db);
+	}
+	return 0;
+}
+
+#define CCV_PERSPECTIVE_TRANSFORM_BAND_ROWS (16)
+
+void ccv_perspective_transform_batch(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, const float* m, const ccv_rect_t* rect, int count)
+{
+	type = (type == 0) ? CCV_GET_DATA_TYPE(a->type) | CCV_GET_CHANNEL(a->type) : CCV_GET_DATA_TYPE(type) | CCV_GET_CHANNEL(a->type);
+	int i;
+	int* offset = (int*)alloca(sizeof(int) * (count + 1));
+	float* sm = (float*)alloca(sizeof(float) * 9 * count);
+	ccv_rect_t* sr = (ccv_rect_t*)alloca(sizeof(ccv_rect_t) * count);
+	const int size = ccv_max(a->rows, a->cols);
+	offset[0] = 0;
+	for (i = 0; i < count; i++)
+	{
+		const float* mi = m + i * 9;
+		sr[i] = rect ? rect[i] : ccv_rect(0, 0, a->cols, a->rows);
+		assert(sr[i].width > 0 && sr[i].height > 0);
+		offset[i + 1] = offset[i];
+		if (_ccv_perspective_transform_renew(a, b + i, type, mi, sr[i]))
+			continue;
+		// assume field of view is 60, modify the matrix value to reflect that
+		// (basically, apply x / ccv_max(a->rows, a->cols), y / ccv_max(a->rows, a->cols) before hand
+		float* smi = sm + i * 9;
+		smi[0] = mi[0] * (1.0 / size);
+		smi[1] = mi[1] * (1.0 / size);
+		smi[2] = mi[2] * (1.0 / size);
+		smi[3] = mi[3] * (1.0 / size);
+		smi[4] = mi[4] * (1.0 / size);
+		smi[5] = mi[5] * (1.0 / size);
+		smi[6] = mi[6] * (1.0 / (size * size));
+		smi[7] = mi[7] * (1.0 / (size * size));
+		smi[8] = mi[8] * (1.0 / size);
+		offset[i + 1] += (b[i]->rows + CCV_PERSPECTIVE_TRANSFORM_BAND_ROWS - 1) / CCV_PERSPECTIVE_TRANSFORM_BAND_ROWS;
+	}
+	// a band of rows of any of them is a task, thus, a big one doesn't keep other threads idle
+	parallel_for(t, offset[count]) {
+		int k = 0;
+		while (offset[k + 1] <= t)
+			++k;
+		const int start = (t - offset[k]) * CCV_PERSPECTIVE_TRANSFORM_BAND_ROWS;
+		_ccv_perspective_transform_rows(a, b[k], sm + k * 9, sr[k].x, sr[k].y, start, ccv_min(start + CCV_PERSPECTIVE_TRANSFORM_BAND_ROWS, b[k]->rows));
+	} parallel_endfor
+}
+
+void ccv_perspective_transform(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, float m00, float m01, float m02, float m10, float m11, float m12, float m20, float m21, float m22)
+{
+	const float m[] = {
+		m00, m01, m02,
+		m10, m11, m12,
+		m20, m21, m22,
+	};
+	ccv_perspective_transform_batch(a, b, type, m, 0, 1);
+}
+
+void ccv_decimal_slice_batch(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, int type, const ccv_decimal_point_t* point, int rows, int cols, int count)
+{
+	parallel_for(i, count) {
+		ccv_decimal_slice(a, b + i, type, point[i].y, point[i].x, rows, cols);
+	} parallel_endfor
+}
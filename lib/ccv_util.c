@@ -1,5 +1,12 @@
 #include "ccv.h"
 #include "ccv_internal.h"
+#include <limits.h>
+#if defined(HAVE_SSE2) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_F16C_DISPATCH
+#elif defined(HAVE_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 ccv_dense_matrix_t* ccv_get_dense_matrix(ccv_matrix_t* mat)
 {
@@ -63,25 +70,43 @@ void ccv_zero(ccv_matrix_t* mat)
 	memset(dmt->data.u8, 0, dmt->step * dmt->rows);
 }
 
+// check the bits, isnan is folded to 0 with -ffast-math
+static inline int _ccv_is_nan_32f(float f)
+{
+	union { float f; uint32_t i; } u = { .f = f };
+	return (u.i & 0x7fffffffU) > 0x7f800000U;
+}
+
+static inline int _ccv_is_nan_64f(double f)
+{
+	union { double f; uint64_t i; } u = { .f = f };
+	return (u.i & 0x7fffffffffffffffULL) > 0x7ff0000000000000ULL;
+}
+
 int ccv_any_nan(ccv_matrix_t *a)
 {
 	ccv_dense_matrix_t* da = ccv_get_dense_matrix(a);
 	assert((da->type & CCV_32F) || (da->type & CCV_64F));
-	int ch = CCV_GET_CHANNEL(da->type);
-	int i;
+	const int len = da->cols * CCV_GET_CHANNEL(da->type);
+	int i, j;
+	// walk the rows with step, the matrix can have padded rows
 	if (da->type & CCV_32F)
 	{
-		for (i = 0; i < da->rows * da->cols * ch; i++)
-#ifdef isnanf
-			if (isnanf(da->data.f32[i]))
-#else
-			if (isnan(da->data.f32[i]))
-#endif
-				return i + 1;
+		for (i = 0; i < da->rows; i++)
+		{
+			const float* f32 = (const float*)(da->data.u8 + (size_t)i * da->step);
+			for (j = 0; j < len; j++)
+				if (_ccv_is_nan_32f(f32[j]))
+					return i * len + j + 1;
+		}
 	} else {
-		for (i = 0; i < da->rows * da->cols * ch; i++)
-			if (isnan(da->data.f64[i]))
-				return i + 1;
+		for (i = 0; i < da->rows; i++)
+		{
+			const double* f64 = (const double*)(da->data.u8 + (size_t)i * da->step);
+			for (j = 0; j < len; j++)
+				if (_ccv_is_nan_64f(f64[j]))
+					return i * len + j + 1;
+		}
 	}
 	return 0;
 }
@@ -1350,14 +1375,93 @@ static uint8_t _ccv_shift_table[512] = {
 	0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0xd,
 };
 
-void ccv_float_to_half_precision(float* f, uint16_t* h, size_t len)
+static void _ccv_float_to_half_precision(float* f, uint16_t* h, size_t len)
 {
-	int i;
+	size_t i;
 	uint32_t* u = (uint32_t*)f;
 	for (i = 0; i < len; i++)
 		h[i] = _ccv_base_table[(u[i] >> 23) & 0x1ff] + ((u[i] & 0x007fffff) >> _ccv_shift_table[(u[i] >> 23) & 0x1ff]);
 }
 
+/* The vectorized conversions below must match the tables bit by bit. The tables truncate (round toward zero),
+ * except that anything at or above 65536 in magnitude becomes infinity, and NaN keeps the top 10 bits of its
+ * payload (thus, can become infinity). Half to float is exact, but the hardware quiets signaling NaN, which
+ * the tables don't. These differences are patched up after the hardware conversion. */
+#ifdef HAVE_F16C_DISPATCH
+__attribute__((target("f16c,sse4.1"))) static inline __m128i _ccv_float_to_half_f16c_x4(const float* f)
+{
+	__m128i u = _mm_loadu_si128((const __m128i*)f);
+	__m128i h = _mm_unpacklo_epi16(_mm_cvtps_ph(_mm_loadu_ps(f), _MM_FROUND_TO_ZERO), _mm_setzero_si128());
+	__m128i a = _mm_and_si128(u, _mm_set1_epi32(0x7fffffff));
+	__m128i big = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x477fffff));
+	__m128i nan = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x7f7fffff));
+	__m128i fix = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(u, 16), _mm_set1_epi32(0x8000)), _mm_set1_epi32(0x7c00)),
+		_mm_and_si128(nan, _mm_srli_epi32(_mm_and_si128(u, _mm_set1_epi32(0x007fffff)), 13)));
+	return _mm_blendv_epi8(h, fix, big);
+}
+
+__attribute__((target("f16c,sse4.1"))) static void _ccv_float_to_half_precision_f16c(float* f, uint16_t* h, size_t len)
+{
+	size_t i;
+	for (i = 0; i + 8 <= len; i += 8)
+		_mm_storeu_si128((__m128i*)(h + i), _mm_packus_epi32(_ccv_float_to_half_f16c_x4(f + i), _ccv_float_to_half_f16c_x4(f + i + 4)));
+	_ccv_float_to_half_precision(f + i, h + i, len - i);
+}
+#elif defined(HAVE_NEON) && defined(__aarch64__)
+static void _ccv_float_to_half_precision_neon(float* f, uint16_t* h, size_t len)
+{
+	size_t i;
+	for (i = 0; i + 4 <= len; i += 4)
+	{
+		float32x4_t x = vld1q_f32(f + i);
+		uint32x4_t u = vreinterpretq_u32_f32(x);
+		// the conversion rounds to nearest, step back one ulp where it rounded up in magnitude
+		float16x4_t y = vcvt_f16_f32(x);
+		uint32x4_t up = vcgtq_f32(vabsq_f32(vcvt_f32_f16(y)), vabsq_f32(x));
+		uint32x4_t v = vsubq_u32(vmovl_u16(vreinterpret_u16_f16(y)), vandq_u32(up, vdupq_n_u32(1)));
+		uint32x4_t a = vandq_u32(u, vdupq_n_u32(0x7fffffff));
+		uint32x4_t big = vcgtq_u32(a, vdupq_n_u32(0x477fffff));
+		uint32x4_t nan = vcgtq_u32(a, vdupq_n_u32(0x7f7fffff));
+		uint32x4_t fix = vorrq_u32(vorrq_u32(vandq_u32(vshrq_n_u32(u, 16), vdupq_n_u32(0x8000)), vdupq_n_u32(0x7c00)),
+			vandq_u32(nan, vshrq_n_u32(vandq_u32(u, vdupq_n_u32(0x007fffff)), 13)));
+		vst1_u16(h + i, vmovn_u32(vbslq_u32(big, fix, v)));
+	}
+	_ccv_float_to_half_precision(f + i, h + i, len - i);
+}
+#endif
+
+static void _ccv_float_to_half_precision_block(float* f, uint16_t* h, size_t len)
+{
+#ifdef HAVE_F16C_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("f16c") && __builtin_cpu_supports("sse4.1"))
+		_ccv_float_to_half_precision_f16c(f, h, len);
+	else
+		_ccv_float_to_half_precision(f, h, len);
+#elif defined(HAVE_NEON) && defined(__aarch64__)
+	_ccv_float_to_half_precision_neon(f, h, len);
+#else
+	_ccv_float_to_half_precision(f, h, len);
+#endif
+}
+
+// large buffers are split into blocks, converted in parallel
+#define CCV_HALF_PRECISION_BLOCK (0x10000)
+
+void ccv_float_to_half_precision(float* f, uint16_t* h, size_t len)
+{
+	if (len <= CCV_HALF_PRECISION_BLOCK * 2)
+	{
+		_ccv_float_to_half_precision_block(f, h, len);
+		return;
+	}
+	const int n = (int)((len + CCV_HALF_PRECISION_BLOCK - 1) / CCV_HALF_PRECISION_BLOCK);
+	parallel_for(i, n) {
+		const size_t start = (size_t)i * CCV_HALF_PRECISION_BLOCK;
+		_ccv_float_to_half_precision_block(f + start, h + start, ccv_min(len - start, CCV_HALF_PRECISION_BLOCK));
+	} parallel_endfor
+}
+
 static uint32_t _ccv_mantissa_table[2048] = {
 	0x0, 0x33800000, 0x34000000, 0x34400000, 0x34800000, 0x34a00000, 0x34c00000, 0x34e00000,
 	0x35000000, 0x35100000, 0x35200000, 0x35300000, 0x35400000, 0x35500000, 0x35600000, 0x35700000,
@@ -1639,22 +1743,95 @@ static uint16_t _ccv_offset_table[64] = {
 	0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400,
 };
 
-void ccv_half_precision_to_float(uint16_t* h, float* f, size_t len)
+static void _ccv_half_precision_to_float(uint16_t* h, float* f, size_t len)
 {
-	int i;
+	size_t i;
 	uint32_t* u = (uint32_t*)f;
 	for (i = 0; i < len; i++)
 		u[i] = _ccv_mantissa_table[_ccv_offset_table[h[i] >> 10] + (h[i] & 0x3ff)] + _ccv_exponent_table[h[i] >> 10];
 }
 
+#ifdef HAVE_F16C_DISPATCH
+__attribute__((target("f16c,sse4.1"))) static void _ccv_half_precision_to_float_f16c(uint16_t* h, float* f, size_t len)
+{
+	size_t i;
+	for (i = 0; i + 4 <= len; i += 4)
+	{
+		__m128i x = _mm_loadl_epi64((const __m128i*)(h + i));
+		__m128i y = _mm_castps_si128(_mm_cvtph_ps(x));
+		__m128i v = _mm_unpacklo_epi16(x, _mm_setzero_si128());
+		__m128i nan = _mm_cmpeq_epi32(_mm_and_si128(v, _mm_set1_epi32(0x7c00)), _mm_set1_epi32(0x7c00));
+		__m128i fix = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0x8000)), 16), _mm_set1_epi32(0x7f800000)),
+			_mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0x3ff)), 13));
+		_mm_storeu_si128((__m128i*)(f + i), _mm_blendv_epi8(y, fix, nan));
+	}
+	_ccv_half_precision_to_float(h + i, f + i, len - i);
+}
+#elif defined(HAVE_NEON) && defined(__aarch64__)
+static void _ccv_half_precision_to_float_neon(uint16_t* h, float* f, size_t len)
+{
+	size_t i;
+	for (i = 0; i + 4 <= len; i += 4)
+	{
+		uint16x4_t x = vld1_u16(h + i);
+		uint32x4_t y = vreinterpretq_u32_f32(vcvt_f32_f16(vreinterpret_f16_u16(x)));
+		uint32x4_t v = vmovl_u16(x);
+		uint32x4_t nan = vceqq_u32(vandq_u32(v, vdupq_n_u32(0x7c00)), vdupq_n_u32(0x7c00));
+		uint32x4_t fix = vorrq_u32(vorrq_u32(vshlq_n_u32(vandq_u32(v, vdupq_n_u32(0x8000)), 16), vdupq_n_u32(0x7f800000)),
+			vshlq_n_u32(vandq_u32(v, vdupq_n_u32(0x3ff)), 13));
+		vst1q_f32(f + i, vreinterpretq_f32_u32(vbslq_u32(nan, fix, y)));
+	}
+	_ccv_half_precision_to_float(h + i, f + i, len - i);
+}
+#endif
+
+static void _ccv_half_precision_to_float_block(uint16_t* h, float* f, size_t len)
+{
+#ifdef HAVE_F16C_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("f16c") && __builtin_cpu_supports("sse4.1"))
+		_ccv_half_precision_to_float_f16c(h, f, len);
+	else
+		_ccv_half_precision_to_float(h, f, len);
+#elif defined(HAVE_NEON) && defined(__aarch64__)
+	_ccv_half_precision_to_float_neon(h, f, len);
+#else
+	_ccv_half_precision_to_float(h, f, len);
+#endif
+}
+
+void ccv_half_precision_to_float(uint16_t* h, float* f, size_t len)
+{
+	if (len <= CCV_HALF_PRECISION_BLOCK * 2)
+	{
+		_ccv_half_precision_to_float_block(h, f, len);
+		return;
+	}
+	const int n = (int)((len + CCV_HALF_PRECISION_BLOCK - 1) / CCV_HALF_PRECISION_BLOCK);
+	parallel_for(i, n) {
+		const size_t start = (size_t)i * CCV_HALF_PRECISION_BLOCK;
+		_ccv_half_precision_to_float_block(h + start, f + start, ccv_min(len - start, CCV_HALF_PRECISION_BLOCK));
+	} parallel_endfor
+}
+
+static void _ccv_array_realloc(ccv_array_t* array, int size)
+{
+	if (array->arena)
+	{
+		// arena cannot grow in place, the old data will be released with the arena scope
+		void* data = ccv_arena_alloc((size_t)size * (size_t)array->rsize);
+		memcpy(data, array->data, (size_t)array->size * (size_t)array->rsize);
+		array->data = data;
+	} else
+		array->data = ccrealloc(array->data, (size_t)size * (size_t)array->rsize);
+	array->size = size;
+}
+
 void ccv_array_push(ccv_array_t* array, const void* r)
 {
 	array->rnum++;
 	if (array->rnum > array->size)
-	{
-		array->size = ccv_max(array->size * 3 / 2, array->size + 1);
-		array->data = ccrealloc(array->data, (size_t)array->size * (size_t)array->rsize);
-	}
+		_ccv_array_realloc(array, ccv_max(array->size * 3 / 2, array->size + 1));
 	memcpy(ccv_array_get(array, array->rnum - 1), r, array->rsize);
 }
 
@@ -1666,10 +1843,7 @@ void ccv_array_zero(ccv_array_t* array)
 void ccv_array_resize(ccv_array_t* array, int rnum)
 {
 	if (rnum > array->size)
-	{
-		array->size = ccv_max(array->size * 3 / 2, rnum);
-		array->data = ccrealloc(array->data, (size_t)array->size * (size_t)array->rsize);
-	}
+		_ccv_array_realloc(array, ccv_max(array->size * 3 / 2, rnum));
 	memset(ccv_array_get(array, array->rnum), 0, (size_t)array->rsize * (size_t)(rnum - array->rnum));
 	array->rnum = rnum;
 }
@@ -1686,73 +1860,56 @@ typedef struct ccv_ptree_node_t
 	int rank;
 } ccv_ptree_node_t;
 
-/* the code for grouping array is adopted from OpenCV's cvSeqPartition func, it is essentially a find-union algorithm */
-int ccv_array_group(ccv_array_t* array, ccv_array_t** index, ccv_array_group_f gfunc, void* data)
+static ccv_ptree_node_t* _ccv_ptree_union(ccv_ptree_node_t* node, ccv_ptree_node_t* root, int i, int j)
 {
-	int i, j;
-	ccv_ptree_node_t* node = (ccv_ptree_node_t*)ccmalloc(array->rnum * sizeof(ccv_ptree_node_t));
-	for (i = 0; i < array->rnum; i++)
-	{
-		node[i].parent = 0;
-		node[i].element = ccv_array_get(array, i);
-		node[i].rank = 0;
-	}
-	for (i = 0; i < array->rnum; i++)
-	{
-		if (!node[i].element)
-			continue;
-		ccv_ptree_node_t* root = node + i;
-		while (root->parent)
-			root = root->parent;
-		for (j = 0; j < array->rnum; j++)
-		{
-			if( i != j && node[j].element && gfunc(node[i].element, node[j].element, data))
-			{
-				ccv_ptree_node_t* root2 = node + j;
+	ccv_ptree_node_t* root2 = node + j;
 
-				while(root2->parent)
-					root2 = root2->parent;
+	while(root2->parent)
+		root2 = root2->parent;
 
-				if(root2 != root)
-				{
-					if(root->rank > root2->rank)
-						root2->parent = root;
-					else
-					{
-						root->parent = root2;
-						root2->rank += root->rank == root2->rank;
-						root = root2;
-					}
+	if(root2 != root)
+	{
+		if(root->rank > root2->rank)
+			root2->parent = root;
+		else
+		{
+			root->parent = root2;
+			root2->rank += root->rank == root2->rank;
+			root = root2;
+		}
 
-					/* compress path from node2 to the root: */
-					ccv_ptree_node_t* node2 = node + j;
-					while(node2->parent)
-					{
-						ccv_ptree_node_t* temp = node2;
-						node2 = node2->parent;
-						temp->parent = root;
-					}
+		/* compress path from node2 to the root: */
+		ccv_ptree_node_t* node2 = node + j;
+		while(node2->parent)
+		{
+			ccv_ptree_node_t* temp = node2;
+			node2 = node2->parent;
+			temp->parent = root;
+		}
 
-					/* compress path from node to the root: */
-					node2 = node + i;
-					while(node2->parent)
-					{
-						ccv_ptree_node_t* temp = node2;
-						node2 = node2->parent;
-						temp->parent = root;
-					}
-				}
-			}
+		/* compress path from node to the root: */
+		node2 = node + i;
+		while(node2->parent)
+		{
+			ccv_ptree_node_t* temp = node2;
+			node2 = node2->parent;
+			temp->parent = root;
 		}
 	}
+	return root;
+}
+
+static int _ccv_ptree_index(ccv_ptree_node_t* node, int rnum, ccv_array_t** index)
+{
+	int i, j;
 	if (*index == 0)
-		*index = ccv_array_new(sizeof(int), array->rnum, 0);
+		*index = ccv_array_new(sizeof(int), rnum, 0);
 	else
 		ccv_array_clear(*index);
 	ccv_array_t* idx = *index;
 
 	int class_idx = 0;
-	for(i = 0; i < array->rnum; i++)
+	for(i = 0; i < rnum; i++)
 	{
 		j = -1;
 		ccv_ptree_node_t* node1 = node + i;
@@ -1766,6 +1923,122 @@ int ccv_array_group(ccv_array_t* array, ccv_array_t** index, ccv_array_group_f g
 		}
 		ccv_array_push(idx, &j);
 	}
+	return class_idx;
+}
+
+/* the code for grouping array is adopted from OpenCV's cvSeqPartition func, it is essentially a find-union algorithm */
+int ccv_array_group(ccv_array_t* array, ccv_array_t** index, ccv_array_group_f gfunc, void* data)
+{
+	int i, j;
+	ccv_ptree_node_t* node = (ccv_ptree_node_t*)ccmalloc(array->rnum * sizeof(ccv_ptree_node_t));
+	for (i = 0; i < array->rnum; i++)
+	{
+		node[i].parent = 0;
+		node[i].element = ccv_array_get(array, i);
+		node[i].rank = 0;
+	}
+	for (i = 0; i < array->rnum; i++)
+	{
+		if (!node[i].element)
+			continue;
+		ccv_ptree_node_t* root = node + i;
+		while (root->parent)
+			root = root->parent;
+		for (j = 0; j < array->rnum; j++)
+			if( i != j && node[j].element && gfunc(node[i].element, node[j].element, data))
+				root = _ccv_ptree_union(node, root, i, j);
+	}
+	int class_idx = _ccv_ptree_index(node, array->rnum, index);
+	ccfree(node);
+	return class_idx;
+}
+
+int ccv_array_group_spatial(ccv_array_t* array, ccv_array_t** index, ccv_array_group_f gfunc, ccv_array_group_hint_f hfunc, void* data)
+{
+	if (!hfunc)
+		return ccv_array_group(array, index, gfunc, data);
+	int i, j, k, x, y;
+	const int rnum = array->rnum;
+	ccv_ptree_node_t* node = (ccv_ptree_node_t*)ccmalloc(rnum * sizeof(ccv_ptree_node_t));
+	ccv_rect_t* hint = (ccv_rect_t*)ccmalloc(rnum * sizeof(ccv_rect_t));
+	int min_x = INT_MAX, min_y = INT_MAX, max_x = INT_MIN, max_y = INT_MIN;
+	int64_t side = 0;
+	for (i = 0; i < rnum; i++)
+	{
+		node[i].parent = 0;
+		node[i].element = ccv_array_get(array, i);
+		node[i].rank = 0;
+		hint[i] = hfunc(node[i].element, data);
+		assert(hint[i].width > 0 && hint[i].height > 0);
+		min_x = ccv_min(min_x, hint[i].x);
+		min_y = ccv_min(min_y, hint[i].y);
+		max_x = ccv_max(max_x, hint[i].x + hint[i].width - 1);
+		max_y = ccv_max(max_y, hint[i].y + hint[i].height - 1);
+		side += hint[i].width + hint[i].height;
+	}
+	// bucket hint rectangles into a uniform grid with cell about the average
+	// hint size, so only elements that share a cell will be compared, and
+	// keep the grid at most a few cells per element
+	int cell = rnum > 0 ? ccv_max(1, (int)(side / (2 * rnum))) : 1;
+	int gw = rnum > 0 ? (int)(((int64_t)max_x - min_x) / cell) + 1 : 1;
+	int gh = rnum > 0 ? (int)(((int64_t)max_y - min_y) / cell) + 1 : 1;
+	while ((int64_t)gw * gh > 4 * (int64_t)rnum + 4)
+	{
+		cell *= 2;
+		gw = (int)(((int64_t)max_x - min_x) / cell) + 1;
+		gh = (int)(((int64_t)max_y - min_y) / cell) + 1;
+	}
+	int* offset = (int*)cccalloc(gw * gh + 1, sizeof(int));
+#define for_each_cell(i, block) \
+	do { \
+		const int x0 = (int)(((int64_t)hint[i].x - min_x) / cell); \
+		const int x1 = (int)(((int64_t)hint[i].x + hint[i].width - 1 - min_x) / cell); \
+		const int y0 = (int)(((int64_t)hint[i].y - min_y) / cell); \
+		const int y1 = (int)(((int64_t)hint[i].y + hint[i].height - 1 - min_y) / cell); \
+		for (y = y0; y <= y1; y++) \
+			for (x = x0; x <= x1; x++) \
+				{ block } \
+	} while (0)
+	for (i = 0; i < rnum; i++)
+		for_each_cell(i, { ++offset[y * gw + x + 1]; });
+	for (i = 1; i <= gw * gh; i++)
+		offset[i] += offset[i - 1];
+	int* bucket = (int*)ccmalloc(sizeof(int) * ccv_max(offset[gw * gh], 1));
+	int* cursor = (int*)ccmalloc(sizeof(int) * gw * gh);
+	memcpy(cursor, offset, sizeof(int) * gw * gh);
+	for (i = 0; i < rnum; i++)
+		for_each_cell(i, { bucket[cursor[y * gw + x]++] = i; });
+	ccfree(cursor);
+	// seen marks the last element that compared against j, so a pair that shares
+	// multiple cells is only compared once
+	int* seen = (int*)ccmalloc(sizeof(int) * ccv_max(rnum, 1));
+	for (i = 0; i < rnum; i++)
+		seen[i] = -1;
+	for (i = 0; i < rnum; i++)
+	{
+		ccv_ptree_node_t* root = node + i;
+		while (root->parent)
+			root = root->parent;
+		for_each_cell(i, {
+			for (k = offset[y * gw + x]; k < offset[y * gw + x + 1]; k++)
+			{
+				j = bucket[k];
+				if (j == i || seen[j] == i)
+					continue;
+				seen[j] = i;
+				if (hint[j].x < hint[i].x + hint[i].width && hint[i].x < hint[j].x + hint[j].width &&
+					hint[j].y < hint[i].y + hint[i].height && hint[i].y < hint[j].y + hint[j].height &&
+					gfunc(node[i].element, node[j].element, data))
+					root = _ccv_ptree_union(node, root, i, j);
+			}
+		});
+	}
+#undef for_each_cell
+	ccfree(seen);
+	ccfree(bucket);
+	ccfree(offset);
+	ccfree(hint);
+	int class_idx = _ccv_ptree_index(node, rnum, index);
 	ccfree(node);
 	return class_idx;
 }
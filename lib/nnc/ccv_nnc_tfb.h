@@ -106,7 +106,7 @@ typedef struct {
 	int type;
 	int refcount;
 	ccv_numeric_data_t data;
-	uintptr_t reserved0;
+	uintptr_t arena; // matrix is allocated in the arena, see ccv_arena_begin. It is where a tensor has its alias_ref, which is 0 for a matrix from the heap
 	uint64_t sig;
 	// This is used for toll-free bridging between ccv_dense_matrix_t and ccv_nnc_tensor_t
 	// Note that this is bigger than it is needed, we carefully structured this
@@ -138,6 +138,7 @@ typedef struct {
 typedef struct {
 	int type;
 	int refcount;
+	uintptr_t arena;
 	uint64_t sig;
 	int cols;
 	int rows;
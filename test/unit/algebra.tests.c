@@ -26,6 +26,50 @@ TEST_CASE("matrix multiplication")
 	ccv_matrix_free(y);
 }
 
+static double gemm_ref(ccv_dense_matrix_t* a, ccv_dense_matrix_t* b, ccv_dense_matrix_t* c, int transpose, int i, int j)
+{
+	int k, p;
+	k = (transpose & CCV_A_TRANSPOSE) ? a->rows : a->cols;
+	double sum = 0;
+	for (p = 0; p < k; p++)
+		sum += ccv_get_value(a->type, a->data.u8 + ((transpose & CCV_A_TRANSPOSE) ? p : i) * a->step, (transpose & CCV_A_TRANSPOSE) ? i : p) *
+			ccv_get_value(b->type, b->data.u8 + ((transpose & CCV_B_TRANSPOSE) ? j : p) * b->step, (transpose & CCV_B_TRANSPOSE) ? p : j);
+	return 0.5 * sum + 2 * ccv_get_value(c->type, c->data.u8 + ((transpose & CCV_C_TRANSPOSE) ? j : i) * c->step, (transpose & CCV_C_TRANSPOSE) ? i : j);
+}
+
+TEST_CASE("native matrix multiplication with all transposes")
+{
+	const int m = 131, n = 75, k = 301;
+	int type, transpose, i, j;
+	for (type = 0; type < 2; type++)
+		for (transpose = 0; transpose < 8; transpose++)
+		{
+			int dtype = (type == 0 ? CCV_32F : CCV_64F) | CCV_C1;
+			ccv_dense_matrix_t* a = (transpose & CCV_A_TRANSPOSE) ? ccv_dense_matrix_new(k, m, dtype, 0, 0) : ccv_dense_matrix_new(m, k, dtype, 0, 0);
+			ccv_dense_matrix_t* b = (transpose & CCV_B_TRANSPOSE) ? ccv_dense_matrix_new(n, k, dtype, 0, 0) : ccv_dense_matrix_new(k, n, dtype, 0, 0);
+			ccv_dense_matrix_t* c = (transpose & CCV_C_TRANSPOSE) ? ccv_dense_matrix_new(n, m, dtype, 0, 0) : ccv_dense_matrix_new(m, n, dtype, 0, 0);
+			for (i = 0; i < a->rows * a->cols; i++)
+				ccv_set_value(dtype, a->data.u8, i, (i * 7 % 13) / 13.0 - 0.5, 0);
+			for (i = 0; i < b->rows * b->cols; i++)
+				ccv_set_value(dtype, b->data.u8, i, (i * 5 % 11) / 11.0 - 0.5, 0);
+			for (i = 0; i < c->rows * c->cols; i++)
+				ccv_set_value(dtype, c->data.u8, i, (i % 17) / 17.0, 0);
+			ccv_dense_matrix_t* d = 0;
+			ccv_gemm_native(a, b, 0.5, c, 2, transpose, (ccv_matrix_t**)&d, 0);
+			REQUIRE(d->rows == m && d->cols == n, "output should be m x n");
+			int mismatch = 0;
+			for (i = 0; i < m; i++)
+				for (j = 0; j < n; j++)
+					if (fabs(ccv_get_value(d->type, d->data.u8 + i * d->step, j) - gemm_ref(a, b, c, transpose, i, j)) > 1e-3)
+						++mismatch;
+			REQUIRE_EQ(0, mismatch, "native gemm should match the reference for every transpose combination");
+			ccv_matrix_free(a);
+			ccv_matrix_free(b);
+			ccv_matrix_free(c);
+			ccv_matrix_free(d);
+		}
+}
+
 TEST_CASE("matrix addition")
 {
 	ccv_dense_matrix_t* a = ccv_dense_matrix_new(3, 2, CCV_64F | CCV_C1, 0, 0);
@@ -164,4 +208,54 @@ TEST_CASE("summed area table with padding")
 	ccv_matrix_free(b);
 }
 
+TEST_CASE("summed area table and of squares in one pass")
+{
+	int i, j, k, ch;
+	for (ch = 1; ch <= 3; ch += 2)
+	{
+		ccv_dense_matrix_t* dmt = ccv_dense_matrix_new(150, 203, CCV_8U | ch, 0, 0);
+		for (i = 0; i < dmt->rows; i++)
+			for (j = 0; j < dmt->cols * ch; j++)
+				dmt->data.u8[i * dmt->step + j] = (i * 131 + j * 29 + (i * j) % 17) & 0xff;
+		int64_t* sat = (int64_t*)ccmalloc(sizeof(int64_t) * 151 * 204 * ch * 2);
+		int64_t* sqsat = sat + 151 * 204 * ch;
+		memset(sat, 0, sizeof(int64_t) * 151 * 204 * ch * 2);
+		for (i = 0; i < dmt->rows; i++)
+			for (j = 0; j < dmt->cols; j++)
+				for (k = 0; k < ch; k++)
+				{
+					const int x = dmt->data.u8[i * dmt->step + j * ch + k];
+					const int idx = ((i + 1) * 204 + j + 1) * ch + k;
+					sat[idx] = sat[idx - ch] + sat[idx - 204 * ch] - sat[idx - 205 * ch] + x;
+					sqsat[idx] = sqsat[idx - ch] + sqsat[idx - 204 * ch] - sqsat[idx - 205 * ch] + x * x;
+				}
+		int padding;
+		for (padding = 0; padding < 2; padding++)
+		{
+			ccv_dense_matrix_t* b = 0;
+			ccv_dense_matrix_t* c = 0;
+			ccv_sat_square(dmt, &b, &c, 0, padding ? CCV_PADDING_ZERO : CCV_NO_PADDING);
+			REQUIRE_EQ(CCV_GET_DATA_TYPE(b->type), CCV_32S, "summed area table should be 32-bit integer for 8-bit input");
+			REQUIRE_EQ(CCV_GET_DATA_TYPE(c->type), CCV_64S, "summed area table of squares should be 64-bit integer for 8-bit input");
+			ccv_dense_matrix_t* d = 0;
+			ccv_sat(dmt, &d, CCV_64F, padding ? CCV_PADDING_ZERO : CCV_NO_PADDING);
+			int mismatch = 0;
+			for (i = 0; i < b->rows; i++)
+				for (j = 0; j < b->cols * ch; j++)
+				{
+					const int idx = (i + 1 - padding) * 204 * ch + j + (1 - padding) * ch;
+					mismatch += (b->data.i32[i * b->cols * ch + j] != sat[idx]);
+					mismatch += (c->data.i64[i * c->cols * ch + j] != sqsat[idx]);
+					mismatch += (d->data.f64[i * d->cols * ch + j] != sat[idx]);
+				}
+			REQUIRE_EQ(mismatch, 0, "summed area tables should match the reference");
+			ccv_matrix_free(b);
+			ccv_matrix_free(c);
+			ccv_matrix_free(d);
+		}
+		ccfree(sat);
+		ccv_matrix_free(dmt);
+	}
+}
+
 #include "case_main.h"
@@ -1,6 +1,9 @@
 #include "ccv.h"
 #include "case.h"
 #include "ccv_case.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 TEST_CASE("read raw memory, rgb => gray")
 {
@@ -334,6 +337,126 @@ TEST_CASE("read raw memory with no copy mode")
 	ccv_matrix_free(x);
 }
 
+TEST_CASE("read raw memory, nv12 => rgb")
+{
+	// 3 rows of 11 with the scanline of 12, the chroma is neutral thus, the color is gray
+	unsigned char nv12[12 * 3 + 12 * 2];
+	int i, j;
+	for (i = 0; i < 12 * 3; i++)
+		nv12[i] = (unsigned char)(i * 7);
+	memset(nv12 + 12 * 3, 128, 12 * 2);
+	ccv_dense_matrix_t* x = 0;
+	ccv_read(nv12, &x, CCV_IO_NV12_RAW, 3, 11, 12);
+	REQUIRE_EQ(CCV_8U | CCV_C3, CCV_GET_DATA_TYPE(x->type) | CCV_GET_CHANNEL(x->type), "nv12 should be read as rgb matrix by default");
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 11; j++)
+		{
+			unsigned char g = (unsigned char)ccv_clamp((298 * (nv12[i * 12 + j] - 16) + 128) >> 8, 0, 255);
+			unsigned char rgb[] = {
+				g, g, g
+			};
+			REQUIRE_ARRAY_EQ(unsigned char, rgb, x->data.u8 + i * x->step + j * 3, 3, "pixel with neutral chroma should be gray");
+		}
+	ccv_matrix_free(x);
+}
+
+TEST_CASE("read raw memory, i420, nv12 and nv21 => rgb")
+{
+	// 5 rows of 19, thus, both the vectorized and the remaining columns are covered
+	unsigned char y[19 * 5];
+	unsigned char u[10 * 3];
+	unsigned char v[10 * 3];
+	int i, j;
+	for (i = 0; i < 19 * 5; i++)
+		y[i] = (unsigned char)(i * 37 + 11);
+	for (i = 0; i < 10 * 3; i++)
+		u[i] = (unsigned char)(i * 53 + 7), v[i] = (unsigned char)(255 - i * 29);
+	unsigned char i420[19 * 5 + 10 * 3 * 2];
+	unsigned char nv12[19 * 5 + 20 * 3];
+	unsigned char nv21[19 * 5 + 20 * 3];
+	memcpy(i420, y, 19 * 5);
+	memcpy(i420 + 19 * 5, u, 10 * 3);
+	memcpy(i420 + 19 * 5 + 10 * 3, v, 10 * 3);
+	memcpy(nv12, y, 19 * 5);
+	memcpy(nv21, y, 19 * 5);
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 10; j++)
+		{
+			// the interleaved chroma rows have the scanline of 19 as well, 9 pairs cover the 18 columns
+			if (j * 2 + 1 >= 19)
+				continue;
+			nv12[19 * 5 + i * 19 + j * 2] = nv21[19 * 5 + i * 19 + j * 2 + 1] = u[i * 10 + j];
+			nv12[19 * 5 + i * 19 + j * 2 + 1] = nv21[19 * 5 + i * 19 + j * 2] = v[i * 10 + j];
+		}
+	ccv_dense_matrix_t* x = 0;
+	ccv_read(i420, &x, CCV_IO_I420_RAW | CCV_IO_RGB_COLOR, 5, 18, 19);
+	ccv_dense_matrix_t* a = 0;
+	ccv_read(nv12, &a, CCV_IO_NV12_RAW | CCV_IO_RGB_COLOR, 5, 18, 19);
+	ccv_dense_matrix_t* b = 0;
+	ccv_read(nv21, &b, CCV_IO_NV21_RAW | CCV_IO_RGB_COLOR, 5, 18, 19);
+	REQUIRE_MATRIX_EQ(x, a, "nv12 should be read the same as i420");
+	REQUIRE_MATRIX_EQ(x, b, "nv21 should be read the same as i420");
+	ccv_matrix_free(b);
+	ccv_matrix_free(a);
+	ccv_matrix_free(x);
+}
+
+TEST_CASE("read raw memory, nv12 and nv21 of odd width => rgb within 2 of BT.601")
+{
+	// 5 rows of 13 with the scanline of 13, the interleaved chroma rows take 14 bytes for the 7 pairs
+	unsigned char nv12[13 * 5 + 14 * 3];
+	unsigned char nv21[13 * 5 + 14 * 3];
+	int i, j, k;
+	for (i = 0; i < 13 * 5; i++)
+		nv12[i] = nv21[i] = (unsigned char)(i * 37 + 11);
+	for (i = 0; i < 3 * 7; i++)
+	{
+		nv12[13 * 5 + i * 2] = nv21[13 * 5 + i * 2 + 1] = (unsigned char)(i * 53 + 7);
+		nv12[13 * 5 + i * 2 + 1] = nv21[13 * 5 + i * 2] = (unsigned char)(255 - i * 29);
+	}
+	ccv_dense_matrix_t* a = 0;
+	ccv_read(nv12, &a, CCV_IO_NV12_RAW | CCV_IO_RGB_COLOR, 5, 13, 13);
+	ccv_dense_matrix_t* b = 0;
+	ccv_read(nv21, &b, CCV_IO_NV21_RAW | CCV_IO_RGB_COLOR, 5, 13, 13);
+	for (i = 0; i < 5; i++)
+		for (j = 0; j < 13; j++)
+		{
+			const unsigned char* uv = nv12 + 13 * 5 + (i >> 1) * 14 + (j >> 1) * 2;
+			const double yy = 1.164 * (nv12[i * 13 + j] - 16);
+			const double u = uv[0] - 128, v = uv[1] - 128;
+			const double rgb[] = {
+				yy + 1.596 * v,
+				yy - 0.392 * u - 0.813 * v,
+				yy + 2.017 * u,
+			};
+			for (k = 0; k < 3; k++)
+			{
+				const double c = ccv_clamp(rgb[k], 0, 255);
+				REQUIRE(fabs(a->data.u8[i * a->step + j * 3 + k] - c) <= 2, "nv12 at (%d, %d) should be within 2 of BT.601", i, j);
+				REQUIRE(fabs(b->data.u8[i * b->step + j * 3 + k] - c) <= 2, "nv21 at (%d, %d) should be within 2 of BT.601", i, j);
+			}
+		}
+	ccv_matrix_free(b);
+	ccv_matrix_free(a);
+}
+
+TEST_CASE("read raw memory, nv12 => gray with no copy mode")
+{
+	unsigned char nv12[8 * 4 + 8 * 2];
+	int i;
+	for (i = 0; i < 8 * 6; i++)
+		nv12[i] = (unsigned char)(i * 5);
+	ccv_dense_matrix_t* x = 0;
+	ccv_read(nv12, &x, CCV_IO_NV12_RAW | CCV_IO_NO_COPY, 4, 7, 8);
+	REQUIRE(nv12 == x->data.u8, "its data section should point to the y plane");
+	REQUIRE_EQ(CCV_C1, CCV_GET_CHANNEL(x->type), "the y plane should be wrapped as a grayscale matrix");
+	ccv_dense_matrix_t* y = 0;
+	ccv_read(nv12, &y, CCV_IO_NV12_RAW | CCV_IO_GRAY, 4, 7, 8);
+	REQUIRE_MATRIX_EQ(x, y, "copied y plane should be the same as the wrapped one");
+	ccv_matrix_free(y);
+	ccv_matrix_free(x);
+}
+
 TEST_CASE("read JPEG from memory")
 {
 	ccv_dense_matrix_t* x = 0;
@@ -372,4 +495,587 @@ TEST_CASE("read PNG from memory")
 	ccv_matrix_free(x);
 }
 
+TEST_CASE("read binary file with no copy mode")
+{
+	ccv_dense_matrix_t* x = 0;
+	ccv_read("../../samples/nature.png", &x, CCV_IO_ANY_FILE);
+	int align = 4096;
+	ccv_write(x, "io.aligned.bin", 0, CCV_IO_BINARY_FILE, &align);
+	ccv_write(x, "io.packed.bin", 0, CCV_IO_BINARY_FILE, 0);
+	ccv_dense_matrix_t* y = 0;
+	ccv_read("io.aligned.bin", &y, CCV_IO_ANY_FILE | CCV_IO_NO_COPY);
+	REQUIRE(y->type & CCV_NO_DATA_ALLOC, "aligned binary file should be mapped in place");
+	REQUIRE_EQ(0, (int)((uintptr_t)y->data.u8 & (align - 1)), "data section should be aligned");
+	REQUIRE_MATRIX_EQ(x, y, "mapped aligned binary file should be the same as the original");
+	ccv_dense_matrix_t* z = 0;
+	ccv_read("io.packed.bin", &z, CCV_IO_BINARY_FILE | CCV_IO_NO_COPY);
+	REQUIRE_MATRIX_EQ(x, z, "mapped packed binary file should be the same as the original");
+	ccv_dense_matrix_t* w = 0;
+	ccv_read("io.aligned.bin", &w, CCV_IO_ANY_FILE);
+	REQUIRE(!(w->type & CCV_NO_DATA_ALLOC), "aligned binary file should be copied without no copy mode");
+	REQUIRE_MATRIX_EQ(x, w, "aligned binary file should be the same as the original");
+	ccv_matrix_free(w);
+	ccv_matrix_unmap(z);
+	ccv_matrix_unmap(y);
+	ccv_matrix_free(x);
+	remove("io.aligned.bin");
+	remove("io.packed.bin");
+}
+
+TEST_CASE("read corrupt or unaligned binary file with no copy mode")
+{
+	ccv_dense_matrix_t* x = ccv_dense_matrix_new(7, 5, CCV_64F | CCV_C1, 0, 0);
+	int i;
+	for (i = 0; i < 7 * 5; i++)
+		x->data.f64[i] = i * 0.5 - 3;
+	// the packed layout has its data at 20 bytes, 64-bit data cannot be mapped there
+	ccv_write(x, "io.packed.bin", 0, CCV_IO_BINARY_FILE, 0);
+	ccv_dense_matrix_t* y = 0;
+	REQUIRE_EQ(CCV_IO_FINAL, ccv_read("io.packed.bin", &y, CCV_IO_ANY_FILE | CCV_IO_NO_COPY), "unaligned binary file should be read");
+	REQUIRE(!(y->type & CCV_NO_DATA_ALLOC), "unaligned binary file should be copied");
+	REQUIRE_MATRIX_EQ(x, y, "unaligned binary file should be the same as the original");
+	ccv_matrix_unmap(y);
+	y = 0;
+	REQUIRE_EQ(CCV_IO_ERROR, ccv_read("io.packed.bin", &y, CCV_IO_ANY_FILE | CCV_IO_GRAY | CCV_IO_NO_COPY), "binary file cannot be converted in no copy mode");
+	REQUIRE(y == 0, "no matrix should be read");
+	static const int rows[] = {
+		-7, 0, 8, 0x40000000
+	};
+	for (i = 0; i < sizeof(rows) / sizeof(rows[0]); i++)
+	{
+		// rewrite the rows in the header, none of these fits in the file
+		FILE* w = fopen("io.packed.bin", "r+b");
+		fseek(w, 12, SEEK_SET);
+		fwrite(rows + i, 1, 4, w);
+		fclose(w);
+		y = 0;
+		ccv_read("io.packed.bin", &y, CCV_IO_ANY_FILE | CCV_IO_NO_COPY);
+		REQUIRE(y == 0, "corrupt binary file should not be mapped");
+		ccv_read("io.packed.bin", &y, CCV_IO_ANY_FILE);
+		REQUIRE(y == 0, "corrupt binary file should not be read");
+	}
+	remove("io.packed.bin");
+	ccv_matrix_free(x);
+}
+
+TEST_CASE("read JPEG with region of interest")
+{
+	ccv_dense_matrix_t* image = 0;
+	ccv_read("../../samples/nature.png", &image, CCV_IO_ANY_FILE);
+	ccv_write(image, "io.roi.jpg", 0, CCV_IO_JPEG_FILE, 0);
+	ccv_matrix_free(image);
+	ccv_dense_matrix_t* x = 0;
+	ccv_read("io.roi.jpg", &x, CCV_IO_ANY_FILE);
+	ccv_io_read_param_t params = {
+		.x = 123,
+		.y = 77,
+		.width = 301,
+		.height = 199,
+	};
+	ccv_dense_matrix_t* y = 0;
+	ccv_read_with_param("io.roi.jpg", &y, CCV_IO_ANY_FILE, 0, params);
+	ccv_dense_matrix_t* z = 0;
+	ccv_slice(x, (ccv_matrix_t**)&z, 0, 77, 123, 199, 301);
+	REQUIRE_MATRIX_EQ(y, z, "decoded region of interest should be the same as the slice of the whole image");
+	ccv_matrix_free(y);
+	ccv_matrix_free(z);
+	// the region crosses the right bottom border
+	params.x = x->cols - 50;
+	params.y = x->rows - 30;
+	y = 0;
+	ccv_read_with_param("io.roi.jpg", &y, CCV_IO_ANY_FILE, 0, params);
+	z = 0;
+	ccv_slice(x, (ccv_matrix_t**)&z, 0, x->rows - 30, x->cols - 50, 30, 50);
+	REQUIRE_MATRIX_EQ(y, z, "decoded region of interest should be clipped to the image");
+	ccv_matrix_free(y);
+	ccv_matrix_free(z);
+	ccv_matrix_free(x);
+	remove("io.roi.jpg");
+}
+
+TEST_CASE("read JPEG scaled down while decoding")
+{
+	ccv_dense_matrix_t* image = 0;
+	ccv_read("../../samples/nature.png", &image, CCV_IO_ANY_FILE);
+	ccv_write(image, "io.scale.jpg", 0, CCV_IO_JPEG_FILE, 0);
+	ccv_dense_matrix_t* x = 0;
+	ccv_io_read_param_t params = {
+		.rows = image->rows / 3,
+		.cols = image->cols / 4,
+	};
+	ccv_read_with_param("io.scale.jpg", &x, CCV_IO_ANY_FILE, 0, params);
+	REQUIRE(x->rows >= image->rows / 3 && x->cols >= image->cols / 4, "decoded image should be at least of the requested size");
+	REQUIRE(x->rows < image->rows / 2 && x->cols < image->cols / 2, "decoded image should be scaled down");
+	FILE* rb = fopen("io.scale.jpg", "rb");
+	fseek(rb, 0, SEEK_END);
+	long size = ftell(rb);
+	char* data = (char*)ccmalloc(size);
+	fseek(rb, 0, SEEK_SET);
+	fread(data, 1, size, rb);
+	fclose(rb);
+	ccv_dense_matrix_t* y = 0;
+	ccv_read_with_param(data, &y, CCV_IO_ANY_STREAM, size, params);
+	ccfree(data);
+	REQUIRE_MATRIX_EQ(x, y, "scaled down io.scale.jpg from file system and memory should be the same");
+	ccv_matrix_free(y);
+	ccv_matrix_free(x);
+	ccv_matrix_free(image);
+	remove("io.scale.jpg");
+}
+
+TEST_CASE("read PNG with region of interest")
+{
+	ccv_dense_matrix_t* x = 0;
+	ccv_read("../../samples/nature.png", &x, CCV_IO_ANY_FILE);
+	ccv_io_read_param_t params = {
+		.x = -20,
+		.y = 31,
+		.width = 100,
+		.height = 80,
+	};
+	ccv_dense_matrix_t* y = 0;
+	ccv_read_with_param("../../samples/nature.png", &y, CCV_IO_ANY_FILE, 0, params);
+	ccv_dense_matrix_t* z = 0;
+	ccv_slice(x, (ccv_matrix_t**)&z, 0, 31, 0, 80, 80);
+	REQUIRE_MATRIX_EQ(y, z, "region of interest of nature.png should be the same as the slice of the whole image");
+	ccv_matrix_free(z);
+	ccv_matrix_free(y);
+	ccv_matrix_free(x);
+}
+
+static void _io_flip(ccv_dense_matrix_t* a, ccv_dense_matrix_t** b, void* context)
+{
+	ccv_flip(a, b, 0, *(int*)context);
+}
+
+TEST_CASE("load images in order with a pool of threads")
+{
+	const char* files[] = {
+		"../../samples/nature.png",
+		"../../samples/cmyk-jpeg-format.jpg",
+		"../../samples/does-not-exist.png",
+		"../../samples/street.png",
+		"../../samples/chessbox.png",
+	};
+	int flip = CCV_FLIP_X;
+	ccv_image_loader_param_t params = {
+		.threads = 3,
+		.capacity = 2,
+		.ordered = 1,
+		.rows = 97,
+		.cols = 131,
+		.transform = _io_flip,
+		.context = &flip,
+	};
+	ccv_image_loader_t* loader = ccv_image_loader_new((const void* const*)files, 0, 5, CCV_IO_ANY_FILE | CCV_IO_GRAY, params);
+	int i;
+	for (i = 0; i < 5; i++)
+	{
+		ccv_dense_matrix_t* x = 0;
+		REQUIRE_EQ(i, ccv_image_loader_next(loader, &x), "images should be handed out in the given order");
+		if (i == 2)
+		{
+			REQUIRE(x == 0, "a file that doesn't exist should be handed out as 0");
+			continue;
+		}
+		ccv_dense_matrix_t* image = 0;
+		ccv_read(files[i], &image, CCV_IO_ANY_FILE | CCV_IO_GRAY);
+		ccv_dense_matrix_t* resized = 0;
+		ccv_resample(image, &resized, 0, 97, 131, CCV_INTER_AREA | CCV_INTER_CUBIC);
+		ccv_dense_matrix_t* y = 0;
+		ccv_flip(resized, &y, 0, CCV_FLIP_X);
+		REQUIRE_MATRIX_EQ(x, y, "loaded image should be the same as read, resampled and flipped");
+		ccv_matrix_free(y);
+		ccv_matrix_free(resized);
+		ccv_matrix_free(image);
+		ccv_matrix_free(x);
+	}
+	ccv_dense_matrix_t* x = 0;
+	REQUIRE_EQ(-1, ccv_image_loader_next(loader, &x), "there should be no more image");
+	ccv_image_loader_free(loader);
+}
+
+TEST_CASE("load images from memory as they complete")
+{
+	const char* files[] = {
+		"../../samples/nature.png",
+		"../../samples/cmyk-jpeg-format.jpg",
+		"../../samples/street.png",
+	};
+	void* data[3];
+	int size[3];
+	int i;
+	for (i = 0; i < 3; i++)
+	{
+		FILE* rb = fopen(files[i], "rb");
+		fseek(rb, 0, SEEK_END);
+		size[i] = ftell(rb);
+		data[i] = ccmalloc(size[i]);
+		fseek(rb, 0, SEEK_SET);
+		fread(data[i], 1, size[i], rb);
+		fclose(rb);
+	}
+	ccv_image_loader_param_t params = {
+		.threads = 2,
+	};
+	// the loader is freed before all images are handed out
+	ccv_image_loader_t* loader = ccv_image_loader_new((const void* const*)data, size, 3, CCV_IO_ANY_STREAM, params);
+	int seen = 0;
+	for (i = 0; i < 2; i++)
+	{
+		ccv_dense_matrix_t* x = 0;
+		int index = ccv_image_loader_next(loader, &x);
+		REQUIRE(index >= 0 && index < 3 && !(seen & (1 << index)), "each image should be handed out once");
+		seen |= 1 << index;
+		ccv_dense_matrix_t* y = 0;
+		ccv_read(files[index], &y, CCV_IO_ANY_FILE);
+		REQUIRE_MATRIX_EQ(x, y, "loaded image should be the same as read from file system");
+		ccv_matrix_free(y);
+		ccv_matrix_free(x);
+	}
+	ccv_image_loader_free(loader);
+	for (i = 0; i < 3; i++)
+		ccfree(data[i]);
+}
+
+TEST_CASE("encode JPEG and PNG into memory")
+{
+	ccv_dense_matrix_t* x = 0;
+	ccv_read("../../samples/nature.png", &x, CCV_IO_ANY_FILE);
+	static const int files[] = {
+		CCV_IO_JPEG_FILE, CCV_IO_PNG_FILE
+	};
+	static const int streams[] = {
+		CCV_IO_JPEG_STREAM, CCV_IO_PNG_STREAM
+	};
+	int i;
+	for (i = 0; i < 2; i++)
+	{
+		ccv_write(x, "io.encode.bin", 0, files[i], 0);
+		FILE* rb = fopen("io.encode.bin", "rb");
+		fseek(rb, 0, SEEK_END);
+		long size = ftell(rb);
+		char* data = (char*)ccmalloc(size);
+		fseek(rb, 0, SEEK_SET);
+		fread(data, 1, size, rb);
+		fclose(rb);
+		remove("io.encode.bin");
+		ccv_image_encoder_t* encoder = ccv_image_encoder_new(streams[i], 0);
+		unsigned char* out = 0;
+		size_t out_size = 0, len = 0;
+		// encode twice, the encoder and the buffer are reused
+		REQUIRE_EQ(CCV_IO_FINAL, ccv_image_encode(encoder, x, &out, &out_size, &len), "encoding should succeed");
+		REQUIRE_EQ(CCV_IO_FINAL, ccv_image_encode(encoder, x, &out, &out_size, &len), "encoding again should succeed");
+		ccv_image_encoder_free(encoder);
+		REQUIRE_EQ(size, (long)len, "encoded bytes should be as many as written to the file");
+		REQUIRE_ARRAY_EQ(unsigned char, data, out, (int)len, "encoded bytes should be the same as written to the file");
+		int small = (int)len - 1;
+		REQUIRE_EQ(CCV_IO_ERROR, ccv_write(x, (char*)out, &small, streams[i], 0), "ccv_write should fail if the memory region is too small");
+		REQUIRE_EQ((int)len, small, "ccv_write should tell the bytes needed");
+		int tiny = 16;
+		REQUIRE_EQ(CCV_IO_ERROR, ccv_write(x, (char*)out, &tiny, streams[i], 0), "ccv_write should fail if the memory region is a lot smaller");
+		REQUIRE_EQ((int)len, tiny, "ccv_write should still tell the bytes needed");
+		char* exact = (char*)ccmalloc(len);
+		small = (int)len;
+		REQUIRE_EQ(CCV_IO_FINAL, ccv_write(x, exact, &small, streams[i], 0), "ccv_write should succeed if the memory region fits");
+		REQUIRE_EQ((int)len, small, "ccv_write should tell the bytes written");
+		REQUIRE_ARRAY_EQ(unsigned char, data, exact, (int)len, "ccv_write should write the same bytes as written to the file");
+		ccfree(exact);
+		ccfree(out);
+		ccfree(data);
+	}
+	ccv_matrix_free(x);
+}
+
+TEST_CASE("encode 4-channel matrix as JPEG the same as its first 3 channels")
+{
+	// 37 columns, thus, the rows are converted 8 pixels at a time and then the rest
+	ccv_dense_matrix_t* x = ccv_dense_matrix_new(29, 37, CCV_8U | CCV_C4, 0, 0);
+	ccv_dense_matrix_t* y = ccv_dense_matrix_new(29, 37, CCV_8U | CCV_C3, 0, 0);
+	int i, j;
+	for (i = 0; i < x->rows; i++)
+		for (j = 0; j < x->cols * 4; j++)
+		{
+			x->data.u8[i * x->step + j] = (i * 131 + j * 37) & 0xff;
+			if (j % 4 < 3)
+				y->data.u8[i * y->step + j / 4 * 3 + j % 4] = x->data.u8[i * x->step + j];
+		}
+	int xlen = 65536, ylen = 65536;
+	char* xout = (char*)ccmalloc(xlen);
+	char* yout = (char*)ccmalloc(ylen);
+	REQUIRE_EQ(CCV_IO_FINAL, ccv_write(x, xout, &xlen, CCV_IO_JPEG_STREAM, 0), "encoding 4-channel matrix should succeed");
+	REQUIRE_EQ(CCV_IO_FINAL, ccv_write(y, yout, &ylen, CCV_IO_JPEG_STREAM, 0), "encoding 3-channel matrix should succeed");
+	REQUIRE_EQ(ylen, xlen, "the 4th channel should be dropped");
+	REQUIRE_ARRAY_EQ(unsigned char, yout, xout, ylen, "the 4th channel should be dropped");
+	ccfree(yout);
+	ccfree(xout);
+	ccv_matrix_free(y);
+	ccv_matrix_free(x);
+}
+
+TEST_CASE("encode 32-bit float matrix as PNG")
+{
+	ccv_dense_matrix_t* x = 0;
+	ccv_read("../../samples/chessbox.png", &x, CCV_IO_ANY_FILE | CCV_IO_GRAY);
+	ccv_dense_matrix_t* y = 0;
+	ccv_shift(x, (ccv_matrix_t**)&y, CCV_32F, 0, 0);
+	int i;
+	for (i = 0; i < y->rows * y->cols; i++)
+		y->data.f32[i] = y->data.f32[i] * 1.5 - 20.25;
+	int len = y->rows * y->cols * 2 + 4096;
+	char* out = (char*)ccmalloc(len);
+	REQUIRE_EQ(CCV_IO_FINAL, ccv_write(y, out, &len, CCV_IO_PNG_STREAM, 0), "encoding should succeed");
+	ccv_dense_matrix_t* z = 0;
+	ccv_read(out, &z, CCV_IO_ANY_STREAM, len);
+	ccv_dense_matrix_t* w = 0;
+	ccv_shift(y, (ccv_matrix_t**)&w, CCV_8U, 0, 0);
+	REQUIRE_MATRIX_EQ(z, w, "float matrix should be saturated to 8-bit the same as ccv_shift does");
+	ccv_matrix_free(w);
+	ccv_matrix_free(z);
+	ccfree(out);
+	ccv_matrix_free(y);
+	ccv_matrix_free(x);
+}
+
+TEST_CASE("write and read matrices in a record file")
+{
+	ccv_dense_matrix_t* x = 0;
+	ccv_read("../../samples/nature.png", &x, CCV_IO_ANY_FILE);
+	ccv_dense_matrix_t* y = 0;
+	ccv_shift(x, (ccv_matrix_t**)&y, CCV_32F, 0, 0);
+	ccv_dense_matrix_t* z = ccv_dense_matrix_new(3, 5, CCV_64F | CCV_C2, 0, 0);
+	int i, j;
+	for (i = 0; i < 3 * 5 * 2; i++)
+		z->data.f64[i] = i * 0.25 - 3;
+	ccv_dense_matrix_t* mats[] = {
+		x, y, z, x
+	};
+	for (i = 0; i < 4; i++)
+	{
+		// as they are, then deflated, each read from the mapping and then from the file
+		const int compression = (i / 2) * 6;
+		const int mapped = !(i % 2);
+		ccv_record_writer_t* writer = ccv_record_writer_new("io.record.bin", compression);
+		for (j = 0; j < 4; j++)
+			REQUIRE_EQ(j, ccv_record_write(writer, mats[j]), "record index should be in the written order");
+		REQUIRE_EQ(0, ccv_record_writer_free(writer), "record file should be finished");
+		ccv_record_reader_t* reader = ccv_record_reader_new("io.record.bin", mapped ? CCV_IO_NO_COPY : 0);
+		REQUIRE(reader, "record file should be opened");
+		REQUIRE_EQ(4, ccv_record_count(reader), "record file should have all matrices");
+		for (j = 3; j >= 0; j--)
+		{
+			ccv_dense_matrix_t* a = 0;
+			REQUIRE_EQ(CCV_IO_FINAL, ccv_record_read(reader, j, &a, 0), "record should be read");
+			REQUIRE(!(a->type & CCV_NO_DATA_ALLOC), "record should be copied without no copy mode");
+			REQUIRE_MATRIX_EQ(mats[j], a, "record should be the same as the original");
+			ccv_matrix_free(a);
+			ccv_dense_matrix_t* b = 0;
+			REQUIRE_EQ(CCV_IO_FINAL, ccv_record_read(reader, j, &b, CCV_IO_NO_COPY), "record should be read");
+			if (compression == 0 && mapped)
+			{
+				REQUIRE(b->type & CCV_NO_DATA_ALLOC, "record should be mapped in place");
+				REQUIRE_EQ(0, (int)((uintptr_t)b->data.u8 & 63), "record should be 64-byte aligned");
+			} else
+				REQUIRE(!(b->type & CCV_NO_DATA_ALLOC), "record should be copied if the reader doesn't map the file");
+			REQUIRE_MATRIX_EQ(mats[j], b, "record should be the same as the original");
+			ccv_matrix_free(b);
+		}
+		ccv_record_reader_free(reader);
+	}
+	remove("io.record.bin");
+	ccv_matrix_free(z);
+	ccv_matrix_free(y);
+	ccv_matrix_free(x);
+}
+
+TEST_CASE("read unfinished record file")
+{
+	ccv_dense_matrix_t* x = 0;
+	ccv_read("../../samples/chessbox.png", &x, CCV_IO_ANY_FILE);
+	ccv_write(x, "io.record.bin", 0, CCV_IO_BINARY_FILE, 0);
+	REQUIRE(!ccv_record_reader_new("io.record.bin", CCV_IO_NO_COPY), "binary file is not a record file");
+	ccv_record_writer_t* writer = ccv_record_writer_new("io.record.bin", 0);
+	ccv_record_write(writer, x);
+	fflush(0);
+	REQUIRE(!ccv_record_reader_new("io.record.bin", CCV_IO_NO_COPY), "record file without index should not be opened");
+	REQUIRE(!ccv_record_reader_new("io.record.bin", 0), "record file without index should not be opened");
+	ccv_record_writer_free(writer);
+	ccv_record_reader_t* reader = ccv_record_reader_new("io.record.bin", CCV_IO_NO_COPY);
+	REQUIRE(reader, "finished record file should be opened");
+	ccv_record_reader_free(reader);
+	remove("io.record.bin");
+	ccv_matrix_free(x);
+}
+
+TEST_CASE("read record file with corrupt index")
+{
+	ccv_dense_matrix_t* x = ccv_dense_matrix_new(3, 5, CCV_64F | CCV_C1, 0, 0);
+	int i;
+	for (i = 0; i < 3 * 5; i++)
+		x->data.f64[i] = i * 0.5 - 3;
+	ccv_record_writer_t* writer = ccv_record_writer_new("io.record.bin", 0);
+	ccv_record_write(writer, x);
+	ccv_record_writer_free(writer);
+	FILE* w = fopen("io.record.bin", "r+b");
+	uint64_t index, offset;
+	fseek(w, 16, SEEK_SET);
+	fread(&index, 1, 8, w);
+	fseek(w, index + 16, SEEK_SET);
+	fread(&offset, 1, 8, w);
+	// the rows and the cols of the record, then its offset off the 64-bit element
+	static const int negative = -3;
+	fseek(w, index + 4, SEEK_SET);
+	fwrite(&negative, 1, 4, w);
+	fflush(w);
+	REQUIRE(!ccv_record_reader_new("io.record.bin", CCV_IO_NO_COPY), "record of negative rows should not be opened");
+	REQUIRE(!ccv_record_reader_new("io.record.bin", 0), "record of negative rows should not be opened");
+	fseek(w, index + 4, SEEK_SET);
+	fwrite(&x->rows, 1, 4, w);
+	fwrite(&negative, 1, 4, w);
+	fflush(w);
+	REQUIRE(!ccv_record_reader_new("io.record.bin", CCV_IO_NO_COPY), "record of negative cols should not be opened");
+	fseek(w, index + 8, SEEK_SET);
+	fwrite(&x->cols, 1, 4, w);
+	fflush(w);
+	ccv_record_reader_t* reader = ccv_record_reader_new("io.record.bin", CCV_IO_NO_COPY);
+	REQUIRE(reader, "record file should be opened once the index is restored");
+	ccv_record_reader_free(reader);
+	offset += 4;
+	fseek(w, index + 16, SEEK_SET);
+	fwrite(&offset, 1, 8, w);
+	fclose(w);
+	REQUIRE(!ccv_record_reader_new("io.record.bin", CCV_IO_NO_COPY), "record not aligned to its element should not be opened");
+	REQUIRE(!ccv_record_reader_new("io.record.bin", 0), "record not aligned to its element should not be opened");
+	remove("io.record.bin");
+	ccv_matrix_free(x);
+}
+
+TEST_CASE("read deflated record file with corrupt size")
+{
+	ccv_dense_matrix_t* x = ccv_dense_matrix_new(16, 16, CCV_32S | CCV_C1, 0, 0);
+	ccv_zero(x);
+	ccv_record_writer_t* writer = ccv_record_writer_new("io.record.bin", 9);
+	ccv_record_write(writer, x);
+	ccv_record_writer_free(writer);
+	FILE* w = fopen("io.record.bin", "r+b");
+	uint64_t index;
+	fseek(w, 16, SEEK_SET);
+	fread(&index, 1, 8, w);
+	// the rows, the cols, the step, then the offset and the size of the record
+	static const int huge = 0x7fffffff;
+	fseek(w, index + 4, SEEK_SET);
+	fwrite(&huge, 1, 4, w);
+	fflush(w);
+	REQUIRE(!ccv_record_reader_new("io.record.bin", 0), "deflated record of too many rows should not be opened");
+	fseek(w, index + 4, SEEK_SET);
+	fwrite(&x->rows, 1, 4, w);
+	fwrite(&huge, 1, 4, w);
+	fwrite(&huge, 1, 4, w);
+	fflush(w);
+	REQUIRE(!ccv_record_reader_new("io.record.bin", 0), "deflated record of too many cols should not be opened");
+	static const int fewer_rows = 15;
+	fseek(w, index + 4, SEEK_SET);
+	fwrite(&fewer_rows, 1, 4, w);
+	fwrite(&x->cols, 1, 4, w);
+	fwrite(&x->step, 1, 4, w);
+	fflush(w);
+	ccv_record_reader_t* reader = ccv_record_reader_new("io.record.bin", 0);
+	REQUIRE(reader, "deflated record of fewer rows is consistent with its type");
+	ccv_dense_matrix_t* y = 0;
+	REQUIRE_EQ(CCV_IO_ERROR, ccv_record_read(reader, 0, &y, 0), "deflated record that inflates to more than its rows should not be read");
+	REQUIRE(!y, "no matrix should be returned");
+	ccv_record_reader_free(reader);
+	static const int more_rows = 17;
+	fseek(w, index + 4, SEEK_SET);
+	fwrite(&more_rows, 1, 4, w);
+	fclose(w);
+	reader = ccv_record_reader_new("io.record.bin", 0);
+	REQUIRE_EQ(CCV_IO_ERROR, ccv_record_read(reader, 0, &y, 0), "deflated record that inflates to less than its rows should not be read");
+	ccv_record_reader_free(reader);
+	remove("io.record.bin");
+	ccv_matrix_free(x);
+}
+
+TEST_CASE("write record file to a full device")
+{
+	ccv_dense_matrix_t* x = 0;
+	ccv_read("../../samples/chessbox.png", &x, CCV_IO_ANY_FILE);
+	// only where there is /dev/full
+	ccv_record_writer_t* writer = ccv_record_writer_new("/dev/full", 0);
+	if (writer)
+	{
+		REQUIRE_EQ(-1, ccv_record_write(writer, x), "record should not be written");
+		REQUIRE_EQ(-1, ccv_record_writer_free(writer), "record file should not be finished");
+	}
+	ccv_matrix_free(x);
+}
+
+#ifdef HAVE_PTHREAD
+typedef struct {
+	ccv_record_reader_t* reader;
+	ccv_dense_matrix_t** mats;
+	int start;
+	int failed;
+} record_reader_context_t;
+
+static void* record_reader_thread(void* arg)
+{
+	record_reader_context_t* context = (record_reader_context_t*)arg;
+	int i, j;
+	for (i = 0; i < 16 * 8; i++)
+	{
+		// each thread goes through the records from its own start, thus, the reads interleave
+		const int k = (context->start + i * 5) % 16;
+		ccv_dense_matrix_t* x = 0;
+		if (ccv_record_read(context->reader, k, &x, 0) != CCV_IO_FINAL)
+		{
+			++context->failed;
+			continue;
+		}
+		for (j = 0; j < x->rows * x->cols; j++)
+			if (x->data.i32[j] != context->mats[k]->data.i32[j])
+				break;
+		if (j < x->rows * x->cols)
+			++context->failed;
+		ccv_matrix_free(x);
+	}
+	return 0;
+}
+
+TEST_CASE("read record file from many threads without mapping it")
+{
+	ccv_dense_matrix_t* mats[16];
+	int i, j;
+	ccv_record_writer_t* writer = ccv_record_writer_new("io.record.bin", 0);
+	for (i = 0; i < 16; i++)
+	{
+		mats[i] = ccv_dense_matrix_new(17 + i, 23, CCV_32S | CCV_C1, 0, 0);
+		for (j = 0; j < mats[i]->rows * mats[i]->cols; j++)
+			mats[i]->data.i32[j] = i * 100003 + j;
+		ccv_record_write(writer, mats[i]);
+	}
+	ccv_record_writer_free(writer);
+	ccv_record_reader_t* reader = ccv_record_reader_new("io.record.bin", 0);
+	REQUIRE(reader, "record file should be opened");
+	pthread_t threads[4];
+	record_reader_context_t contexts[4];
+	for (i = 0; i < 4; i++)
+	{
+		contexts[i].reader = reader;
+		contexts[i].mats = mats;
+		contexts[i].start = i * 4;
+		contexts[i].failed = 0;
+		pthread_create(threads + i, 0, record_reader_thread, contexts + i);
+	}
+	for (i = 0; i < 4; i++)
+		pthread_join(threads[i], 0);
+	for (i = 0; i < 4; i++)
+		REQUIRE_EQ(0, contexts[i].failed, "every record read from thread %d should be the same as the original", i);
+	ccv_record_reader_free(reader);
+	remove("io.record.bin");
+	for (i = 0; i < 16; i++)
+		ccv_matrix_free(mats[i]);
+}
+#endif
+
 #include "case_main.h"
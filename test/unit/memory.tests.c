@@ -1,6 +1,9 @@
 #include "ccv.h"
 #include "ccv_internal.h"
 #include "case.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 uint64_t uniqid()
 {
@@ -173,4 +176,219 @@ TEST_CASE("multi-type garbage collector 92\% hit rate")
 	ccv_disable_cache();
 }
 
+TEST_CASE("cache statistics for hits, misses and evictions")
+{
+	int i;
+	// only fits 10 matrices
+	ccv_enable_cache(ccv_compute_dense_matrix_size(1, 1, CCV_32S | CCV_C1) * 10);
+	for (i = 0; i < 20; i++)
+	{
+		ccv_dense_matrix_t* dmt = ccv_dense_matrix_new(1, 1, CCV_32S | CCV_C1, 0, 0);
+		dmt->data.i32[0] = i;
+		dmt->sig = ccv_cache_generate_signature((const char*)&i, 4, CCV_EOF_SIGN);
+		dmt->type |= CCV_REUSABLE;
+		ccv_matrix_free(dmt);
+	}
+	ccv_dense_matrix_t* large = ccv_dense_matrix_new(100, 100, CCV_32S | CCV_C1, 0, 0);
+	large->sig = ccv_cache_generate_signature("large", 5, CCV_EOF_SIGN);
+	large->type |= CCV_REUSABLE;
+	ccv_matrix_free(large);
+	ccv_cache_stats_t stats[2];
+	ccv_cache_stats(stats, 0);
+	REQUIRE_EQ(20, stats[0].puts, "all matrices should be put into the cache");
+	REQUIRE_EQ(1, stats[0].rejects, "the large matrix should be rejected");
+	REQUIRE_EQ(10, stats[0].evictions, "half of the matrices should be evicted");
+	REQUIRE_EQ(ccv_compute_dense_matrix_size(1, 1, CCV_32S | CCV_C1) * 10, stats[0].size, "the cache should be full");
+	REQUIRE_EQ(stats[0].size, stats[0].peak, "the peak should be the full cache");
+	for (i = 0; i < 20; i++)
+	{
+		uint64_t sig = ccv_cache_generate_signature((const char*)&i, 4, CCV_EOF_SIGN);
+		ccv_dense_matrix_t* dmt = ccv_dense_matrix_new(1, 1, CCV_32S | CCV_C1, 0, sig);
+		ccv_matrix_free_immediately(dmt);
+	}
+	ccv_cache_stats(stats, 1);
+	REQUIRE_EQ(10, stats[0].hits, "the recent half should hit");
+	REQUIRE_EQ(10, stats[0].misses, "the evicted half should miss");
+	REQUIRE_EQ(0, stats[0].size, "hits are taken out of the cache");
+	REQUIRE_EQ(0, stats[1].puts, "no array is put into the cache");
+	ccv_cache_stats(stats, 0);
+	REQUIRE_EQ(0, stats[0].hits, "counters should be reset");
+	REQUIRE_EQ(0, stats[0].peak, "peak should restart from current bytes");
+	ccv_disable_cache();
+}
+
+TEST_CASE("arena allocation for matrices and arrays")
+{
+	ccv_arena_begin();
+	ccv_dense_matrix_t* a = ccv_dense_matrix_new(100, 100, CCV_8U | CCV_C1, 0, 0);
+	ccv_dense_matrix_t* first = a;
+	memset(a->data.u8, 1, a->rows * a->step);
+	ccv_array_t* array = ccv_array_new(sizeof(int), 2, 0);
+	int i;
+	for (i = 0; i < 10000; i++)
+		ccv_array_push(array, &i);
+	for (i = 0; i < 10000; i++)
+		REQUIRE_EQ(i, *(int*)ccv_array_get(array, i), "array should keep its content when grown in arena");
+	ccv_arena_begin();
+	ccv_dense_matrix_t* d = ccv_dense_matrix_new(10, 10, CCV_8U | CCV_C1, 0, 0);
+	ccv_dense_matrix_t* b = ccv_dense_matrix_new(2000, 2000, CCV_32F | CCV_C1, 0, 0); // larger than the first block
+	b->data.f32[2000 * 2000 - 1] = 1;
+	ccv_matrix_free(b);
+	ccv_matrix_free(d);
+	ccv_arena_end();
+	ccv_arena_begin();
+	ccv_dense_matrix_t* c = ccv_dense_matrix_new(10, 10, CCV_8U | CCV_C1, 0, 0);
+	REQUIRE(c == d, "nested scope should roll back to where it began");
+	ccv_arena_end();
+	REQUIRE_EQ(1, a->data.u8[100 * 100 - 1], "outer matrix should be intact after nested scope ended");
+	ccv_matrix_free(a);
+	ccv_array_free(array);
+	ccv_arena_end();
+	ccv_arena_begin();
+	a = ccv_dense_matrix_new(100, 100, CCV_8U | CCV_C1, 0, 0);
+	REQUIRE(a == first, "arena memory should be reused by next scope");
+	ccv_matrix_free(a);
+	ccv_arena_end();
+	a = ccv_dense_matrix_new(100, 100, CCV_8U | CCV_C1, 0, 0);
+	REQUIRE(a->type & CCV_REUSABLE, "matrix outside of arena scope is allocated as usual");
+	ccv_matrix_free(a);
+}
+
+#ifdef HAVE_PTHREAD
+static void* arena_free_on_other_thread(void* arg)
+{
+	ccv_matrix_free(((void**)arg)[0]);
+	ccv_array_free((ccv_array_t*)((void**)arg)[1]);
+	return 0;
+}
+#endif
+
+TEST_CASE("free arena matrices and arrays from elsewhere")
+{
+	ccv_dense_matrix_t* x = ccv_dense_matrix_new(10, 10, CCV_8U | CCV_C1, 0, 0);
+	REQUIRE_EQ(0, x->arena, "matrix from the heap should not be tagged");
+	ccv_arena_begin();
+	ccv_dense_matrix_t* a = ccv_dense_matrix_new(10, 10, CCV_8U | CCV_C1, 0, 0);
+	ccv_dense_matrix_t* b = ccv_dense_matrix_new(10, 10, CCV_8U | CCV_C1 | CCV_NO_DATA_ALLOC, x->data.u8, 0);
+	void* data = ccmalloc(ccv_compute_dense_matrix_size(10, 10, CCV_8U | CCV_C1));
+	ccv_dense_matrix_t* c = ccv_dense_matrix_new(10, 10, CCV_8U | CCV_C1, data, 0);
+	ccv_array_t* array = ccv_array_new(sizeof(int), 2, 0);
+	REQUIRE(a->arena && b->arena && array->arena, "matrix and array in arena scope should be tagged");
+	REQUIRE_EQ(0, c->arena, "matrix on memory of the caller should not be tagged");
+	REQUIRE_EQ(0, a->type & ~(CCV_8U | CCV_C1 | CCV_MATRIX_DENSE), "the tag should take no bit of the type");
+	REQUIRE_EQ(0, array->type, "the tag should take no bit of the type");
+#ifdef HAVE_PTHREAD
+	void* objects[] = { a, array };
+	pthread_t thread;
+	pthread_create(&thread, 0, arena_free_on_other_thread, objects);
+	pthread_join(thread, 0);
+#endif
+	ccv_matrix_free(b);
+	ccv_arena_end();
+	// the scope fit in one block, it is kept around, therefore, the headers can still be read
+	ccv_matrix_free(a);
+	ccv_array_free(array);
+	ccfree(data);
+	ccv_matrix_free(x);
+}
+
+#ifdef HAVE_PTHREAD
+static void* shared_cache_producer(void* arg)
+{
+	int i;
+	for (i = 0; i < 1000; i++)
+	{
+		ccv_dense_matrix_t* dmt = ccv_dense_matrix_new(1, 1, CCV_32S | CCV_C1, 0, 0);
+		dmt->data.i32[0] = i;
+		dmt->sig = ccv_cache_generate_signature((const char*)&i, 4, CCV_EOF_SIGN);
+		dmt->type |= CCV_REUSABLE;
+		ccv_matrix_free(dmt);
+	}
+	return 0;
+}
+
+TEST_CASE("shared cache hit across threads")
+{
+	ccv_enable_shared_cache(CCV_DEFAULT_CACHE_SIZE);
+	pthread_t thread;
+	pthread_create(&thread, 0, shared_cache_producer, 0);
+	pthread_join(thread, 0);
+	int i, percent = 0;
+	for (i = 0; i < 1000; i++)
+	{
+		uint64_t sig = ccv_cache_generate_signature((const char*)&i, 4, CCV_EOF_SIGN);
+		ccv_dense_matrix_t* dmt = ccv_dense_matrix_new(1, 1, CCV_32S | CCV_C1, 0, sig);
+		if ((dmt->type & CCV_GARBAGE) && i == dmt->data.i32[0])
+			++percent;
+		ccv_matrix_free_immediately(dmt);
+	}
+	REQUIRE_EQ(1000, percent, "all matrices computed on the other thread should be picked up");
+	ccv_disable_shared_cache();
+}
+
+TEST_CASE("shared cache keeps one byte budget across its shards")
+{
+	ccv_enable_shared_cache(1024 * 1024);
+	int i;
+	uint64_t sigs[3];
+	for (i = 0; i < 3; i++)
+	{
+		// larger than a 16th of the budget, in different shards
+		ccv_dense_matrix_t* dmt = ccv_dense_matrix_new(256, 400, CCV_32F | CCV_C1, 0, 0);
+		dmt->data.f32[0] = i;
+		sigs[i] = dmt->sig = ((uint64_t)i << 62) | (i + 1);
+		dmt->type |= CCV_REUSABLE;
+		ccv_matrix_free(dmt);
+	}
+	ccv_cache_stats_t stats[2];
+	ccv_cache_stats(stats, 0);
+	REQUIRE(stats[0].size <= 1024 * 1024, "the cache should hold no more than the budget");
+	REQUIRE_EQ(1, (int)stats[0].evictions, "the least recently used one should be evicted");
+	for (i = 0; i < 3; i++)
+	{
+		ccv_dense_matrix_t* dmt = ccv_dense_matrix_new(256, 400, CCV_32F | CCV_C1, 0, sigs[i]);
+		REQUIRE_EQ(i > 0, !!(dmt->type & CCV_GARBAGE), "the two most recent matrices should be picked up");
+		if (i > 0)
+			REQUIRE_EQ(i, (int)dmt->data.f32[0], "should be the same matrix");
+		ccv_matrix_free_immediately(dmt);
+	}
+	ccv_disable_shared_cache();
+}
+
+static void* shared_cache_consumer(void* arg)
+{
+	int i;
+	for (i = 0; i < 20000; i++)
+	{
+		uint64_t sig = ccv_cache_generate_signature((const char*)&i, 4, CCV_EOF_SIGN);
+		ccv_dense_matrix_t* dmt = ccv_dense_matrix_new(4, 4, CCV_32S | CCV_C1, 0, sig);
+		dmt->type |= CCV_REUSABLE;
+		ccv_matrix_free(dmt);
+	}
+	return 0;
+}
+
+TEST_CASE("shared cache disabled and enabled while other threads use it")
+{
+	ccv_enable_shared_cache(64 * 1024);
+	pthread_t threads[3];
+	int i;
+	for (i = 0; i < 3; i++)
+		pthread_create(threads + i, 0, shared_cache_consumer, 0);
+	for (i = 0; i < 100; i++)
+	{
+		ccv_disable_shared_cache();
+		ccv_enable_shared_cache(64 * 1024);
+	}
+	ccv_disable_shared_cache();
+	for (i = 0; i < 3; i++)
+		pthread_join(threads[i], 0);
+	ccv_cache_stats_t stats[2];
+	ccv_enable_shared_cache(64 * 1024);
+	ccv_cache_stats(stats, 0);
+	REQUIRE_EQ(0, (int)stats[0].size, "nothing should be left in the cache after it is disabled");
+	ccv_disable_shared_cache();
+}
+#endif
+
 #include "case_main.h"
@@ -2,6 +2,9 @@
 #include "case.h"
 #include "ccv_case.h"
 #include "3rdparty/dsfmt/dSFMT.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 /* numeric tests are more like functional tests rather than unit tests:
  * the following tests contain:
@@ -145,6 +148,113 @@ TEST_CASE("ccv_filter centre point for odd number window size, hint: (size - 1)
 	ccv_matrix_free(x);
 }
 
+TEST_CASE("ccv_filter_plan applies the same kernel to many images")
+{
+	ccv_dense_matrix_t* kernel = ccv_dense_matrix_new(21, 21, CCV_32F | CCV_C1, 0, 0);
+	ccv_filter_kernel(kernel, gaussian, 0);
+	ccv_dense_matrix_t* x = ccv_dense_matrix_new(97, 133, CCV_32F | CCV_C1, 0, 0);
+	ccv_filter_plan_t* plan = ccv_filter_plan_new(kernel, x->rows, x->cols, x->type, 0);
+	int i, j;
+	for (i = 0; i < 3; i++)
+	{
+		for (j = 0; j < x->rows * x->cols; j++)
+			x->data.f32[j] = ((j * (i + 7)) % 31) / 31.0;
+		ccv_dense_matrix_t* d = 0;
+		ccv_filter(x, kernel, &d, 0, CCV_NO_PADDING);
+		ccv_dense_matrix_t* e = 0;
+		ccv_filter_plan_execute(plan, x, &e, CCV_NO_PADDING);
+		REQUIRE_MATRIX_EQ(d, e, "filter plan should give the same result as ccv_filter");
+		ccv_matrix_free(d);
+		ccv_matrix_free(e);
+	}
+	ccv_filter_plan_free(plan);
+	ccv_matrix_free(x);
+	ccv_matrix_free(kernel);
+}
+
+#ifdef HAVE_PTHREAD
+typedef struct {
+	ccv_filter_plan_t* plan;
+	ccv_dense_matrix_t* x;
+	ccv_dense_matrix_t* d[8];
+} filter_plan_thread_t;
+
+static void* filter_plan_thread(void* arg)
+{
+	filter_plan_thread_t* context = (filter_plan_thread_t*)arg;
+	int i;
+	for (i = 0; i < 8; i++)
+		ccv_filter_plan_execute(context->plan, context->x, context->d + i, CCV_NO_PADDING);
+	return 0;
+}
+
+TEST_CASE("ccv_filter_plan executed from many threads at the same time")
+{
+	ccv_dense_matrix_t* kernel = ccv_dense_matrix_new(15, 15, CCV_32F | CCV_C1, 0, 0);
+	ccv_filter_kernel(kernel, gaussian, 0);
+	ccv_dense_matrix_t* x[4];
+	ccv_filter_plan_t* plan = ccv_filter_plan_new(kernel, 161, 143, CCV_32F | CCV_C1, 0);
+	filter_plan_thread_t context[4];
+	pthread_t threads[4];
+	int i, j;
+	for (i = 0; i < 4; i++)
+	{
+		x[i] = ccv_dense_matrix_new(161, 143, CCV_32F | CCV_C1, 0, 0);
+		for (j = 0; j < x[i]->rows * x[i]->cols; j++)
+			x[i]->data.f32[j] = ((j * (i + 5)) % 37) / 37.0;
+		context[i].plan = plan;
+		context[i].x = x[i];
+		memset(context[i].d, 0, sizeof(context[i].d));
+	}
+	for (i = 0; i < 4; i++)
+		pthread_create(threads + i, 0, filter_plan_thread, context + i);
+	for (i = 0; i < 4; i++)
+		pthread_join(threads[i], 0);
+	for (i = 0; i < 4; i++)
+	{
+		ccv_dense_matrix_t* d = 0;
+		ccv_filter(x[i], kernel, &d, 0, CCV_NO_PADDING);
+		for (j = 0; j < 8; j++)
+		{
+			REQUIRE_MATRIX_EQ(d, context[i].d[j], "filter plan shared by threads should give the same result as ccv_filter");
+			ccv_matrix_free(context[i].d[j]);
+		}
+		ccv_matrix_free(d);
+		ccv_matrix_free(x[i]);
+	}
+	ccv_filter_plan_free(plan);
+	ccv_matrix_free(kernel);
+}
+#endif
+
+TEST_CASE("ccv_filter_bank gives the same results as ccv_filter on each kernel")
+{
+	ccv_dense_matrix_t* x = ccv_dense_matrix_new(61, 75, CCV_32F | CCV_C3, 0, 0);
+	int i, j;
+	for (i = 0; i < x->rows * x->cols * 3; i++)
+		x->data.f32[i] = ((i * 7) % 23) / 23.0;
+	static const int size[][2] = {{5, 5}, {9, 7}, {13, 12}, {6, 11}};
+	ccv_dense_matrix_t* kernels[4];
+	ccv_dense_matrix_t* d[4] = {0};
+	for (i = 0; i < 4; i++)
+	{
+		kernels[i] = ccv_dense_matrix_new(size[i][0], size[i][1], CCV_32F | CCV_C3, 0, 0);
+		for (j = 0; j < size[i][0] * size[i][1] * 3; j++)
+			kernels[i]->data.f32[j] = ((j * (i + 3)) % 17) / 17.0 - 0.5;
+	}
+	ccv_filter_bank(x, kernels, 4, d, 0, CCV_NO_PADDING);
+	for (i = 0; i < 4; i++)
+	{
+		ccv_dense_matrix_t* y = 0;
+		ccv_filter(x, kernels[i], &y, 0, CCV_NO_PADDING);
+		REQUIRE_ARRAY_EQ_WITH_TOLERANCE(float, d[i]->data.f32, y->data.f32, x->rows * x->cols * 3, 1e-3, "filter bank should match ccv_filter on kernel %d", i);
+		ccv_matrix_free(y);
+		ccv_matrix_free(d[i]);
+		ccv_matrix_free(kernels[i]);
+	}
+	ccv_matrix_free(x);
+}
+
 #include "ccv_internal.h"
 
 static void naive_ssd(ccv_dense_matrix_t* image, ccv_dense_matrix_t* template, ccv_dense_matrix_t* out)
@@ -398,4 +508,44 @@ TEST_CASE("ccv_distance_transform to compute max distance")
 	ccv_matrix_free(distance);
 }
 
+TEST_CASE("ccv_distance_transform_batch gives the same results and offsets as one by one")
+{
+	ccv_dense_matrix_t* geometry = 0;
+	ccv_read("../../samples/geometry.png", &geometry, CCV_IO_GRAY | CCV_IO_ANY_FILE);
+	ccv_dense_matrix_t* a[3] = {
+		geometry, 0, 0
+	};
+	ccv_slice(geometry, (ccv_matrix_t**)&a[1], 0, 13, 7, 61, 97);
+	ccv_slice(geometry, (ccv_matrix_t**)&a[2], 0, 40, 21, 23, 5);
+	int i;
+	// without signatures, the batch and the single calls won't share results from the cache
+	for (i = 0; i < 3; i++)
+		a[i]->sig = 0;
+	double dx[3] = {1, 0.5, 0};
+	double dy[3] = {1, 0.2, 0.1};
+	double dxx[3] = {0.4, 0.1, 0.01};
+	double dyy[3] = {0.4, 0.3, 0.05};
+	ccv_dense_matrix_t* b[3] = {0};
+	ccv_dense_matrix_t* x[3] = {0};
+	ccv_dense_matrix_t* y[3] = {0};
+	ccv_distance_transform_batch(a, b, 0, x, 0, y, 0, dx, dy, dxx, dyy, 3, CCV_NEGATIVE | CCV_GSEDT);
+	for (i = 0; i < 3; i++)
+	{
+		ccv_dense_matrix_t* rb = 0;
+		ccv_dense_matrix_t* rx = 0;
+		ccv_dense_matrix_t* ry = 0;
+		ccv_distance_transform(a[i], &rb, 0, &rx, 0, &ry, 0, dx[i], dy[i], dxx[i], dyy[i], CCV_NEGATIVE | CCV_GSEDT);
+		REQUIRE_MATRIX_EQ(b[i], rb, "batched distance transform should match the one computed alone");
+		REQUIRE_MATRIX_EQ(x[i], rx, "batched x offsets should match the ones computed alone");
+		REQUIRE_MATRIX_EQ(y[i], ry, "batched y offsets should match the ones computed alone");
+		ccv_matrix_free(rb);
+		ccv_matrix_free(rx);
+		ccv_matrix_free(ry);
+		ccv_matrix_free(a[i]);
+		ccv_matrix_free(b[i]);
+		ccv_matrix_free(x[i]);
+		ccv_matrix_free(y[i]);
+	}
+}
+
 #include "case_main.h"
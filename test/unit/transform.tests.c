@@ -24,4 +24,111 @@ TEST_CASE("matrix perspective transform")
 	ccv_matrix_free(b);
 }
 
+TEST_CASE("matrix decimal slice batch")
+{
+	ccv_dense_matrix_t* image = 0;
+	ccv_read("../../samples/chessbox.png", &image, CCV_IO_ANY_FILE);
+	ccv_decimal_point_t point[] = {
+		ccv_decimal_point(41.5, 33.5),
+		ccv_decimal_point(0.25, 120.75),
+		ccv_decimal_point(-10.3, 7.6),
+		ccv_decimal_point(image->cols - 50.4, image->rows - 80.2),
+	};
+	ccv_dense_matrix_t* b[4] = {0};
+	ccv_decimal_slice_batch(image, b, 0, point, 111, 91, 4);
+	int i;
+	for (i = 0; i < 4; i++)
+	{
+		ccv_dense_matrix_t* x = 0;
+		ccv_decimal_slice(image, &x, 0, point[i].y, point[i].x, 111, 91);
+		REQUIRE_MATRIX_EQ(b[i], x, "decimal slice %d should be the same as ccv_decimal_slice", i);
+		ccv_matrix_free(x);
+		ccv_matrix_free(b[i]);
+	}
+	ccv_matrix_free(image);
+}
+
+TEST_CASE("matrix perspective transform batch with windows")
+{
+	ccv_dense_matrix_t* image = 0;
+	ccv_read("../../samples/chessbox.png", &image, CCV_IO_ANY_FILE);
+	const float m[] = {
+		cosf(CCV_PI / 6), 0, 0, 0, 1, 0, -sinf(CCV_PI / 6), 0, cosf(CCV_PI / 6),
+		cosf(CCV_PI / 8), sinf(CCV_PI / 8), 10, -sinf(CCV_PI / 8), cosf(CCV_PI / 8), -20, 0, 0, 1,
+		1, 0, 0, 0, cosf(CCV_PI / 5), 0, 0, sinf(CCV_PI / 5), cosf(CCV_PI / 5),
+	};
+	const ccv_rect_t rect[] = {
+		ccv_rect(100, 120, 64, 128),
+		ccv_rect(-20, -10, 80, 60),
+		ccv_rect(image->cols - 50, image->rows - 40, 100, 90),
+	};
+	ccv_dense_matrix_t* b[3] = {0};
+	ccv_perspective_transform_batch(image, b, 0, m, rect, 3);
+	int i;
+	for (i = 0; i < 3; i++)
+	{
+		ccv_dense_matrix_t* x = 0;
+		ccv_perspective_transform(image, &x, 0, m[i * 9], m[i * 9 + 1], m[i * 9 + 2], m[i * 9 + 3], m[i * 9 + 4], m[i * 9 + 5], m[i * 9 + 6], m[i * 9 + 7], m[i * 9 + 8]);
+		ccv_dense_matrix_t* y = 0;
+		ccv_slice(x, (ccv_matrix_t**)&y, 0, rect[i].y, rect[i].x, rect[i].height, rect[i].width);
+		REQUIRE_MATRIX_EQ(b[i], y, "window %d should be the same as the slice of ccv_perspective_transform", i);
+		ccv_matrix_free(x);
+		ccv_matrix_free(y);
+		ccv_matrix_free(b[i]);
+	}
+	ccv_matrix_free(image);
+}
+
+// we probably won't cover all static functions in this test, disable annoying warnings
+#pragma GCC diagnostic ignored "-Wunused-function"
+// so that we can test static functions, note that CASE_TESTS is defined in case.h, which will disable all extern functions
+#include "ccv_icf.c"
+
+TEST_CASE("ICF training transforms deformed samples in batches the same as one by one")
+{
+	ccv_dense_matrix_t* image = 0;
+	ccv_read("../../samples/nature.png", &image, CCV_IO_ANY_FILE | CCV_IO_RGB_COLOR);
+	ccv_decimal_pose_t pose = {
+		.x = image->cols * 0.5,
+		.y = image->rows * 0.4,
+		.a = 40,
+		.b = 60,
+		.roll = 0.1,
+		.pitch = 0.05,
+		.yaw = -0.05,
+	};
+	ccv_size_t size = ccv_size(20, 30);
+	ccv_margin_t margin = ccv_margin(2, 3, 4, 5);
+	const int rsize = ccv_compute_dense_matrix_size(size.height + margin.top + margin.bottom + 2, size.width + margin.left + margin.right + 2, CCV_8U | CCV_C3);
+	// more than two batches, and then some left for the last flush
+	const int n = CCV_ICF_CAPTURE_BATCH * 2 + 7;
+	ccv_array_t* features = ccv_array_new(rsize, n, 0);
+	ccv_icf_capture_batch_t batch = {
+		.count = 0,
+	};
+	int i;
+	for (i = 0; i < n; i++)
+	{
+		_ccv_icf_capture_queue(image, pose, size, margin, (i % 7 - 3) * 0.05, (i % 5 - 2) * 0.05, (i % 3 - 1) * 0.1, 0.8 + (i % 9) * 0.05, (i % 4) - 1.5, (i % 6) - 2.5, &batch, features);
+		REQUIRE_EQ((i + 1) / CCV_ICF_CAPTURE_BATCH * CCV_ICF_CAPTURE_BATCH, features->rnum, "the samples should be transformed once the batch is full");
+	}
+	_ccv_icf_capture_features(image, size, margin, &batch, features);
+	REQUIRE_EQ(0, batch.count, "the batch should be empty after it is flushed");
+	REQUIRE_EQ(n, features->rnum, "all the samples should be transformed after the last flush");
+	for (i = 0; i < n; i++)
+	{
+		ccv_array_t* one = ccv_array_new(rsize, 1, 0);
+		_ccv_icf_capture_queue(image, pose, size, margin, (i % 7 - 3) * 0.05, (i % 5 - 2) * 0.05, (i % 3 - 1) * 0.1, 0.8 + (i % 9) * 0.05, (i % 4) - 1.5, (i % 6) - 2.5, &batch, one);
+		_ccv_icf_capture_features(image, size, margin, &batch, one);
+		ccv_dense_matrix_t* a = (ccv_dense_matrix_t*)ccv_array_get(features, i);
+		ccv_dense_matrix_t* b = (ccv_dense_matrix_t*)ccv_array_get(one, 0);
+		a->data.u8 = (unsigned char*)(a + 1);
+		b->data.u8 = (unsigned char*)(b + 1);
+		REQUIRE_MATRIX_EQ(a, b, "sample %d should be the same as transformed alone", i);
+		ccv_array_free(one);
+	}
+	ccv_array_free(features);
+	ccv_matrix_free(image);
+}
+
 #include "case_main.h"
@@ -103,6 +103,56 @@ TEST_CASE("group array with is_equal function")
 	ccv_array_free(idx);
 }
 
+static int is_near(const void* _r1, const void* _r2, void* data)
+{
+	const ccv_comp_t* r1 = (const ccv_comp_t*)_r1;
+	const ccv_comp_t* r2 = (const ccv_comp_t*)_r2;
+	int distance = (int)(r1->rect.width * 0.25 + 0.5);
+	return r2->classification.id == r1->classification.id &&
+		r2->rect.x <= r1->rect.x + distance &&
+		r2->rect.x >= r1->rect.x - distance &&
+		r2->rect.y <= r1->rect.y + distance &&
+		r2->rect.y >= r1->rect.y - distance &&
+		r2->rect.width <= (int)(r1->rect.width * 1.5 + 0.5) &&
+		(int)(r2->rect.width * 1.5 + 0.5) >= r1->rect.width;
+}
+
+static ccv_rect_t is_near_hint(const void* _r, void* data)
+{
+	const ccv_comp_t* r = (const ccv_comp_t*)_r;
+	int distance = (int)(r->rect.width * 0.25 + 0.5);
+	return ccv_rect(r->rect.x - distance, r->rect.y - distance, distance * 2 + 1, distance * 2 + 1);
+}
+
+TEST_CASE("group array spatially should match brute force grouping")
+{
+	sfmt_t sfmt;
+	sfmt_init_gen_rand(&sfmt, 1);
+	ccv_array_t* array = ccv_array_new(sizeof(ccv_comp_t), 2000, 0);
+	int i;
+	for (i = 0; i < 2000; i++)
+	{
+		ccv_comp_t comp = {
+			.classification = {
+				.id = sfmt_genrand_uint32(&sfmt) % 2,
+			},
+		};
+		int size = 8 + sfmt_genrand_uint32(&sfmt) % 120;
+		comp.rect = ccv_rect(sfmt_genrand_uint32(&sfmt) % 1000 - 100, sfmt_genrand_uint32(&sfmt) % 800 - 100, size, size);
+		ccv_array_push(array, &comp);
+	}
+	ccv_array_t* idx = 0;
+	int ncomp = ccv_array_group(array, &idx, is_near, 0);
+	ccv_array_t* sidx = 0;
+	int nscomp = ccv_array_group_spatial(array, &sidx, is_near, is_near_hint, 0);
+	REQUIRE(ncomp < 2000, "some of the rectangles should be grouped");
+	REQUIRE_EQ(ncomp, nscomp, "should have the same number of groups");
+	REQUIRE_ARRAY_EQ(int, (int*)ccv_array_get(idx, 0), (int*)ccv_array_get(sidx, 0), 2000, "should have the same partition");
+	ccv_array_free(array);
+	ccv_array_free(idx);
+	ccv_array_free(sidx);
+}
+
 TEST_CASE("specific sparse matrix insertion")
 {
 	ccv_sparse_matrix_t* mat = ccv_sparse_matrix_new(1, 70, CCV_32S | CCV_C1, CCV_SPARSE_ROW_MAJOR, 0);
@@ -438,4 +488,32 @@ TEST_CASE("half precision and float-point conversion")
 	ccfree(c);
 }
 
+TEST_CASE("half precision conversion of special values and large buffer")
+{
+	uint32_t u[] = {
+		0x3f800000, 0x477fe000, 0x477fffff, 0x47800000, 0x49742400, 0xc9742400, 0x7f800000, 0xff800000,
+		0x7fc00000, 0x7f800001, 0x7f802000, 0x33800000, 0x337fffff, 0x00000001, 0x80000000, 0x3f800fff,
+	};
+	uint16_t hu[] = {
+		0x3c00, 0x7bff, 0x7bff, 0x7c00, 0x7c00, 0xfc00, 0x7c00, 0xfc00,
+		0x7e00, 0x7c00, 0x7c01, 0x0001, 0x0000, 0x0000, 0x8000, 0x3c00,
+	};
+	uint16_t h[16];
+	ccv_float_to_half_precision((float*)u, h, 16);
+	REQUIRE_ARRAY_EQ(uint16_t, hu, h, 16, "special values should truncate, overflow to infinity and keep NaN payload");
+	const int len = 0x10000 * 5 + 3;
+	uint16_t* a = (uint16_t*)ccmalloc(sizeof(uint16_t) * len);
+	float* f = (float*)ccmalloc(sizeof(float) * len);
+	uint16_t* b = (uint16_t*)ccmalloc(sizeof(uint16_t) * len);
+	int i;
+	for (i = 0; i < len; i++)
+		a[i] = (uint16_t)(i * 7);
+	ccv_half_precision_to_float(a, f, len);
+	ccv_float_to_half_precision(f, b, len);
+	REQUIRE_ARRAY_EQ(uint16_t, a, b, len, "large buffer should convert back and forth exactly, including signaling NaN");
+	ccfree(a);
+	ccfree(f);
+	ccfree(b);
+}
+
 #include "case_main.h"